@@ -0,0 +1,146 @@
+#include "bench.h"
+#include "../src/platform.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Results of the measured functions end up here so they can't be elided
+static volatile uint64_t sink;
+
+void vgltf_bench_options_init_default(struct vgltf_bench_options *options) {
+  *options = (struct vgltf_bench_options){
+      .sample_count = 30,
+      .warmup_sample_count = 3,
+      .min_sample_nanoseconds = 10 * 1000 * 1000};
+}
+
+static uint64_t measure_sample(const struct vgltf_bench_case *bench_case,
+                               uint64_t iteration_count) {
+  uint64_t start = vgltf_platform_get_ticks_nanoseconds();
+  sink ^= bench_case->function(bench_case->state, iteration_count);
+  return vgltf_platform_get_ticks_nanoseconds() - start;
+}
+
+static int compare_doubles(const void *lhs, const void *rhs) {
+  double a = *(const double *)lhs;
+  double b = *(const double *)rhs;
+  return (a > b) - (a < b);
+}
+
+// samples must be sorted
+static double sorted_median(const double *samples, uint32_t sample_count) {
+  return sample_count % 2
+             ? samples[sample_count / 2]
+             : (samples[sample_count / 2 - 1] + samples[sample_count / 2]) / 2;
+}
+
+bool vgltf_bench_run(const struct vgltf_bench_options *options,
+                     const struct vgltf_bench_case *bench_case,
+                     struct vgltf_bench_result *result) {
+  if (options->filter && !strstr(bench_case->name, options->filter)) {
+    return false;
+  }
+  assert(options->sample_count > 0 &&
+         options->sample_count <= VGLTF_BENCH_MAX_SAMPLE_COUNT);
+
+  // Also warms the caches up for the first warmup sample
+  uint64_t iteration_count = 1;
+  while (measure_sample(bench_case, iteration_count) <
+             options->min_sample_nanoseconds &&
+         iteration_count < UINT64_MAX / 2) {
+    iteration_count *= 2;
+  }
+
+  for (uint32_t sample_index = 0; sample_index < options->warmup_sample_count;
+       sample_index++) {
+    measure_sample(bench_case, iteration_count);
+  }
+
+  double samples[VGLTF_BENCH_MAX_SAMPLE_COUNT];
+  double sum = 0.0;
+  for (uint32_t sample_index = 0; sample_index < options->sample_count;
+       sample_index++) {
+    samples[sample_index] =
+        (double)measure_sample(bench_case, iteration_count) / iteration_count;
+    sum += samples[sample_index];
+  }
+
+  uint32_t sample_count = options->sample_count;
+  double mean = sum / sample_count;
+  double squared_deviation_sum = 0.0;
+  for (uint32_t sample_index = 0; sample_index < sample_count;
+       sample_index++) {
+    double deviation = samples[sample_index] - mean;
+    squared_deviation_sum += deviation * deviation;
+  }
+  double standard_deviation =
+      sample_count > 1 ? sqrt(squared_deviation_sum / (sample_count - 1)) : 0.0;
+
+  qsort(samples, sample_count, sizeof(double), compare_doubles);
+  double median = sorted_median(samples, sample_count);
+  double deviations[VGLTF_BENCH_MAX_SAMPLE_COUNT];
+  for (uint32_t sample_index = 0; sample_index < sample_count;
+       sample_index++) {
+    deviations[sample_index] = fabs(samples[sample_index] - median);
+  }
+  qsort(deviations, sample_count, sizeof(double), compare_doubles);
+
+  *result = (struct vgltf_bench_result){
+      .name = bench_case->name,
+      .iterations_per_sample = iteration_count,
+      .sample_count = sample_count,
+      .min = samples[0],
+      .median = median,
+      .mean = mean,
+      .standard_deviation = standard_deviation,
+      .median_absolute_deviation = sorted_median(deviations, sample_count),
+      .mean_confidence_interval =
+          1.96 * standard_deviation / sqrt((double)sample_count),
+      .bytes_per_second = bench_case->bytes_per_iteration > 0 && median > 0.0
+                              ? bench_case->bytes_per_iteration * 1e9 / median
+                              : 0.0};
+  return true;
+}
+
+void vgltf_bench_print_result(FILE *file,
+                              const struct vgltf_bench_result *result) {
+  fprintf(file, "%-40s %14.2f ns (mad %6.2f%%, min %14.2f ns)", result->name,
+          result->median,
+          result->median > 0.0
+              ? 100.0 * result->median_absolute_deviation / result->median
+              : 0.0,
+          result->min);
+  if (result->bytes_per_second > 0.0) {
+    fprintf(file, " %10.2f MiB/s", result->bytes_per_second / (1024 * 1024));
+  }
+  fputc('\n', file);
+}
+
+void vgltf_bench_write_json(FILE *file,
+                            const struct vgltf_bench_options *options,
+                            const struct vgltf_bench_result *results,
+                            size_t result_count) {
+  // Case names are plain identifiers, they don't need escaping
+  fprintf(file,
+          "{\n  \"sample_count\": %u,\n  \"warmup_sample_count\": %u,\n"
+          "  \"min_sample_nanoseconds\": %llu,\n  \"benchmarks\": [",
+          options->sample_count, options->warmup_sample_count,
+          (unsigned long long)options->min_sample_nanoseconds);
+  for (size_t result_index = 0; result_index < result_count; result_index++) {
+    const struct vgltf_bench_result *result = &results[result_index];
+    fprintf(file,
+            "%s\n    {\"name\": \"%s\", \"iterations_per_sample\": %llu, "
+            "\"unit\": \"ns\", \"min\": %.3f, \"median\": %.3f, "
+            "\"mean\": %.3f, \"standard_deviation\": %.3f, "
+            "\"median_absolute_deviation\": %.3f, "
+            "\"mean_confidence_interval_95\": %.3f, "
+            "\"bytes_per_second\": %.1f}",
+            result_index > 0 ? "," : "", result->name,
+            (unsigned long long)result->iterations_per_sample, result->min,
+            result->median, result->mean, result->standard_deviation,
+            result->median_absolute_deviation,
+            result->mean_confidence_interval, result->bytes_per_second);
+  }
+  fprintf(file, "\n  ]\n}\n");
+}
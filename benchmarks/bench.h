@@ -0,0 +1,61 @@
+#ifndef VGLTF_BENCH_H
+#define VGLTF_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Runs the measured code iteration_count times. The returned value is
+// consumed by the harness so the work can't be optimized away.
+typedef uint64_t (*vgltf_bench_function)(void *state, uint64_t iteration_count);
+
+struct vgltf_bench_case {
+  const char *name;
+  vgltf_bench_function function;
+  void *state;
+  // Bytes processed per iteration, 0 when a throughput isn't meaningful
+  uint64_t bytes_per_iteration;
+};
+
+struct vgltf_bench_options {
+  // Substring a case name must contain to run, nullptr runs every case
+  const char *filter;
+  uint32_t sample_count;
+  uint32_t warmup_sample_count;
+  // Iteration counts are doubled until a sample lasts at least this long
+  uint64_t min_sample_nanoseconds;
+};
+
+constexpr uint32_t VGLTF_BENCH_MAX_SAMPLE_COUNT = 1024;
+
+// Nanoseconds per iteration statistics over the samples
+struct vgltf_bench_result {
+  const char *name;
+  uint64_t iterations_per_sample;
+  uint32_t sample_count;
+  double min;
+  double median;
+  double mean;
+  double standard_deviation;
+  // Median absolute deviation, robust to the outliers a busy machine causes
+  double median_absolute_deviation;
+  // 95% confidence interval half width of the mean
+  double mean_confidence_interval;
+  double bytes_per_second;
+};
+
+void vgltf_bench_options_init_default(struct vgltf_bench_options *options);
+
+// Returns false if the case got filtered out
+bool vgltf_bench_run(const struct vgltf_bench_options *options,
+                     const struct vgltf_bench_case *bench_case,
+                     struct vgltf_bench_result *result);
+
+void vgltf_bench_print_result(FILE *file,
+                              const struct vgltf_bench_result *result);
+void vgltf_bench_write_json(FILE *file,
+                            const struct vgltf_bench_options *options,
+                            const struct vgltf_bench_result *results,
+                            size_t result_count);
+
+#endif // VGLTF_BENCH_H
@@ -0,0 +1,977 @@
+// CPU side hot path microbenchmarks, run from the source root so the assets
+// are found:
+// vgltf_benchmarks [--filter name] [--json path] [--samples count]
+//                  [--warmup count] [--min-sample-ms milliseconds]
+#include "../src/alloc.h"
+#include "../src/gltf.h"
+#include "../src/gltf_accessor.h"
+#include "../src/hash.h"
+#include "../src/json.h"
+#include "../src/log.h"
+#include "../src/maths.h"
+#include "../src/platform.h"
+#include "../src/renderer/renderer.h"
+#include "../src/str.h"
+#include "../src/string_interner.h"
+#include "bench.h"
+#include <stb_image.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+#define TINYOBJ_LOADER_C_IMPLEMENTATION
+#include <tiny_obj_loader_c.h>
+
+static const char MODEL_PATH[] = "assets/model.obj";
+static const char TEXTURE_PATH[] = "assets/texture.png";
+
+// Deterministic inputs, the same on every run
+static uint64_t random_next(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+struct buffer {
+  char *data;
+  size_t size;
+};
+
+static bool buffer_append(struct buffer *buffer, size_t *capacity,
+                          const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+static bool buffer_append(struct buffer *buffer, size_t *capacity,
+                          const char *format, ...) {
+  while (true) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer->data + buffer->size,
+                           *capacity - buffer->size, format, args);
+    va_end(args);
+    if (length < 0) {
+      return false;
+    }
+    if (buffer->size + length < *capacity) {
+      buffer->size += length;
+      return true;
+    }
+
+    size_t new_capacity = *capacity * 2 + length;
+    char *data = vgltf_allocator_reallocate(&system_allocator, buffer->data,
+                                            *capacity, new_capacity);
+    if (!data) {
+      return false;
+    }
+    buffer->data = data;
+    *capacity = new_capacity;
+  }
+}
+
+static uint64_t bench_hash_fnv_1a(void *state, uint64_t iteration_count) {
+  const struct buffer *buffer = state;
+  uint64_t hash = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    hash ^= vgltf_hash_fnv_1a(buffer->data, buffer->size);
+  }
+  return hash;
+}
+
+static uint64_t bench_hash_64(void *state, uint64_t iteration_count) {
+  const struct buffer *buffer = state;
+  uint64_t hash = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    hash ^= vgltf_hash_64(buffer->data, buffer->size);
+  }
+  return hash;
+}
+
+static uint64_t bench_hash_128(void *state, uint64_t iteration_count) {
+  const struct buffer *buffer = state;
+  uint64_t hash = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    struct vgltf_hash_128_value value =
+        vgltf_hash_128(buffer->data, buffer->size);
+    hash ^= value.low ^ value.high;
+  }
+  return hash;
+}
+
+// Fed in 4KiB updates, as when hashing a file while reading it
+static uint64_t bench_hash_streamed(void *state, uint64_t iteration_count) {
+  const struct buffer *buffer = state;
+  static constexpr size_t UPDATE_SIZE = 4096;
+  uint64_t hash = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    struct vgltf_hash_state hash_state;
+    vgltf_hash_state_init(&hash_state);
+    for (size_t offset = 0; offset < buffer->size; offset += UPDATE_SIZE) {
+      size_t remaining_size = buffer->size - offset;
+      vgltf_hash_state_update(&hash_state, buffer->data + offset,
+                              remaining_size < UPDATE_SIZE ? remaining_size
+                                                           : UPDATE_SIZE);
+    }
+    hash ^= vgltf_hash_state_digest_64(&hash_state);
+  }
+  return hash;
+}
+
+// Names as found in glTF files
+static const char *STRING_KEYS[] = {
+    "POSITION",        "NORMAL",
+    "TANGENT",         "TEXCOORD_0",
+    "TEXCOORD_1",      "COLOR_0",
+    "JOINTS_0",        "WEIGHTS_0",
+    "baseColorTexture", "metallicRoughnessTexture",
+    "textures/Sponza_Bricks_a_Albedo.png",
+    "materials/lion_head_emissive_strength_material"};
+static constexpr size_t STRING_KEY_COUNT =
+    sizeof(STRING_KEYS) / sizeof(STRING_KEYS[0]);
+
+static uint64_t bench_string_view_hash(void *state, uint64_t iteration_count) {
+  const struct vgltf_string_view *views = state;
+  uint64_t hash = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    for (size_t key_index = 0; key_index < STRING_KEY_COUNT; key_index++) {
+      hash ^= vgltf_string_view_hash(views[key_index]);
+    }
+  }
+  return hash;
+}
+
+// Every key is already interned, as for the names repeated through a file
+struct string_intern_input {
+  struct vgltf_string_interner *interner;
+  const struct vgltf_string_view *views;
+};
+
+static uint64_t bench_string_intern(void *state, uint64_t iteration_count) {
+  const struct string_intern_input *input = state;
+  uint64_t id_sum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    for (size_t key_index = 0; key_index < STRING_KEY_COUNT; key_index++) {
+      id_sum += vgltf_string_interner_intern(input->interner,
+                                             input->views[key_index]);
+    }
+  }
+  return id_sum;
+}
+
+static uint64_t bench_utf8_validate(void *state, uint64_t iteration_count) {
+  const struct buffer *text = state;
+  uint64_t valid_count = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    valid_count += vgltf_string_view_utf8_validate(
+        (struct vgltf_string_view){.data = text->data, .length = text->size});
+  }
+  return valid_count;
+}
+
+// One codepoint per call, the baseline for the bulk decoder
+static uint64_t bench_utf8_codepoint_at_offset(void *state,
+                                               uint64_t iteration_count) {
+  const struct buffer *text = state;
+  struct vgltf_string_view view = {.data = text->data, .length = text->size};
+  uint64_t codepoint_sum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    for (size_t offset = 0; offset < view.length;) {
+      uint32_t codepoint;
+      offset +=
+          vgltf_string_view_utf8_codepoint_at_offset(view, offset, &codepoint);
+      codepoint_sum += codepoint;
+    }
+  }
+  return codepoint_sum;
+}
+
+struct utf8_decode_input {
+  const struct buffer *text;
+  uint32_t *codepoints;
+};
+
+static uint64_t bench_utf8_decode(void *state, uint64_t iteration_count) {
+  const struct utf8_decode_input *input = state;
+  uint64_t codepoint_count_sum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    size_t codepoint_count;
+    if (!vgltf_string_view_utf8_decode(
+            (struct vgltf_string_view){.data = input->text->data,
+                                       .length = input->text->size},
+            input->codepoints, input->text->size, &codepoint_count)) {
+      VGLTF_PANIC("Couldn't decode the text");
+    }
+    codepoint_count_sum += codepoint_count + input->codepoints[0];
+  }
+  return codepoint_count_sum;
+}
+
+// Chained so the latency is measured rather than the throughput
+static uint64_t bench_mat4_multiply(void *state, uint64_t iteration_count) {
+  (void)state;
+  vgltf_mat4 matrix = VGLTF_MAT4_IDENTITY;
+  vgltf_mat4 rotation;
+  vgltf_mat4_rotate(rotation, matrix, 0.01f, (vgltf_vec3){0.f, 0.f, 1.f});
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    vgltf_mat4 result;
+    vgltf_mat4_multiply(result, matrix, rotation);
+    memcpy(matrix, result, sizeof(matrix));
+  }
+  uint32_t bits;
+  memcpy(&bits, &matrix[0], sizeof(bits));
+  return bits;
+}
+
+static constexpr int ALLOCATION_COUNT = 256;
+static size_t allocation_size(int allocation_index) {
+  return 16 + (allocation_index * 37) % 240;
+}
+
+static uint64_t bench_system_allocator(void *state, uint64_t iteration_count) {
+  (void)state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    char *allocations[ALLOCATION_COUNT];
+    for (int allocation_index = 0; allocation_index < ALLOCATION_COUNT;
+         allocation_index++) {
+      allocations[allocation_index] = vgltf_allocator_allocate(
+          &system_allocator, allocation_size(allocation_index));
+      allocations[allocation_index][0] = (char)allocation_index;
+    }
+    for (int allocation_index = 0; allocation_index < ALLOCATION_COUNT;
+         allocation_index++) {
+      checksum += allocations[allocation_index][0];
+      vgltf_allocator_free(&system_allocator, allocations[allocation_index]);
+    }
+  }
+  return checksum;
+}
+
+static uint64_t bench_arena_allocator(void *state, uint64_t iteration_count) {
+  struct vgltf_arena *arena = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    char *allocations[ALLOCATION_COUNT];
+    for (int allocation_index = 0; allocation_index < ALLOCATION_COUNT;
+         allocation_index++) {
+      allocations[allocation_index] =
+          vgltf_arena_allocate(arena, allocation_size(allocation_index));
+      allocations[allocation_index][0] = (char)allocation_index;
+    }
+    for (int allocation_index = 0; allocation_index < ALLOCATION_COUNT;
+         allocation_index++) {
+      checksum += allocations[allocation_index][0];
+    }
+    vgltf_arena_reset(arena);
+  }
+  return checksum;
+}
+
+// tinyobj reads the OBJ through a callback, referenced materials resolve to a
+// single default one as they aren't what's benchmarked
+static char DEFAULT_MTL[] = "newmtl default\n";
+static void get_obj_data(void *ctx, const char *filename, const int is_mtl,
+                         const char *obj_filename, char **data, size_t *len) {
+  (void)filename;
+  (void)obj_filename;
+  const struct buffer *obj = ctx;
+  *data = is_mtl ? DEFAULT_MTL : obj->data;
+  *len = is_mtl ? sizeof(DEFAULT_MTL) - 1 : obj->size;
+}
+
+static uint64_t bench_obj_parse(void *state, uint64_t iteration_count) {
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    tinyobj_attrib_t attrib;
+    tinyobj_shape_t *shapes = nullptr;
+    size_t shape_count = 0;
+    tinyobj_material_t *materials = nullptr;
+    size_t material_count = 0;
+    if (tinyobj_parse_obj(&attrib, &shapes, &shape_count, &materials,
+                          &material_count, "model.obj", get_obj_data, state,
+                          TINYOBJ_FLAG_TRIANGULATE) != TINYOBJ_SUCCESS) {
+      VGLTF_PANIC("Couldn't parse the OBJ");
+    }
+    checksum += attrib.num_faces;
+    tinyobj_attrib_free(&attrib);
+    tinyobj_shapes_free(shapes, shape_count);
+    tinyobj_materials_free(materials, material_count);
+  }
+  return checksum;
+}
+
+static uint64_t bench_gltf_parse(void *state, uint64_t iteration_count) {
+  const struct buffer *gltf = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    cgltf_options options = {};
+    cgltf_data *data = nullptr;
+    if (cgltf_parse(&options, gltf->data, gltf->size, &data) !=
+        cgltf_result_success) {
+      VGLTF_PANIC("Couldn't parse the glTF");
+    }
+    checksum += data->accessors_count;
+    cgltf_free(data);
+  }
+  return checksum;
+}
+
+static uint64_t bench_json_tokenize(void *state, uint64_t iteration_count) {
+  const struct buffer *json = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    struct vgltf_json_document document;
+    if (!vgltf_json_document_parse(
+            &document, &system_allocator,
+            (struct vgltf_string_view){.data = json->data,
+                                       .length = json->size})) {
+      VGLTF_PANIC("Couldn't tokenize the JSON");
+    }
+    checksum += document.token_count;
+    vgltf_json_document_deinit(&document, &system_allocator);
+  }
+  return checksum;
+}
+
+// The names are already interned after the first iteration
+struct vgltf_gltf_parse_input {
+  const struct buffer *gltf;
+  struct vgltf_string_interner *interner;
+};
+
+static uint64_t bench_vgltf_gltf_parse(void *state, uint64_t iteration_count) {
+  const struct vgltf_gltf_parse_input *input = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    struct vgltf_gltf gltf;
+    if (!vgltf_gltf_parse(
+            &gltf, &system_allocator, input->interner,
+            (struct vgltf_string_view){.data = input->gltf->data,
+                                       .length = input->gltf->size})) {
+      VGLTF_PANIC("Couldn't parse the glTF");
+    }
+    checksum += gltf.accessor_count;
+    vgltf_gltf_deinit(&gltf, &system_allocator);
+  }
+  return checksum;
+}
+
+// The same vertex data seen through vgltf and cgltf accessors: interleaved
+// float positions and normalized unsigned short texture coordinates, and 16
+// bits indices
+static constexpr uint32_t ACCESSOR_ELEMENT_COUNT = 1 << 16;
+enum accessor_kind {
+  ACCESSOR_KIND_POSITION,
+  ACCESSOR_KIND_TEXTURE_COORDINATES,
+  ACCESSOR_KIND_INDICES,
+  ACCESSOR_KIND_COUNT
+};
+struct accessor_input {
+  struct vgltf_gltf gltf;
+  struct vgltf_gltf_buffer buffer;
+  struct vgltf_gltf_buffer_view buffer_views[2];
+  struct vgltf_gltf_accessor accessors[ACCESSOR_KIND_COUNT];
+  cgltf_buffer cgltf_buffer;
+  cgltf_buffer_view cgltf_buffer_views[2];
+  cgltf_accessor cgltf_accessors[ACCESSOR_KIND_COUNT];
+  float *values;
+};
+
+struct accessor_case {
+  struct accessor_input *input;
+  enum accessor_kind kind;
+};
+
+static uint64_t bench_accessor_read_floats(void *state,
+                                           uint64_t iteration_count) {
+  const struct accessor_case *accessor_case = state;
+  struct accessor_input *input = accessor_case->input;
+  uint32_t component_count = vgltf_gltf_accessor_type_component_count(
+      input->accessors[accessor_case->kind].type);
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    if (!vgltf_gltf_accessor_read_floats(
+            &input->gltf, accessor_case->kind, 0, ACCESSOR_ELEMENT_COUNT,
+            input->values, component_count, component_count)) {
+      VGLTF_PANIC("Couldn't read the accessor");
+    }
+    checksum += (uint64_t)input->values[ACCESSOR_ELEMENT_COUNT - 1];
+  }
+  return checksum;
+}
+
+static uint64_t bench_cgltf_accessor_unpack_floats(void *state,
+                                                   uint64_t iteration_count) {
+  const struct accessor_case *accessor_case = state;
+  struct accessor_input *input = accessor_case->input;
+  const cgltf_accessor *accessor =
+      &input->cgltf_accessors[accessor_case->kind];
+  cgltf_size float_count = cgltf_accessor_unpack_floats(accessor, nullptr, 0);
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    if (cgltf_accessor_unpack_floats(accessor, input->values, float_count) !=
+        float_count) {
+      VGLTF_PANIC("Couldn't unpack the accessor");
+    }
+    checksum += (uint64_t)input->values[ACCESSOR_ELEMENT_COUNT - 1];
+  }
+  return checksum;
+}
+
+static uint64_t bench_accessor_read_indices(void *state,
+                                            uint64_t iteration_count) {
+  struct accessor_input *input = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    uint32_t max_index;
+    if (!vgltf_gltf_accessor_read_indices(
+            &input->gltf, ACCESSOR_KIND_INDICES, 0, ACCESSOR_ELEMENT_COUNT,
+            (uint32_t *)input->values, &max_index)) {
+      VGLTF_PANIC("Couldn't read the indices");
+    }
+    checksum += max_index;
+  }
+  return checksum;
+}
+
+static uint64_t bench_cgltf_accessor_unpack_indices(void *state,
+                                                    uint64_t iteration_count) {
+  struct accessor_input *input = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    if (cgltf_accessor_unpack_indices(
+            &input->cgltf_accessors[ACCESSOR_KIND_INDICES], input->values,
+            sizeof(uint32_t), ACCESSOR_ELEMENT_COUNT) !=
+        ACCESSOR_ELEMENT_COUNT) {
+      VGLTF_PANIC("Couldn't unpack the indices");
+    }
+    checksum += ((uint32_t *)input->values)[ACCESSOR_ELEMENT_COUNT - 1];
+  }
+  return checksum;
+}
+
+// Unindexed triangles, as load_obj_model builds them
+struct weld_input {
+  struct vgltf_vertex *vertices;
+  uint32_t vertex_count;
+  uint32_t *indices;
+  uint32_t *table;
+  uint32_t table_capacity;
+};
+
+static uint64_t bench_weld_vertices(void *state, uint64_t iteration_count) {
+  struct weld_input *input = state;
+  uint64_t unique_vertex_count = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    // Open addressing table of unique vertex indices plus one
+    memset(input->table, 0, input->table_capacity * sizeof(uint32_t));
+    uint32_t unique_count = 0;
+    for (uint32_t vertex_index = 0; vertex_index < input->vertex_count;
+         vertex_index++) {
+      const struct vgltf_vertex *vertex = &input->vertices[vertex_index];
+      uint64_t slot = vgltf_hash_64((const char *)vertex, sizeof(*vertex)) &
+                      (input->table_capacity - 1);
+      while (input->table[slot] != 0 &&
+             memcmp(&input->vertices[input->table[slot] - 1], vertex,
+                    sizeof(*vertex)) != 0) {
+        slot = (slot + 1) & (input->table_capacity - 1);
+      }
+      if (input->table[slot] == 0) {
+        input->table[slot] = vertex_index + 1;
+        unique_count++;
+      }
+      input->indices[vertex_index] = input->table[slot] - 1;
+    }
+    unique_vertex_count += unique_count;
+  }
+  return unique_vertex_count;
+}
+
+static uint64_t bench_image_decode(void *state, uint64_t iteration_count) {
+  const struct buffer *png = state;
+  uint64_t checksum = 0;
+  for (uint64_t iteration = 0; iteration < iteration_count; iteration++) {
+    int width;
+    int height;
+    int channels;
+    stbi_uc *pixels =
+        stbi_load_from_memory((const stbi_uc *)png->data, (int)png->size,
+                              &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+      VGLTF_PANIC("Couldn't decode the image");
+    }
+    checksum += pixels[0];
+    stbi_image_free(pixels);
+  }
+  return checksum;
+}
+
+static constexpr int GRID_SIZE = 128;
+
+static bool generate_grid_obj(struct buffer *obj) {
+  size_t capacity = 1 << 20;
+  *obj = (struct buffer){
+      .data = vgltf_allocator_allocate(&system_allocator, capacity)};
+  if (!obj->data) {
+    return false;
+  }
+
+  for (int y = 0; y <= GRID_SIZE; y++) {
+    for (int x = 0; x <= GRID_SIZE; x++) {
+      if (!buffer_append(obj, &capacity, "v %f %f 0\nvt %f %f\n",
+                         (float)x / GRID_SIZE, (float)y / GRID_SIZE,
+                         (float)x / GRID_SIZE, (float)y / GRID_SIZE)) {
+        return false;
+      }
+    }
+  }
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      int corner = y * (GRID_SIZE + 1) + x + 1;
+      int a = corner;
+      int b = corner + 1;
+      int c = corner + GRID_SIZE + 2;
+      int d = corner + GRID_SIZE + 1;
+      if (!buffer_append(obj, &capacity, "f %d/%d %d/%d %d/%d %d/%d\n", a, a,
+                         b, b, c, c, d, d)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Scene shaped like exported ones, every mesh has its own accessors
+static constexpr int GLTF_MESH_COUNT = 1024;
+static bool generate_gltf(struct buffer *gltf) {
+  size_t capacity = 1 << 20;
+  *gltf = (struct buffer){
+      .data = vgltf_allocator_allocate(&system_allocator, capacity)};
+  if (!gltf->data) {
+    return false;
+  }
+
+  static constexpr int VERTEX_COUNT = 1024;
+  static constexpr int INDEX_COUNT = 3072;
+  static constexpr int MESH_SIZE = VERTEX_COUNT * 32 + INDEX_COUNT * 4;
+  bool appended =
+      buffer_append(gltf, &capacity,
+                    "{\"asset\": {\"version\": \"2.0\"}, \"scene\": 0, "
+                    "\"buffers\": [{\"byteLength\": %d}], \"bufferViews\": [",
+                    GLTF_MESH_COUNT * MESH_SIZE);
+  for (int mesh = 0; mesh < GLTF_MESH_COUNT && appended; mesh++) {
+    int offset = mesh * MESH_SIZE;
+    appended = buffer_append(
+        gltf, &capacity,
+        "%s{\"buffer\": 0, \"byteOffset\": %d, \"byteLength\": %d, "
+        "\"byteStride\": 32, \"target\": 34962}, "
+        "{\"buffer\": 0, \"byteOffset\": %d, \"byteLength\": %d, "
+        "\"target\": 34963}",
+        mesh > 0 ? ", " : "", offset, VERTEX_COUNT * 32,
+        offset + VERTEX_COUNT * 32, INDEX_COUNT * 4);
+  }
+  appended = appended && buffer_append(gltf, &capacity, "], \"accessors\": [");
+  for (int mesh = 0; mesh < GLTF_MESH_COUNT && appended; mesh++) {
+    appended = buffer_append(
+        gltf, &capacity,
+        "%s{\"bufferView\": %d, \"componentType\": 5126, \"count\": %d, "
+        "\"type\": \"VEC3\", \"min\": [-1.0, -1.0, -1.0], "
+        "\"max\": [1.0, 1.0, 1.0]}, "
+        "{\"bufferView\": %d, \"byteOffset\": 12, \"componentType\": 5126, "
+        "\"count\": %d, \"type\": \"VEC3\"}, "
+        "{\"bufferView\": %d, \"byteOffset\": 24, \"componentType\": 5126, "
+        "\"count\": %d, \"type\": \"VEC2\"}, "
+        "{\"bufferView\": %d, \"componentType\": 5125, \"count\": %d, "
+        "\"type\": \"SCALAR\"}",
+        mesh > 0 ? ", " : "", mesh * 2, VERTEX_COUNT, mesh * 2, VERTEX_COUNT,
+        mesh * 2, VERTEX_COUNT, mesh * 2 + 1, INDEX_COUNT);
+  }
+  appended = appended && buffer_append(gltf, &capacity, "], \"meshes\": [");
+  for (int mesh = 0; mesh < GLTF_MESH_COUNT && appended; mesh++) {
+    appended = buffer_append(
+        gltf, &capacity,
+        "%s{\"name\": \"mesh_%d\", \"primitives\": [{\"attributes\": "
+        "{\"POSITION\": %d, \"NORMAL\": %d, \"TEXCOORD_0\": %d}, "
+        "\"indices\": %d}]}",
+        mesh > 0 ? ", " : "", mesh, mesh * 4, mesh * 4 + 1, mesh * 4 + 2,
+        mesh * 4 + 3);
+  }
+  appended = appended && buffer_append(gltf, &capacity, "], \"nodes\": [");
+  for (int mesh = 0; mesh < GLTF_MESH_COUNT && appended; mesh++) {
+    appended = buffer_append(
+        gltf, &capacity,
+        "%s{\"name\": \"node_%d\", \"mesh\": %d, "
+        "\"translation\": [%d.0, 0.0, 0.0]}",
+        mesh > 0 ? ", " : "", mesh, mesh, mesh);
+  }
+  appended = appended &&
+             buffer_append(gltf, &capacity, "], \"scenes\": [{\"nodes\": [");
+  for (int mesh = 0; mesh < GLTF_MESH_COUNT && appended; mesh++) {
+    appended =
+        buffer_append(gltf, &capacity, "%s%d", mesh > 0 ? ", " : "", mesh);
+  }
+  return appended && buffer_append(gltf, &capacity, "]}]}");
+}
+
+// Names and paths of a localized asset, mostly ASCII with some multibyte
+// codepoints
+static bool generate_mixed_text(struct buffer *text) {
+  size_t capacity = 1 << 20;
+  *text = (struct buffer){
+      .data = vgltf_allocator_allocate(&system_allocator, capacity)};
+  if (!text->data) {
+    return false;
+  }
+
+  for (int line = 0; line < 8192; line++) {
+    if (!buffer_append(text, &capacity,
+                       "\"name\": \"Matériau_%d_木材\", \"uri\": "
+                       "\"textures/façade_%d.png\",\n",
+                       line, line)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool generate_weld_input(struct weld_input *input) {
+  input->vertex_count = GRID_SIZE * GRID_SIZE * 6;
+  input->table_capacity = 1;
+  while (input->table_capacity < input->vertex_count * 2) {
+    input->table_capacity *= 2;
+  }
+  input->vertices = vgltf_allocator_allocate_array(
+      &system_allocator, input->vertex_count, sizeof(struct vgltf_vertex));
+  input->indices = vgltf_allocator_allocate_array(
+      &system_allocator, input->vertex_count, sizeof(uint32_t));
+  input->table = vgltf_allocator_allocate_array(
+      &system_allocator, input->table_capacity, sizeof(uint32_t));
+  if (!input->vertices || !input->indices || !input->table) {
+    return false;
+  }
+
+  static constexpr int QUAD_CORNERS[6][2] = {{0, 0}, {1, 0}, {1, 1},
+                                             {0, 0}, {1, 1}, {0, 1}};
+  uint32_t vertex_index = 0;
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      for (int corner = 0; corner < 6; corner++) {
+        float u = (float)(x + QUAD_CORNERS[corner][0]) / GRID_SIZE;
+        float v = (float)(y + QUAD_CORNERS[corner][1]) / GRID_SIZE;
+        input->vertices[vertex_index++] =
+            (struct vgltf_vertex){.position = {u, v, 0.f},
+                                  .color = {1.f, 1.f, 1.f},
+                                  .texture_coordinates = {u, 1.f - v}};
+      }
+    }
+  }
+  return true;
+}
+
+static bool generate_accessor_input(struct accessor_input *input) {
+  static constexpr uint32_t VERTEX_SIZE = 16;
+  static constexpr uint64_t VERTICES_SIZE =
+      (uint64_t)ACCESSOR_ELEMENT_COUNT * VERTEX_SIZE;
+  static constexpr uint64_t INDICES_SIZE =
+      (uint64_t)ACCESSOR_ELEMENT_COUNT * sizeof(uint16_t);
+  char *data = vgltf_allocator_allocate(&system_allocator,
+                                        VERTICES_SIZE + INDICES_SIZE);
+  input->values = vgltf_allocator_allocate_array(
+      &system_allocator, ACCESSOR_ELEMENT_COUNT * 3, sizeof(float));
+  if (!data || !input->values) {
+    return false;
+  }
+
+  uint64_t random_state = 0x2545F4914F6CDD1Du;
+  for (uint32_t vertex_index = 0; vertex_index < ACCESSOR_ELEMENT_COUNT;
+       vertex_index++) {
+    char *vertex = data + (uint64_t)vertex_index * VERTEX_SIZE;
+    float position[3] = {(float)vertex_index, (float)(vertex_index % 256),
+                         (float)(vertex_index / 256)};
+    uint16_t texture_coordinates[2] = {
+        (uint16_t)random_next(&random_state),
+        (uint16_t)random_next(&random_state)};
+    memcpy(vertex, position, sizeof(position));
+    memcpy(vertex + sizeof(position), texture_coordinates,
+           sizeof(texture_coordinates));
+    uint16_t index = (uint16_t)(random_next(&random_state) % 65535);
+    memcpy(data + VERTICES_SIZE + vertex_index * sizeof(uint16_t), &index,
+           sizeof(index));
+  }
+
+  input->buffer = (struct vgltf_gltf_buffer){
+      .byte_length = VERTICES_SIZE + INDICES_SIZE, .data = data};
+  input->buffer_views[0] = (struct vgltf_gltf_buffer_view){
+      .byte_length = VERTICES_SIZE, .byte_stride = VERTEX_SIZE, .data = data};
+  input->buffer_views[1] =
+      (struct vgltf_gltf_buffer_view){.byte_offset = VERTICES_SIZE,
+                                      .byte_length = INDICES_SIZE,
+                                      .data = data + VERTICES_SIZE};
+  input->accessors[ACCESSOR_KIND_POSITION] = (struct vgltf_gltf_accessor){
+      .buffer_view = 0,
+      .component_type = VGLTF_GLTF_COMPONENT_TYPE_FLOAT,
+      .count = ACCESSOR_ELEMENT_COUNT,
+      .type = VGLTF_GLTF_ACCESSOR_TYPE_VEC3};
+  input->accessors[ACCESSOR_KIND_TEXTURE_COORDINATES] =
+      (struct vgltf_gltf_accessor){
+          .buffer_view = 0,
+          .byte_offset = 3 * sizeof(float),
+          .component_type = VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+          .normalized = true,
+          .count = ACCESSOR_ELEMENT_COUNT,
+          .type = VGLTF_GLTF_ACCESSOR_TYPE_VEC2};
+  input->accessors[ACCESSOR_KIND_INDICES] = (struct vgltf_gltf_accessor){
+      .buffer_view = 1,
+      .component_type = VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+      .count = ACCESSOR_ELEMENT_COUNT,
+      .type = VGLTF_GLTF_ACCESSOR_TYPE_SCALAR};
+  input->gltf = (struct vgltf_gltf){.buffers = &input->buffer,
+                                    .buffer_count = 1,
+                                    .buffer_views = input->buffer_views,
+                                    .buffer_view_count = 2,
+                                    .accessors = input->accessors,
+                                    .accessor_count = ACCESSOR_KIND_COUNT,
+                                    .scene = VGLTF_GLTF_INDEX_NONE};
+
+  input->cgltf_buffer =
+      (cgltf_buffer){.size = VERTICES_SIZE + INDICES_SIZE, .data = data};
+  input->cgltf_buffer_views[0] = (cgltf_buffer_view){
+      .buffer = &input->cgltf_buffer,
+      .size = VERTICES_SIZE,
+      .stride = VERTEX_SIZE};
+  input->cgltf_buffer_views[1] = (cgltf_buffer_view){
+      .buffer = &input->cgltf_buffer,
+      .offset = VERTICES_SIZE,
+      .size = INDICES_SIZE};
+  input->cgltf_accessors[ACCESSOR_KIND_POSITION] = (cgltf_accessor){
+      .component_type = cgltf_component_type_r_32f,
+      .type = cgltf_type_vec3,
+      .count = ACCESSOR_ELEMENT_COUNT,
+      .stride = VERTEX_SIZE,
+      .buffer_view = &input->cgltf_buffer_views[0]};
+  input->cgltf_accessors[ACCESSOR_KIND_TEXTURE_COORDINATES] = (cgltf_accessor){
+      .component_type = cgltf_component_type_r_16u,
+      .normalized = true,
+      .type = cgltf_type_vec2,
+      .offset = 3 * sizeof(float),
+      .count = ACCESSOR_ELEMENT_COUNT,
+      .stride = VERTEX_SIZE,
+      .buffer_view = &input->cgltf_buffer_views[0]};
+  input->cgltf_accessors[ACCESSOR_KIND_INDICES] = (cgltf_accessor){
+      .component_type = cgltf_component_type_r_16u,
+      .type = cgltf_type_scalar,
+      .count = ACCESSOR_ELEMENT_COUNT,
+      .stride = sizeof(uint16_t),
+      .buffer_view = &input->cgltf_buffer_views[1]};
+  return true;
+}
+
+static bool read_file(const char *path, struct buffer *buffer) {
+  buffer->data = vgltf_platform_read_file_to_string(path, &buffer->size);
+  if (!buffer->data) {
+    fprintf(stderr, "Couldn't read %s, benchmarks must run from the source "
+                    "root\n",
+            path);
+    return false;
+  }
+  return true;
+}
+
+static constexpr int MAX_CASE_COUNT = 64;
+
+int main(int argc, char **argv) {
+  // Falls back to writing messages directly
+  if (!vgltf_log_init()) {
+    VGLTF_LOG_ERR("Couldn't start the asynchronous logger");
+  }
+
+  struct vgltf_bench_options options;
+  vgltf_bench_options_init_default(&options);
+  const char *json_path = nullptr;
+  for (int arg_index = 1; arg_index < argc; arg_index++) {
+    bool has_value = arg_index + 1 < argc;
+    if (strcmp(argv[arg_index], "--filter") == 0 && has_value) {
+      options.filter = argv[++arg_index];
+    } else if (strcmp(argv[arg_index], "--json") == 0 && has_value) {
+      json_path = argv[++arg_index];
+    } else if (strcmp(argv[arg_index], "--samples") == 0 && has_value) {
+      options.sample_count = (uint32_t)atoi(argv[++arg_index]);
+    } else if (strcmp(argv[arg_index], "--warmup") == 0 && has_value) {
+      options.warmup_sample_count = (uint32_t)atoi(argv[++arg_index]);
+    } else if (strcmp(argv[arg_index], "--min-sample-ms") == 0 && has_value) {
+      options.min_sample_nanoseconds =
+          (uint64_t)atoi(argv[++arg_index]) * 1000 * 1000;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--filter name] [--json path] [--samples count] "
+              "[--warmup count] [--min-sample-ms milliseconds]\n",
+              argv[0]);
+      goto err;
+    }
+  }
+  if (options.sample_count == 0 ||
+      options.sample_count > VGLTF_BENCH_MAX_SAMPLE_COUNT) {
+    fprintf(stderr, "The sample count must be in [1, %u]\n",
+            VGLTF_BENCH_MAX_SAMPLE_COUNT);
+    goto err;
+  }
+
+  uint64_t random_state = 0x9E3779B97F4A7C15u;
+  static char random_bytes[64 * 1024];
+  for (size_t byte_index = 0; byte_index < sizeof(random_bytes);
+       byte_index++) {
+    random_bytes[byte_index] = (char)random_next(&random_state);
+  }
+  struct buffer hash_inputs[] = {{random_bytes, 8},
+                                 {random_bytes, 16},
+                                 {random_bytes, 64},
+                                 {random_bytes, 256},
+                                 {random_bytes, sizeof(random_bytes)}};
+
+  struct vgltf_string_view string_keys[STRING_KEY_COUNT];
+  for (size_t key_index = 0; key_index < STRING_KEY_COUNT; key_index++) {
+    string_keys[key_index] = SV(STRING_KEYS[key_index]);
+  }
+
+  static struct vgltf_string_interner interner;
+  if (!vgltf_string_interner_init(&interner, &system_allocator,
+                                  STRING_KEY_COUNT, 4096)) {
+    goto err;
+  }
+  for (size_t key_index = 0; key_index < STRING_KEY_COUNT; key_index++) {
+    vgltf_string_interner_intern(&interner, string_keys[key_index]);
+  }
+  struct string_intern_input string_intern_input = {.interner = &interner,
+                                                    .views = string_keys};
+
+  static struct vgltf_string_interner gltf_interner;
+  if (!vgltf_string_interner_init(&gltf_interner, &system_allocator,
+                                  2 * GLTF_MESH_COUNT, 64 * 1024)) {
+    goto err;
+  }
+
+  struct vgltf_arena arena;
+  vgltf_arena_init(&system_allocator, &arena, 64 * 1024);
+
+  struct buffer model_obj;
+  struct buffer texture_png;
+  struct buffer grid_obj;
+  struct buffer gltf;
+  struct buffer mixed_text;
+  struct weld_input weld_input;
+  static struct accessor_input accessor_input;
+  if (!read_file(MODEL_PATH, &model_obj) ||
+      !read_file(TEXTURE_PATH, &texture_png) ||
+      !generate_grid_obj(&grid_obj) || !generate_gltf(&gltf) ||
+      !generate_mixed_text(&mixed_text) || !generate_weld_input(&weld_input) ||
+      !generate_accessor_input(&accessor_input)) {
+    fprintf(stderr, "Couldn't prepare the benchmark inputs\n");
+    goto err;
+  }
+
+  size_t max_text_size = VGLTF_MAX(gltf.size, mixed_text.size);
+  uint32_t *codepoints = vgltf_allocator_allocate_array(
+      &system_allocator, max_text_size, sizeof(uint32_t));
+  if (!codepoints) {
+    fprintf(stderr, "Couldn't allocate the decoded codepoints\n");
+    goto err;
+  }
+  struct vgltf_gltf_parse_input vgltf_gltf_parse_input = {
+      .gltf = &gltf, .interner = &gltf_interner};
+  struct accessor_case position_accessor_case = {
+      .input = &accessor_input, .kind = ACCESSOR_KIND_POSITION};
+  struct accessor_case texture_coordinates_accessor_case = {
+      .input = &accessor_input, .kind = ACCESSOR_KIND_TEXTURE_COORDINATES};
+  struct utf8_decode_input gltf_decode_input = {.text = &gltf,
+                                                .codepoints = codepoints};
+  struct utf8_decode_input mixed_text_decode_input = {
+      .text = &mixed_text, .codepoints = codepoints};
+
+  const struct vgltf_bench_case cases[] = {
+      {"hash/fnv_1a/8", bench_hash_fnv_1a, &hash_inputs[0], 8},
+      {"hash/fnv_1a/16", bench_hash_fnv_1a, &hash_inputs[1], 16},
+      {"hash/fnv_1a/64", bench_hash_fnv_1a, &hash_inputs[2], 64},
+      {"hash/fnv_1a/256", bench_hash_fnv_1a, &hash_inputs[3], 256},
+      {"hash/fnv_1a/65536", bench_hash_fnv_1a, &hash_inputs[4],
+       sizeof(random_bytes)},
+      {"hash/hash_64/8", bench_hash_64, &hash_inputs[0], 8},
+      {"hash/hash_64/16", bench_hash_64, &hash_inputs[1], 16},
+      {"hash/hash_64/64", bench_hash_64, &hash_inputs[2], 64},
+      {"hash/hash_64/256", bench_hash_64, &hash_inputs[3], 256},
+      {"hash/hash_64/65536", bench_hash_64, &hash_inputs[4],
+       sizeof(random_bytes)},
+      {"hash/hash_128/65536", bench_hash_128, &hash_inputs[4],
+       sizeof(random_bytes)},
+      {"hash/hash_64_streamed/65536", bench_hash_streamed, &hash_inputs[4],
+       sizeof(random_bytes)},
+      {"string/view_hash/gltf_keys", bench_string_view_hash, string_keys, 0},
+      {"string/intern/gltf_keys", bench_string_intern, &string_intern_input,
+       0},
+      {"utf8/validate/gltf", bench_utf8_validate, &gltf, gltf.size},
+      {"utf8/validate/mixed_text", bench_utf8_validate, &mixed_text,
+       mixed_text.size},
+      {"utf8/codepoint_at_offset/gltf", bench_utf8_codepoint_at_offset, &gltf,
+       gltf.size},
+      {"utf8/decode/gltf", bench_utf8_decode, &gltf_decode_input, gltf.size},
+      {"utf8/decode/mixed_text", bench_utf8_decode, &mixed_text_decode_input,
+       mixed_text.size},
+      {"maths/mat4_multiply", bench_mat4_multiply, nullptr, 0},
+      {"alloc/system/256_allocations", bench_system_allocator, nullptr, 0},
+      {"alloc/arena/256_allocations", bench_arena_allocator, &arena, 0},
+      {"parse/obj/model", bench_obj_parse, &model_obj, model_obj.size},
+      {"parse/obj/grid_128", bench_obj_parse, &grid_obj, grid_obj.size},
+      {"parse/gltf/1024_meshes", bench_gltf_parse, &gltf, gltf.size},
+      {"parse/json_tokenize/1024_meshes", bench_json_tokenize, &gltf,
+       gltf.size},
+      {"parse/vgltf_gltf/1024_meshes", bench_vgltf_gltf_parse,
+       &vgltf_gltf_parse_input, gltf.size},
+      {"accessor/read_floats/vec3_f32", bench_accessor_read_floats,
+       &position_accessor_case, ACCESSOR_ELEMENT_COUNT * 3 * sizeof(float)},
+      {"accessor/cgltf_unpack_floats/vec3_f32",
+       bench_cgltf_accessor_unpack_floats, &position_accessor_case,
+       ACCESSOR_ELEMENT_COUNT * 3 * sizeof(float)},
+      {"accessor/read_floats/vec2_u16_normalized", bench_accessor_read_floats,
+       &texture_coordinates_accessor_case,
+       ACCESSOR_ELEMENT_COUNT * 2 * sizeof(uint16_t)},
+      {"accessor/cgltf_unpack_floats/vec2_u16_normalized",
+       bench_cgltf_accessor_unpack_floats, &texture_coordinates_accessor_case,
+       ACCESSOR_ELEMENT_COUNT * 2 * sizeof(uint16_t)},
+      {"accessor/read_indices/u16", bench_accessor_read_indices,
+       &accessor_input, ACCESSOR_ELEMENT_COUNT * sizeof(uint16_t)},
+      {"accessor/cgltf_unpack_indices/u16", bench_cgltf_accessor_unpack_indices,
+       &accessor_input, ACCESSOR_ELEMENT_COUNT * sizeof(uint16_t)},
+      {"weld/grid_128", bench_weld_vertices, &weld_input,
+       weld_input.vertex_count * sizeof(struct vgltf_vertex)},
+      {"image/decode_png/texture", bench_image_decode, &texture_png,
+       texture_png.size},
+  };
+  static constexpr size_t CASE_COUNT = sizeof(cases) / sizeof(cases[0]);
+  static_assert(CASE_COUNT <= MAX_CASE_COUNT);
+
+  struct vgltf_bench_result results[MAX_CASE_COUNT];
+  size_t result_count = 0;
+  for (size_t case_index = 0; case_index < CASE_COUNT; case_index++) {
+    if (vgltf_bench_run(&options, &cases[case_index], &results[result_count])) {
+      vgltf_bench_print_result(stdout, &results[result_count]);
+      result_count++;
+    }
+  }
+
+  if (json_path) {
+    FILE *json_file = fopen(json_path, "w");
+    if (!json_file) {
+      fprintf(stderr, "Couldn't open %s\n", json_path);
+      goto err;
+    }
+    vgltf_bench_write_json(json_file, &options, results, result_count);
+    fclose(json_file);
+  }
+
+  vgltf_log_deinit();
+  return 0;
+err:
+  vgltf_log_deinit();
+  return 1;
+}
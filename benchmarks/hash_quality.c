@@ -0,0 +1,217 @@
+// Statistical quality of the hashes: avalanche, collisions and hash table
+// bucket distribution. Fails when vgltf_hash_64 or vgltf_hash_128 don't meet
+// the thresholds, vgltf_hash_fnv_1a is only reported for comparison.
+#include "../src/alloc.h"
+#include "../src/hash.h"
+#include "../src/log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint64_t (*hash_function)(const char *bytes, size_t nbytes);
+
+static uint64_t hash_128_high(const char *bytes, size_t nbytes) {
+  return vgltf_hash_128(bytes, nbytes).high;
+}
+
+static uint64_t hash_streamed(const char *bytes, size_t nbytes) {
+  struct vgltf_hash_state state;
+  vgltf_hash_state_init(&state);
+  // Odd update sizes so updates straddle the stripes
+  for (size_t offset = 0; offset < nbytes; offset += 7) {
+    vgltf_hash_state_update(&state, bytes + offset,
+                            nbytes - offset < 7 ? nbytes - offset : 7);
+  }
+  return vgltf_hash_state_digest_64(&state);
+}
+
+struct hash_under_test {
+  const char *name;
+  hash_function function;
+  bool checked;
+};
+
+static const struct hash_under_test HASHES[] = {
+    {"fnv_1a", vgltf_hash_fnv_1a, false},
+    {"hash_64", vgltf_hash_64, true},
+    {"hash_128/high", hash_128_high, true},
+    {"hash_64/streamed", hash_streamed, true},
+};
+
+// Each flipped input bit must flip each output bit half of the time, the
+// bias is the largest deviation from that over every input/output bit pair.
+// With 1000 keys the bias of an ideal hash has a standard deviation of
+// 1 / sqrt(1000), the threshold is 6 of them so the ~10^5 pairs don't fail
+// by chance.
+static constexpr int AVALANCHE_KEY_COUNT = 1000;
+static constexpr int AVALANCHE_MAX_KEY_SIZE = 256;
+static constexpr double AVALANCHE_MAX_BIAS = 0.19;
+static const size_t AVALANCHE_KEY_SIZES[] = {3, 8, 16, 32, 100, 240, 256};
+
+static uint64_t random_next(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static double avalanche_bias(hash_function hash, size_t key_size,
+                             uint32_t *flip_counts) {
+  memset(flip_counts, 0, key_size * 8 * 64 * sizeof(uint32_t));
+  uint64_t random_state = 0x2545F4914F6CDD1Du;
+  char key[AVALANCHE_MAX_KEY_SIZE];
+  for (int key_index = 0; key_index < AVALANCHE_KEY_COUNT; key_index++) {
+    for (size_t byte_index = 0; byte_index < key_size; byte_index++) {
+      key[byte_index] = (char)random_next(&random_state);
+    }
+
+    uint64_t reference = hash(key, key_size);
+    for (size_t bit_index = 0; bit_index < key_size * 8; bit_index++) {
+      key[bit_index / 8] ^= (char)(1 << (bit_index % 8));
+      uint64_t flipped = reference ^ hash(key, key_size);
+      key[bit_index / 8] ^= (char)(1 << (bit_index % 8));
+      for (int output_bit = 0; output_bit < 64; output_bit++) {
+        flip_counts[bit_index * 64 + output_bit] +=
+            (flipped >> output_bit) & 1;
+      }
+    }
+  }
+
+  double max_bias = 0.0;
+  for (size_t pair_index = 0; pair_index < key_size * 8 * 64; pair_index++) {
+    double bias =
+        fabs(2.0 * flip_counts[pair_index] / AVALANCHE_KEY_COUNT - 1.0);
+    max_bias = bias > max_bias ? bias : max_bias;
+  }
+  return max_bias;
+}
+
+static int compare_u64(const void *lhs, const void *rhs) {
+  uint64_t lhs_value = *(const uint64_t *)lhs;
+  uint64_t rhs_value = *(const uint64_t *)rhs;
+  return (lhs_value > rhs_value) - (lhs_value < rhs_value);
+}
+
+static size_t count_collisions(uint64_t *hashes, size_t count,
+                               uint64_t mask) {
+  for (size_t hash_index = 0; hash_index < count; hash_index++) {
+    hashes[hash_index] &= mask;
+  }
+  qsort(hashes, count, sizeof(uint64_t), compare_u64);
+  size_t collision_count = 0;
+  for (size_t hash_index = 1; hash_index < count; hash_index++) {
+    collision_count += hashes[hash_index] == hashes[hash_index - 1];
+  }
+  return collision_count;
+}
+
+// Keys as found in hash tables: consecutive integers and generated names
+static constexpr int KEY_COUNT = 1 << 20;
+static constexpr int BUCKET_COUNT = 1 << 16;
+// A 32 bits collision has a 2^-32 chance per pair
+static constexpr double EXPECTED_32_BITS_COLLISIONS =
+    (double)KEY_COUNT * (KEY_COUNT - 1) / 2.0 / 4294967296.0;
+static constexpr double MAX_COLLISION_RATIO = 2.0;
+static constexpr double MAX_BUCKET_CHI_SQUARED_SCORE = 6.0;
+
+enum key_kind { KEY_KIND_INTEGER, KEY_KIND_NAME, KEY_KIND_COUNT };
+static const char *KEY_KIND_STR[] = {"integers", "names"};
+
+static size_t make_key(enum key_kind kind, uint32_t key_index, char *key) {
+  if (kind == KEY_KIND_INTEGER) {
+    uint64_t value = key_index;
+    memcpy(key, &value, sizeof(value));
+    return sizeof(value);
+  }
+  return (size_t)snprintf(key, 32, "node_%u", key_index);
+}
+
+struct distribution_result {
+  size_t collisions_64;
+  size_t collisions_32;
+  // Chi squared of the low bits bucket counts, as a standard score
+  double bucket_score;
+};
+
+static void measure_distribution(hash_function hash, enum key_kind kind,
+                                 uint64_t *hashes, uint32_t *bucket_counts,
+                                 struct distribution_result *result) {
+  memset(bucket_counts, 0, BUCKET_COUNT * sizeof(uint32_t));
+  for (uint32_t key_index = 0; key_index < KEY_COUNT; key_index++) {
+    char key[32];
+    size_t key_size = make_key(kind, key_index, key);
+    hashes[key_index] = hash(key, key_size);
+    bucket_counts[hashes[key_index] & (BUCKET_COUNT - 1)]++;
+  }
+
+  double expected = (double)KEY_COUNT / BUCKET_COUNT;
+  double chi_squared = 0.0;
+  for (int bucket_index = 0; bucket_index < BUCKET_COUNT; bucket_index++) {
+    double difference = bucket_counts[bucket_index] - expected;
+    chi_squared += difference * difference / expected;
+  }
+  double degrees_of_freedom = BUCKET_COUNT - 1;
+  result->bucket_score = (chi_squared - degrees_of_freedom) /
+                         sqrt(2.0 * degrees_of_freedom);
+  result->collisions_64 = count_collisions(hashes, KEY_COUNT, UINT64_MAX);
+  result->collisions_32 = count_collisions(hashes, KEY_COUNT, UINT32_MAX);
+}
+
+int main(void) {
+  if (!vgltf_log_init()) {
+    VGLTF_LOG_ERR("Couldn't start the asynchronous logger");
+  }
+
+  uint32_t *flip_counts = vgltf_allocator_allocate_array(
+      &system_allocator, AVALANCHE_MAX_KEY_SIZE * 8 * 64, sizeof(uint32_t));
+  uint64_t *hashes = vgltf_allocator_allocate_array(
+      &system_allocator, KEY_COUNT, sizeof(uint64_t));
+  uint32_t *bucket_counts = vgltf_allocator_allocate_array(
+      &system_allocator, BUCKET_COUNT, sizeof(uint32_t));
+  bool passed = false;
+  if (!flip_counts || !hashes || !bucket_counts) {
+    VGLTF_LOG_ERR("Couldn't allocate the hash quality buffers");
+    goto free_buffers;
+  }
+
+  passed = true;
+  for (size_t hash_index = 0; hash_index < sizeof(HASHES) / sizeof(HASHES[0]);
+       hash_index++) {
+    const struct hash_under_test *hash = &HASHES[hash_index];
+    for (size_t size_index = 0; size_index < sizeof(AVALANCHE_KEY_SIZES) /
+                                                 sizeof(AVALANCHE_KEY_SIZES[0]);
+         size_index++) {
+      size_t key_size = AVALANCHE_KEY_SIZES[size_index];
+      double bias = avalanche_bias(hash->function, key_size, flip_counts);
+      bool failed = hash->checked && bias > AVALANCHE_MAX_BIAS;
+      printf("%-18s avalanche %4zu bytes keys: max bias %.3f%s\n", hash->name,
+             key_size, bias, failed ? " FAILED" : "");
+      passed = passed && !failed;
+    }
+
+    for (int kind = 0; kind < KEY_KIND_COUNT; kind++) {
+      struct distribution_result result;
+      measure_distribution(hash->function, kind, hashes, bucket_counts,
+                           &result);
+      bool failed = hash->checked &&
+                    (result.collisions_64 > 0 ||
+                     result.collisions_32 >
+                         EXPECTED_32_BITS_COLLISIONS * MAX_COLLISION_RATIO ||
+                     fabs(result.bucket_score) > MAX_BUCKET_CHI_SQUARED_SCORE);
+      printf("%-18s %-8s: %zu 64 bits collisions, %zu 32 bits collisions "
+             "(%.0f expected), bucket chi squared score %.2f%s\n",
+             hash->name, KEY_KIND_STR[kind], result.collisions_64,
+             result.collisions_32, EXPECTED_32_BITS_COLLISIONS,
+             result.bucket_score, failed ? " FAILED" : "");
+      passed = passed && !failed;
+    }
+  }
+
+free_buffers:
+  vgltf_allocator_free(&system_allocator, bucket_counts);
+  vgltf_allocator_free(&system_allocator, hashes);
+  vgltf_allocator_free(&system_allocator, flip_counts);
+  vgltf_log_deinit();
+  return passed ? 0 : 1;
+}
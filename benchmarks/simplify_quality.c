@@ -0,0 +1,262 @@
+// Inverted triangles in the LOD chains of noisy meshes, simplified the way
+// the renderer generates its LODs. A triangle is inverted when it faces away
+// from the source surface normals at its corners. Fails when any LOD inverts
+// more than a small fraction of its triangles.
+#include "../src/alloc.h"
+#include "../src/log.h"
+#include "../src/maths.h"
+#include "../src/simplify.h"
+#include <math.h>
+#include <stdio.h>
+
+static constexpr int SPHERE_SEGMENT_COUNT = 64;
+static constexpr int SPHERE_RING_COUNT = 64;
+static constexpr int HEIGHTFIELD_SIZE = 64;
+// Of the sphere radius, or of the heightfield cell size
+static constexpr float NOISE_AMPLITUDE = 0.005f;
+static constexpr int MAX_LOD_COUNT = 6;
+static constexpr float LOD_MAX_RELATIVE_ERROR = 0.25f;
+static constexpr double MAX_INVERTED_FRACTION = 0.002;
+
+static uint64_t random_next(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// In [-1, 1]
+static float random_float(uint64_t *state) {
+  return (float)(random_next(state) >> 40) / (float)(1u << 23) - 1.f;
+}
+
+struct mesh {
+  vgltf_vec3 *positions;
+  uint32_t vertex_count;
+  uint32_t *indices;
+  uint32_t index_count;
+  float radius;
+};
+
+static bool mesh_allocate(struct mesh *mesh, uint32_t vertex_count,
+                          uint32_t index_count) {
+  *mesh = (struct mesh){
+      .positions = vgltf_allocator_allocate_array(
+          &system_allocator, vertex_count, sizeof(vgltf_vec3)),
+      .indices = vgltf_allocator_allocate_array(&system_allocator,
+                                                index_count, sizeof(uint32_t))};
+  return mesh->positions && mesh->indices;
+}
+
+static void mesh_free(struct mesh *mesh) {
+  vgltf_allocator_free(&system_allocator, mesh->indices);
+  vgltf_allocator_free(&system_allocator, mesh->positions);
+}
+
+static void push_triangle(struct mesh *mesh, uint32_t a, uint32_t b,
+                          uint32_t c) {
+  mesh->indices[mesh->index_count++] = a;
+  mesh->indices[mesh->index_count++] = b;
+  mesh->indices[mesh->index_count++] = c;
+}
+
+// Closed and welded, each vertex pushed along its radius by the noise
+static bool make_sphere(struct mesh *mesh) {
+  uint32_t ring_vertex_count = SPHERE_SEGMENT_COUNT;
+  uint32_t vertex_count = 2 + (SPHERE_RING_COUNT - 1) * ring_vertex_count;
+  uint32_t triangle_count =
+      2 * SPHERE_SEGMENT_COUNT * (SPHERE_RING_COUNT - 1);
+  if (!mesh_allocate(mesh, vertex_count, triangle_count * 3)) {
+    return false;
+  }
+
+  uint64_t random_state = 0x9E3779B97F4A7C15u;
+  mesh->positions[mesh->vertex_count++] = (vgltf_vec3){0.f, 1.f, 0.f};
+  for (int ring = 1; ring < SPHERE_RING_COUNT; ring++) {
+    float polar = (float)VGLTF_MATHS_PI * (float)ring / SPHERE_RING_COUNT;
+    for (int segment = 0; segment < SPHERE_SEGMENT_COUNT; segment++) {
+      float azimuth =
+          2.f * (float)VGLTF_MATHS_PI * (float)segment / SPHERE_SEGMENT_COUNT;
+      float radius = 1.f + NOISE_AMPLITUDE * random_float(&random_state);
+      mesh->positions[mesh->vertex_count++] =
+          (vgltf_vec3){radius * sinf(polar) * cosf(azimuth),
+                       radius * cosf(polar),
+                       -radius * sinf(polar) * sinf(azimuth)};
+    }
+  }
+  uint32_t south_pole = mesh->vertex_count++;
+  mesh->positions[south_pole] = (vgltf_vec3){0.f, -1.f, 0.f};
+
+  for (uint32_t segment = 0; segment < ring_vertex_count; segment++) {
+    uint32_t next_segment = (segment + 1) % ring_vertex_count;
+    push_triangle(mesh, 0, 1 + segment, 1 + next_segment);
+    uint32_t last_ring = 1 + (SPHERE_RING_COUNT - 2) * ring_vertex_count;
+    push_triangle(mesh, south_pole, last_ring + next_segment,
+                  last_ring + segment);
+    for (uint32_t ring = 0; ring + 2 < SPHERE_RING_COUNT; ring++) {
+      uint32_t top = 1 + ring * ring_vertex_count;
+      uint32_t bottom = top + ring_vertex_count;
+      push_triangle(mesh, top + segment, bottom + segment,
+                    bottom + next_segment);
+      push_triangle(mesh, top + segment, bottom + next_segment,
+                    top + next_segment);
+    }
+  }
+  mesh->radius = 1.f + NOISE_AMPLITUDE;
+  return true;
+}
+
+// A unit cell grid with an open border, the noise is on the heights
+static bool make_heightfield(struct mesh *mesh) {
+  uint32_t triangle_count =
+      2 * (HEIGHTFIELD_SIZE - 1) * (HEIGHTFIELD_SIZE - 1);
+  if (!mesh_allocate(mesh, HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE,
+                     triangle_count * 3)) {
+    return false;
+  }
+
+  uint64_t random_state = 0x2545F4914F6CDD1Du;
+  for (int z = 0; z < HEIGHTFIELD_SIZE; z++) {
+    for (int x = 0; x < HEIGHTFIELD_SIZE; x++) {
+      float height = 4.f * sinf((float)x * 0.15f) * cosf((float)z * 0.1f) +
+                     NOISE_AMPLITUDE * random_float(&random_state);
+      mesh->positions[mesh->vertex_count++] =
+          (vgltf_vec3){(float)x, height, (float)z};
+    }
+  }
+  for (uint32_t z = 0; z + 1 < HEIGHTFIELD_SIZE; z++) {
+    for (uint32_t x = 0; x + 1 < HEIGHTFIELD_SIZE; x++) {
+      uint32_t corner = z * HEIGHTFIELD_SIZE + x;
+      push_triangle(mesh, corner, corner + HEIGHTFIELD_SIZE, corner + 1);
+      push_triangle(mesh, corner + 1, corner + HEIGHTFIELD_SIZE,
+                    corner + HEIGHTFIELD_SIZE + 1);
+    }
+  }
+  mesh->radius = (float)HEIGHTFIELD_SIZE * 0.5f * sqrtf(2.f);
+  return true;
+}
+
+static vgltf_vec3 triangle_normal(const vgltf_vec3 *positions,
+                                  const uint32_t *triangle) {
+  return vgltf_vec3_cross(
+      vgltf_vec3_sub(positions[triangle[1]], positions[triangle[0]]),
+      vgltf_vec3_sub(positions[triangle[2]], positions[triangle[0]]));
+}
+
+// Area weighted normals of the source triangles around each vertex
+static void compute_vertex_normals(const struct mesh *mesh,
+                                   vgltf_vec3 *normals) {
+  for (uint32_t vertex = 0; vertex < mesh->vertex_count; vertex++) {
+    normals[vertex] = (vgltf_vec3){};
+  }
+  for (uint32_t first_corner = 0; first_corner < mesh->index_count;
+       first_corner += 3) {
+    const uint32_t *triangle = &mesh->indices[first_corner];
+    vgltf_vec3 normal = triangle_normal(mesh->positions, triangle);
+    for (int corner = 0; corner < 3; corner++) {
+      vgltf_vec3 *vertex_normal = &normals[triangle[corner]];
+      *vertex_normal = (vgltf_vec3){vertex_normal->x + normal.x,
+                                    vertex_normal->y + normal.y,
+                                    vertex_normal->z + normal.z};
+    }
+  }
+}
+
+static uint32_t count_inverted_triangles(const struct mesh *mesh,
+                                         const vgltf_vec3 *normals,
+                                         const uint32_t *indices,
+                                         uint32_t index_count) {
+  uint32_t inverted_count = 0;
+  for (uint32_t first_corner = 0; first_corner < index_count;
+       first_corner += 3) {
+    const uint32_t *triangle = &indices[first_corner];
+    vgltf_vec3 source_normal = {};
+    for (int corner = 0; corner < 3; corner++) {
+      vgltf_vec3 normal = vgltf_vec3_normalized(normals[triangle[corner]]);
+      source_normal = (vgltf_vec3){source_normal.x + normal.x,
+                                   source_normal.y + normal.y,
+                                   source_normal.z + normal.z};
+    }
+    inverted_count += vgltf_vec3_dot(triangle_normal(mesh->positions,
+                                                     triangle),
+                                     source_normal) < 0.f;
+  }
+  return inverted_count;
+}
+
+// Each LOD halves the previous one, with the same error limits as the
+// renderer
+static bool check_lods(const char *name, const struct mesh *mesh) {
+  vgltf_vec3 *normals = vgltf_allocator_allocate_array(
+      &system_allocator, mesh->vertex_count, sizeof(vgltf_vec3));
+  uint32_t *lods = vgltf_allocator_allocate_array(
+      &system_allocator, (size_t)mesh->index_count * 4, sizeof(uint32_t));
+  bool passed = false;
+  if (!normals || !lods) {
+    VGLTF_LOG_ERR("Couldn't allocate the LOD buffers");
+    goto free_buffers;
+  }
+  compute_vertex_normals(mesh, normals);
+
+  passed = true;
+  const uint32_t *source = mesh->indices;
+  uint32_t source_index_count = mesh->index_count;
+  uint32_t *destination = lods;
+  float error = 0.f;
+  for (int lod = 1; lod < MAX_LOD_COUNT; lod++) {
+    float max_error = mesh->radius * LOD_MAX_RELATIVE_ERROR - error;
+    struct vgltf_simplify_result result;
+    if (max_error <= 0.f ||
+        !vgltf_simplify(&system_allocator, destination, source,
+                        source_index_count, mesh->positions,
+                        mesh->vertex_count, source_index_count / 2,
+                        max_error, &result) ||
+        result.index_count == 0 ||
+        result.index_count > source_index_count / 5 * 4) {
+      break;
+    }
+    error += result.error;
+
+    uint32_t triangle_count = result.index_count / 3;
+    uint32_t inverted_count = count_inverted_triangles(
+        mesh, normals, destination, result.index_count);
+    bool failed =
+        inverted_count > MAX_INVERTED_FRACTION * (double)triangle_count;
+    printf("%-11s LOD%d: %5u triangles, error %.4f, %u inverted%s\n", name,
+           lod, triangle_count, error, inverted_count,
+           failed ? " FAILED" : "");
+    passed = passed && !failed;
+
+    source = destination;
+    source_index_count = result.index_count;
+    destination += result.index_count;
+  }
+
+free_buffers:
+  vgltf_allocator_free(&system_allocator, lods);
+  vgltf_allocator_free(&system_allocator, normals);
+  return passed;
+}
+
+int main(void) {
+  if (!vgltf_log_init()) {
+    VGLTF_LOG_ERR("Couldn't start the asynchronous logger");
+  }
+
+  bool passed = false;
+  struct mesh sphere = {};
+  struct mesh heightfield = {};
+  if (!make_sphere(&sphere) || !make_heightfield(&heightfield)) {
+    VGLTF_LOG_ERR("Couldn't allocate the meshes");
+    goto free_meshes;
+  }
+
+  passed = check_lods("sphere", &sphere);
+  passed = check_lods("heightfield", &heightfield) && passed;
+
+free_meshes:
+  mesh_free(&heightfield);
+  mesh_free(&sphere);
+  vgltf_log_deinit();
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#version 450
+
+struct Instance {
+    mat4 transform;
+    vec4 boundingSphere;
+    uint materialIndex;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+// Reads the position stream only. Positions are transformed as in
+// triangle.vert, and gl_Position is invariant in both, so that the depths of
+// both passes are equal.
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+    gl_Position = ubo.projection * ubo.view * ubo.model * instance.transform * vec4(inPosition, 1.0);
+}
@@ -1,12 +1,25 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct Material {
+    vec4 baseColorFactor;
+    uint baseColorTextureIndex;
+};
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTextureCoordinates;
+layout(location = 2) flat in uint fragMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 1) uniform sampler2D textureSampler;
+layout(set = 0, binding = 2) readonly buffer Materials {
+    Material materials[];
+};
+
+layout(set = 0, binding = 3) uniform sampler2D textures[];
 
 void main() {
-    outColor = vec4(fragColor * texture(textureSampler, fragTextureCoordinates).rgb, 1.0);
+    Material material = materials[fragMaterialIndex];
+    vec4 baseColor = material.baseColorFactor * texture(textures[nonuniformEXT(material.baseColorTextureIndex)], fragTextureCoordinates);
+    outColor = vec4(fragColor * baseColor.rgb, 1.0);
 }
@@ -1,11 +1,25 @@
 #version 450
 
+struct Instance {
+    mat4 transform;
+    vec4 boundingSphere;
+    uint materialIndex;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+// Quantized attributes are converted by their vertex input formats
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTextureCoordinates;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTextureCoordinates;
+layout(location = 2) flat out uint fragMaterialIndex;
+
+// Matches the depths written by depth.vert
+invariant gl_Position;
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 model;
@@ -13,8 +27,15 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 projection;
 } ubo;
 
+// The indirect draws set firstInstance to the instance index
+layout(set = 0, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+
 void main() {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    Instance instance = instances[gl_InstanceIndex];
+    gl_Position = ubo.projection * ubo.view * ubo.model * instance.transform * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTextureCoordinates = inTextureCoordinates;
+    fragMaterialIndex = instance.materialIndex;
 }
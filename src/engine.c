@@ -1,17 +1,47 @@
 #include "engine.h"
 
-bool vgltf_engine_init(struct vgltf_engine *engine, struct vgltf_platform *platform) {
-  if (!vgltf_renderer_init(&engine->renderer, platform)) {
+bool vgltf_engine_init(struct vgltf_engine *engine,
+                       struct vgltf_platform *platform,
+                       const char *model_path) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (!vgltf_job_system_init(&engine->job_system, 0)) {
     goto err;
   }
 
+  if (!vgltf_renderer_init(&engine->renderer, platform, &engine->job_system,
+                           model_path)) {
+    goto deinit_job_system;
+  }
+
+  return true;
+deinit_job_system:
+  vgltf_job_system_deinit(&engine->job_system);
+err:
+  return false;
+}
+bool vgltf_engine_init_headless(struct vgltf_engine *engine,
+                                struct vgltf_window_size size,
+                                const char *model_path) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (!vgltf_job_system_init(&engine->job_system, 0)) {
+    goto err;
+  }
+
+  if (!vgltf_renderer_init_headless(&engine->renderer, &engine->job_system,
+                                    size, model_path)) {
+    goto deinit_job_system;
+  }
+
   return true;
+deinit_job_system:
+  vgltf_job_system_deinit(&engine->job_system);
 err:
   return false;
 }
 void vgltf_engine_deinit(struct vgltf_engine *engine) {
   vgltf_renderer_deinit(&engine->renderer);
+  vgltf_job_system_deinit(&engine->job_system);
 }
-void vgltf_engine_run_frame(struct vgltf_engine *engine) {
-  vgltf_renderer_render_frame(&engine->renderer);
+bool vgltf_engine_run_frame(struct vgltf_engine *engine) {
+  return vgltf_renderer_render_frame(&engine->renderer);
 }
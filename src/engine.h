@@ -1,14 +1,20 @@
 #ifndef VGLTF_ENGINE_H
 #define VGLTF_ENGINE_H
 
+#include "job.h"
 #include "renderer/renderer.h"
 
 struct vgltf_engine {
+  struct vgltf_job_system job_system;
   struct vgltf_renderer renderer;
 };
 
-bool vgltf_engine_init(struct vgltf_engine *engine, struct vgltf_platform *platform);
+bool vgltf_engine_init(struct vgltf_engine *engine,
+                       struct vgltf_platform *platform, const char *model_path);
+bool vgltf_engine_init_headless(struct vgltf_engine *engine,
+                                struct vgltf_window_size size,
+                                const char *model_path);
 void vgltf_engine_deinit(struct vgltf_engine *engine);
-void vgltf_engine_run_frame(struct vgltf_engine *engine);
+bool vgltf_engine_run_frame(struct vgltf_engine *engine);
 
 #endif // VGLTF_ENGINE_H
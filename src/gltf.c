@@ -0,0 +1,1807 @@
+#include "gltf.h"
+#include "job.h"
+#include "log.h"
+#include "platform.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <string.h>
+
+uint32_t vgltf_gltf_component_type_size(enum vgltf_gltf_component_type type) {
+  switch (type) {
+  case VGLTF_GLTF_COMPONENT_TYPE_BYTE:
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return 1;
+  case VGLTF_GLTF_COMPONENT_TYPE_SHORT:
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return 2;
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_INT:
+  case VGLTF_GLTF_COMPONENT_TYPE_FLOAT:
+    return 4;
+  }
+  return 0;
+}
+
+uint32_t vgltf_gltf_accessor_type_component_count(
+    enum vgltf_gltf_accessor_type type) {
+  static const uint32_t COMPONENT_COUNTS[] = {1, 2, 3, 4, 4, 9, 16};
+  return COMPONENT_COUNTS[type];
+}
+
+// Matrix columns are aligned to 4 bytes
+static uint64_t
+accessor_element_size(const struct vgltf_gltf_accessor *accessor) {
+  uint32_t component_size =
+      vgltf_gltf_component_type_size(accessor->component_type);
+  switch (accessor->type) {
+  case VGLTF_GLTF_ACCESSOR_TYPE_MAT2:
+    return component_size == 1 ? 8 : 4 * component_size;
+  case VGLTF_GLTF_ACCESSOR_TYPE_MAT3:
+    return component_size == 4 ? 36 : 12 * component_size;
+  default:
+    return (uint64_t)component_size *
+           vgltf_gltf_accessor_type_component_count(accessor->type);
+  }
+}
+
+struct parser {
+  const struct vgltf_json_document *document;
+  struct vgltf_allocator *allocator;
+  struct vgltf_string_interner *interner;
+  struct vgltf_gltf *gltf;
+  // Relative URIs are resolved against it
+  struct vgltf_string_view base_directory;
+  uint32_t sampler_count;
+  // URI tokens, VGLTF_JSON_TOKEN_NONE if there's none
+  uint32_t *buffer_uris;
+  uint32_t *image_uris;
+};
+
+static bool invalid(const struct parser *parser, uint32_t token,
+                    const char *what) {
+  VGLTF_LOG_ERR("Invalid glTF %s at offset %u", what,
+                parser->document->tokens[token].start);
+  return false;
+}
+
+static bool is_type(const struct parser *parser, uint32_t token,
+                    enum vgltf_json_type type) {
+  return parser->document->tokens[token].type == type;
+}
+
+static bool key_eq(const struct parser *parser, uint32_t key,
+                   const char *name) {
+  return vgltf_json_string_eq(parser->document, key, SV(name));
+}
+
+static uint32_t first_member(uint32_t object) { return object + 1; }
+static uint32_t next_member(const struct parser *parser, uint32_t key) {
+  return parser->document->tokens[key + 1].next;
+}
+static uint32_t end_of(const struct parser *parser, uint32_t token) {
+  return parser->document->tokens[token].next;
+}
+
+static bool parse_index(const struct parser *parser, uint32_t token,
+                        uint32_t count, uint32_t *index, const char *what) {
+  if (!vgltf_json_to_uint32(parser->document, token, index) ||
+      *index >= count) {
+    return invalid(parser, token, what);
+  }
+  return true;
+}
+
+static bool parse_floats(const struct parser *parser, uint32_t token,
+                         float *values, uint32_t count, const char *what) {
+  const struct vgltf_json_token *array = &parser->document->tokens[token];
+  if (array->type != VGLTF_JSON_TYPE_ARRAY || array->child_count != count) {
+    return invalid(parser, token, what);
+  }
+  uint32_t element = token + 1;
+  for (uint32_t value_index = 0; value_index < count; value_index++) {
+    if (!vgltf_json_to_float(parser->document, element,
+                             &values[value_index])) {
+      return invalid(parser, element, what);
+    }
+    element = end_of(parser, element);
+  }
+  return true;
+}
+
+// Unescapes the string if needed before interning it
+static bool intern_string(const struct parser *parser, uint32_t token,
+                          vgltf_string_id *id) {
+  if (!is_type(parser, token, VGLTF_JSON_TYPE_STRING)) {
+    return invalid(parser, token, "string");
+  }
+
+  struct vgltf_string_view text =
+      vgltf_json_token_text(parser->document, token);
+  if (!memchr(text.data, '\\', text.length)) {
+    *id = vgltf_string_interner_intern(parser->interner, text);
+    return *id != VGLTF_STRING_ID_INVALID;
+  }
+
+  char *unescaped = vgltf_allocator_allocate(parser->allocator, text.length);
+  if (!unescaped) {
+    VGLTF_LOG_ERR("Couldn't allocate an unescaped string");
+    return false;
+  }
+  size_t length;
+  bool interned =
+      vgltf_json_string_unescape(parser->document, token, unescaped,
+                                 text.length, &length) &&
+      (*id = vgltf_string_interner_intern(
+           parser->interner,
+           (struct vgltf_string_view){.data = unescaped, .length = length})) !=
+          VGLTF_STRING_ID_INVALID;
+  vgltf_allocator_free(parser->allocator, unescaped);
+  return interned || invalid(parser, token, "string");
+}
+
+static bool parse_asset(const struct parser *parser, uint32_t asset) {
+  if (!is_type(parser, asset, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, asset, "asset");
+  }
+  uint32_t version =
+      vgltf_json_object_find(parser->document, asset, SV("version"));
+  if (version == VGLTF_JSON_TOKEN_NONE ||
+      !is_type(parser, version, VGLTF_JSON_TYPE_STRING)) {
+    return invalid(parser, asset, "asset version");
+  }
+  struct vgltf_string_view text =
+      vgltf_json_token_text(parser->document, version);
+  if (text.length < 2 || text.data[0] != '2' || text.data[1] != '.') {
+    VGLTF_LOG_ERR("Unsupported glTF version %.*s", (int)text.length,
+                  text.data);
+    return false;
+  }
+  return true;
+}
+
+// Quantized attributes are read like any other integer attribute, compressed
+// buffer views are decoded once the buffers are loaded
+static const char *const SUPPORTED_EXTENSIONS[] = {"KHR_mesh_quantization",
+                                                   "EXT_meshopt_compression"};
+
+static bool parse_required_extensions(const struct parser *parser,
+                                      uint32_t extensions) {
+  if (!is_type(parser, extensions, VGLTF_JSON_TYPE_ARRAY)) {
+    return invalid(parser, extensions, "extensionsRequired");
+  }
+  for (uint32_t element = extensions + 1;
+       element < end_of(parser, extensions);
+       element = end_of(parser, element)) {
+    if (!is_type(parser, element, VGLTF_JSON_TYPE_STRING)) {
+      return invalid(parser, element, "extensionsRequired");
+    }
+    bool supported = false;
+    for (size_t extension_index = 0;
+         extension_index <
+         sizeof(SUPPORTED_EXTENSIONS) / sizeof(SUPPORTED_EXTENSIONS[0]);
+         extension_index++) {
+      supported |=
+          key_eq(parser, element, SUPPORTED_EXTENSIONS[extension_index]);
+    }
+    if (!supported) {
+      struct vgltf_string_view name =
+          vgltf_json_token_text(parser->document, element);
+      VGLTF_LOG_ERR("Unsupported required glTF extension %.*s",
+                    (int)name.length, name.data);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parse_buffer(struct parser *parser, uint32_t object,
+                         uint32_t buffer_index) {
+  struct vgltf_gltf_buffer *buffer = &parser->gltf->buffers[buffer_index];
+  *buffer = (struct vgltf_gltf_buffer){};
+  parser->buffer_uris[buffer_index] = VGLTF_JSON_TOKEN_NONE;
+  bool has_byte_length = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "byteLength")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &buffer->byte_length)) {
+        return invalid(parser, value, "buffer byteLength");
+      }
+      has_byte_length = true;
+    } else if (key_eq(parser, key, "uri")) {
+      if (!is_type(parser, value, VGLTF_JSON_TYPE_STRING)) {
+        return invalid(parser, value, "buffer uri");
+      }
+      parser->buffer_uris[buffer_index] = value;
+    } else if (key_eq(parser, key, "extensions")) {
+      uint32_t meshopt = vgltf_json_object_find(
+          parser->document, value, SV("EXT_meshopt_compression"));
+      uint32_t fallback =
+          meshopt == VGLTF_JSON_TOKEN_NONE
+              ? VGLTF_JSON_TOKEN_NONE
+              : vgltf_json_object_find(parser->document, meshopt,
+                                       SV("fallback"));
+      if (fallback != VGLTF_JSON_TOKEN_NONE &&
+          !vgltf_json_to_bool(parser->document, fallback, &buffer->fallback)) {
+        return invalid(parser, fallback, "buffer fallback");
+      }
+    }
+  }
+  return has_byte_length || invalid(parser, object, "buffer");
+}
+
+static bool parse_meshopt_mode(const struct parser *parser, uint32_t token,
+                               enum vgltf_meshopt_mode *mode) {
+  if (key_eq(parser, token, "ATTRIBUTES")) {
+    *mode = VGLTF_MESHOPT_MODE_ATTRIBUTES;
+  } else if (key_eq(parser, token, "TRIANGLES")) {
+    *mode = VGLTF_MESHOPT_MODE_TRIANGLES;
+  } else if (key_eq(parser, token, "INDICES")) {
+    *mode = VGLTF_MESHOPT_MODE_INDICES;
+  } else {
+    return invalid(parser, token, "meshopt mode");
+  }
+  return true;
+}
+
+static bool parse_meshopt_filter(const struct parser *parser, uint32_t token,
+                                 enum vgltf_meshopt_filter *filter) {
+  if (key_eq(parser, token, "NONE")) {
+    *filter = VGLTF_MESHOPT_FILTER_NONE;
+  } else if (key_eq(parser, token, "OCTAHEDRAL")) {
+    *filter = VGLTF_MESHOPT_FILTER_OCTAHEDRAL;
+  } else if (key_eq(parser, token, "QUATERNION")) {
+    *filter = VGLTF_MESHOPT_FILTER_QUATERNION;
+  } else if (key_eq(parser, token, "EXPONENTIAL")) {
+    *filter = VGLTF_MESHOPT_FILTER_EXPONENTIAL;
+  } else {
+    return invalid(parser, token, "meshopt filter");
+  }
+  return true;
+}
+
+// The strides are the ones vgltf_meshopt_decode accepts, which are also the
+// only ones the extension allows
+static bool is_valid_meshopt_stride(
+    const struct vgltf_gltf_meshopt_compression *compression) {
+  uint32_t stride = compression->byte_stride;
+  switch (compression->filter) {
+  case VGLTF_MESHOPT_FILTER_NONE:
+    break;
+  case VGLTF_MESHOPT_FILTER_OCTAHEDRAL:
+    return compression->mode == VGLTF_MESHOPT_MODE_ATTRIBUTES &&
+           (stride == 4 || stride == 8);
+  case VGLTF_MESHOPT_FILTER_QUATERNION:
+    return compression->mode == VGLTF_MESHOPT_MODE_ATTRIBUTES && stride == 8;
+  case VGLTF_MESHOPT_FILTER_EXPONENTIAL:
+    return compression->mode == VGLTF_MESHOPT_MODE_ATTRIBUTES &&
+           stride % 4 == 0 && stride <= 256;
+  }
+  switch (compression->mode) {
+  case VGLTF_MESHOPT_MODE_ATTRIBUTES:
+    return stride != 0 && stride % 4 == 0 && stride <= 256;
+  case VGLTF_MESHOPT_MODE_TRIANGLES:
+    return (stride == 2 || stride == 4) && compression->count % 3 == 0;
+  case VGLTF_MESHOPT_MODE_INDICES:
+    return stride == 2 || stride == 4;
+  }
+  return false;
+}
+
+static bool
+parse_meshopt_compression(const struct parser *parser, uint32_t object,
+                          struct vgltf_gltf_meshopt_compression *compression) {
+  const struct vgltf_gltf *gltf = parser->gltf;
+  *compression = (struct vgltf_gltf_meshopt_compression){
+      .buffer = VGLTF_GLTF_INDEX_NONE, .filter = VGLTF_MESHOPT_FILTER_NONE};
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "EXT_meshopt_compression");
+  }
+  bool has_byte_length = false;
+  bool has_byte_stride = false;
+  bool has_count = false;
+  bool has_mode = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "buffer")) {
+      if (!parse_index(parser, value, gltf->buffer_count, &compression->buffer,
+                       "meshopt buffer")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "byteOffset")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &compression->byte_offset)) {
+        return invalid(parser, value, "meshopt byteOffset");
+      }
+    } else if (key_eq(parser, key, "byteLength")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &compression->byte_length)) {
+        return invalid(parser, value, "meshopt byteLength");
+      }
+      has_byte_length = true;
+    } else if (key_eq(parser, key, "byteStride")) {
+      if (!vgltf_json_to_uint32(parser->document, value,
+                                &compression->byte_stride)) {
+        return invalid(parser, value, "meshopt byteStride");
+      }
+      has_byte_stride = true;
+    } else if (key_eq(parser, key, "count")) {
+      if (!vgltf_json_to_uint32(parser->document, value,
+                                &compression->count)) {
+        return invalid(parser, value, "meshopt count");
+      }
+      has_count = true;
+    } else if (key_eq(parser, key, "mode")) {
+      if (!parse_meshopt_mode(parser, value, &compression->mode)) {
+        return false;
+      }
+      has_mode = true;
+    } else if (key_eq(parser, key, "filter")) {
+      if (!parse_meshopt_filter(parser, value, &compression->filter)) {
+        return false;
+      }
+    }
+  }
+
+  if (compression->buffer == VGLTF_GLTF_INDEX_NONE || !has_byte_length ||
+      !has_byte_stride || !has_count || !has_mode ||
+      !is_valid_meshopt_stride(compression)) {
+    return invalid(parser, object, "EXT_meshopt_compression");
+  }
+  const struct vgltf_gltf_buffer *buffer = &gltf->buffers[compression->buffer];
+  if (buffer->fallback || compression->byte_offset > buffer->byte_length ||
+      compression->byte_length >
+          buffer->byte_length - compression->byte_offset) {
+    return invalid(parser, object, "meshopt range");
+  }
+  return true;
+}
+
+static bool parse_buffer_view(struct parser *parser, uint32_t object,
+                              struct vgltf_gltf_buffer_view *buffer_view) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *buffer_view = (struct vgltf_gltf_buffer_view){
+      .buffer = VGLTF_GLTF_INDEX_NONE};
+  bool has_byte_length = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "buffer")) {
+      if (!parse_index(parser, value, gltf->buffer_count,
+                       &buffer_view->buffer, "bufferView buffer")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "byteOffset")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &buffer_view->byte_offset)) {
+        return invalid(parser, value, "bufferView byteOffset");
+      }
+    } else if (key_eq(parser, key, "byteLength")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &buffer_view->byte_length)) {
+        return invalid(parser, value, "bufferView byteLength");
+      }
+      has_byte_length = true;
+    } else if (key_eq(parser, key, "byteStride")) {
+      if (!vgltf_json_to_uint32(parser->document, value,
+                                &buffer_view->byte_stride) ||
+          buffer_view->byte_stride < 4 || buffer_view->byte_stride > 252 ||
+          buffer_view->byte_stride % 4 != 0) {
+        return invalid(parser, value, "bufferView byteStride");
+      }
+    } else if (key_eq(parser, key, "extensions")) {
+      uint32_t meshopt = vgltf_json_object_find(
+          parser->document, value, SV("EXT_meshopt_compression"));
+      if (meshopt != VGLTF_JSON_TOKEN_NONE) {
+        if (!parse_meshopt_compression(parser, meshopt,
+                                       &buffer_view->compression)) {
+          return false;
+        }
+        buffer_view->compressed = true;
+      }
+    }
+  }
+
+  if (buffer_view->buffer == VGLTF_GLTF_INDEX_NONE || !has_byte_length) {
+    return invalid(parser, object, "bufferView");
+  }
+  const struct vgltf_gltf_buffer *buffer = &gltf->buffers[buffer_view->buffer];
+  if (buffer_view->byte_offset > buffer->byte_length ||
+      buffer_view->byte_length >
+          buffer->byte_length - buffer_view->byte_offset) {
+    return invalid(parser, object, "bufferView range");
+  }
+  // The decoded elements must fit in the view, and fallback buffers are only
+  // readable through compressed views
+  if (buffer_view->compressed
+          ? (uint64_t)buffer_view->compression.count *
+                    buffer_view->compression.byte_stride >
+                buffer_view->byte_length
+          : buffer->fallback) {
+    return invalid(parser, object, "bufferView range");
+  }
+  return true;
+}
+
+static bool parse_accessor_type(const struct parser *parser, uint32_t token,
+                                enum vgltf_gltf_accessor_type *type) {
+  static const char *const TYPE_NAMES[] = {"SCALAR", "VEC2", "VEC3", "VEC4",
+                                           "MAT2",   "MAT3", "MAT4"};
+  for (size_t type_index = 0;
+       type_index < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); type_index++) {
+    if (key_eq(parser, token, TYPE_NAMES[type_index])) {
+      *type = type_index;
+      return true;
+    }
+  }
+  return invalid(parser, token, "accessor type");
+}
+
+// Sparse indices and values are tightly packed
+static bool parse_sparse_range(const struct parser *parser, uint32_t object,
+                               uint32_t buffer_view_index, uint64_t byte_offset,
+                               uint64_t byte_length, const char *what) {
+  const struct vgltf_gltf_buffer_view *buffer_view =
+      &parser->gltf->buffer_views[buffer_view_index];
+  if (buffer_view->byte_stride != 0 ||
+      byte_offset > buffer_view->byte_length ||
+      byte_length > buffer_view->byte_length - byte_offset) {
+    return invalid(parser, object, what);
+  }
+  return true;
+}
+
+static bool parse_sparse_indices(const struct parser *parser, uint32_t object,
+                                 struct vgltf_gltf_accessor_sparse *sparse) {
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "sparse indices");
+  }
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "bufferView")) {
+      if (!parse_index(parser, value, parser->gltf->buffer_view_count,
+                       &sparse->indices_buffer_view,
+                       "sparse indices bufferView")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "byteOffset")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &sparse->indices_byte_offset)) {
+        return invalid(parser, value, "sparse indices byteOffset");
+      }
+    } else if (key_eq(parser, key, "componentType")) {
+      uint32_t component_type;
+      if (!vgltf_json_to_uint32(parser->document, value, &component_type) ||
+          (component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+           component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+           component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_INT)) {
+        return invalid(parser, value, "sparse indices componentType");
+      }
+      sparse->indices_component_type = component_type;
+    }
+  }
+
+  if (sparse->indices_buffer_view == VGLTF_GLTF_INDEX_NONE ||
+      sparse->indices_component_type == 0) {
+    return invalid(parser, object, "sparse indices");
+  }
+  return parse_sparse_range(
+      parser, object, sparse->indices_buffer_view, sparse->indices_byte_offset,
+      (uint64_t)sparse->count *
+          vgltf_gltf_component_type_size(sparse->indices_component_type),
+      "sparse indices range");
+}
+
+static bool parse_sparse_values(const struct parser *parser, uint32_t object,
+                                const struct vgltf_gltf_accessor *accessor,
+                                struct vgltf_gltf_accessor_sparse *sparse) {
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "sparse values");
+  }
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "bufferView")) {
+      if (!parse_index(parser, value, parser->gltf->buffer_view_count,
+                       &sparse->values_buffer_view,
+                       "sparse values bufferView")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "byteOffset")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &sparse->values_byte_offset)) {
+        return invalid(parser, value, "sparse values byteOffset");
+      }
+    }
+  }
+
+  if (sparse->values_buffer_view == VGLTF_GLTF_INDEX_NONE) {
+    return invalid(parser, object, "sparse values");
+  }
+  return parse_sparse_range(parser, object, sparse->values_buffer_view,
+                            sparse->values_byte_offset,
+                            sparse->count * accessor_element_size(accessor),
+                            "sparse values range");
+}
+
+// Needs the type and count of the accessor, so it's parsed last
+static bool parse_sparse(const struct parser *parser, uint32_t object,
+                         struct vgltf_gltf_accessor *accessor) {
+  struct vgltf_gltf_accessor_sparse *sparse = &accessor->sparse;
+  *sparse = (struct vgltf_gltf_accessor_sparse){
+      .indices_buffer_view = VGLTF_GLTF_INDEX_NONE,
+      .values_buffer_view = VGLTF_GLTF_INDEX_NONE};
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "accessor sparse");
+  }
+  uint32_t count =
+      vgltf_json_object_find(parser->document, object, SV("count"));
+  uint32_t indices =
+      vgltf_json_object_find(parser->document, object, SV("indices"));
+  uint32_t values =
+      vgltf_json_object_find(parser->document, object, SV("values"));
+  if (count == VGLTF_JSON_TOKEN_NONE || indices == VGLTF_JSON_TOKEN_NONE ||
+      values == VGLTF_JSON_TOKEN_NONE) {
+    return invalid(parser, object, "accessor sparse");
+  }
+  if (!vgltf_json_to_uint32(parser->document, count, &sparse->count) ||
+      sparse->count == 0 || sparse->count > accessor->count) {
+    return invalid(parser, count, "accessor sparse count");
+  }
+  return parse_sparse_indices(parser, indices, sparse) &&
+         parse_sparse_values(parser, values, accessor, sparse);
+}
+
+static bool parse_accessor(struct parser *parser, uint32_t object,
+                           struct vgltf_gltf_accessor *accessor) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *accessor = (struct vgltf_gltf_accessor){
+      .buffer_view = VGLTF_GLTF_INDEX_NONE};
+  bool has_count = false;
+  bool has_type = false;
+  uint32_t min = VGLTF_JSON_TOKEN_NONE;
+  uint32_t max = VGLTF_JSON_TOKEN_NONE;
+  uint32_t sparse = VGLTF_JSON_TOKEN_NONE;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "bufferView")) {
+      if (!parse_index(parser, value, gltf->buffer_view_count,
+                       &accessor->buffer_view, "accessor bufferView")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "byteOffset")) {
+      if (!vgltf_json_to_uint64(parser->document, value,
+                                &accessor->byte_offset)) {
+        return invalid(parser, value, "accessor byteOffset");
+      }
+    } else if (key_eq(parser, key, "componentType")) {
+      uint32_t component_type;
+      if (!vgltf_json_to_uint32(parser->document, value, &component_type) ||
+          vgltf_gltf_component_type_size(component_type) == 0) {
+        return invalid(parser, value, "accessor componentType");
+      }
+      accessor->component_type = component_type;
+    } else if (key_eq(parser, key, "normalized")) {
+      if (!vgltf_json_to_bool(parser->document, value,
+                              &accessor->normalized)) {
+        return invalid(parser, value, "accessor normalized");
+      }
+    } else if (key_eq(parser, key, "count")) {
+      if (!vgltf_json_to_uint32(parser->document, value, &accessor->count) ||
+          accessor->count == 0) {
+        return invalid(parser, value, "accessor count");
+      }
+      has_count = true;
+    } else if (key_eq(parser, key, "type")) {
+      if (!parse_accessor_type(parser, value, &accessor->type)) {
+        return false;
+      }
+      has_type = true;
+    } else if (key_eq(parser, key, "min")) {
+      min = value;
+    } else if (key_eq(parser, key, "max")) {
+      max = value;
+    } else if (key_eq(parser, key, "sparse")) {
+      sparse = value;
+    }
+  }
+
+  if (accessor->component_type == 0 || !has_count || !has_type) {
+    return invalid(parser, object, "accessor");
+  }
+
+  uint32_t component_count =
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+  if (min != VGLTF_JSON_TOKEN_NONE && max != VGLTF_JSON_TOKEN_NONE &&
+      component_count <= VGLTF_GLTF_MAX_BOUNDS_COMPONENT_COUNT) {
+    if (!parse_floats(parser, min, accessor->min, component_count,
+                      "accessor min") ||
+        !parse_floats(parser, max, accessor->max, component_count,
+                      "accessor max")) {
+      return false;
+    }
+    accessor->has_bounds = true;
+  }
+
+  if (sparse != VGLTF_JSON_TOKEN_NONE &&
+      !parse_sparse(parser, sparse, accessor)) {
+    return false;
+  }
+
+  if (accessor->buffer_view == VGLTF_GLTF_INDEX_NONE) {
+    return true;
+  }
+  const struct vgltf_gltf_buffer_view *buffer_view =
+      &gltf->buffer_views[accessor->buffer_view];
+  uint64_t element_size = accessor_element_size(accessor);
+  uint64_t stride =
+      buffer_view->byte_stride ? buffer_view->byte_stride : element_size;
+  if (stride < element_size ||
+      accessor->byte_offset > buffer_view->byte_length ||
+      stride * (accessor->count - 1) + element_size >
+          buffer_view->byte_length - accessor->byte_offset) {
+    return invalid(parser, object, "accessor range");
+  }
+  return true;
+}
+
+static bool parse_attributes(const struct parser *parser, uint32_t object,
+                             struct vgltf_gltf_primitive *primitive) {
+  static const char *const ATTRIBUTE_NAMES[VGLTF_GLTF_ATTRIBUTE_COUNT] = {
+      "POSITION",   "NORMAL",  "TANGENT",  "TEXCOORD_0",
+      "TEXCOORD_1", "COLOR_0", "JOINTS_0", "WEIGHTS_0"};
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "primitive attributes");
+  }
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    // Other attributes aren't used
+    for (int attribute = 0; attribute < VGLTF_GLTF_ATTRIBUTE_COUNT;
+         attribute++) {
+      if (key_eq(parser, key, ATTRIBUTE_NAMES[attribute])) {
+        if (!parse_index(parser, key + 1, parser->gltf->accessor_count,
+                         &primitive->attributes[attribute],
+                         "primitive attribute")) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+static bool parse_primitive(const struct parser *parser, uint32_t object,
+                            struct vgltf_gltf_primitive *primitive) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *primitive = (struct vgltf_gltf_primitive){
+      .indices = VGLTF_GLTF_INDEX_NONE,
+      .material = VGLTF_GLTF_INDEX_NONE,
+      .mode = VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLES};
+  for (int attribute = 0; attribute < VGLTF_GLTF_ATTRIBUTE_COUNT;
+       attribute++) {
+    primitive->attributes[attribute] = VGLTF_GLTF_INDEX_NONE;
+  }
+
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "primitive");
+  }
+  bool has_attributes = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "attributes")) {
+      if (!parse_attributes(parser, value, primitive)) {
+        return false;
+      }
+      has_attributes = true;
+    } else if (key_eq(parser, key, "indices")) {
+      if (!parse_index(parser, value, gltf->accessor_count,
+                       &primitive->indices, "primitive indices")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "material")) {
+      if (!parse_index(parser, value, gltf->material_count,
+                       &primitive->material, "primitive material")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "mode")) {
+      uint32_t mode;
+      if (!parse_index(parser, value,
+                       VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLE_FAN + 1, &mode,
+                       "primitive mode")) {
+        return false;
+      }
+      primitive->mode = mode;
+    }
+  }
+  return has_attributes || invalid(parser, object, "primitive");
+}
+
+static bool parse_mesh(struct parser *parser, uint32_t object,
+                       struct vgltf_gltf_mesh *mesh) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *mesh = (struct vgltf_gltf_mesh){.first_primitive = gltf->primitive_count};
+  bool has_primitives = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "name")) {
+      if (!intern_string(parser, value, &mesh->name)) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "primitives")) {
+      // Arrays were sized from the first occurrence of the key
+      if (!is_type(parser, value, VGLTF_JSON_TYPE_ARRAY) || has_primitives) {
+        return invalid(parser, value, "mesh primitives");
+      }
+      has_primitives = true;
+      for (uint32_t element = value + 1; element < end_of(parser, value);
+           element = end_of(parser, element)) {
+        if (!parse_primitive(parser, element,
+                             &gltf->primitives[gltf->primitive_count])) {
+          return false;
+        }
+        gltf->primitive_count++;
+        mesh->primitive_count++;
+      }
+    }
+  }
+  return mesh->primitive_count > 0 || invalid(parser, object, "mesh");
+}
+
+static bool parse_texture_info(const struct parser *parser, uint32_t object,
+                               struct vgltf_gltf_texture_info *texture_info) {
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "textureInfo");
+  }
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "index")) {
+      if (!parse_index(parser, value, parser->gltf->texture_count,
+                       &texture_info->texture, "textureInfo index")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "texCoord")) {
+      if (!vgltf_json_to_uint32(parser->document, value,
+                                &texture_info->texcoord)) {
+        return invalid(parser, value, "textureInfo texCoord");
+      }
+    }
+  }
+  return texture_info->texture != VGLTF_GLTF_INDEX_NONE ||
+         invalid(parser, object, "textureInfo");
+}
+
+static bool parse_pbr_metallic_roughness(const struct parser *parser,
+                                         uint32_t object,
+                                         struct vgltf_gltf_material *material) {
+  if (!is_type(parser, object, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, object, "pbrMetallicRoughness");
+  }
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    bool parsed = true;
+    if (key_eq(parser, key, "baseColorFactor")) {
+      parsed = parse_floats(parser, value, material->base_color_factor, 4,
+                            "baseColorFactor");
+    } else if (key_eq(parser, key, "baseColorTexture")) {
+      parsed = parse_texture_info(parser, value, &material->base_color_texture);
+    } else if (key_eq(parser, key, "metallicFactor")) {
+      parsed = vgltf_json_to_float(parser->document, value,
+                                   &material->metallic_factor) ||
+               invalid(parser, value, "metallicFactor");
+    } else if (key_eq(parser, key, "roughnessFactor")) {
+      parsed = vgltf_json_to_float(parser->document, value,
+                                   &material->roughness_factor) ||
+               invalid(parser, value, "roughnessFactor");
+    } else if (key_eq(parser, key, "metallicRoughnessTexture")) {
+      parsed = parse_texture_info(parser, value,
+                                  &material->metallic_roughness_texture);
+    }
+    if (!parsed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parse_material(const struct parser *parser, uint32_t object,
+                           struct vgltf_gltf_material *material) {
+  static const struct vgltf_gltf_texture_info NO_TEXTURE = {
+      .texture = VGLTF_GLTF_INDEX_NONE};
+  *material = (struct vgltf_gltf_material){
+      .base_color_factor = {1.f, 1.f, 1.f, 1.f},
+      .base_color_texture = NO_TEXTURE,
+      .metallic_factor = 1.f,
+      .roughness_factor = 1.f,
+      .metallic_roughness_texture = NO_TEXTURE,
+      .normal_texture = NO_TEXTURE,
+      .occlusion_texture = NO_TEXTURE,
+      .emissive_texture = NO_TEXTURE,
+      .alpha_mode = VGLTF_GLTF_ALPHA_MODE_OPAQUE,
+      .alpha_cutoff = 0.5f};
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    bool parsed = true;
+    if (key_eq(parser, key, "name")) {
+      parsed = intern_string(parser, value, &material->name);
+    } else if (key_eq(parser, key, "pbrMetallicRoughness")) {
+      parsed = parse_pbr_metallic_roughness(parser, value, material);
+    } else if (key_eq(parser, key, "normalTexture")) {
+      parsed = parse_texture_info(parser, value, &material->normal_texture);
+    } else if (key_eq(parser, key, "occlusionTexture")) {
+      parsed = parse_texture_info(parser, value, &material->occlusion_texture);
+    } else if (key_eq(parser, key, "emissiveTexture")) {
+      parsed = parse_texture_info(parser, value, &material->emissive_texture);
+    } else if (key_eq(parser, key, "emissiveFactor")) {
+      parsed = parse_floats(parser, value, material->emissive_factor, 3,
+                            "emissiveFactor");
+    } else if (key_eq(parser, key, "alphaMode")) {
+      if (key_eq(parser, value, "OPAQUE")) {
+        material->alpha_mode = VGLTF_GLTF_ALPHA_MODE_OPAQUE;
+      } else if (key_eq(parser, value, "MASK")) {
+        material->alpha_mode = VGLTF_GLTF_ALPHA_MODE_MASK;
+      } else if (key_eq(parser, value, "BLEND")) {
+        material->alpha_mode = VGLTF_GLTF_ALPHA_MODE_BLEND;
+      } else {
+        parsed = invalid(parser, value, "alphaMode");
+      }
+    } else if (key_eq(parser, key, "alphaCutoff")) {
+      parsed = vgltf_json_to_float(parser->document, value,
+                                   &material->alpha_cutoff) ||
+               invalid(parser, value, "alphaCutoff");
+    } else if (key_eq(parser, key, "doubleSided")) {
+      parsed = vgltf_json_to_bool(parser->document, value,
+                                  &material->double_sided) ||
+               invalid(parser, value, "doubleSided");
+    }
+    if (!parsed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parse_texture(const struct parser *parser, uint32_t object,
+                          struct vgltf_gltf_texture *texture) {
+  *texture = (struct vgltf_gltf_texture){.source = VGLTF_GLTF_INDEX_NONE,
+                                         .sampler = VGLTF_GLTF_INDEX_NONE};
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "source")) {
+      if (!parse_index(parser, value, parser->gltf->image_count,
+                       &texture->source, "texture source")) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "sampler")) {
+      if (!parse_index(parser, value, parser->sampler_count,
+                       &texture->sampler, "texture sampler")) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool is_data_uri(struct vgltf_string_view uri) {
+  return uri.length >= 5 && memcmp(uri.data, "data:", 5) == 0;
+}
+
+static int hex_digit_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+    return (c | 0x20) - 'a' + 10;
+  }
+  return -1;
+}
+
+// Interns the base directory joined with the percent decoded URI
+static bool intern_path(const struct parser *parser, uint32_t uri_token,
+                        vgltf_string_id *path) {
+  struct vgltf_string_view uri =
+      vgltf_json_token_text(parser->document, uri_token);
+  size_t capacity = parser->base_directory.length + uri.length;
+  char *joined = vgltf_allocator_allocate(parser->allocator, capacity + 1);
+  if (!joined) {
+    VGLTF_LOG_ERR("Couldn't allocate a glTF URI path");
+    return false;
+  }
+
+  bool interned = false;
+  memcpy(joined, parser->base_directory.data, parser->base_directory.length);
+  char *unescaped = joined + parser->base_directory.length;
+  size_t length;
+  if (!vgltf_json_string_unescape(parser->document, uri_token, unescaped,
+                                  uri.length, &length)) {
+    invalid(parser, uri_token, "uri");
+    goto free_joined;
+  }
+
+  size_t decoded_length = 0;
+  for (size_t i = 0; i < length; i++) {
+    int high;
+    int low;
+    if (unescaped[i] == '%' && i + 2 < length &&
+        (high = hex_digit_value(unescaped[i + 1])) >= 0 &&
+        (low = hex_digit_value(unescaped[i + 2])) >= 0) {
+      unescaped[decoded_length++] = (char)(high << 4 | low);
+      i += 2;
+    } else {
+      unescaped[decoded_length++] = unescaped[i];
+    }
+  }
+
+  *path = vgltf_string_interner_intern(
+      parser->interner,
+      (struct vgltf_string_view){.data = joined,
+                                 .length = parser->base_directory.length +
+                                           decoded_length});
+  interned = *path != VGLTF_STRING_ID_INVALID;
+free_joined:
+  vgltf_allocator_free(parser->allocator, joined);
+  return interned;
+}
+
+static bool parse_image(struct parser *parser, uint32_t object,
+                        uint32_t image_index) {
+  struct vgltf_gltf_image *image = &parser->gltf->images[image_index];
+  *image = (struct vgltf_gltf_image){.buffer_view = VGLTF_GLTF_INDEX_NONE};
+  parser->image_uris[image_index] = VGLTF_JSON_TOKEN_NONE;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "uri")) {
+      if (!is_type(parser, value, VGLTF_JSON_TYPE_STRING)) {
+        return invalid(parser, value, "image uri");
+      }
+      parser->image_uris[image_index] = value;
+      if (!is_data_uri(vgltf_json_token_text(parser->document, value)) &&
+          !intern_path(parser, value, &image->path)) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "bufferView")) {
+      if (!parse_index(parser, value, parser->gltf->buffer_view_count,
+                       &image->buffer_view, "image bufferView")) {
+        return false;
+      }
+    }
+  }
+  return (parser->image_uris[image_index] != VGLTF_JSON_TOKEN_NONE) !=
+             (image->buffer_view != VGLTF_GLTF_INDEX_NONE) ||
+         invalid(parser, object, "image");
+}
+
+// Composes translation * rotation * scale, the rotation is a unit quaternion
+static void compose_trs(vgltf_mat4 matrix, const float translation[3],
+                        const float rotation[4], const float scale[3]) {
+  float x = rotation[0];
+  float y = rotation[1];
+  float z = rotation[2];
+  float w = rotation[3];
+  // Rotation matrix rows, the elements of a column are consecutive in the
+  // renderer layout
+  float rotation_matrix[3][3] = {
+      {1.f - 2.f * (y * y + z * z), 2.f * (x * y - z * w),
+       2.f * (x * z + y * w)},
+      {2.f * (x * y + z * w), 1.f - 2.f * (x * x + z * z),
+       2.f * (y * z - x * w)},
+      {2.f * (x * z - y * w), 2.f * (y * z + x * w),
+       1.f - 2.f * (x * x + y * y)},
+  };
+  for (int column = 0; column < 3; column++) {
+    for (int row = 0; row < 3; row++) {
+      matrix[column * 4 + row] = rotation_matrix[row][column] * scale[column];
+    }
+    matrix[column * 4 + 3] = 0.f;
+  }
+  matrix[12] = translation[0];
+  matrix[13] = translation[1];
+  matrix[14] = translation[2];
+  matrix[15] = 1.f;
+}
+
+static bool parse_node(struct parser *parser, uint32_t object,
+                       struct vgltf_gltf_node *node) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *node = (struct vgltf_gltf_node){.mesh = VGLTF_GLTF_INDEX_NONE,
+                                   .first_child = gltf->node_child_count};
+  float translation[3] = {};
+  float rotation[4] = {0.f, 0.f, 0.f, 1.f};
+  float scale[3] = {1.f, 1.f, 1.f};
+  bool has_children = false;
+  bool has_matrix = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    bool parsed = true;
+    if (key_eq(parser, key, "name")) {
+      parsed = intern_string(parser, value, &node->name);
+    } else if (key_eq(parser, key, "mesh")) {
+      parsed = parse_index(parser, value, gltf->mesh_count, &node->mesh,
+                           "node mesh");
+    } else if (key_eq(parser, key, "children")) {
+      if (!is_type(parser, value, VGLTF_JSON_TYPE_ARRAY) || has_children) {
+        return invalid(parser, value, "node children");
+      }
+      has_children = true;
+      for (uint32_t element = value + 1; element < end_of(parser, value);
+           element = end_of(parser, element)) {
+        if (!parse_index(parser, element, gltf->node_count,
+                         &gltf->node_children[gltf->node_child_count],
+                         "node child")) {
+          return false;
+        }
+        gltf->node_child_count++;
+        node->child_count++;
+      }
+    } else if (key_eq(parser, key, "matrix")) {
+      // Column major, like the renderer layout
+      parsed = parse_floats(parser, value, node->matrix, 16, "node matrix");
+      has_matrix = true;
+    } else if (key_eq(parser, key, "translation")) {
+      parsed = parse_floats(parser, value, translation, 3, "node translation");
+    } else if (key_eq(parser, key, "rotation")) {
+      parsed = parse_floats(parser, value, rotation, 4, "node rotation");
+    } else if (key_eq(parser, key, "scale")) {
+      parsed = parse_floats(parser, value, scale, 3, "node scale");
+    }
+    if (!parsed) {
+      return false;
+    }
+  }
+
+  if (!has_matrix) {
+    compose_trs(node->matrix, translation, rotation, scale);
+  }
+  return true;
+}
+
+static bool parse_scene(struct parser *parser, uint32_t object,
+                        struct vgltf_gltf_scene *scene) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  *scene = (struct vgltf_gltf_scene){.first_node = gltf->scene_node_count};
+  bool has_nodes = false;
+  for (uint32_t key = first_member(object); key < end_of(parser, object);
+       key = next_member(parser, key)) {
+    uint32_t value = key + 1;
+    if (key_eq(parser, key, "name")) {
+      if (!intern_string(parser, value, &scene->name)) {
+        return false;
+      }
+    } else if (key_eq(parser, key, "nodes")) {
+      if (!is_type(parser, value, VGLTF_JSON_TYPE_ARRAY) || has_nodes) {
+        return invalid(parser, value, "scene nodes");
+      }
+      has_nodes = true;
+      for (uint32_t element = value + 1; element < end_of(parser, value);
+           element = end_of(parser, element)) {
+        if (!parse_index(parser, element, gltf->node_count,
+                         &gltf->scene_nodes[gltf->scene_node_count],
+                         "scene node")) {
+          return false;
+        }
+        gltf->scene_node_count++;
+        scene->node_count++;
+      }
+    }
+  }
+  return true;
+}
+
+// Nodes form trees, so no node can have two parents or be its own ancestor
+static bool check_node_hierarchy(const struct parser *parser) {
+  const struct vgltf_gltf *gltf = parser->gltf;
+  bool acyclic = false;
+  uint32_t *parents = vgltf_allocator_allocate_array(
+      parser->allocator, gltf->node_count + 1, sizeof(uint32_t));
+  if (!parents) {
+    VGLTF_LOG_ERR("Couldn't allocate the glTF node parents");
+    goto out;
+  }
+  for (uint32_t node_index = 0; node_index < gltf->node_count; node_index++) {
+    parents[node_index] = VGLTF_GLTF_INDEX_NONE;
+  }
+
+  for (uint32_t node_index = 0; node_index < gltf->node_count; node_index++) {
+    const struct vgltf_gltf_node *node = &gltf->nodes[node_index];
+    for (uint32_t child_index = 0; child_index < node->child_count;
+         child_index++) {
+      uint32_t child = gltf->node_children[node->first_child + child_index];
+      if (parents[child] != VGLTF_GLTF_INDEX_NONE) {
+        VGLTF_LOG_ERR("glTF node %u has more than one parent", child);
+        goto free_parents;
+      }
+      parents[child] = node_index;
+    }
+  }
+
+  // With one parent at most, walking up from a node of a cycle comes back to
+  // it within node_count steps
+  for (uint32_t node_index = 0; node_index < gltf->node_count; node_index++) {
+    uint32_t ancestor = parents[node_index];
+    for (uint32_t step = 0;
+         step < gltf->node_count && ancestor != VGLTF_GLTF_INDEX_NONE;
+         step++) {
+      if (ancestor == node_index) {
+        VGLTF_LOG_ERR("glTF node %u is its own ancestor", node_index);
+        goto free_parents;
+      }
+      ancestor = parents[ancestor];
+    }
+  }
+
+  acyclic = true;
+free_parents:
+  vgltf_allocator_free(parser->allocator, parents);
+out:
+  return acyclic;
+}
+
+// Sizes of the nested arrays, counted before they are allocated
+static uint32_t count_nested(const struct parser *parser, uint32_t array,
+                             const char *key) {
+  uint32_t count = 0;
+  if (array == VGLTF_JSON_TOKEN_NONE) {
+    return 0;
+  }
+  for (uint32_t element = array + 1; element < end_of(parser, array);
+       element = end_of(parser, element)) {
+    uint32_t nested =
+        vgltf_json_object_find(parser->document, element, SV(key));
+    if (nested != VGLTF_JSON_TOKEN_NONE) {
+      count += parser->document->tokens[nested].child_count;
+    }
+  }
+  return count;
+}
+
+enum section {
+  SECTION_BUFFERS,
+  SECTION_BUFFER_VIEWS,
+  SECTION_ACCESSORS,
+  SECTION_MESHES,
+  SECTION_MATERIALS,
+  SECTION_TEXTURES,
+  SECTION_IMAGES,
+  SECTION_SAMPLERS,
+  SECTION_NODES,
+  SECTION_SCENES,
+  SECTION_COUNT
+};
+static const char *const SECTION_NAMES[SECTION_COUNT] = {
+    "buffers",  "bufferViews", "accessors", "meshes", "materials",
+    "textures", "images",      "samplers",  "nodes",  "scenes"};
+
+static void *allocate_section(struct parser *parser, uint32_t count,
+                              size_t item_size, bool *allocated) {
+  void *items =
+      vgltf_allocator_allocate_array(parser->allocator, count, item_size);
+  *allocated = *allocated && (count == 0 || items);
+  return items;
+}
+
+static bool parse_document(struct parser *parser) {
+  const struct vgltf_json_document *document = parser->document;
+  struct vgltf_gltf *gltf = parser->gltf;
+  *gltf = (struct vgltf_gltf){.scene = VGLTF_GLTF_INDEX_NONE};
+  if (!is_type(parser, 0, VGLTF_JSON_TYPE_OBJECT)) {
+    return invalid(parser, 0, "document");
+  }
+
+  uint32_t sections[SECTION_COUNT];
+  uint32_t counts[SECTION_COUNT] = {};
+  for (int section = 0; section < SECTION_COUNT; section++) {
+    sections[section] =
+        vgltf_json_object_find(document, 0, SV(SECTION_NAMES[section]));
+    if (sections[section] == VGLTF_JSON_TOKEN_NONE) {
+      continue;
+    }
+    if (!is_type(parser, sections[section], VGLTF_JSON_TYPE_ARRAY)) {
+      return invalid(parser, sections[section], SECTION_NAMES[section]);
+    }
+    counts[section] = document->tokens[sections[section]].child_count;
+    // Elements are all objects
+    for (uint32_t element = sections[section] + 1;
+         element < end_of(parser, sections[section]);
+         element = end_of(parser, element)) {
+      if (!is_type(parser, element, VGLTF_JSON_TYPE_OBJECT)) {
+        return invalid(parser, element, SECTION_NAMES[section]);
+      }
+    }
+  }
+
+  uint32_t asset = vgltf_json_object_find(document, 0, SV("asset"));
+  if (asset == VGLTF_JSON_TOKEN_NONE || !parse_asset(parser, asset)) {
+    VGLTF_LOG_ERR("Missing or unsupported glTF asset description");
+    return false;
+  }
+  uint32_t required_extensions =
+      vgltf_json_object_find(document, 0, SV("extensionsRequired"));
+  if (required_extensions != VGLTF_JSON_TOKEN_NONE &&
+      !parse_required_extensions(parser, required_extensions)) {
+    return false;
+  }
+
+  // Every count is known before parsing, so indices can be checked as they
+  // are read
+  gltf->buffer_count = counts[SECTION_BUFFERS];
+  gltf->buffer_view_count = counts[SECTION_BUFFER_VIEWS];
+  gltf->accessor_count = counts[SECTION_ACCESSORS];
+  gltf->mesh_count = counts[SECTION_MESHES];
+  gltf->material_count = counts[SECTION_MATERIALS];
+  gltf->texture_count = counts[SECTION_TEXTURES];
+  gltf->image_count = counts[SECTION_IMAGES];
+  parser->sampler_count = counts[SECTION_SAMPLERS];
+  gltf->node_count = counts[SECTION_NODES];
+  gltf->scene_count = counts[SECTION_SCENES];
+  uint32_t primitive_capacity =
+      count_nested(parser, sections[SECTION_MESHES], "primitives");
+  uint32_t node_child_capacity =
+      count_nested(parser, sections[SECTION_NODES], "children");
+  uint32_t scene_node_capacity =
+      count_nested(parser, sections[SECTION_SCENES], "nodes");
+
+  bool allocated = true;
+  gltf->buffers =
+      allocate_section(parser, gltf->buffer_count,
+                       sizeof(struct vgltf_gltf_buffer), &allocated);
+  gltf->buffer_views =
+      allocate_section(parser, gltf->buffer_view_count,
+                       sizeof(struct vgltf_gltf_buffer_view), &allocated);
+  gltf->accessors =
+      allocate_section(parser, gltf->accessor_count,
+                       sizeof(struct vgltf_gltf_accessor), &allocated);
+  gltf->primitives =
+      allocate_section(parser, primitive_capacity,
+                       sizeof(struct vgltf_gltf_primitive), &allocated);
+  gltf->meshes = allocate_section(parser, gltf->mesh_count,
+                                  sizeof(struct vgltf_gltf_mesh), &allocated);
+  gltf->materials =
+      allocate_section(parser, gltf->material_count,
+                       sizeof(struct vgltf_gltf_material), &allocated);
+  gltf->textures =
+      allocate_section(parser, gltf->texture_count,
+                       sizeof(struct vgltf_gltf_texture), &allocated);
+  gltf->images = allocate_section(parser, gltf->image_count,
+                                  sizeof(struct vgltf_gltf_image), &allocated);
+  gltf->nodes = allocate_section(parser, gltf->node_count,
+                                 sizeof(struct vgltf_gltf_node), &allocated);
+  gltf->node_children = allocate_section(parser, node_child_capacity,
+                                         sizeof(uint32_t), &allocated);
+  gltf->scenes = allocate_section(parser, gltf->scene_count,
+                                  sizeof(struct vgltf_gltf_scene), &allocated);
+  gltf->scene_nodes = allocate_section(parser, scene_node_capacity,
+                                       sizeof(uint32_t), &allocated);
+  parser->buffer_uris = allocate_section(parser, gltf->buffer_count,
+                                         sizeof(uint32_t), &allocated);
+  parser->image_uris = allocate_section(parser, gltf->image_count,
+                                        sizeof(uint32_t), &allocated);
+  if (!allocated) {
+    VGLTF_LOG_ERR("Couldn't allocate the glTF arrays");
+    return false;
+  }
+
+  // Buffers come first, then buffer views, then accessors, so ranges can be
+  // checked as they are read
+  for (uint32_t index = 0, element = sections[SECTION_BUFFERS] + 1;
+       index < gltf->buffer_count; index++, element = end_of(parser, element)) {
+    if (!parse_buffer(parser, element, index)) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_BUFFER_VIEWS] + 1;
+       index < gltf->buffer_view_count;
+       index++, element = end_of(parser, element)) {
+    if (!parse_buffer_view(parser, element, &gltf->buffer_views[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_ACCESSORS] + 1;
+       index < gltf->accessor_count;
+       index++, element = end_of(parser, element)) {
+    if (!parse_accessor(parser, element, &gltf->accessors[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_MESHES] + 1;
+       index < gltf->mesh_count; index++, element = end_of(parser, element)) {
+    if (!parse_mesh(parser, element, &gltf->meshes[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_MATERIALS] + 1;
+       index < gltf->material_count;
+       index++, element = end_of(parser, element)) {
+    if (!parse_material(parser, element, &gltf->materials[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_TEXTURES] + 1;
+       index < gltf->texture_count;
+       index++, element = end_of(parser, element)) {
+    if (!parse_texture(parser, element, &gltf->textures[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_IMAGES] + 1;
+       index < gltf->image_count; index++, element = end_of(parser, element)) {
+    if (!parse_image(parser, element, index)) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_NODES] + 1;
+       index < gltf->node_count; index++, element = end_of(parser, element)) {
+    if (!parse_node(parser, element, &gltf->nodes[index])) {
+      return false;
+    }
+  }
+  for (uint32_t index = 0, element = sections[SECTION_SCENES] + 1;
+       index < gltf->scene_count; index++, element = end_of(parser, element)) {
+    if (!parse_scene(parser, element, &gltf->scenes[index])) {
+      return false;
+    }
+  }
+
+  uint32_t scene = vgltf_json_object_find(document, 0, SV("scene"));
+  if (scene != VGLTF_JSON_TOKEN_NONE &&
+      !parse_index(parser, scene, gltf->scene_count, &gltf->scene, "scene")) {
+    return false;
+  }
+  return check_node_hierarchy(parser);
+}
+
+static int base64_value(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  }
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  }
+  if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  }
+  if (c == '+') {
+    return 62;
+  }
+  if (c == '/') {
+    return 63;
+  }
+  return -1;
+}
+
+// Decodes in place, the decoded data is never longer than the encoded one
+static bool decode_base64(char *data, size_t encoded_size,
+                          size_t *decoded_size) {
+  while (encoded_size > 0 && data[encoded_size - 1] == '=') {
+    encoded_size--;
+  }
+
+  uint32_t bits = 0;
+  int bit_count = 0;
+  *decoded_size = 0;
+  for (size_t i = 0; i < encoded_size; i++) {
+    int value = base64_value(data[i]);
+    if (value < 0) {
+      return false;
+    }
+    bits = bits << 6 | (uint32_t)value;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      data[(*decoded_size)++] = (char)(bits >> bit_count);
+    }
+  }
+  return true;
+}
+
+// Returns the decoded data of a base64 data URI, to be freed with the
+// allocator
+static char *decode_data_uri(const struct parser *parser, uint32_t uri_token,
+                             size_t *size) {
+  struct vgltf_string_view uri =
+      vgltf_json_token_text(parser->document, uri_token);
+  char *data = vgltf_allocator_allocate(parser->allocator, uri.length);
+  if (!data) {
+    VGLTF_LOG_ERR("Couldn't allocate a glTF data URI");
+    goto err;
+  }
+
+  // Base64 data may have its slashes escaped
+  size_t length;
+  if (!vgltf_json_string_unescape(parser->document, uri_token, data,
+                                  uri.length, &length)) {
+    goto free_data;
+  }
+  char *comma = memchr(data, ',', length);
+  static const char BASE64_SUFFIX[] = ";base64";
+  size_t suffix_length = sizeof(BASE64_SUFFIX) - 1;
+  if (!comma || (size_t)(comma - data) < suffix_length ||
+      memcmp(comma - suffix_length, BASE64_SUFFIX, suffix_length) != 0) {
+    VGLTF_LOG_ERR("Only base64 glTF data URIs are supported");
+    goto free_data;
+  }
+
+  size_t header_length = comma + 1 - data;
+  memmove(data, comma + 1, length - header_length);
+  if (!decode_base64(data, length - header_length, size)) {
+    invalid(parser, uri_token, "base64 data");
+    goto free_data;
+  }
+  return data;
+free_data:
+  vgltf_allocator_free(parser->allocator, data);
+err:
+  return nullptr;
+}
+
+static bool load_buffers(const struct parser *parser,
+                         const char *binary_chunk, size_t binary_chunk_size) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  for (uint32_t buffer_index = 0; buffer_index < gltf->buffer_count;
+       buffer_index++) {
+    struct vgltf_gltf_buffer *buffer = &gltf->buffers[buffer_index];
+    uint32_t uri = parser->buffer_uris[buffer_index];
+    size_t size;
+    if (buffer->fallback) {
+      continue;
+    }
+    if (uri == VGLTF_JSON_TOKEN_NONE) {
+      // Only the first buffer of a GLB file can omit its URI
+      if (buffer_index != 0 || !binary_chunk) {
+        VGLTF_LOG_ERR("glTF buffer %u has no data", buffer_index);
+        return false;
+      }
+      buffer->data = binary_chunk;
+      size = binary_chunk_size;
+    } else if (is_data_uri(vgltf_json_token_text(parser->document, uri))) {
+      char *data = decode_data_uri(parser, uri, &size);
+      if (!data) {
+        return false;
+      }
+      gltf->decoded_data[gltf->decoded_data_count++] = data;
+      buffer->data = data;
+    } else {
+      vgltf_string_id path;
+      if (!intern_path(parser, uri, &path)) {
+        return false;
+      }
+      const char *path_data =
+          vgltf_string_interner_get(parser->interner, path).data;
+      gltf->buffer_file_data[buffer_index] =
+          vgltf_platform_read_file_to_string(path_data, &size);
+      if (!gltf->buffer_file_data[buffer_index]) {
+        VGLTF_LOG_ERR("Couldn't read glTF buffer %s", path_data);
+        return false;
+      }
+      buffer->data = gltf->buffer_file_data[buffer_index];
+    }
+
+    if (size < buffer->byte_length) {
+      VGLTF_LOG_ERR("glTF buffer %u is %zu bytes instead of %zu", buffer_index,
+                    size, (size_t)buffer->byte_length);
+      return false;
+    }
+  }
+  return true;
+}
+
+struct buffer_view_decoding {
+  const struct vgltf_gltf *gltf;
+  // The compressed views and where they are decoded
+  const uint32_t *buffer_views;
+  char *const *destinations;
+  atomic_bool failed;
+};
+
+static void decode_buffer_views(void *data, uint32_t begin, uint32_t end) {
+  struct buffer_view_decoding *decoding = data;
+  const struct vgltf_gltf *gltf = decoding->gltf;
+  for (uint32_t index = begin; index < end; index++) {
+    uint32_t buffer_view_index = decoding->buffer_views[index];
+    const struct vgltf_gltf_meshopt_compression *compression =
+        &gltf->buffer_views[buffer_view_index].compression;
+    const char *source =
+        gltf->buffers[compression->buffer].data + compression->byte_offset;
+    if (!vgltf_meshopt_decode(decoding->destinations[index], compression->count,
+                              compression->byte_stride, compression->mode,
+                              compression->filter,
+                              (const unsigned char *)source,
+                              compression->byte_length)) {
+      VGLTF_LOG_ERR("Couldn't decode glTF bufferView %u", buffer_view_index);
+      atomic_store_explicit(&decoding->failed, true, memory_order_relaxed);
+    }
+  }
+}
+
+// Points the views into their buffers, compressed views are decoded in
+// parallel, one job per view
+static bool load_buffer_views(const struct parser *parser,
+                              struct vgltf_job_system *job_system) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  uint32_t compressed_count = 0;
+  for (uint32_t buffer_view_index = 0;
+       buffer_view_index < gltf->buffer_view_count; buffer_view_index++) {
+    compressed_count += gltf->buffer_views[buffer_view_index].compressed;
+  }
+  uint32_t *compressed_buffer_views = vgltf_allocator_allocate_array(
+      parser->allocator, compressed_count, sizeof(uint32_t));
+  if (compressed_count != 0 && !compressed_buffer_views) {
+    VGLTF_LOG_ERR("Couldn't allocate the compressed glTF buffer views");
+    return false;
+  }
+
+  struct buffer_view_decoding decoding = {
+      .gltf = gltf,
+      .buffer_views = compressed_buffer_views,
+      .destinations = &gltf->decoded_data[gltf->decoded_data_count]};
+  uint32_t compressed_index = 0;
+  for (uint32_t buffer_view_index = 0;
+       buffer_view_index < gltf->buffer_view_count; buffer_view_index++) {
+    struct vgltf_gltf_buffer_view *buffer_view =
+        &gltf->buffer_views[buffer_view_index];
+    if (!buffer_view->compressed) {
+      buffer_view->data =
+          gltf->buffers[buffer_view->buffer].data + buffer_view->byte_offset;
+      continue;
+    }
+
+    char *data =
+        vgltf_allocator_allocate(parser->allocator, buffer_view->byte_length);
+    if (!data) {
+      VGLTF_LOG_ERR("Couldn't allocate glTF bufferView %u", buffer_view_index);
+      vgltf_allocator_free(parser->allocator, compressed_buffer_views);
+      return false;
+    }
+    // Past the decoded elements the view is zeros
+    uint64_t decoded_size = (uint64_t)buffer_view->compression.count *
+                            buffer_view->compression.byte_stride;
+    memset(data + decoded_size, 0, buffer_view->byte_length - decoded_size);
+    gltf->decoded_data[gltf->decoded_data_count++] = data;
+    buffer_view->data = data;
+    compressed_buffer_views[compressed_index++] = buffer_view_index;
+  }
+
+  if (job_system) {
+    vgltf_job_system_parallel_for(job_system, compressed_count, 1,
+                                  decode_buffer_views, &decoding);
+  } else {
+    decode_buffer_views(&decoding, 0, compressed_count);
+  }
+  vgltf_allocator_free(parser->allocator, compressed_buffer_views);
+  return !atomic_load(&decoding.failed);
+}
+
+static bool load_images(const struct parser *parser) {
+  struct vgltf_gltf *gltf = parser->gltf;
+  for (uint32_t image_index = 0; image_index < gltf->image_count;
+       image_index++) {
+    struct vgltf_gltf_image *image = &gltf->images[image_index];
+    uint32_t uri = parser->image_uris[image_index];
+    if (image->buffer_view != VGLTF_GLTF_INDEX_NONE) {
+      const struct vgltf_gltf_buffer_view *buffer_view =
+          &gltf->buffer_views[image->buffer_view];
+      image->data = buffer_view->data;
+      image->data_size = buffer_view->byte_length;
+    } else if (image->path == VGLTF_STRING_ID_INVALID) {
+      char *data = decode_data_uri(parser, uri, &image->data_size);
+      if (!data) {
+        return false;
+      }
+      gltf->decoded_data[gltf->decoded_data_count++] = data;
+      image->data = data;
+    }
+  }
+  return true;
+}
+
+static constexpr uint32_t GLB_MAGIC = 0x46546C67;
+static constexpr uint32_t GLB_VERSION = 2;
+static constexpr uint32_t GLB_CHUNK_TYPE_JSON = 0x4E4F534A;
+static constexpr uint32_t GLB_CHUNK_TYPE_BIN = 0x004E4942;
+static constexpr size_t GLB_HEADER_SIZE = 12;
+static constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+static uint32_t read_u32(const char *bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static bool is_glb(const char *data, size_t size) {
+  return size >= GLB_HEADER_SIZE && read_u32(data) == GLB_MAGIC;
+}
+
+// The JSON chunk comes first, the binary chunk, if any, right after
+static bool parse_glb(const char *data, size_t size,
+                      struct vgltf_string_view *json,
+                      const char **binary_chunk, size_t *binary_chunk_size) {
+  if (read_u32(data + 4) != GLB_VERSION) {
+    VGLTF_LOG_ERR("Unsupported GLB version %u", read_u32(data + 4));
+    return false;
+  }
+  size_t length = read_u32(data + 8);
+  if (length > size || length < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE) {
+    VGLTF_LOG_ERR("Truncated GLB file");
+    return false;
+  }
+
+  size_t json_size = read_u32(data + GLB_HEADER_SIZE);
+  if (read_u32(data + GLB_HEADER_SIZE + 4) != GLB_CHUNK_TYPE_JSON ||
+      json_size > length - GLB_HEADER_SIZE - GLB_CHUNK_HEADER_SIZE) {
+    VGLTF_LOG_ERR("Invalid GLB JSON chunk");
+    return false;
+  }
+  *json = (struct vgltf_string_view){
+      .data = data + GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE,
+      .length = json_size};
+
+  *binary_chunk = nullptr;
+  *binary_chunk_size = 0;
+  size_t binary_chunk_offset =
+      GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE + ((json_size + 3) & ~3ull);
+  if (binary_chunk_offset + GLB_CHUNK_HEADER_SIZE <= length &&
+      read_u32(data + binary_chunk_offset + 4) == GLB_CHUNK_TYPE_BIN) {
+    *binary_chunk_size = read_u32(data + binary_chunk_offset);
+    if (*binary_chunk_size >
+        length - binary_chunk_offset - GLB_CHUNK_HEADER_SIZE) {
+      VGLTF_LOG_ERR("Invalid GLB binary chunk");
+      return false;
+    }
+    *binary_chunk = data + binary_chunk_offset + GLB_CHUNK_HEADER_SIZE;
+  }
+  return true;
+}
+
+static void free_parser(struct parser *parser) {
+  vgltf_allocator_free(parser->allocator, parser->image_uris);
+  vgltf_allocator_free(parser->allocator, parser->buffer_uris);
+}
+
+bool vgltf_gltf_load(struct vgltf_gltf *gltf, struct vgltf_allocator *allocator,
+                     struct vgltf_string_interner *interner,
+                     struct vgltf_job_system *job_system, const char *path) {
+  assert(gltf);
+  assert(allocator);
+  assert(interner);
+  assert(path);
+  size_t file_size;
+  char *file_data = vgltf_platform_read_file_to_string(path, &file_size);
+  if (!file_data) {
+    VGLTF_LOG_ERR("Couldn't read glTF file %s", path);
+    goto err;
+  }
+
+  struct vgltf_string_view json = {.data = file_data, .length = file_size};
+  const char *binary_chunk = nullptr;
+  size_t binary_chunk_size = 0;
+  if (is_glb(file_data, file_size) &&
+      !parse_glb(file_data, file_size, &json, &binary_chunk,
+                 &binary_chunk_size)) {
+    goto free_file_data;
+  }
+
+  struct vgltf_json_document document;
+  if (!vgltf_json_document_parse(&document, allocator, json)) {
+    VGLTF_LOG_ERR("Couldn't parse the JSON of %s", path);
+    goto free_file_data;
+  }
+
+  const char *last_separator = strrchr(path, '/');
+#ifdef VGLTF_PLATFORM_WINDOWS
+  const char *last_backslash = strrchr(path, '\\');
+  last_separator = last_backslash > last_separator ? last_backslash
+                                                   : last_separator;
+#endif
+  struct parser parser = {
+      .document = &document,
+      .allocator = allocator,
+      .interner = interner,
+      .gltf = gltf,
+      .base_directory = {.data = path,
+                         .length = last_separator ? last_separator + 1 - path
+                                                  : 0}};
+  if (!parse_document(&parser)) {
+    VGLTF_LOG_ERR("Couldn't parse glTF file %s", path);
+    goto deinit_gltf;
+  }
+
+  gltf->buffer_file_data = vgltf_allocator_allocate_array(
+      allocator, gltf->buffer_count + 1, sizeof(char *));
+  gltf->decoded_data = vgltf_allocator_allocate_array(
+      allocator,
+      gltf->buffer_count + gltf->buffer_view_count + gltf->image_count + 1,
+      sizeof(char *));
+  if (!gltf->buffer_file_data || !gltf->decoded_data) {
+    VGLTF_LOG_ERR("Couldn't allocate the glTF buffer data");
+    goto deinit_gltf;
+  }
+  if (!load_buffers(&parser, binary_chunk, binary_chunk_size) ||
+      !load_buffer_views(&parser, job_system) || !load_images(&parser)) {
+    VGLTF_LOG_ERR("Couldn't load the buffers of glTF file %s", path);
+    goto deinit_gltf;
+  }
+
+  gltf->file_data = file_data;
+  free_parser(&parser);
+  vgltf_json_document_deinit(&document, allocator);
+  return true;
+deinit_gltf:
+  free_parser(&parser);
+  vgltf_gltf_deinit(gltf, allocator);
+  vgltf_json_document_deinit(&document, allocator);
+free_file_data:
+  vgltf_platform_free_file_data(file_data);
+err:
+  return false;
+}
+
+bool vgltf_gltf_parse(struct vgltf_gltf *gltf,
+                      struct vgltf_allocator *allocator,
+                      struct vgltf_string_interner *interner,
+                      struct vgltf_string_view json) {
+  assert(gltf);
+  assert(allocator);
+  assert(interner);
+  struct vgltf_json_document document;
+  if (!vgltf_json_document_parse(&document, allocator, json)) {
+    return false;
+  }
+
+  struct parser parser = {.document = &document,
+                          .allocator = allocator,
+                          .interner = interner,
+                          .gltf = gltf};
+  bool parsed = parse_document(&parser);
+  free_parser(&parser);
+  if (!parsed) {
+    vgltf_gltf_deinit(gltf, allocator);
+  }
+  vgltf_json_document_deinit(&document, allocator);
+  return parsed;
+}
+
+void vgltf_gltf_deinit(struct vgltf_gltf *gltf,
+                       struct vgltf_allocator *allocator) {
+  assert(gltf);
+  assert(allocator);
+  for (uint32_t data_index = 0; data_index < gltf->decoded_data_count;
+       data_index++) {
+    vgltf_allocator_free(allocator, gltf->decoded_data[data_index]);
+  }
+  vgltf_allocator_free(allocator, gltf->decoded_data);
+  if (gltf->buffer_file_data) {
+    for (uint32_t buffer_index = 0; buffer_index < gltf->buffer_count;
+         buffer_index++) {
+      if (gltf->buffer_file_data[buffer_index]) {
+        vgltf_platform_free_file_data(gltf->buffer_file_data[buffer_index]);
+      }
+    }
+  }
+  vgltf_allocator_free(allocator, gltf->buffer_file_data);
+  if (gltf->file_data) {
+    vgltf_platform_free_file_data(gltf->file_data);
+  }
+
+  vgltf_allocator_free(allocator, gltf->scene_nodes);
+  vgltf_allocator_free(allocator, gltf->scenes);
+  vgltf_allocator_free(allocator, gltf->node_children);
+  vgltf_allocator_free(allocator, gltf->nodes);
+  vgltf_allocator_free(allocator, gltf->images);
+  vgltf_allocator_free(allocator, gltf->textures);
+  vgltf_allocator_free(allocator, gltf->materials);
+  vgltf_allocator_free(allocator, gltf->meshes);
+  vgltf_allocator_free(allocator, gltf->primitives);
+  vgltf_allocator_free(allocator, gltf->accessors);
+  vgltf_allocator_free(allocator, gltf->buffer_views);
+  vgltf_allocator_free(allocator, gltf->buffers);
+}
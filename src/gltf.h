@@ -0,0 +1,253 @@
+#ifndef VGLTF_GLTF_H
+#define VGLTF_GLTF_H
+
+#include "alloc.h"
+#include "json.h"
+#include "maths.h"
+#include "meshopt.h"
+#include "str.h"
+#include "string_interner.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint32_t VGLTF_GLTF_INDEX_NONE = UINT32_MAX;
+
+enum vgltf_gltf_component_type {
+  VGLTF_GLTF_COMPONENT_TYPE_BYTE = 5120,
+  VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE = 5121,
+  VGLTF_GLTF_COMPONENT_TYPE_SHORT = 5122,
+  VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT = 5123,
+  VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_INT = 5125,
+  VGLTF_GLTF_COMPONENT_TYPE_FLOAT = 5126,
+};
+uint32_t vgltf_gltf_component_type_size(enum vgltf_gltf_component_type type);
+
+enum vgltf_gltf_accessor_type {
+  VGLTF_GLTF_ACCESSOR_TYPE_SCALAR,
+  VGLTF_GLTF_ACCESSOR_TYPE_VEC2,
+  VGLTF_GLTF_ACCESSOR_TYPE_VEC3,
+  VGLTF_GLTF_ACCESSOR_TYPE_VEC4,
+  VGLTF_GLTF_ACCESSOR_TYPE_MAT2,
+  VGLTF_GLTF_ACCESSOR_TYPE_MAT3,
+  VGLTF_GLTF_ACCESSOR_TYPE_MAT4,
+};
+uint32_t vgltf_gltf_accessor_type_component_count(
+    enum vgltf_gltf_accessor_type type);
+
+enum vgltf_gltf_primitive_mode {
+  VGLTF_GLTF_PRIMITIVE_MODE_POINTS,
+  VGLTF_GLTF_PRIMITIVE_MODE_LINES,
+  VGLTF_GLTF_PRIMITIVE_MODE_LINE_LOOP,
+  VGLTF_GLTF_PRIMITIVE_MODE_LINE_STRIP,
+  VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLES,
+  VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLE_STRIP,
+  VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLE_FAN,
+};
+
+enum vgltf_gltf_attribute {
+  VGLTF_GLTF_ATTRIBUTE_POSITION,
+  VGLTF_GLTF_ATTRIBUTE_NORMAL,
+  VGLTF_GLTF_ATTRIBUTE_TANGENT,
+  VGLTF_GLTF_ATTRIBUTE_TEXCOORD_0,
+  VGLTF_GLTF_ATTRIBUTE_TEXCOORD_1,
+  VGLTF_GLTF_ATTRIBUTE_COLOR_0,
+  VGLTF_GLTF_ATTRIBUTE_JOINTS_0,
+  VGLTF_GLTF_ATTRIBUTE_WEIGHTS_0,
+  VGLTF_GLTF_ATTRIBUTE_COUNT
+};
+
+enum vgltf_gltf_alpha_mode {
+  VGLTF_GLTF_ALPHA_MODE_OPAQUE,
+  VGLTF_GLTF_ALPHA_MODE_MASK,
+  VGLTF_GLTF_ALPHA_MODE_BLEND,
+};
+
+struct vgltf_gltf_buffer {
+  uint64_t byte_length;
+  // An EXT_meshopt_compression fallback, only compressed buffer views use it
+  // and it isn't loaded, its data is left null
+  bool fallback;
+  // Points into the GLB binary chunk, a loaded file or decoded data URI
+  const char *data;
+};
+
+// Where the EXT_meshopt_compression stream of a buffer view is, and how it
+// decodes to the view's bytes
+struct vgltf_gltf_meshopt_compression {
+  uint32_t buffer;
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint32_t byte_stride;
+  uint32_t count;
+  enum vgltf_meshopt_mode mode;
+  enum vgltf_meshopt_filter filter;
+};
+
+struct vgltf_gltf_buffer_view {
+  uint32_t buffer;
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  // 0 if the elements are tightly packed
+  uint32_t byte_stride;
+  bool compressed;
+  struct vgltf_gltf_meshopt_compression compression;
+  // Points to the view's bytes in its buffer, or to the decoded stream of a
+  // compressed view
+  const char *data;
+};
+
+// Bounds are only kept for scalar and vector accessors
+constexpr int VGLTF_GLTF_MAX_BOUNDS_COMPONENT_COUNT = 4;
+
+// Elements of a sparse accessor replaced by tightly packed values. Indices are
+// unsigned integers, the glTF spec requires them to be strictly increasing.
+struct vgltf_gltf_accessor_sparse {
+  // 0 if the accessor isn't sparse
+  uint32_t count;
+  uint32_t indices_buffer_view;
+  uint64_t indices_byte_offset;
+  enum vgltf_gltf_component_type indices_component_type;
+  uint32_t values_buffer_view;
+  uint64_t values_byte_offset;
+};
+
+struct vgltf_gltf_accessor {
+  // VGLTF_GLTF_INDEX_NONE if the elements are all zeros, before the sparse
+  // substitutions
+  uint32_t buffer_view;
+  uint64_t byte_offset;
+  enum vgltf_gltf_component_type component_type;
+  bool normalized;
+  uint32_t count;
+  enum vgltf_gltf_accessor_type type;
+  bool has_bounds;
+  float min[VGLTF_GLTF_MAX_BOUNDS_COMPONENT_COUNT];
+  float max[VGLTF_GLTF_MAX_BOUNDS_COMPONENT_COUNT];
+  struct vgltf_gltf_accessor_sparse sparse;
+};
+
+struct vgltf_gltf_primitive {
+  // Accessor indices, VGLTF_GLTF_INDEX_NONE for the missing attributes
+  uint32_t attributes[VGLTF_GLTF_ATTRIBUTE_COUNT];
+  uint32_t indices;
+  uint32_t material;
+  enum vgltf_gltf_primitive_mode mode;
+};
+
+struct vgltf_gltf_mesh {
+  vgltf_string_id name;
+  uint32_t first_primitive;
+  uint32_t primitive_count;
+};
+
+struct vgltf_gltf_texture_info {
+  // VGLTF_GLTF_INDEX_NONE if the material has no such texture
+  uint32_t texture;
+  uint32_t texcoord;
+};
+
+struct vgltf_gltf_material {
+  vgltf_string_id name;
+  float base_color_factor[4];
+  struct vgltf_gltf_texture_info base_color_texture;
+  float metallic_factor;
+  float roughness_factor;
+  struct vgltf_gltf_texture_info metallic_roughness_texture;
+  struct vgltf_gltf_texture_info normal_texture;
+  struct vgltf_gltf_texture_info occlusion_texture;
+  struct vgltf_gltf_texture_info emissive_texture;
+  float emissive_factor[3];
+  enum vgltf_gltf_alpha_mode alpha_mode;
+  float alpha_cutoff;
+  bool double_sided;
+};
+
+struct vgltf_gltf_texture {
+  uint32_t source;
+  uint32_t sampler;
+};
+
+struct vgltf_gltf_image {
+  // Path of the image file, VGLTF_STRING_ID_INVALID if the image is embedded
+  // in a buffer view or a data URI
+  vgltf_string_id path;
+  uint32_t buffer_view;
+  const char *data;
+  size_t data_size;
+};
+
+struct vgltf_gltf_node {
+  vgltf_string_id name;
+  uint32_t mesh;
+  // Range of gltf->node_children
+  uint32_t first_child;
+  uint32_t child_count;
+  // Same layout as the renderer matrices, points are transformed as row
+  // vectors
+  vgltf_mat4 matrix;
+};
+
+struct vgltf_gltf_scene {
+  vgltf_string_id name;
+  // Range of gltf->scene_nodes
+  uint32_t first_node;
+  uint32_t node_count;
+};
+
+// A glTF 2.0 asset, parsed from the token stream of vgltf_json_document. Every
+// index is checked to be in range, as is every accessor against its buffer
+// view and every buffer view against its buffer.
+struct vgltf_gltf {
+  struct vgltf_gltf_buffer *buffers;
+  uint32_t buffer_count;
+  struct vgltf_gltf_buffer_view *buffer_views;
+  uint32_t buffer_view_count;
+  struct vgltf_gltf_accessor *accessors;
+  uint32_t accessor_count;
+  struct vgltf_gltf_primitive *primitives;
+  uint32_t primitive_count;
+  struct vgltf_gltf_mesh *meshes;
+  uint32_t mesh_count;
+  struct vgltf_gltf_material *materials;
+  uint32_t material_count;
+  struct vgltf_gltf_texture *textures;
+  uint32_t texture_count;
+  struct vgltf_gltf_image *images;
+  uint32_t image_count;
+  struct vgltf_gltf_node *nodes;
+  uint32_t node_count;
+  uint32_t *node_children;
+  uint32_t node_child_count;
+  struct vgltf_gltf_scene *scenes;
+  uint32_t scene_count;
+  uint32_t *scene_nodes;
+  uint32_t scene_node_count;
+  // VGLTF_GLTF_INDEX_NONE if the asset doesn't tell
+  uint32_t scene;
+
+  // Backing memory of the buffers, decoded buffer views and images
+  char *file_data;
+  char **buffer_file_data;
+  char **decoded_data;
+  uint32_t decoded_data_count;
+};
+
+struct vgltf_job_system;
+
+// Loads a .gltf or .glb file and the buffers it references. Strings are
+// interned, so they outlive the asset. Compressed buffer views are decoded on
+// the job system, or on the calling thread if job_system is null.
+bool vgltf_gltf_load(struct vgltf_gltf *gltf, struct vgltf_allocator *allocator,
+                     struct vgltf_string_interner *interner,
+                     struct vgltf_job_system *job_system, const char *path);
+// Parses the JSON of an asset without loading its buffers, buffer views and
+// embedded images, their data is left null
+bool vgltf_gltf_parse(struct vgltf_gltf *gltf,
+                      struct vgltf_allocator *allocator,
+                      struct vgltf_string_interner *interner,
+                      struct vgltf_string_view json);
+void vgltf_gltf_deinit(struct vgltf_gltf *gltf,
+                       struct vgltf_allocator *allocator);
+
+#endif // VGLTF_GLTF_H
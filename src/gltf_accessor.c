@@ -0,0 +1,631 @@
+#include "gltf_accessor.h"
+#include "log.h"
+#include "simd.h"
+#include <assert.h>
+#include <string.h>
+
+// Elements are gathered and converted a batch at a time through stack
+// buffers, so the conversion loops always see contiguous components
+static constexpr uint32_t BATCH_ELEMENT_COUNT = 256;
+static constexpr uint32_t MAX_COMPONENT_COUNT = 4;
+static constexpr uint32_t MAX_ELEMENT_SIZE =
+    MAX_COMPONENT_COUNT * sizeof(float);
+
+// 32 bits lanes, narrower components are widened to them
+#define VGLTF_GLTF_ACCESSOR_LANE_COUNT (VGLTF_SIMD_VECTOR_SIZE / 4)
+
+typedef float vgltf_gltf_f32v
+    __attribute__((vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(float))));
+typedef int32_t vgltf_gltf_i32v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(int32_t))));
+typedef uint32_t vgltf_gltf_u32v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(uint32_t))));
+typedef uint16_t vgltf_gltf_u16v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(uint16_t))));
+typedef int16_t vgltf_gltf_i16v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(int16_t))));
+typedef uint8_t vgltf_gltf_u8v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(uint8_t))));
+typedef int8_t vgltf_gltf_i8v __attribute__((
+    vector_size(VGLTF_GLTF_ACCESSOR_LANE_COUNT * sizeof(int8_t))));
+
+// The most negative value of a signed normalized integer would be below -1
+static vgltf_gltf_f32v clamp_to_minus_one(vgltf_gltf_f32v values) {
+  vgltf_gltf_i32v below = values < -1.f;
+  vgltf_gltf_f32v minus_one = (vgltf_gltf_f32v){} - 1.f;
+  return (vgltf_gltf_f32v)(((vgltf_gltf_i32v)values & ~below) |
+                           ((vgltf_gltf_i32v)minus_one & below));
+}
+
+static void store_floats(float *values, vgltf_gltf_f32v converted) {
+  memcpy(values, &converted, sizeof(converted));
+}
+
+static void convert_u8(const char *components, uint32_t count, float scale,
+                       float *values) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_u8v packed;
+    memcpy(&packed, components + index, sizeof(packed));
+    store_floats(values + index,
+                 __builtin_convertvector(packed, vgltf_gltf_f32v) * scale);
+  }
+  for (; index < count; index++) {
+    values[index] = (float)(uint8_t)components[index] * scale;
+  }
+}
+
+static void convert_i8(const char *components, uint32_t count, float scale,
+                       bool normalized, float *values) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_i8v packed;
+    memcpy(&packed, components + index, sizeof(packed));
+    vgltf_gltf_f32v converted =
+        __builtin_convertvector(packed, vgltf_gltf_f32v) * scale;
+    store_floats(values + index,
+                 normalized ? clamp_to_minus_one(converted) : converted);
+  }
+  for (; index < count; index++) {
+    float value = (float)(int8_t)components[index] * scale;
+    values[index] = normalized && value < -1.f ? -1.f : value;
+  }
+}
+
+static void convert_u16(const char *components, uint32_t count, float scale,
+                        float *values) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_u16v packed;
+    memcpy(&packed, components + index * sizeof(uint16_t), sizeof(packed));
+    store_floats(values + index,
+                 __builtin_convertvector(packed, vgltf_gltf_f32v) * scale);
+  }
+  for (; index < count; index++) {
+    uint16_t component;
+    memcpy(&component, components + index * sizeof(uint16_t),
+           sizeof(component));
+    values[index] = (float)component * scale;
+  }
+}
+
+static void convert_i16(const char *components, uint32_t count, float scale,
+                        bool normalized, float *values) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_i16v packed;
+    memcpy(&packed, components + index * sizeof(int16_t), sizeof(packed));
+    vgltf_gltf_f32v converted =
+        __builtin_convertvector(packed, vgltf_gltf_f32v) * scale;
+    store_floats(values + index,
+                 normalized ? clamp_to_minus_one(converted) : converted);
+  }
+  for (; index < count; index++) {
+    int16_t component;
+    memcpy(&component, components + index * sizeof(int16_t),
+           sizeof(component));
+    float value = (float)component * scale;
+    values[index] = normalized && value < -1.f ? -1.f : value;
+  }
+}
+
+static void convert_u32(const char *components, uint32_t count,
+                        float *values) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_u32v packed;
+    memcpy(&packed, components + index * sizeof(uint32_t), sizeof(packed));
+    store_floats(values + index,
+                 __builtin_convertvector(packed, vgltf_gltf_f32v));
+  }
+  for (; index < count; index++) {
+    uint32_t component;
+    memcpy(&component, components + index * sizeof(uint32_t),
+           sizeof(component));
+    values[index] = (float)component;
+  }
+}
+
+static void convert_components(const struct vgltf_gltf_accessor *accessor,
+                               const char *components, uint32_t count,
+                               float *values) {
+  bool normalized = accessor->normalized;
+  switch (accessor->component_type) {
+  case VGLTF_GLTF_COMPONENT_TYPE_BYTE:
+    convert_i8(components, count, normalized ? 1.f / 127.f : 1.f, normalized,
+               values);
+    break;
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    convert_u8(components, count, normalized ? 1.f / 255.f : 1.f, values);
+    break;
+  case VGLTF_GLTF_COMPONENT_TYPE_SHORT:
+    convert_i16(components, count, normalized ? 1.f / 32767.f : 1.f,
+                normalized, values);
+    break;
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    convert_u16(components, count, normalized ? 1.f / 65535.f : 1.f, values);
+    break;
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    convert_u32(components, count, values);
+    break;
+  case VGLTF_GLTF_COMPONENT_TYPE_FLOAT:
+    memcpy(values, components, count * sizeof(float));
+    break;
+  }
+}
+
+// Returns the first element of the accessor and the distance between
+// elements, or a null pointer for accessors without buffer view, whose
+// elements are all zeros
+static bool locate_elements(const struct vgltf_gltf *gltf,
+                            const struct vgltf_gltf_accessor *accessor,
+                            const char **elements, size_t *element_stride) {
+  *elements = nullptr;
+  *element_stride = 0;
+  if (accessor->buffer_view == VGLTF_GLTF_INDEX_NONE) {
+    return true;
+  }
+
+  const struct vgltf_gltf_buffer_view *buffer_view =
+      &gltf->buffer_views[accessor->buffer_view];
+  if (!buffer_view->data) {
+    VGLTF_LOG_ERR("glTF bufferView %u isn't loaded", accessor->buffer_view);
+    return false;
+  }
+
+  *elements = buffer_view->data + accessor->byte_offset;
+  *element_stride =
+      buffer_view->byte_stride != 0
+          ? buffer_view->byte_stride
+          : vgltf_gltf_component_type_size(accessor->component_type) *
+                vgltf_gltf_accessor_type_component_count(accessor->type);
+  return true;
+}
+
+// Packs strided elements together, tightly packed ones are used in place
+static const char *gather_elements(const char *elements, size_t element_stride,
+                                   size_t element_size, uint32_t first_element,
+                                   uint32_t element_count, char *gathered) {
+  const char *first = elements + first_element * element_stride;
+  if (element_stride == element_size) {
+    return first;
+  }
+
+  for (uint32_t element_index = 0; element_index < element_count;
+       element_index++) {
+    memcpy(gathered + element_index * element_size,
+           first + element_index * element_stride, element_size);
+  }
+  return gathered;
+}
+
+static bool check_range(const struct vgltf_gltf *gltf, uint32_t accessor_index,
+                        uint32_t first_element, uint32_t element_count) {
+  if (accessor_index >= gltf->accessor_count) {
+    VGLTF_LOG_ERR("Invalid glTF accessor %u", accessor_index);
+    return false;
+  }
+  const struct vgltf_gltf_accessor *accessor =
+      &gltf->accessors[accessor_index];
+  if (first_element > accessor->count ||
+      element_count > accessor->count - first_element) {
+    VGLTF_LOG_ERR("Elements [%u, %u) out of the %u of glTF accessor %u",
+                  first_element, first_element + element_count,
+                  accessor->count, accessor_index);
+    return false;
+  }
+  return true;
+}
+
+static vgltf_gltf_u32v max_u32v(vgltf_gltf_u32v lhs, vgltf_gltf_u32v rhs) {
+  vgltf_gltf_u32v greater = (vgltf_gltf_u32v)(lhs > rhs);
+  return (lhs & greater) | (rhs & ~greater);
+}
+
+static uint32_t reduce_max(vgltf_gltf_u32v maxima, uint32_t max) {
+  for (int lane = 0; lane < VGLTF_GLTF_ACCESSOR_LANE_COUNT; lane++) {
+    max = maxima[lane] > max ? maxima[lane] : max;
+  }
+  return max;
+}
+
+// Widens unsigned integers of element_size bytes to 32 bits, maxima and max
+// accumulate the vector and scalar maxima
+static void widen_indices(const char *components, size_t element_size,
+                          uint32_t count, uint32_t *indices,
+                          vgltf_gltf_u32v *maxima, uint32_t *max) {
+  uint32_t index = 0;
+  for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= count;
+       index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+    vgltf_gltf_u32v widened;
+    if (element_size == sizeof(uint8_t)) {
+      vgltf_gltf_u8v packed;
+      memcpy(&packed, components + index, sizeof(packed));
+      widened = __builtin_convertvector(packed, vgltf_gltf_u32v);
+    } else if (element_size == sizeof(uint16_t)) {
+      vgltf_gltf_u16v packed;
+      memcpy(&packed, components + index * sizeof(uint16_t), sizeof(packed));
+      widened = __builtin_convertvector(packed, vgltf_gltf_u32v);
+    } else {
+      memcpy(&widened, components + index * sizeof(uint32_t),
+             sizeof(widened));
+    }
+    memcpy(indices + index, &widened, sizeof(widened));
+    *maxima = max_u32v(*maxima, widened);
+  }
+  for (; index < count; index++) {
+    uint32_t value = 0;
+    // Little endian, the low bytes come first
+    memcpy(&value, components + index * element_size, element_size);
+    indices[index] = value;
+    *max = value > *max ? value : *max;
+  }
+}
+
+struct sparse_batch {
+  // Relative to the first element read
+  uint32_t elements[BATCH_ELEMENT_COUNT];
+  // Tightly packed values of the elements
+  const char *values;
+  uint32_t count;
+};
+
+typedef void (*sparse_substitute_fn)(const struct vgltf_gltf_accessor *accessor,
+                                     const struct sparse_batch *batch,
+                                     void *context);
+
+static uint32_t sparse_index(const char *indices, size_t index_size,
+                             uint32_t entry) {
+  uint32_t index = 0;
+  memcpy(&index, indices + entry * index_size, index_size);
+  return index;
+}
+
+// First sparse entry whose index isn't below element
+static uint32_t sparse_lower_bound(const char *indices, size_t index_size,
+                                   uint32_t entry_count, uint32_t element) {
+  uint32_t begin = 0;
+  uint32_t end = entry_count;
+  while (begin < end) {
+    uint32_t middle = begin + (end - begin) / 2;
+    if (sparse_index(indices, index_size, middle) < element) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
+
+// Hands the sparse elements of [first_element, first_element + element_count)
+// to substitute a batch at a time, after the dense elements were written
+static bool apply_sparse(const struct vgltf_gltf *gltf,
+                         uint32_t accessor_index, uint32_t first_element,
+                         uint32_t element_count,
+                         sparse_substitute_fn substitute, void *context) {
+  const struct vgltf_gltf_accessor *accessor =
+      &gltf->accessors[accessor_index];
+  const struct vgltf_gltf_accessor_sparse *sparse = &accessor->sparse;
+  if (sparse->count == 0) {
+    return true;
+  }
+
+  const struct vgltf_gltf_buffer_view *indices_view =
+      &gltf->buffer_views[sparse->indices_buffer_view];
+  const struct vgltf_gltf_buffer_view *values_view =
+      &gltf->buffer_views[sparse->values_buffer_view];
+  if (!indices_view->data || !values_view->data) {
+    VGLTF_LOG_ERR("Sparse buffers of glTF accessor %u aren't loaded",
+                  accessor_index);
+    return false;
+  }
+  const char *indices = indices_view->data + sparse->indices_byte_offset;
+  const char *values = values_view->data + sparse->values_byte_offset;
+  size_t index_size =
+      vgltf_gltf_component_type_size(sparse->indices_component_type);
+  size_t value_size =
+      vgltf_gltf_component_type_size(accessor->component_type) *
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+
+  uint32_t end_element = first_element + element_count;
+  uint32_t first_entry =
+      sparse_lower_bound(indices, index_size, sparse->count, first_element);
+  uint32_t end_entry =
+      sparse_lower_bound(indices, index_size, sparse->count, end_element);
+  uint32_t min_element = first_element;
+  struct sparse_batch batch;
+  for (uint32_t batch_entry = first_entry; batch_entry < end_entry;
+       batch_entry += BATCH_ELEMENT_COUNT) {
+    batch.count = end_entry - batch_entry < BATCH_ELEMENT_COUNT
+                      ? end_entry - batch_entry
+                      : BATCH_ELEMENT_COUNT;
+    batch.values = values + batch_entry * value_size;
+    vgltf_gltf_u32v maxima = {};
+    uint32_t max = 0;
+    widen_indices(indices + batch_entry * index_size, index_size, batch.count,
+                  batch.elements, &maxima, &max);
+
+    // Binary searches only find the range if the indices are sorted
+    for (uint32_t entry = 0; entry < batch.count; entry++) {
+      uint32_t element = batch.elements[entry];
+      if (element < min_element || element >= end_element) {
+        VGLTF_LOG_ERR("Sparse indices of glTF accessor %u aren't strictly "
+                      "increasing",
+                      accessor_index);
+        return false;
+      }
+      min_element = element + 1;
+      batch.elements[entry] = element - first_element;
+    }
+    substitute(accessor, &batch, context);
+  }
+  return true;
+}
+
+struct float_substitution {
+  float *values;
+  uint32_t component_count;
+  size_t value_stride;
+};
+
+static void substitute_floats(const struct vgltf_gltf_accessor *accessor,
+                              const struct sparse_batch *batch,
+                              void *context) {
+  const struct float_substitution *substitution = context;
+  uint32_t accessor_component_count =
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+  uint32_t copied_component_count =
+      substitution->component_count < accessor_component_count
+          ? substitution->component_count
+          : accessor_component_count;
+  float converted[BATCH_ELEMENT_COUNT * MAX_COMPONENT_COUNT];
+  convert_components(accessor, batch->values,
+                     batch->count * accessor_component_count, converted);
+  for (uint32_t entry = 0; entry < batch->count; entry++) {
+    memcpy(substitution->values +
+               batch->elements[entry] * substitution->value_stride,
+           &converted[entry * accessor_component_count],
+           copied_component_count * sizeof(float));
+  }
+}
+
+static void substitute_indices(const struct vgltf_gltf_accessor *accessor,
+                               const struct sparse_batch *batch,
+                               void *context) {
+  uint32_t *indices = context;
+  uint32_t widened[BATCH_ELEMENT_COUNT];
+  vgltf_gltf_u32v maxima = {};
+  uint32_t max = 0;
+  widen_indices(batch->values,
+                vgltf_gltf_component_type_size(accessor->component_type),
+                batch->count, widened, &maxima, &max);
+  for (uint32_t entry = 0; entry < batch->count; entry++) {
+    indices[batch->elements[entry]] = widened[entry];
+  }
+}
+
+struct component_substitution {
+  char *destination;
+  size_t copied_size;
+  size_t destination_stride;
+};
+
+static void substitute_components(const struct vgltf_gltf_accessor *accessor,
+                                  const struct sparse_batch *batch,
+                                  void *context) {
+  const struct component_substitution *substitution = context;
+  size_t element_size =
+      vgltf_gltf_component_type_size(accessor->component_type) *
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+  for (uint32_t entry = 0; entry < batch->count; entry++) {
+    memcpy(substitution->destination +
+               batch->elements[entry] * substitution->destination_stride,
+           batch->values + entry * element_size, substitution->copied_size);
+  }
+}
+
+bool vgltf_gltf_accessor_read_floats(const struct vgltf_gltf *gltf,
+                                     uint32_t accessor_index,
+                                     uint32_t first_element,
+                                     uint32_t element_count, float *values,
+                                     uint32_t component_count,
+                                     size_t value_stride) {
+  assert(gltf);
+  assert(values);
+  assert(component_count > 0 && component_count <= MAX_COMPONENT_COUNT);
+  if (!check_range(gltf, accessor_index, first_element, element_count)) {
+    return false;
+  }
+  const struct vgltf_gltf_accessor *accessor =
+      &gltf->accessors[accessor_index];
+  uint32_t accessor_component_count =
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+  if (accessor_component_count > MAX_COMPONENT_COUNT) {
+    VGLTF_LOG_ERR("glTF accessor %u is a matrix, not a vector",
+                  accessor_index);
+    return false;
+  }
+
+  const char *elements;
+  size_t element_stride;
+  if (!locate_elements(gltf, accessor, &elements, &element_stride)) {
+    return false;
+  }
+
+  size_t element_size =
+      vgltf_gltf_component_type_size(accessor->component_type) *
+      accessor_component_count;
+  uint32_t copied_component_count = component_count < accessor_component_count
+                                        ? component_count
+                                        : accessor_component_count;
+  char gathered[BATCH_ELEMENT_COUNT * MAX_ELEMENT_SIZE];
+  float converted[BATCH_ELEMENT_COUNT * MAX_COMPONENT_COUNT];
+  for (uint32_t batch_start = 0; batch_start < element_count;
+       batch_start += BATCH_ELEMENT_COUNT) {
+    uint32_t batch_count = element_count - batch_start < BATCH_ELEMENT_COUNT
+                               ? element_count - batch_start
+                               : BATCH_ELEMENT_COUNT;
+    uint32_t batch_component_count = batch_count * accessor_component_count;
+    if (elements) {
+      const char *components =
+          gather_elements(elements, element_stride, element_size,
+                          first_element + batch_start, batch_count, gathered);
+      convert_components(accessor, components, batch_component_count,
+                         converted);
+    } else {
+      memset(converted, 0, batch_component_count * sizeof(float));
+    }
+
+    for (uint32_t element_index = 0; element_index < batch_count;
+         element_index++) {
+      float *value = values + (batch_start + element_index) * value_stride;
+      memcpy(value, &converted[element_index * accessor_component_count],
+             copied_component_count * sizeof(float));
+      for (uint32_t component_index = copied_component_count;
+           component_index < component_count; component_index++) {
+        value[component_index] = component_index == 3 ? 1.f : 0.f;
+      }
+    }
+  }
+
+  struct float_substitution substitution = {.values = values,
+                                            .component_count = component_count,
+                                            .value_stride = value_stride};
+  return apply_sparse(gltf, accessor_index, first_element, element_count,
+                      substitute_floats, &substitution);
+}
+
+bool vgltf_gltf_accessor_read_indices(const struct vgltf_gltf *gltf,
+                                      uint32_t accessor_index,
+                                      uint32_t first_element,
+                                      uint32_t element_count,
+                                      uint32_t *indices, uint32_t *max_index) {
+  assert(gltf);
+  assert(indices);
+  assert(max_index);
+  if (!check_range(gltf, accessor_index, first_element, element_count)) {
+    return false;
+  }
+  const struct vgltf_gltf_accessor *accessor =
+      &gltf->accessors[accessor_index];
+  if (accessor->type != VGLTF_GLTF_ACCESSOR_TYPE_SCALAR ||
+      (accessor->component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+       accessor->component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+       accessor->component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_INT)) {
+    VGLTF_LOG_ERR("glTF accessor %u can't hold indices", accessor_index);
+    return false;
+  }
+
+  const char *elements;
+  size_t element_stride;
+  if (!locate_elements(gltf, accessor, &elements, &element_stride)) {
+    return false;
+  }
+
+  size_t element_size =
+      vgltf_gltf_component_type_size(accessor->component_type);
+  vgltf_gltf_u32v maxima = {};
+  uint32_t max = 0;
+  char gathered[BATCH_ELEMENT_COUNT * sizeof(uint32_t)];
+  for (uint32_t batch_start = 0; batch_start < element_count;
+       batch_start += BATCH_ELEMENT_COUNT) {
+    uint32_t batch_count = element_count - batch_start < BATCH_ELEMENT_COUNT
+                               ? element_count - batch_start
+                               : BATCH_ELEMENT_COUNT;
+    if (elements) {
+      const char *components =
+          gather_elements(elements, element_stride, element_size,
+                          first_element + batch_start, batch_count, gathered);
+      widen_indices(components, element_size, batch_count,
+                    indices + batch_start, &maxima, &max);
+    } else {
+      memset(indices + batch_start, 0, batch_count * sizeof(uint32_t));
+    }
+  }
+
+  if (accessor->sparse.count > 0) {
+    if (!apply_sparse(gltf, accessor_index, first_element, element_count,
+                      substitute_indices, indices)) {
+      return false;
+    }
+    // Substituted elements may have held the maximum
+    maxima = (vgltf_gltf_u32v){};
+    max = 0;
+    uint32_t index = 0;
+    for (; index + VGLTF_GLTF_ACCESSOR_LANE_COUNT <= element_count;
+         index += VGLTF_GLTF_ACCESSOR_LANE_COUNT) {
+      vgltf_gltf_u32v values;
+      memcpy(&values, indices + index, sizeof(values));
+      maxima = max_u32v(maxima, values);
+    }
+    for (; index < element_count; index++) {
+      max = indices[index] > max ? indices[index] : max;
+    }
+  }
+
+  *max_index = reduce_max(maxima, max);
+  return true;
+}
+
+bool vgltf_gltf_accessor_read_components(const struct vgltf_gltf *gltf,
+                                         uint32_t accessor_index,
+                                         uint32_t first_element,
+                                         uint32_t element_count,
+                                         void *destination,
+                                         uint32_t component_count,
+                                         size_t destination_stride) {
+  assert(gltf);
+  assert(destination);
+  if (!check_range(gltf, accessor_index, first_element, element_count)) {
+    return false;
+  }
+  const struct vgltf_gltf_accessor *accessor =
+      &gltf->accessors[accessor_index];
+  uint32_t accessor_component_count =
+      vgltf_gltf_accessor_type_component_count(accessor->type);
+  if (accessor_component_count > MAX_COMPONENT_COUNT) {
+    VGLTF_LOG_ERR("glTF accessor %u is a matrix, not a vector",
+                  accessor_index);
+    return false;
+  }
+
+  const char *elements;
+  size_t element_stride;
+  if (!locate_elements(gltf, accessor, &elements, &element_stride)) {
+    return false;
+  }
+
+  size_t component_size =
+      vgltf_gltf_component_type_size(accessor->component_type);
+  size_t copied_size =
+      component_size * (component_count < accessor_component_count
+                            ? component_count
+                            : accessor_component_count);
+  size_t destination_size = component_size * component_count;
+  char *first = destination;
+  for (uint32_t element_index = 0; element_index < element_count;
+       element_index++) {
+    char *element = first + element_index * destination_stride;
+    if (elements) {
+      memcpy(element,
+             elements + (size_t)(first_element + element_index) *
+                            element_stride,
+             copied_size);
+    } else {
+      memset(element, 0, copied_size);
+    }
+    memset(element + copied_size, 0, destination_size - copied_size);
+  }
+
+  struct component_substitution substitution = {
+      .destination = destination,
+      .copied_size = copied_size,
+      .destination_stride = destination_stride};
+  return apply_sparse(gltf, accessor_index, first_element, element_count,
+                      substitute_components, &substitution);
+}
@@ -0,0 +1,43 @@
+#ifndef VGLTF_GLTF_ACCESSOR_H
+#define VGLTF_GLTF_ACCESSOR_H
+
+#include "gltf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Sparse accessors are read with their substitutions applied.
+
+// Converts the elements [first_element, first_element + element_count) of a
+// scalar or vector accessor to floats, normalized integers are mapped to
+// [0, 1] or [-1, 1]. Element i is written at values + i * value_stride, in
+// floats. Components the accessor doesn't have are 0, except a fourth one
+// which is 1, as for RGB colors.
+bool vgltf_gltf_accessor_read_floats(const struct vgltf_gltf *gltf,
+                                     uint32_t accessor_index,
+                                     uint32_t first_element,
+                                     uint32_t element_count, float *values,
+                                     uint32_t component_count,
+                                     size_t value_stride);
+
+// Widens the elements [first_element, first_element + element_count) of an
+// unsigned integer scalar accessor to 32 bits, and returns their maximum so
+// the caller can check them against the vertex count
+bool vgltf_gltf_accessor_read_indices(const struct vgltf_gltf *gltf,
+                                      uint32_t accessor_index,
+                                      uint32_t first_element,
+                                      uint32_t element_count,
+                                      uint32_t *indices, uint32_t *max_index);
+
+// Copies the components of the elements [first_element, first_element +
+// element_count) without converting them, element i is written at
+// destination + i * destination_stride, in bytes. Components the accessor
+// doesn't have are 0.
+bool vgltf_gltf_accessor_read_components(const struct vgltf_gltf *gltf,
+                                         uint32_t accessor_index,
+                                         uint32_t first_element,
+                                         uint32_t element_count,
+                                         void *destination,
+                                         uint32_t component_count,
+                                         size_t destination_stride);
+
+#endif // VGLTF_GLTF_ACCESSOR_H
@@ -1,5 +1,7 @@
 #include "hash.h"
+#include "simd.h"
 #include <assert.h>
+#include <string.h>
 
 uint64_t vgltf_hash_fnv_1a(const char *bytes, size_t nbytes) {
   assert(bytes);
@@ -13,3 +15,373 @@ uint64_t vgltf_hash_fnv_1a(const char *bytes, size_t nbytes) {
 
   return hash;
 }
+
+// The construction follows XXH3: inputs up to 16 bytes are folded in a single
+// 128 bits multiplication like wyhash does, inputs up to 240 bytes in one per
+// 16 bytes, longer inputs are accumulated 64 bytes at a time in 8 lanes with
+// 32x32->64 bits multiplications.
+static constexpr uint64_t PRIME32_1 = 0x9E3779B1u;
+static constexpr uint64_t PRIME32_2 = 0x85EBCA77u;
+static constexpr uint64_t PRIME32_3 = 0xC2B2AE3Du;
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87u;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Fu;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9u;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63u;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5u;
+
+static constexpr int SHORT_SIZE_MAX = 16;
+static constexpr int MID_SIZE_MAX = 240;
+static constexpr int SECRET_SIZE = 256;
+// Consecutive stripes use keys 8 bytes apart in the secret
+static constexpr int BLOCK_STRIPE_COUNT =
+    (SECRET_SIZE - VGLTF_HASH_STRIPE_SIZE) / 8;
+static constexpr int LAST_STRIPE_SECRET_OFFSET =
+    SECRET_SIZE - VGLTF_HASH_STRIPE_SIZE - 7;
+static constexpr int SCRAMBLE_SECRET_OFFSET =
+    SECRET_SIZE - VGLTF_HASH_STRIPE_SIZE;
+
+// Splitmix64 output, read as little endian bytes
+static const uint64_t SECRET_WORDS[SECRET_SIZE / sizeof(uint64_t)] = {
+    0x9c5eb1fb915da95bu, 0xec867dd1b55aef31u, 0x252e41b944d15e87u,
+    0xbc4e144ba62edc26u, 0xbad2195f853d6fbcu, 0xa0d9a288b24c9d6eu,
+    0x7b1a8d207cc4e5a4u, 0xf3bdc6f97df6fd3bu, 0xa83630d2daea0219u,
+    0xf958d648a9ed992bu, 0x843a4dceb89ec25cu, 0x5ccf864bfa916d01u,
+    0x5a877dde1c7b9214u, 0x4efe891b6875f424u, 0x74ab2e3dc1645eecu,
+    0x19e074440ec54f72u, 0x9b0fd9d6fa6ad188u, 0xa80908ef0f33300bu,
+    0xe308f8b256ca4191u, 0x8bec4219941bb52fu, 0x056651030e541bd2u,
+    0xcbd0ccd694ce08edu, 0x7eb6abeae91d4a7bu, 0x3c94cd22fbc374fdu,
+    0x908012cc82f0ee2bu, 0x19bbd653de7e925au, 0x20908df50367398du,
+    0xcc79fc45e827804cu, 0xfb36ed401d37fa4au, 0xe6283505771e10e4u,
+    0xfe6b50c57b266c54u, 0xdf028995fc67f9c9u,
+};
+#define SECRET ((const char *)SECRET_WORDS)
+
+static const uint64_t INITIAL_ACCUMULATORS[VGLTF_HASH_ACCUMULATOR_COUNT] = {
+    PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+    PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+
+static uint64_t read_u64(const char *bytes) {
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static uint64_t read_u32(const char *bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static uint64_t multiply_fold(uint64_t lhs, uint64_t rhs) {
+  unsigned __int128 product = (unsigned __int128)lhs * rhs;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static uint64_t avalanche(uint64_t hash) {
+  hash ^= hash >> 37;
+  hash *= 0x165667919E3779F9u;
+  return hash ^ (hash >> 32);
+}
+
+static uint64_t hash_short(const char *bytes, size_t nbytes,
+                           const char *secret) {
+  uint64_t lhs = 0;
+  uint64_t rhs = 0;
+  if (nbytes >= 8) {
+    lhs = read_u64(bytes);
+    rhs = read_u64(bytes + nbytes - 8);
+  } else if (nbytes >= 4) {
+    lhs = read_u32(bytes);
+    rhs = read_u32(bytes + nbytes - 4);
+  } else if (nbytes > 0) {
+    lhs = ((uint64_t)(unsigned char)bytes[0] << 16) |
+          ((uint64_t)(unsigned char)bytes[nbytes / 2] << 8) |
+          (unsigned char)bytes[nbytes - 1];
+  }
+
+  unsigned __int128 product = (unsigned __int128)(lhs ^ read_u64(secret)) *
+                              (rhs ^ read_u64(secret + 8));
+  return multiply_fold((uint64_t)product ^ read_u64(secret + 16) ^ nbytes,
+                       (uint64_t)(product >> 64) ^ read_u64(secret + 24));
+}
+
+static uint64_t mix_16(const char *bytes, const char *secret) {
+  return multiply_fold(read_u64(bytes) ^ read_u64(secret),
+                       read_u64(bytes + 8) ^ read_u64(secret + 8));
+}
+
+// The last 16 bytes chunk may overlap the previous one, secret_offset +
+// MID_SIZE_MAX must fit in the secret
+static uint64_t hash_mid(const char *bytes, size_t nbytes, uint64_t start,
+                         int secret_offset) {
+  uint64_t hash = start;
+  size_t chunk_count = (nbytes - 1) / 16;
+  for (size_t chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+    hash += mix_16(bytes + chunk_index * 16,
+                   SECRET + secret_offset + chunk_index * 16);
+  }
+  hash += mix_16(bytes + nbytes - 16,
+                 SECRET + secret_offset + MID_SIZE_MAX - 16);
+  return avalanche(hash);
+}
+
+#define VGLTF_HASH_LANE_COUNT (VGLTF_SIMD_VECTOR_SIZE / 8)
+static constexpr int VECTOR_COUNT =
+    VGLTF_HASH_ACCUMULATOR_COUNT / VGLTF_HASH_LANE_COUNT;
+
+typedef uint64_t vgltf_hash_u64v
+    __attribute__((vector_size(VGLTF_HASH_LANE_COUNT * sizeof(uint64_t))));
+
+static vgltf_hash_u64v load_lanes(const char *bytes) {
+  vgltf_hash_u64v lanes;
+  memcpy(&lanes, bytes, sizeof(lanes));
+  return lanes;
+}
+
+static vgltf_hash_u64v swap_lane_pairs(vgltf_hash_u64v lanes) {
+#if VGLTF_HASH_LANE_COUNT == 4
+  return __builtin_shufflevector(lanes, lanes, 1, 0, 3, 2);
+#else
+  return __builtin_shufflevector(lanes, lanes, 1, 0);
+#endif
+}
+
+// Multiplies the low 32 bits of each lane, compilers don't know the high
+// bits are discarded and emit a full 64 bits multiplication otherwise
+static vgltf_hash_u64v multiply_low_halves(vgltf_hash_u64v lhs,
+                                           vgltf_hash_u64v rhs) {
+#if defined(__AVX2__)
+  return (vgltf_hash_u64v)_mm256_mul_epu32((__m256i)lhs, (__m256i)rhs);
+#elif defined(__SSE2__)
+  return (vgltf_hash_u64v)_mm_mul_epu32((__m128i)lhs, (__m128i)rhs);
+#elif defined(__ARM_NEON)
+  return (vgltf_hash_u64v)vmull_u32(vmovn_u64((uint64x2_t)lhs),
+                                    vmovn_u64((uint64x2_t)rhs));
+#else
+  return (lhs & 0xFFFFFFFFu) * (rhs & 0xFFFFFFFFu);
+#endif
+}
+
+static void init_accumulators(vgltf_hash_u64v accumulators[VECTOR_COUNT]) {
+  memcpy(accumulators, INITIAL_ACCUMULATORS, sizeof(INITIAL_ACCUMULATORS));
+}
+
+static void accumulate_stripe(vgltf_hash_u64v accumulators[VECTOR_COUNT],
+                              const char *stripe, const char *secret) {
+  for (int vector_index = 0; vector_index < VECTOR_COUNT; vector_index++) {
+    size_t offset = vector_index * sizeof(vgltf_hash_u64v);
+    vgltf_hash_u64v data = load_lanes(stripe + offset);
+    vgltf_hash_u64v keyed_data = data ^ load_lanes(secret + offset);
+    accumulators[vector_index] += swap_lane_pairs(data) +
+                                  multiply_low_halves(keyed_data,
+                                                      keyed_data >> 32);
+  }
+}
+
+static void scramble(vgltf_hash_u64v accumulators[VECTOR_COUNT]) {
+  vgltf_hash_u64v prime = (vgltf_hash_u64v){} + PRIME32_1;
+  for (int vector_index = 0; vector_index < VECTOR_COUNT; vector_index++) {
+    vgltf_hash_u64v accumulator = accumulators[vector_index];
+    accumulator ^= accumulator >> 47;
+    accumulator ^= load_lanes(SECRET + SCRAMBLE_SECRET_OFFSET +
+                              vector_index * sizeof(vgltf_hash_u64v));
+    accumulators[vector_index] =
+        multiply_low_halves(accumulator, prime) +
+        (multiply_low_halves(accumulator >> 32, prime) << 32);
+  }
+}
+
+// Accumulators are scrambled every BLOCK_STRIPE_COUNT stripes, as the secret
+// runs out of keys
+static void accumulate_stripes(vgltf_hash_u64v accumulators[VECTOR_COUNT],
+                               const char *bytes, size_t stripe_count,
+                               size_t *block_stripe_count) {
+  for (size_t stripe_index = 0; stripe_index < stripe_count; stripe_index++) {
+    accumulate_stripe(accumulators,
+                      bytes + stripe_index * VGLTF_HASH_STRIPE_SIZE,
+                      SECRET + *block_stripe_count * 8);
+    if (++*block_stripe_count == BLOCK_STRIPE_COUNT) {
+      scramble(accumulators);
+      *block_stripe_count = 0;
+    }
+  }
+}
+
+// The last stripe is always accumulated separately, so it ends the input
+// even if the input isn't a whole number of stripes
+static void hash_long(vgltf_hash_u64v accumulators[VECTOR_COUNT],
+                      const char *bytes, size_t nbytes) {
+  init_accumulators(accumulators);
+  size_t block_stripe_count = 0;
+  accumulate_stripes(accumulators, bytes, (nbytes - 1) / VGLTF_HASH_STRIPE_SIZE,
+                     &block_stripe_count);
+  accumulate_stripe(accumulators, bytes + nbytes - VGLTF_HASH_STRIPE_SIZE,
+                    SECRET + LAST_STRIPE_SECRET_OFFSET);
+}
+
+static uint64_t merge_accumulators(
+    const vgltf_hash_u64v accumulators[VECTOR_COUNT], const char *secret,
+    uint64_t start) {
+  uint64_t values[VGLTF_HASH_ACCUMULATOR_COUNT];
+  memcpy(values, accumulators, sizeof(values));
+  uint64_t hash = start;
+  for (int pair_index = 0; pair_index < VGLTF_HASH_ACCUMULATOR_COUNT / 2;
+       pair_index++) {
+    hash += multiply_fold(values[2 * pair_index] ^
+                              read_u64(secret + 16 * pair_index),
+                          values[2 * pair_index + 1] ^
+                              read_u64(secret + 16 * pair_index + 8));
+  }
+  return avalanche(hash);
+}
+
+static uint64_t merge_accumulators_64(
+    const vgltf_hash_u64v accumulators[VECTOR_COUNT], size_t nbytes) {
+  return merge_accumulators(accumulators, SECRET + 11, nbytes * PRIME64_1);
+}
+
+static struct vgltf_hash_128_value merge_accumulators_128(
+    const vgltf_hash_u64v accumulators[VECTOR_COUNT], size_t nbytes) {
+  return (struct vgltf_hash_128_value){
+      .low = merge_accumulators_64(accumulators, nbytes),
+      .high = merge_accumulators(
+          accumulators, SECRET + SECRET_SIZE - VGLTF_HASH_STRIPE_SIZE - 11,
+          ~(nbytes * PRIME64_2))};
+}
+
+uint64_t vgltf_hash_64(const char *bytes, size_t nbytes) {
+  assert(bytes);
+  if (nbytes <= SHORT_SIZE_MAX) {
+    return hash_short(bytes, nbytes, SECRET);
+  }
+  if (nbytes <= MID_SIZE_MAX) {
+    return hash_mid(bytes, nbytes, nbytes * PRIME64_1, 0);
+  }
+
+  vgltf_hash_u64v accumulators[VECTOR_COUNT];
+  hash_long(accumulators, bytes, nbytes);
+  return merge_accumulators_64(accumulators, nbytes);
+}
+
+struct vgltf_hash_128_value vgltf_hash_128(const char *bytes, size_t nbytes) {
+  assert(bytes);
+  if (nbytes <= SHORT_SIZE_MAX) {
+    return (struct vgltf_hash_128_value){
+        .low = hash_short(bytes, nbytes, SECRET),
+        .high = hash_short(bytes, nbytes, SECRET + 32)};
+  }
+  if (nbytes <= MID_SIZE_MAX) {
+    return (struct vgltf_hash_128_value){
+        .low = hash_mid(bytes, nbytes, nbytes * PRIME64_1, 0),
+        .high = hash_mid(bytes, nbytes, ~(nbytes * PRIME64_2), 3)};
+  }
+
+  vgltf_hash_u64v accumulators[VECTOR_COUNT];
+  hash_long(accumulators, bytes, nbytes);
+  return merge_accumulators_128(accumulators, nbytes);
+}
+
+bool vgltf_hash_128_eq(struct vgltf_hash_128_value lhs,
+                       struct vgltf_hash_128_value rhs) {
+  return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+void vgltf_hash_state_init(struct vgltf_hash_state *state) {
+  assert(state);
+  memcpy(state->accumulators, INITIAL_ACCUMULATORS,
+         sizeof(INITIAL_ACCUMULATORS));
+  state->buffer_size = 0;
+  state->block_stripe_count = 0;
+  state->total_size = 0;
+}
+
+// Stripes are only accumulated once more input follows them, so the buffer
+// is never empty when digesting
+void vgltf_hash_state_update(struct vgltf_hash_state *state, const char *bytes,
+                             size_t nbytes) {
+  assert(state);
+  assert(bytes);
+  state->total_size += nbytes;
+  if (state->buffer_size + nbytes <= VGLTF_HASH_BUFFER_SIZE) {
+    memcpy(state->buffer + state->buffer_size, bytes, nbytes);
+    state->buffer_size += nbytes;
+    return;
+  }
+
+  vgltf_hash_u64v accumulators[VECTOR_COUNT];
+  memcpy(accumulators, state->accumulators, sizeof(accumulators));
+  if (state->buffer_size > 0) {
+    size_t fill_size = VGLTF_HASH_BUFFER_SIZE - state->buffer_size;
+    memcpy(state->buffer + state->buffer_size, bytes, fill_size);
+    bytes += fill_size;
+    nbytes -= fill_size;
+    accumulate_stripes(accumulators, state->buffer,
+                       VGLTF_HASH_BUFFER_SIZE / VGLTF_HASH_STRIPE_SIZE,
+                       &state->block_stripe_count);
+    memcpy(state->previous_stripe,
+           state->buffer + VGLTF_HASH_BUFFER_SIZE - VGLTF_HASH_STRIPE_SIZE,
+           VGLTF_HASH_STRIPE_SIZE);
+  }
+
+  if (nbytes > VGLTF_HASH_BUFFER_SIZE) {
+    size_t stripe_count = (nbytes - 1) / VGLTF_HASH_STRIPE_SIZE;
+    accumulate_stripes(accumulators, bytes, stripe_count,
+                       &state->block_stripe_count);
+    bytes += stripe_count * VGLTF_HASH_STRIPE_SIZE;
+    nbytes -= stripe_count * VGLTF_HASH_STRIPE_SIZE;
+    memcpy(state->previous_stripe, bytes - VGLTF_HASH_STRIPE_SIZE,
+           VGLTF_HASH_STRIPE_SIZE);
+  }
+
+  memcpy(state->buffer, bytes, nbytes);
+  state->buffer_size = nbytes;
+  memcpy(state->accumulators, accumulators, sizeof(accumulators));
+}
+
+static void digest_accumulators(const struct vgltf_hash_state *state,
+                                vgltf_hash_u64v accumulators[VECTOR_COUNT]) {
+  memcpy(accumulators, state->accumulators, sizeof(state->accumulators));
+  size_t block_stripe_count = state->block_stripe_count;
+  accumulate_stripes(accumulators, state->buffer,
+                     (state->buffer_size - 1) / VGLTF_HASH_STRIPE_SIZE,
+                     &block_stripe_count);
+
+  char last_stripe[VGLTF_HASH_STRIPE_SIZE];
+  if (state->buffer_size >= VGLTF_HASH_STRIPE_SIZE) {
+    memcpy(last_stripe,
+           state->buffer + state->buffer_size - VGLTF_HASH_STRIPE_SIZE,
+           VGLTF_HASH_STRIPE_SIZE);
+  } else {
+    size_t previous_size = VGLTF_HASH_STRIPE_SIZE - state->buffer_size;
+    memcpy(last_stripe,
+           state->previous_stripe + VGLTF_HASH_STRIPE_SIZE - previous_size,
+           previous_size);
+    memcpy(last_stripe + previous_size, state->buffer, state->buffer_size);
+  }
+  accumulate_stripe(accumulators, last_stripe,
+                    SECRET + LAST_STRIPE_SECRET_OFFSET);
+}
+
+// Short inputs never left the buffer
+uint64_t vgltf_hash_state_digest_64(const struct vgltf_hash_state *state) {
+  assert(state);
+  if (state->total_size <= MID_SIZE_MAX) {
+    return vgltf_hash_64(state->buffer, state->total_size);
+  }
+
+  vgltf_hash_u64v accumulators[VECTOR_COUNT];
+  digest_accumulators(state, accumulators);
+  return merge_accumulators_64(accumulators, state->total_size);
+}
+
+struct vgltf_hash_128_value
+vgltf_hash_state_digest_128(const struct vgltf_hash_state *state) {
+  assert(state);
+  if (state->total_size <= MID_SIZE_MAX) {
+    return vgltf_hash_128(state->buffer, state->total_size);
+  }
+
+  vgltf_hash_u64v accumulators[VECTOR_COUNT];
+  digest_accumulators(state, accumulators);
+  return merge_accumulators_128(accumulators, state->total_size);
+}
@@ -1,9 +1,46 @@
 #ifndef VGLTF_HASH_H
 #define VGLTF_HASH_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 uint64_t vgltf_hash_fnv_1a(const char *bytes, size_t nbytes);
 
+// Non cryptographic hash reading 8 to 16 bytes per step for short inputs and
+// accumulating 64 bytes stripes in SIMD lanes for long ones. Hashes are
+// stable across runs and little endian platforms, so they can be persisted.
+uint64_t vgltf_hash_64(const char *bytes, size_t nbytes);
+
+// Wide enough to identify content, e.g. as a cache key
+struct vgltf_hash_128_value {
+  uint64_t low;
+  uint64_t high;
+};
+struct vgltf_hash_128_value vgltf_hash_128(const char *bytes, size_t nbytes);
+bool vgltf_hash_128_eq(struct vgltf_hash_128_value lhs,
+                       struct vgltf_hash_128_value rhs);
+
+constexpr int VGLTF_HASH_STRIPE_SIZE = 64;
+constexpr int VGLTF_HASH_ACCUMULATOR_COUNT = 8;
+constexpr int VGLTF_HASH_BUFFER_SIZE = 4 * VGLTF_HASH_STRIPE_SIZE;
+
+// Incremental hashing, digests match the one shot hashes of the concatenated
+// input whatever the sizes of the updates are
+struct vgltf_hash_state {
+  uint64_t accumulators[VGLTF_HASH_ACCUMULATOR_COUNT];
+  char buffer[VGLTF_HASH_BUFFER_SIZE];
+  // Last accumulated stripe, for inputs ending with a partial stripe
+  char previous_stripe[VGLTF_HASH_STRIPE_SIZE];
+  size_t buffer_size;
+  size_t block_stripe_count;
+  uint64_t total_size;
+};
+void vgltf_hash_state_init(struct vgltf_hash_state *state);
+void vgltf_hash_state_update(struct vgltf_hash_state *state, const char *bytes,
+                             size_t nbytes);
+uint64_t vgltf_hash_state_digest_64(const struct vgltf_hash_state *state);
+struct vgltf_hash_128_value
+vgltf_hash_state_digest_128(const struct vgltf_hash_state *state);
+
 #endif // VGLTF_HASH_H
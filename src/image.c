@@ -1,5 +1,10 @@
 #include "image.h"
 
+#include "log.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -17,4 +22,209 @@ bool vgltf_image_load_from_file(struct vgltf_image *image,
   return image->data != nullptr;
 }
 
+bool vgltf_image_load_from_memory(struct vgltf_image *image, const void *data,
+                                  size_t size) {
+  if (size > INT_MAX) {
+    VGLTF_LOG_ERR("Image of %zu bytes is too large to decode", size);
+    return false;
+  }
+
+  int width;
+  int height;
+  int tex_channels;
+  image->data = stbi_load_from_memory(data, (int)size, &width, &height,
+                                      &tex_channels, STBI_rgb_alpha);
+  image->width = width;
+  image->height = height;
+  image->format = VGLTF_IMAGE_FORMAT_R8G8B8A8;
+
+  return image->data != nullptr;
+}
+
 void vgltf_image_deinit(struct vgltf_image *image) { stbi_image_free(image->data); }
+
+static constexpr int IMAGE_CHANNEL_COUNT = 4;
+
+static bool write_ppm(const struct vgltf_image *image, FILE *file) {
+  if (fprintf(file, "P6\n%u %u\n255\n", image->width, image->height) < 0) {
+    return false;
+  }
+
+  unsigned char row[4096 * 3];
+  for (uint32_t y = 0; y < image->height; y++) {
+    const unsigned char *pixels =
+        image->data + (size_t)y * image->width * IMAGE_CHANNEL_COUNT;
+    for (uint32_t first_x = 0; first_x < image->width;
+         first_x += sizeof(row) / 3) {
+      uint32_t pixel_count = image->width - first_x < sizeof(row) / 3
+                                 ? image->width - first_x
+                                 : sizeof(row) / 3;
+      for (uint32_t x = 0; x < pixel_count; x++) {
+        memcpy(&row[x * 3], &pixels[(first_x + x) * IMAGE_CHANNEL_COUNT], 3);
+      }
+      if (fwrite(row, 3, pixel_count, file) != pixel_count) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// CRC-32 processed a nibble at a time
+static const uint32_t CRC32_NIBBLE_TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+static uint32_t crc32_update(uint32_t crc, const unsigned char *bytes,
+                             size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    crc ^= bytes[i];
+    crc = CRC32_NIBBLE_TABLE[crc & 0xF] ^ (crc >> 4);
+    crc = CRC32_NIBBLE_TABLE[crc & 0xF] ^ (crc >> 4);
+  }
+  return crc;
+}
+
+// Chunks are written piece by piece, their CRC covers the type and the data
+struct png_writer {
+  FILE *file;
+  uint32_t crc;
+  bool failed;
+};
+
+static void png_write(struct png_writer *writer, const void *bytes,
+                      size_t size) {
+  writer->crc = crc32_update(writer->crc, bytes, size);
+  if (fwrite(bytes, 1, size, writer->file) != size) {
+    writer->failed = true;
+  }
+}
+
+static void png_write_u32(struct png_writer *writer, uint32_t value) {
+  unsigned char bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+  png_write(writer, bytes, sizeof(bytes));
+}
+
+static void png_begin_chunk(struct png_writer *writer, const char type[4],
+                            uint32_t size) {
+  png_write_u32(writer, size);
+  writer->crc = 0xFFFFFFFFu;
+  png_write(writer, type, 4);
+}
+
+static void png_end_chunk(struct png_writer *writer) {
+  png_write_u32(writer, writer->crc ^ 0xFFFFFFFFu);
+}
+
+// Zlib stream made of deflate stored blocks, split as the data comes
+struct png_stored_stream {
+  struct png_writer *writer;
+  uint64_t remaining_size;
+  uint32_t block_remaining_size;
+  uint32_t adler_a;
+  uint32_t adler_b;
+};
+
+static void png_stored_write(struct png_stored_stream *stream,
+                             const unsigned char *bytes, size_t size) {
+  static constexpr uint32_t MAX_STORED_BLOCK_SIZE = 65535;
+  static constexpr uint32_t ADLER32_MODULO = 65521;
+  while (size > 0) {
+    if (stream->block_remaining_size == 0) {
+      uint32_t block_size = stream->remaining_size < MAX_STORED_BLOCK_SIZE
+                                ? (uint32_t)stream->remaining_size
+                                : MAX_STORED_BLOCK_SIZE;
+      unsigned char block_header[5] = {
+          stream->remaining_size == block_size, block_size & 0xFF,
+          block_size >> 8, ~block_size & 0xFF, (~block_size >> 8) & 0xFF};
+      png_write(stream->writer, block_header, sizeof(block_header));
+      stream->block_remaining_size = block_size;
+    }
+
+    size_t write_size = size < stream->block_remaining_size
+                            ? size
+                            : stream->block_remaining_size;
+    png_write(stream->writer, bytes, write_size);
+    for (size_t i = 0; i < write_size; i++) {
+      stream->adler_a = (stream->adler_a + bytes[i]) % ADLER32_MODULO;
+      stream->adler_b = (stream->adler_b + stream->adler_a) % ADLER32_MODULO;
+    }
+    stream->block_remaining_size -= write_size;
+    stream->remaining_size -= write_size;
+    bytes += write_size;
+    size -= write_size;
+  }
+}
+
+// The pixels are stored uncompressed, encoding stays cheap and the files are
+// meant to be compared by tools rather than shipped
+static bool write_png(const struct vgltf_image *image, FILE *file) {
+  static constexpr unsigned char SIGNATURE[] = {0x89, 'P',  'N',  'G',
+                                                '\r', '\n', 0x1A, '\n'};
+  // 8 bits per channel RGBA, deflate, no filtering, no interlacing
+  static constexpr unsigned char HEADER_END[] = {8, 6, 0, 0, 0};
+  static constexpr unsigned char ZLIB_HEADER[] = {0x78, 0x01};
+
+  // Every row starts with its filter type
+  uint64_t row_size = (uint64_t)image->width * IMAGE_CHANNEL_COUNT;
+  uint64_t raw_size = (1 + row_size) * image->height;
+  uint64_t block_count = (raw_size + 65534) / 65535;
+  uint64_t idat_size =
+      sizeof(ZLIB_HEADER) + raw_size + 5 * block_count + sizeof(uint32_t);
+  if (image->width == 0 || image->height == 0 || idat_size > INT32_MAX) {
+    VGLTF_LOG_ERR("Can't write a %ux%u image as PNG", image->width,
+                  image->height);
+    return false;
+  }
+
+  struct png_writer writer = {.file = file};
+  png_write(&writer, SIGNATURE, sizeof(SIGNATURE));
+
+  png_begin_chunk(&writer, "IHDR", 13);
+  png_write_u32(&writer, image->width);
+  png_write_u32(&writer, image->height);
+  png_write(&writer, HEADER_END, sizeof(HEADER_END));
+  png_end_chunk(&writer);
+
+  png_begin_chunk(&writer, "IDAT", (uint32_t)idat_size);
+  png_write(&writer, ZLIB_HEADER, sizeof(ZLIB_HEADER));
+  struct png_stored_stream stream = {
+      .writer = &writer, .remaining_size = raw_size, .adler_a = 1};
+  for (uint32_t y = 0; y < image->height; y++) {
+    static constexpr unsigned char FILTER_TYPE_NONE = 0;
+    png_stored_write(&stream, &FILTER_TYPE_NONE, 1);
+    png_stored_write(&stream, image->data + y * row_size, row_size);
+  }
+  png_write_u32(&writer, (stream.adler_b << 16) | stream.adler_a);
+  png_end_chunk(&writer);
+
+  png_begin_chunk(&writer, "IEND", 0);
+  png_end_chunk(&writer);
+  return !writer.failed;
+}
+
+bool vgltf_image_write_to_file(const struct vgltf_image *image,
+                               struct vgltf_string_view path) {
+  assert(image->format == VGLTF_IMAGE_FORMAT_R8G8B8A8);
+  FILE *file = fopen(path.data, "wb");
+  if (!file) {
+    VGLTF_LOG_ERR("Couldn't open %s", path.data);
+    goto err;
+  }
+
+  static constexpr char PPM_EXTENSION[] = ".ppm";
+  static constexpr size_t PPM_EXTENSION_LENGTH = sizeof(PPM_EXTENSION) - 1;
+  bool is_ppm = path.length >= PPM_EXTENSION_LENGTH &&
+                strncmp(path.data + path.length - PPM_EXTENSION_LENGTH,
+                        PPM_EXTENSION, PPM_EXTENSION_LENGTH) == 0;
+  bool written = is_ppm ? write_ppm(image, file) : write_png(image, file);
+  if (fclose(file) != 0 || !written) {
+    VGLTF_LOG_ERR("Couldn't write %s", path.data);
+    goto err;
+  }
+
+  return true;
+err:
+  return false;
+}
@@ -1,6 +1,7 @@
 #ifndef VGLTF_IMAGE_H
 #define VGLTF_IMAGE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "str.h"
 
@@ -16,6 +17,14 @@ struct vgltf_image {
 };
 
 bool vgltf_image_load_from_file(struct vgltf_image* image, struct vgltf_string_view path);
+// Decodes an encoded image file already in memory, such as an image embedded
+// in a glTF buffer
+bool vgltf_image_load_from_memory(struct vgltf_image *image, const void *data,
+                                  size_t size);
 void vgltf_image_deinit(struct vgltf_image* image);
+// Paths ending with .ppm are written as binary PPM, dropping the alpha
+// channel, others as PNG
+bool vgltf_image_write_to_file(const struct vgltf_image *image,
+                               struct vgltf_string_view path);
 
 #endif // VGLTF_IMAGE_H
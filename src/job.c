@@ -0,0 +1,234 @@
+#include "job.h"
+#include "log.h"
+
+static thread_local int current_thread_index;
+
+static bool pop_job(struct vgltf_job_system *job_system,
+                    struct vgltf_job *job) {
+  if (job_system->queue_length == 0) {
+    return false;
+  }
+
+  *job = job_system->queue[job_system->queue_head];
+  job_system->queue_head =
+      (job_system->queue_head + 1) % VGLTF_JOB_SYSTEM_QUEUE_CAPACITY;
+  job_system->queue_length--;
+  return true;
+}
+
+// Takes the oldest queued job of the counter, keeping the others in order
+static bool pop_counter_job(struct vgltf_job_system *job_system,
+                            const struct vgltf_job_counter *counter,
+                            struct vgltf_job *job) {
+  for (int offset = 0; offset < job_system->queue_length; offset++) {
+    int index =
+        (job_system->queue_head + offset) % VGLTF_JOB_SYSTEM_QUEUE_CAPACITY;
+    if (job_system->queue[index].counter != counter) {
+      continue;
+    }
+
+    *job = job_system->queue[index];
+    for (; offset > 0; offset--) {
+      job_system->queue[(job_system->queue_head + offset) %
+                        VGLTF_JOB_SYSTEM_QUEUE_CAPACITY] =
+          job_system->queue[(job_system->queue_head + offset - 1) %
+                            VGLTF_JOB_SYSTEM_QUEUE_CAPACITY];
+    }
+    job_system->queue_head =
+        (job_system->queue_head + 1) % VGLTF_JOB_SYSTEM_QUEUE_CAPACITY;
+    job_system->queue_length--;
+    return true;
+  }
+
+  return false;
+}
+
+static void run_job(struct vgltf_job_system *job_system,
+                    const struct vgltf_job *job) {
+  job->function(job->data, job->begin, job->end);
+  if (atomic_fetch_sub_explicit(&job->counter->pending_job_count, 1,
+                                memory_order_acq_rel) == 1) {
+    // Broadcasting under the lock so a waiter can't miss the wake up
+    // between its check and its wait
+    vgltf_platform_mutex_lock(&job_system->mutex);
+    vgltf_platform_condition_broadcast(&job_system->job_finished);
+    vgltf_platform_mutex_unlock(&job_system->mutex);
+  }
+}
+
+static int worker_main(void *data) {
+  struct vgltf_job_worker *worker = data;
+  struct vgltf_job_system *job_system = worker->job_system;
+  current_thread_index = worker->thread_index;
+
+  vgltf_platform_mutex_lock(&job_system->mutex);
+  while (true) {
+    struct vgltf_job job;
+    if (pop_job(job_system, &job)) {
+      vgltf_platform_mutex_unlock(&job_system->mutex);
+      run_job(job_system, &job);
+      vgltf_platform_mutex_lock(&job_system->mutex);
+      continue;
+    }
+
+    if (!job_system->running) {
+      break;
+    }
+
+    vgltf_platform_condition_wait(&job_system->job_available,
+                                  &job_system->mutex);
+  }
+  vgltf_platform_mutex_unlock(&job_system->mutex);
+  return 0;
+}
+
+bool vgltf_job_system_init(struct vgltf_job_system *job_system,
+                           int worker_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (worker_count <= 0) {
+    worker_count = vgltf_platform_get_cpu_count() - 1;
+  }
+  if (worker_count > VGLTF_JOB_SYSTEM_MAX_WORKER_COUNT) {
+    worker_count = VGLTF_JOB_SYSTEM_MAX_WORKER_COUNT;
+  }
+  if (worker_count < 0) {
+    worker_count = 0;
+  }
+
+  job_system->queue_head = 0;
+  job_system->queue_length = 0;
+  job_system->running = true;
+
+  if (!vgltf_platform_mutex_init(&job_system->mutex)) {
+    goto err;
+  }
+
+  if (!vgltf_platform_condition_init(&job_system->job_available)) {
+    goto deinit_mutex;
+  }
+
+  if (!vgltf_platform_condition_init(&job_system->job_finished)) {
+    goto deinit_job_available;
+  }
+
+  for (job_system->worker_count = 0; job_system->worker_count < worker_count;
+       job_system->worker_count++) {
+    struct vgltf_job_worker *worker =
+        &job_system->workers[job_system->worker_count];
+    worker->job_system = job_system;
+    worker->thread_index = job_system->worker_count + 1;
+    if (!vgltf_platform_thread_create(&worker->thread, "vgltf_job_worker",
+                                      worker_main, worker)) {
+      VGLTF_LOG_ERR("Couldn't create job worker thread");
+      goto stop_workers;
+    }
+  }
+
+  VGLTF_LOG_INFO("Job system initialized with %d workers",
+                 job_system->worker_count);
+  return true;
+stop_workers:
+  vgltf_job_system_deinit(job_system);
+  return false;
+deinit_job_available:
+  vgltf_platform_condition_deinit(&job_system->job_available);
+deinit_mutex:
+  vgltf_platform_mutex_deinit(&job_system->mutex);
+err:
+  return false;
+}
+
+void vgltf_job_system_deinit(struct vgltf_job_system *job_system) {
+  vgltf_platform_mutex_lock(&job_system->mutex);
+  job_system->running = false;
+  vgltf_platform_condition_broadcast(&job_system->job_available);
+  vgltf_platform_mutex_unlock(&job_system->mutex);
+
+  for (int worker_index = 0; worker_index < job_system->worker_count;
+       worker_index++) {
+    vgltf_platform_thread_join(&job_system->workers[worker_index].thread);
+  }
+  job_system->worker_count = 0;
+
+  vgltf_platform_condition_deinit(&job_system->job_finished);
+  vgltf_platform_condition_deinit(&job_system->job_available);
+  vgltf_platform_mutex_deinit(&job_system->mutex);
+}
+
+void vgltf_job_system_submit(struct vgltf_job_system *job_system,
+                             const struct vgltf_job *job) {
+  atomic_fetch_add_explicit(&job->counter->pending_job_count, 1,
+                            memory_order_relaxed);
+
+  vgltf_platform_mutex_lock(&job_system->mutex);
+  if (job_system->queue_length == VGLTF_JOB_SYSTEM_QUEUE_CAPACITY) {
+    vgltf_platform_mutex_unlock(&job_system->mutex);
+    run_job(job_system, job);
+    return;
+  }
+
+  int tail = (job_system->queue_head + job_system->queue_length) %
+             VGLTF_JOB_SYSTEM_QUEUE_CAPACITY;
+  job_system->queue[tail] = *job;
+  job_system->queue_length++;
+  vgltf_platform_condition_signal(&job_system->job_available);
+  vgltf_platform_mutex_unlock(&job_system->mutex);
+}
+
+void vgltf_job_system_wait(struct vgltf_job_system *job_system,
+                           struct vgltf_job_counter *counter) {
+  vgltf_platform_mutex_lock(&job_system->mutex);
+  while (atomic_load_explicit(&counter->pending_job_count,
+                              memory_order_acquire) > 0) {
+    // Other jobs may be long running background work, like writing files,
+    // that the waiting thread mustn't get stuck in
+    struct vgltf_job job;
+    if (pop_counter_job(job_system, counter, &job)) {
+      vgltf_platform_mutex_unlock(&job_system->mutex);
+      run_job(job_system, &job);
+      vgltf_platform_mutex_lock(&job_system->mutex);
+      continue;
+    }
+
+    vgltf_platform_condition_wait(&job_system->job_finished,
+                                  &job_system->mutex);
+  }
+  vgltf_platform_mutex_unlock(&job_system->mutex);
+}
+
+void vgltf_job_system_parallel_for(struct vgltf_job_system *job_system,
+                                   uint32_t count, uint32_t batch_size,
+                                   vgltf_job_function function, void *data) {
+  if (count == 0) {
+    return;
+  }
+
+  if (batch_size == 0) {
+    batch_size = 1;
+  }
+
+  // Small workloads aren't worth the synchronization
+  if (count <= batch_size || job_system->worker_count == 0) {
+    function(data, 0, count);
+    return;
+  }
+
+  struct vgltf_job_counter counter = {};
+  for (uint32_t begin = 0; begin < count; begin += batch_size) {
+    uint32_t end = count - begin < batch_size ? count : begin + batch_size;
+    vgltf_job_system_submit(job_system, &(const struct vgltf_job){
+                                            .function = function,
+                                            .data = data,
+                                            .begin = begin,
+                                            .end = end,
+                                            .counter = &counter});
+  }
+  vgltf_job_system_wait(job_system, &counter);
+}
+
+int vgltf_job_system_get_thread_count(
+    const struct vgltf_job_system *job_system) {
+  return job_system->worker_count + 1;
+}
+
+int vgltf_job_system_get_thread_index(void) { return current_thread_index; }
@@ -0,0 +1,76 @@
+#ifndef VGLTF_JOB_H
+#define VGLTF_JOB_H
+
+#include "platform.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+constexpr int VGLTF_JOB_SYSTEM_MAX_WORKER_COUNT = 15;
+constexpr int VGLTF_JOB_SYSTEM_QUEUE_CAPACITY = 1024;
+constexpr int VGLTF_JOB_SYSTEM_MAX_THREAD_COUNT =
+    VGLTF_JOB_SYSTEM_MAX_WORKER_COUNT + 1;
+
+// Processes the items [begin, end) of a job
+typedef void (*vgltf_job_function)(void *data, uint32_t begin, uint32_t end);
+
+// Tracks the completion of a group of jobs
+struct vgltf_job_counter {
+  atomic_int pending_job_count;
+};
+
+struct vgltf_job {
+  vgltf_job_function function;
+  void *data;
+  uint32_t begin;
+  uint32_t end;
+  struct vgltf_job_counter *counter;
+};
+
+struct vgltf_job_system;
+struct vgltf_job_worker {
+  struct vgltf_platform_thread thread;
+  struct vgltf_job_system *job_system;
+  int thread_index;
+};
+
+struct vgltf_job_system {
+  struct vgltf_job_worker workers[VGLTF_JOB_SYSTEM_MAX_WORKER_COUNT];
+  int worker_count;
+
+  struct vgltf_platform_mutex mutex;
+  struct vgltf_platform_condition job_available;
+  struct vgltf_platform_condition job_finished;
+  struct vgltf_job queue[VGLTF_JOB_SYSTEM_QUEUE_CAPACITY];
+  int queue_head;
+  int queue_length;
+  bool running;
+};
+
+// A worker_count of 0 picks one worker per logical core, minus the calling
+// thread
+bool vgltf_job_system_init(struct vgltf_job_system *job_system,
+                           int worker_count);
+void vgltf_job_system_deinit(struct vgltf_job_system *job_system);
+
+// Runs the job inline if the queue is full
+void vgltf_job_system_submit(struct vgltf_job_system *job_system,
+                             const struct vgltf_job *job);
+
+// Runs the counter's queued jobs on the calling thread until the counter
+// reaches zero
+void vgltf_job_system_wait(struct vgltf_job_system *job_system,
+                           struct vgltf_job_counter *counter);
+
+// Splits [0, count) into batches of batch_size items, the calling thread
+// takes part and returns once every batch is done
+void vgltf_job_system_parallel_for(struct vgltf_job_system *job_system,
+                                   uint32_t count, uint32_t batch_size,
+                                   vgltf_job_function function, void *data);
+
+// Number of threads that can run jobs, workers plus the calling thread
+int vgltf_job_system_get_thread_count(const struct vgltf_job_system *job_system);
+
+// 0 for threads that aren't workers, [1, worker_count] for the workers
+int vgltf_job_system_get_thread_index(void);
+
+#endif // VGLTF_JOB_H
@@ -0,0 +1,800 @@
+#include "json.h"
+#include "log.h"
+#include "maths.h"
+#include "simd.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stage 1 classifies 64 bytes per step, one bit per byte in each mask
+static constexpr int BLOCK_SIZE = 64;
+
+typedef uint8_t vgltf_json_u8v
+    __attribute__((vector_size(VGLTF_SIMD_VECTOR_SIZE)));
+typedef int8_t vgltf_json_i8v
+    __attribute__((vector_size(VGLTF_SIMD_VECTOR_SIZE)));
+
+// One bit per byte of the comparison result
+static uint64_t movemask(vgltf_json_i8v mask) {
+#if defined(__AVX2__)
+  return (uint32_t)_mm256_movemask_epi8((__m256i)mask);
+#elif defined(__SSE2__)
+  return (uint32_t)_mm_movemask_epi8((__m128i)mask);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  static const uint8_t BIT_WEIGHTS[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                          1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t bits = vandq_u8((uint8x16_t)mask, vld1q_u8(BIT_WEIGHTS));
+  return vaddv_u8(vget_low_u8(bits)) |
+         (uint64_t)vaddv_u8(vget_high_u8(bits)) << 8;
+#else
+  uint64_t bits = 0;
+  for (int byte_index = 0; byte_index < VGLTF_SIMD_VECTOR_SIZE; byte_index++) {
+    bits |= (uint64_t)(mask[byte_index] & 1) << byte_index;
+  }
+  return bits;
+#endif
+}
+
+struct block_classes {
+  uint64_t quotes;
+  uint64_t backslashes;
+  // {}[]:,
+  uint64_t operators;
+  uint64_t whitespace;
+  // Bytes below 0x20, not allowed in strings
+  uint64_t controls;
+};
+
+static void classify_block(const char *block, struct block_classes *classes) {
+  *classes = (struct block_classes){};
+  for (int vector_index = 0; vector_index < BLOCK_SIZE / VGLTF_SIMD_VECTOR_SIZE;
+       vector_index++) {
+    vgltf_json_u8v bytes;
+    memcpy(&bytes, block + vector_index * VGLTF_SIMD_VECTOR_SIZE,
+           sizeof(bytes));
+    int shift = vector_index * VGLTF_SIMD_VECTOR_SIZE;
+    // [ and ] only differ from { and } by the 0x20 bit
+    vgltf_json_u8v folded = bytes | 0x20;
+    classes->quotes |= movemask(bytes == '"') << shift;
+    classes->backslashes |= movemask(bytes == '\\') << shift;
+    classes->operators |= movemask((folded == '{') | (folded == '}') |
+                                   (bytes == ':') | (bytes == ','))
+                          << shift;
+    classes->whitespace |= movemask((bytes == ' ') | (bytes == '\t') |
+                                    (bytes == '\n') | (bytes == '\r'))
+                           << shift;
+    classes->controls |= movemask(bytes < 0x20) << shift;
+  }
+}
+
+static constexpr uint64_t EVEN_BITS = 0x5555555555555555u;
+
+// Returns the bytes following an odd length run of backslashes. Runs are
+// found by carrying through them with an addition, separately for runs
+// starting on even and odd bytes so the parity of their end tells their
+// length.
+static uint64_t find_escaped(uint64_t backslashes,
+                             uint64_t *previous_ends_odd_backslash) {
+  uint64_t start_edges = backslashes & ~(backslashes << 1);
+  // A run continuing the previous block's odd run starts one byte later
+  uint64_t even_start_mask = EVEN_BITS ^ *previous_ends_odd_backslash;
+  uint64_t even_starts = start_edges & even_start_mask;
+  uint64_t odd_starts = start_edges & ~even_start_mask;
+  uint64_t even_carries = backslashes + even_starts;
+  uint64_t odd_carries;
+  bool ends_odd_backslash =
+      __builtin_add_overflow(backslashes, odd_starts, &odd_carries);
+  odd_carries |= *previous_ends_odd_backslash;
+  *previous_ends_odd_backslash = ends_odd_backslash;
+  uint64_t even_carry_ends = even_carries & ~backslashes;
+  uint64_t odd_carry_ends = odd_carries & ~backslashes;
+  return (even_carry_ends & ~EVEN_BITS) | (odd_carry_ends & EVEN_BITS);
+}
+
+// Bit i is the parity of the bits 0 to i, which is a carry-less
+// multiplication by all ones
+static uint64_t prefix_xor(uint64_t bits) {
+#if defined(__PCLMUL__)
+  return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(
+      _mm_set_epi64x(0, (int64_t)bits), _mm_set1_epi8((char)0xFF), 0));
+#else
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+#endif
+}
+
+// State carried from one block to the next
+struct indexer {
+  uint64_t previous_ends_odd_backslash;
+  // All ones if the previous block ended inside a string
+  uint64_t previous_in_string;
+  uint64_t previous_scalar;
+  // Bytes of the next block that have to be hex digits of a \u escape
+  uint64_t next_hex_digits;
+  uint64_t string_controls;
+  uint64_t invalid_escapes;
+};
+
+// Escaped bytes have to be one of "\/bfnrtu, and \u has to be followed by 4
+// hex digits. Only blocks with escapes get here.
+static void check_escapes(struct indexer *indexer, const char *block,
+                          uint64_t escaped) {
+  uint64_t escape_chars = 0;
+  uint64_t unicode_chars = 0;
+  uint64_t hex_digits = 0;
+  for (int vector_index = 0; vector_index < BLOCK_SIZE / VGLTF_SIMD_VECTOR_SIZE;
+       vector_index++) {
+    vgltf_json_u8v bytes;
+    memcpy(&bytes, block + vector_index * VGLTF_SIMD_VECTOR_SIZE,
+           sizeof(bytes));
+    int shift = vector_index * VGLTF_SIMD_VECTOR_SIZE;
+    vgltf_json_u8v folded = bytes | 0x20;
+    escape_chars |= movemask((bytes == '"') | (bytes == '\\') |
+                             (bytes == '/') | (bytes == 'b') | (bytes == 'f') |
+                             (bytes == 'n') | (bytes == 'r') | (bytes == 't') |
+                             (bytes == 'u'))
+                    << shift;
+    unicode_chars |= movemask(bytes == 'u') << shift;
+    hex_digits |= movemask(((bytes >= '0') & (bytes <= '9')) |
+                           ((folded >= 'a') & (folded <= 'f')))
+                  << shift;
+  }
+
+  uint64_t unicode_escapes = escaped & unicode_chars;
+  uint64_t required_hex_digits = indexer->next_hex_digits;
+  indexer->next_hex_digits = 0;
+  for (int shift = 1; shift <= 4; shift++) {
+    required_hex_digits |= unicode_escapes << shift;
+    indexer->next_hex_digits |= unicode_escapes >> (64 - shift);
+  }
+  indexer->invalid_escapes |=
+      (escaped & ~escape_chars) | (required_hex_digits & ~hex_digits);
+}
+
+// Structural bytes are the operators and the quotes outside of strings, and
+// the first byte of numbers, true, false and null
+static uint64_t index_block(struct indexer *indexer, const char *block) {
+  struct block_classes classes;
+  classify_block(block, &classes);
+  uint64_t escaped = find_escaped(classes.backslashes,
+                                  &indexer->previous_ends_odd_backslash);
+  if (escaped | indexer->next_hex_digits) {
+    check_escapes(indexer, block, escaped);
+  }
+  uint64_t quotes = classes.quotes & ~escaped;
+  // Opening quotes and string contents, without the closing quotes
+  uint64_t in_string = prefix_xor(quotes) ^ indexer->previous_in_string;
+  indexer->previous_in_string = (uint64_t)((int64_t)in_string >> 63);
+  indexer->string_controls |= classes.controls & in_string;
+
+  uint64_t scalars =
+      ~(classes.operators | classes.whitespace | quotes | in_string);
+  uint64_t scalar_starts =
+      scalars & ~((scalars << 1) | indexer->previous_scalar);
+  indexer->previous_scalar = scalars >> 63;
+  return (classes.operators & ~in_string) | quotes | scalar_starts;
+}
+
+static constexpr int MAX_DEPTH = 1024;
+// Structural indices are handed from stage 1 to stage 2 in windows small
+// enough to stay in the L1 cache
+static constexpr int WINDOW_BLOCK_COUNT = 64;
+static constexpr int WINDOW_SIZE = WINDOW_BLOCK_COUNT * BLOCK_SIZE;
+
+enum parser_state {
+  PARSER_STATE_VALUE,
+  PARSER_STATE_VALUE_OR_END,
+  PARSER_STATE_KEY,
+  PARSER_STATE_KEY_OR_END,
+  PARSER_STATE_COLON,
+  PARSER_STATE_COMMA_OR_END,
+  // The next structural byte is the closing quote
+  PARSER_STATE_STRING_END,
+  PARSER_STATE_KEY_END,
+  PARSER_STATE_DONE,
+};
+
+// Stage 2 state carried from one window to the next
+struct parser {
+  enum parser_state state;
+  uint32_t depth;
+  // Token of each open container, and the commas it holds so far
+  uint32_t containers[MAX_DEPTH];
+  uint32_t comma_counts[MAX_DEPTH];
+};
+
+// Every token starts at a structural byte, so a window never emits more tokens
+// than it has indices
+static bool reserve_tokens(struct vgltf_json_document *document,
+                           struct vgltf_allocator *allocator,
+                           uint32_t index_count) {
+  uint32_t required_capacity = document->token_count + index_count;
+  if (required_capacity <= document->token_capacity) {
+    return true;
+  }
+
+  uint32_t capacity = VGLTF_MAX(document->token_capacity * 2,
+                                required_capacity);
+  struct vgltf_json_token *tokens = vgltf_allocator_reallocate(
+      allocator, document->tokens,
+      document->token_capacity * sizeof(struct vgltf_json_token),
+      capacity * sizeof(struct vgltf_json_token));
+  if (!tokens) {
+    VGLTF_LOG_ERR("Couldn't grow the JSON tokens to %u", capacity);
+    return false;
+  }
+  document->tokens = tokens;
+  document->token_capacity = capacity;
+  return true;
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static const char *skip_digits(const char *c, const char *end) {
+  while (c < end && is_digit(*c)) {
+    c++;
+  }
+  return c;
+}
+
+// Returns the end of the longest prefix matching
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, nullptr if there is none
+static const char *skip_number(const char *c, const char *end) {
+  c += c < end && *c == '-';
+  if (c == end || !is_digit(*c)) {
+    return nullptr;
+  }
+  c = *c == '0' ? c + 1 : skip_digits(c, end);
+  if (c < end && *c == '.') {
+    c++;
+    if (c == end || !is_digit(*c)) {
+      return nullptr;
+    }
+    c = skip_digits(c, end);
+  }
+  if (c < end && (*c == 'e' || *c == 'E')) {
+    c++;
+    c += c < end && (*c == '+' || *c == '-');
+    if (c == end || !is_digit(*c)) {
+      return nullptr;
+    }
+    c = skip_digits(c, end);
+  }
+  return c;
+}
+
+static bool is_scalar_end(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' ||
+         c == ':' || c == '[' || c == ']' || c == '{' || c == '}' || c == '"';
+}
+
+static bool starts_with(const char *c, const char *end,
+                        struct vgltf_string_view prefix) {
+  return (size_t)(end - c) >= prefix.length &&
+         memcmp(c, prefix.data, prefix.length) == 0;
+}
+
+// Stage 1 only marks the first byte of scalars, their end is found here while
+// checking them. Returns the end offset, 0 if the scalar is invalid.
+static uint32_t scan_scalar(struct vgltf_string_view json, uint32_t start,
+                            enum vgltf_json_type *type) {
+  const char *c = json.data + start;
+  const char *json_end = json.data + json.length;
+  const char *end;
+  switch (*c) {
+  case 't':
+    *type = VGLTF_JSON_TYPE_TRUE;
+    end = starts_with(c, json_end, SV("true")) ? c + 4 : nullptr;
+    break;
+  case 'f':
+    *type = VGLTF_JSON_TYPE_FALSE;
+    end = starts_with(c, json_end, SV("false")) ? c + 5 : nullptr;
+    break;
+  case 'n':
+    *type = VGLTF_JSON_TYPE_NULL;
+    end = starts_with(c, json_end, SV("null")) ? c + 4 : nullptr;
+    break;
+  default:
+    *type = VGLTF_JSON_TYPE_NUMBER;
+    end = skip_number(c, json_end);
+    break;
+  }
+  if (!end || (end < json_end && !is_scalar_end(*end))) {
+    return 0;
+  }
+  return (uint32_t)(end - json.data);
+}
+
+// Walks the structural bytes of a window. The hot state lives in locals so
+// that the token stores don't force it back to memory.
+static bool parse_window(struct parser *parser,
+                         struct vgltf_json_document *document,
+                         const uint32_t *indices, uint32_t index_count) {
+  struct vgltf_string_view json = document->json;
+  struct vgltf_json_token *tokens = document->tokens;
+  uint32_t token_count = document->token_count;
+  enum parser_state state = parser->state;
+  uint32_t depth = parser->depth;
+  uint32_t *containers = parser->containers;
+  uint32_t *comma_counts = parser->comma_counts;
+
+  for (uint32_t index_index = 0; index_index < index_count; index_index++) {
+    uint32_t offset = indices[index_index];
+    char c = json.data[offset];
+    switch (state) {
+    case PARSER_STATE_VALUE_OR_END:
+      if (c == ']') {
+        goto close_container;
+      }
+      [[fallthrough]];
+    case PARSER_STATE_VALUE:
+      switch (c) {
+      case '{':
+      case '[':
+        if (depth == MAX_DEPTH) {
+          VGLTF_LOG_ERR("JSON nested deeper than %d at offset %u", MAX_DEPTH,
+                        offset);
+          return false;
+        }
+        containers[depth] = token_count;
+        comma_counts[depth] = 0;
+        depth++;
+        tokens[token_count] = (struct vgltf_json_token){
+            .start = offset,
+            .type = c == '{' ? VGLTF_JSON_TYPE_OBJECT : VGLTF_JSON_TYPE_ARRAY};
+        token_count++;
+        state = c == '{' ? PARSER_STATE_KEY_OR_END : PARSER_STATE_VALUE_OR_END;
+        break;
+      case '"':
+        tokens[token_count] = (struct vgltf_json_token){
+            .start = offset + 1,
+            .next = token_count + 1,
+            .type = VGLTF_JSON_TYPE_STRING};
+        token_count++;
+        state = PARSER_STATE_STRING_END;
+        break;
+      case '}':
+      case ']':
+      case ':':
+      case ',':
+        VGLTF_LOG_ERR("Expected a JSON value at offset %u", offset);
+        return false;
+      default: {
+        enum vgltf_json_type type;
+        uint32_t end = scan_scalar(json, offset, &type);
+        if (end == 0) {
+          VGLTF_LOG_ERR("Invalid JSON value at offset %u", offset);
+          return false;
+        }
+        tokens[token_count] = (struct vgltf_json_token){
+            .start = offset,
+            .end = end,
+            .next = token_count + 1,
+            .type = type};
+        token_count++;
+        goto end_value;
+      }
+      }
+      break;
+    case PARSER_STATE_KEY_OR_END:
+      if (c == '}') {
+        goto close_container;
+      }
+      [[fallthrough]];
+    case PARSER_STATE_KEY:
+      if (c != '"') {
+        VGLTF_LOG_ERR("Expected a JSON object key at offset %u", offset);
+        return false;
+      }
+      tokens[token_count] =
+          (struct vgltf_json_token){.start = offset + 1,
+                                    .next = token_count + 1,
+                                    .type = VGLTF_JSON_TYPE_STRING};
+      token_count++;
+      state = PARSER_STATE_KEY_END;
+      break;
+    case PARSER_STATE_STRING_END:
+      assert(c == '"');
+      tokens[token_count - 1].end = offset;
+      goto end_value;
+    case PARSER_STATE_KEY_END:
+      assert(c == '"');
+      tokens[token_count - 1].end = offset;
+      state = PARSER_STATE_COLON;
+      break;
+    case PARSER_STATE_COLON:
+      if (c != ':') {
+        VGLTF_LOG_ERR("Expected ':' at offset %u", offset);
+        return false;
+      }
+      state = PARSER_STATE_VALUE;
+      break;
+    case PARSER_STATE_COMMA_OR_END:
+      if (c == ',') {
+        comma_counts[depth - 1]++;
+        state = tokens[containers[depth - 1]].type == VGLTF_JSON_TYPE_OBJECT
+                    ? PARSER_STATE_KEY
+                    : PARSER_STATE_VALUE;
+        break;
+      }
+      if (c == '}' || c == ']') {
+        goto close_container;
+      }
+      VGLTF_LOG_ERR("Expected ',' or a closing bracket at offset %u", offset);
+      return false;
+    case PARSER_STATE_DONE:
+      VGLTF_LOG_ERR(
+          "Unexpected JSON content after the root value at offset %u", offset);
+      return false;
+    }
+    continue;
+
+  close_container: {
+    struct vgltf_json_token *container = &tokens[containers[depth - 1]];
+    if (container->type !=
+        (c == '}' ? VGLTF_JSON_TYPE_OBJECT : VGLTF_JSON_TYPE_ARRAY)) {
+      VGLTF_LOG_ERR("Mismatched JSON bracket at offset %u", offset);
+      return false;
+    }
+    // Empty containers are closed before any element
+    container->child_count = state == PARSER_STATE_COMMA_OR_END
+                                 ? comma_counts[depth - 1] + 1
+                                 : 0;
+    container->end = offset + 1;
+    container->next = token_count;
+    depth--;
+  }
+  end_value:
+    state = depth == 0 ? PARSER_STATE_DONE : PARSER_STATE_COMMA_OR_END;
+  }
+
+  document->token_count = token_count;
+  parser->state = state;
+  parser->depth = depth;
+  return true;
+}
+
+bool vgltf_json_document_parse(struct vgltf_json_document *document,
+                               struct vgltf_allocator *allocator,
+                               struct vgltf_string_view json) {
+  assert(document);
+  assert(allocator);
+  if (json.length >= UINT32_MAX) {
+    VGLTF_LOG_ERR("JSON documents are limited to 4GiB");
+    goto err;
+  }
+  if (!vgltf_string_view_utf8_validate(json)) {
+    VGLTF_LOG_ERR("JSON document isn't valid UTF-8");
+    goto err;
+  }
+
+  // Dense glTF JSON has about a token every 8 bytes
+  *document = (struct vgltf_json_document){
+      .json = json, .token_capacity = json.length / 8 + 16};
+  // Every token is written before being read, no need to zero them
+  document->tokens = vgltf_allocator_allocate(
+      allocator, document->token_capacity * sizeof(struct vgltf_json_token));
+  if (!document->tokens) {
+    VGLTF_LOG_ERR("Couldn't allocate the JSON tokens");
+    goto err;
+  }
+
+  struct parser *parser =
+      vgltf_allocator_allocate(allocator, sizeof(struct parser));
+  if (!parser) {
+    VGLTF_LOG_ERR("Couldn't allocate the JSON parser");
+    goto free_tokens;
+  }
+  parser->state = PARSER_STATE_VALUE;
+  parser->depth = 0;
+
+  struct indexer indexer = {};
+  uint32_t indices[WINDOW_SIZE];
+  for (size_t window_start = 0; window_start < json.length;
+       window_start += WINDOW_SIZE) {
+    size_t window_end = window_start + WINDOW_SIZE < json.length
+                            ? window_start + WINDOW_SIZE
+                            : json.length;
+    uint32_t index_count = 0;
+    for (size_t block_start = window_start; block_start < window_end;
+         block_start += BLOCK_SIZE) {
+      uint64_t structurals;
+      if (block_start + BLOCK_SIZE <= json.length) {
+        structurals = index_block(&indexer, json.data + block_start);
+      } else {
+        // The last partial block is padded with whitespace
+        char block[BLOCK_SIZE];
+        memset(block, ' ', sizeof(block));
+        memcpy(block, json.data + block_start, json.length - block_start);
+        structurals = index_block(&indexer, block);
+      }
+
+      while (structurals) {
+        indices[index_count++] =
+            (uint32_t)block_start + __builtin_ctzll(structurals);
+        structurals &= structurals - 1;
+      }
+    }
+
+    if (!reserve_tokens(document, allocator, index_count) ||
+        !parse_window(parser, document, indices, index_count)) {
+      goto free_parser;
+    }
+  }
+
+  if (indexer.previous_in_string) {
+    VGLTF_LOG_ERR("Unterminated JSON string");
+    goto free_parser;
+  }
+  if (indexer.string_controls) {
+    VGLTF_LOG_ERR("Unescaped control character in a JSON string");
+    goto free_parser;
+  }
+  if (indexer.invalid_escapes) {
+    VGLTF_LOG_ERR("Invalid escape sequence in a JSON string");
+    goto free_parser;
+  }
+  if (parser->state != PARSER_STATE_DONE) {
+    VGLTF_LOG_ERR("Truncated JSON document");
+    goto free_parser;
+  }
+
+  vgltf_allocator_free(allocator, parser);
+  return true;
+free_parser:
+  vgltf_allocator_free(allocator, parser);
+free_tokens:
+  vgltf_allocator_free(allocator, document->tokens);
+err:
+  return false;
+}
+
+void vgltf_json_document_deinit(struct vgltf_json_document *document,
+                                struct vgltf_allocator *allocator) {
+  assert(document);
+  assert(allocator);
+  vgltf_allocator_free(allocator, document->tokens);
+}
+
+uint32_t vgltf_json_object_find(const struct vgltf_json_document *document,
+                                uint32_t object, struct vgltf_string_view key) {
+  assert(document);
+  assert(object < document->token_count);
+  const struct vgltf_json_token *tokens = document->tokens;
+  if (tokens[object].type != VGLTF_JSON_TYPE_OBJECT) {
+    return VGLTF_JSON_TOKEN_NONE;
+  }
+
+  for (uint32_t member = object + 1; member < tokens[object].next;
+       member = tokens[member + 1].next) {
+    if (vgltf_json_string_eq(document, member, key)) {
+      return member + 1;
+    }
+  }
+  return VGLTF_JSON_TOKEN_NONE;
+}
+
+struct vgltf_string_view
+vgltf_json_token_text(const struct vgltf_json_document *document,
+                      uint32_t token) {
+  assert(document);
+  assert(token < document->token_count);
+  const struct vgltf_json_token *json_token = &document->tokens[token];
+  return (struct vgltf_string_view){
+      .data = document->json.data + json_token->start,
+      .length = json_token->end - json_token->start};
+}
+
+bool vgltf_json_string_eq(const struct vgltf_json_document *document,
+                          uint32_t token, struct vgltf_string_view string) {
+  assert(document);
+  if (document->tokens[token].type != VGLTF_JSON_TYPE_STRING) {
+    return false;
+  }
+
+  // Escape sequences are longer than the characters they stand for, so most
+  // mismatches are found from the lengths alone
+  struct vgltf_string_view text = vgltf_json_token_text(document, token);
+  if (text.length <= string.length) {
+    return text.length == string.length &&
+           memcmp(text.data, string.data, text.length) == 0 &&
+           !memchr(text.data, '\\', text.length);
+  }
+  if (!memchr(text.data, '\\', text.length)) {
+    return false;
+  }
+
+  char unescaped[256];
+  size_t length;
+  return text.length <= sizeof(unescaped) &&
+         vgltf_json_string_unescape(document, token, unescaped,
+                                    sizeof(unescaped), &length) &&
+         vgltf_string_view_eq(
+             (struct vgltf_string_view){.data = unescaped, .length = length},
+             string);
+}
+
+static bool parse_hex_4(const char *hex, uint32_t *value) {
+  *value = 0;
+  for (int digit_index = 0; digit_index < 4; digit_index++) {
+    char c = hex[digit_index];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      digit = (c | 0x20) - 'a' + 10;
+    } else {
+      return false;
+    }
+    *value = (*value << 4) | digit;
+  }
+  return true;
+}
+
+bool vgltf_json_string_unescape(const struct vgltf_json_document *document,
+                                uint32_t token, char *unescaped,
+                                size_t capacity, size_t *length) {
+  assert(document);
+  assert(unescaped);
+  assert(length);
+  if (document->tokens[token].type != VGLTF_JSON_TYPE_STRING) {
+    return false;
+  }
+
+  struct vgltf_string_view text = vgltf_json_token_text(document, token);
+  if (text.length > capacity) {
+    return false;
+  }
+
+  const char *c = text.data;
+  const char *end = text.data + text.length;
+  *length = 0;
+  while (c < end) {
+    const char *backslash = memchr(c, '\\', end - c);
+    size_t run_length = (backslash ? backslash : end) - c;
+    memcpy(unescaped + *length, c, run_length);
+    *length += run_length;
+    if (!backslash) {
+      break;
+    }
+
+    // The tokenizer made sure a backslash is never last
+    c = backslash + 2;
+    switch (backslash[1]) {
+    case '"':
+    case '\\':
+    case '/':
+      unescaped[(*length)++] = backslash[1];
+      break;
+    case 'b':
+      unescaped[(*length)++] = '\b';
+      break;
+    case 'f':
+      unescaped[(*length)++] = '\f';
+      break;
+    case 'n':
+      unescaped[(*length)++] = '\n';
+      break;
+    case 'r':
+      unescaped[(*length)++] = '\r';
+      break;
+    case 't':
+      unescaped[(*length)++] = '\t';
+      break;
+    case 'u': {
+      uint32_t codepoint;
+      if (end - c < 4 || !parse_hex_4(c, &codepoint)) {
+        return false;
+      }
+      c += 4;
+      if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+        // High surrogate, the low one has to follow
+        uint32_t low_surrogate;
+        if (end - c < 6 || c[0] != '\\' || c[1] != 'u' ||
+            !parse_hex_4(c + 2, &low_surrogate) || low_surrogate < 0xDC00 ||
+            low_surrogate > 0xDFFF) {
+          return false;
+        }
+        c += 6;
+        codepoint =
+            0x10000 + ((codepoint - 0xD800) << 10) + (low_surrogate - 0xDC00);
+      } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+        return false;
+      }
+      // 6 escaped bytes encode to at most 3, 12 to 4
+      *length += vgltf_string_utf8_encode_codepoint(codepoint,
+                                                    unescaped + *length);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+bool vgltf_json_to_bool(const struct vgltf_json_document *document,
+                        uint32_t token, bool *value) {
+  assert(document);
+  assert(value);
+  enum vgltf_json_type type = document->tokens[token].type;
+  *value = type == VGLTF_JSON_TYPE_TRUE;
+  return type == VGLTF_JSON_TYPE_TRUE || type == VGLTF_JSON_TYPE_FALSE;
+}
+
+bool vgltf_json_to_double(const struct vgltf_json_document *document,
+                          uint32_t token, double *value) {
+  assert(document);
+  assert(value);
+  if (document->tokens[token].type != VGLTF_JSON_TYPE_NUMBER) {
+    return false;
+  }
+
+  // Integers are most of the numbers in glTF
+  uint64_t integer;
+  if (vgltf_json_to_uint64(document, token, &integer) &&
+      integer <= (1ull << 53)) {
+    *value = (double)integer;
+    return true;
+  }
+
+  // strtod needs a null terminated string
+  struct vgltf_string_view text = vgltf_json_token_text(document, token);
+  char number[128];
+  if (text.length >= sizeof(number)) {
+    return false;
+  }
+  memcpy(number, text.data, text.length);
+  number[text.length] = '\0';
+  *value = strtod(number, nullptr);
+  return true;
+}
+
+bool vgltf_json_to_float(const struct vgltf_json_document *document,
+                         uint32_t token, float *value) {
+  assert(value);
+  double double_value;
+  if (!vgltf_json_to_double(document, token, &double_value)) {
+    return false;
+  }
+  *value = (float)double_value;
+  return true;
+}
+
+bool vgltf_json_to_uint64(const struct vgltf_json_document *document,
+                          uint32_t token, uint64_t *value) {
+  assert(document);
+  assert(value);
+  if (document->tokens[token].type != VGLTF_JSON_TYPE_NUMBER) {
+    return false;
+  }
+
+  struct vgltf_string_view text = vgltf_json_token_text(document, token);
+  *value = 0;
+  for (size_t i = 0; i < text.length; i++) {
+    if (!is_digit(text.data[i]) ||
+        __builtin_mul_overflow(*value, 10, value) ||
+        __builtin_add_overflow(*value, (uint64_t)(text.data[i] - '0'),
+                               value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool vgltf_json_to_uint32(const struct vgltf_json_document *document,
+                          uint32_t token, uint32_t *value) {
+  assert(value);
+  uint64_t wide_value;
+  if (!vgltf_json_to_uint64(document, token, &wide_value) ||
+      wide_value > UINT32_MAX) {
+    return false;
+  }
+  *value = (uint32_t)wide_value;
+  return true;
+}
@@ -0,0 +1,82 @@
+#ifndef VGLTF_JSON_H
+#define VGLTF_JSON_H
+
+#include "alloc.h"
+#include "str.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum vgltf_json_type {
+  VGLTF_JSON_TYPE_OBJECT,
+  VGLTF_JSON_TYPE_ARRAY,
+  VGLTF_JSON_TYPE_STRING,
+  VGLTF_JSON_TYPE_NUMBER,
+  VGLTF_JSON_TYPE_TRUE,
+  VGLTF_JSON_TYPE_FALSE,
+  VGLTF_JSON_TYPE_NULL,
+};
+
+constexpr uint32_t VGLTF_JSON_TOKEN_NONE = UINT32_MAX;
+
+// Tokens are stored in document order: the first child of a container is the
+// token following it, an object member is a key string token followed by its
+// value, and the next sibling of any token is at its next index.
+struct vgltf_json_token {
+  // Byte range in the JSON text, quotes excluded for strings, which are left
+  // escaped
+  uint32_t start;
+  uint32_t end;
+  // Index of the token following this token and its descendants
+  uint32_t next;
+  // Elements of an array, members of an object
+  uint32_t child_count;
+  enum vgltf_json_type type;
+};
+
+struct vgltf_json_document {
+  struct vgltf_string_view json;
+  struct vgltf_json_token *tokens;
+  uint32_t token_count;
+  uint32_t token_capacity;
+};
+
+// Tokenizes in two stages like simdjson does: structural characters are found
+// 64 bytes at a time with SIMD comparisons and bit manipulations, then only
+// those are walked to check the grammar and emit tokens. The JSON text has to
+// outlive the document.
+bool vgltf_json_document_parse(struct vgltf_json_document *document,
+                               struct vgltf_allocator *allocator,
+                               struct vgltf_string_view json);
+void vgltf_json_document_deinit(struct vgltf_json_document *document,
+                                struct vgltf_allocator *allocator);
+
+// Returns the value of the member named key, VGLTF_JSON_TOKEN_NONE if the
+// object has none
+uint32_t vgltf_json_object_find(const struct vgltf_json_document *document,
+                                uint32_t object, struct vgltf_string_view key);
+
+// Raw text of the token, still escaped for strings
+struct vgltf_string_view
+vgltf_json_token_text(const struct vgltf_json_document *document,
+                      uint32_t token);
+bool vgltf_json_string_eq(const struct vgltf_json_document *document,
+                          uint32_t token, struct vgltf_string_view string);
+// The unescaped string is never longer than the raw one
+bool vgltf_json_string_unescape(const struct vgltf_json_document *document,
+                                uint32_t token, char *unescaped,
+                                size_t capacity, size_t *length);
+
+// Return false if the token isn't of the right type or its value doesn't fit
+bool vgltf_json_to_bool(const struct vgltf_json_document *document,
+                        uint32_t token, bool *value);
+bool vgltf_json_to_double(const struct vgltf_json_document *document,
+                          uint32_t token, double *value);
+bool vgltf_json_to_float(const struct vgltf_json_document *document,
+                         uint32_t token, float *value);
+bool vgltf_json_to_uint64(const struct vgltf_json_document *document,
+                          uint32_t token, uint64_t *value);
+bool vgltf_json_to_uint32(const struct vgltf_json_document *document,
+                          uint32_t token, uint32_t *value);
+
+#endif // VGLTF_JSON_H
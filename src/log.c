@@ -1,5 +1,405 @@
 #include "log.h"
+#include "log_binary.h"
+#include "platform.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
 
 const char *vgltf_log_level_str[] = {[VGLTF_LOG_LEVEL_DBG] = "debug",
                                    [VGLTF_LOG_LEVEL_INFO] = "info",
                                    [VGLTF_LOG_LEVEL_ERR] = "error"};
+
+constexpr int VGLTF_LOG_MAX_THREAD_COUNT = 32;
+constexpr int VGLTF_LOG_RING_CAPACITY = 256;
+constexpr int VGLTF_LOG_MESSAGE_CAPACITY = 256;
+constexpr int VGLTF_LOG_DRAIN_INTERVAL_MILLISECONDS = 5;
+#ifdef VGLTF_LOG_BINARY
+static const char BINARY_LOG_PATH[] = "vgltf_log.bin";
+#endif
+
+struct vgltf_log_record {
+  // Records of every thread are written in sequence order
+  uint64_t sequence;
+  const char *file;
+  const char *format;
+  int line;
+  enum vgltf_log_level level;
+  // The formatted message, or the packed arguments for the binary log
+  uint32_t size;
+  char data[VGLTF_LOG_MESSAGE_CAPACITY];
+};
+
+// Filled by its own thread only, drained by whoever holds the drain mutex
+struct vgltf_log_ring {
+  struct vgltf_log_record records[VGLTF_LOG_RING_CAPACITY];
+  atomic_uint_fast64_t head;
+  atomic_uint_fast64_t tail;
+  atomic_uint_fast64_t dropped_count;
+};
+
+struct vgltf_log {
+  struct vgltf_log_ring rings[VGLTF_LOG_MAX_THREAD_COUNT];
+  atomic_int ring_count;
+  atomic_uint_fast64_t next_sequence;
+  atomic_bool running;
+  struct vgltf_platform_mutex drain_mutex;
+  struct vgltf_platform_thread drain_thread;
+  FILE *output;
+};
+
+static struct vgltf_log logger;
+static thread_local struct vgltf_log_ring *log_thread_ring;
+static thread_local bool log_thread_registered;
+
+static struct vgltf_log_ring *get_log_thread_ring(void) {
+  if (!log_thread_registered) {
+    log_thread_registered = true;
+    int thread_index = atomic_fetch_add(&logger.ring_count, 1);
+    if (thread_index < VGLTF_LOG_MAX_THREAD_COUNT) {
+      log_thread_ring = &logger.rings[thread_index];
+    }
+  }
+
+  return log_thread_ring;
+}
+
+static void fill_record(struct vgltf_log_record *record,
+                        enum vgltf_log_level level, const char *file,
+                        int line, const char *format, bool pack_arguments,
+                        va_list args) {
+  record->file = file;
+  record->format = format;
+  record->line = line;
+  record->level = level;
+  if (pack_arguments) {
+    record->size = vgltf_log_binary_pack_arguments(
+        record->data, VGLTF_LOG_MESSAGE_CAPACITY, format, args);
+  } else {
+    int length =
+        vsnprintf(record->data, VGLTF_LOG_MESSAGE_CAPACITY, format, args);
+    record->size = length < 0 ? 0 : (uint32_t)length;
+  }
+}
+
+static void write_text_record(FILE *output,
+                              const struct vgltf_log_record *record) {
+  fprintf(output, "[%s %s:%d] %s\n", vgltf_log_level_str[record->level],
+          record->file, record->line, record->data);
+}
+
+#ifdef VGLTF_LOG_BINARY
+static void write_binary_string(FILE *output, const char *string) {
+  uint16_t length = strlen(string);
+  fwrite(&length, sizeof(length), 1, output);
+  fwrite(string, 1, length, output);
+}
+
+static void write_binary_record(FILE *output,
+                                const struct vgltf_log_record *record) {
+  uint8_t level = record->level;
+  int32_t line = record->line;
+  uint16_t arguments_size = record->size;
+  fwrite(&level, sizeof(level), 1, output);
+  fwrite(&line, sizeof(line), 1, output);
+  write_binary_string(output, record->file);
+  write_binary_string(output, record->format);
+  fwrite(&arguments_size, sizeof(arguments_size), 1, output);
+  fwrite(record->data, 1, arguments_size, output);
+}
+#endif
+
+// Must be called with the drain mutex locked
+static void drain(void) {
+  int ring_count = atomic_load(&logger.ring_count);
+  if (ring_count > VGLTF_LOG_MAX_THREAD_COUNT) {
+    ring_count = VGLTF_LOG_MAX_THREAD_COUNT;
+  }
+
+  while (true) {
+    struct vgltf_log_ring *next_ring = nullptr;
+    struct vgltf_log_record *next_record = nullptr;
+    for (int ring_index = 0; ring_index < ring_count; ring_index++) {
+      struct vgltf_log_ring *ring = &logger.rings[ring_index];
+      uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      if (tail ==
+          atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        continue;
+      }
+
+      struct vgltf_log_record *record =
+          &ring->records[tail % VGLTF_LOG_RING_CAPACITY];
+      if (!next_record || record->sequence < next_record->sequence) {
+        next_ring = ring;
+        next_record = record;
+      }
+    }
+
+    if (!next_record) {
+      break;
+    }
+
+#ifdef VGLTF_LOG_BINARY
+    write_binary_record(logger.output, next_record);
+#else
+    write_text_record(logger.output, next_record);
+#endif
+    atomic_fetch_add_explicit(&next_ring->tail, 1, memory_order_release);
+  }
+
+  for (int ring_index = 0; ring_index < ring_count; ring_index++) {
+    uint64_t dropped_count =
+        atomic_exchange(&logger.rings[ring_index].dropped_count, 0);
+    if (dropped_count > 0) {
+      fprintf(stderr, "[%s] %llu log messages dropped\n",
+              vgltf_log_level_str[VGLTF_LOG_LEVEL_ERR],
+              (unsigned long long)dropped_count);
+    }
+  }
+
+  fflush(logger.output);
+}
+
+static int drain_thread_function(void *data) {
+  (void)data;
+  while (atomic_load(&logger.running)) {
+    vgltf_platform_mutex_lock(&logger.drain_mutex);
+    drain();
+    vgltf_platform_mutex_unlock(&logger.drain_mutex);
+    vgltf_platform_sleep_milliseconds(VGLTF_LOG_DRAIN_INTERVAL_MILLISECONDS);
+  }
+
+  return 0;
+}
+
+bool vgltf_log_init(void) {
+  logger.output = stderr;
+#ifdef VGLTF_LOG_BINARY
+  logger.output = fopen(BINARY_LOG_PATH, "wb");
+  if (!logger.output) {
+    logger.output = stderr;
+    VGLTF_LOG_ERR("Couldn't open binary log %s", BINARY_LOG_PATH);
+    return false;
+  }
+  fwrite(VGLTF_LOG_BINARY_MAGIC, 1, sizeof(VGLTF_LOG_BINARY_MAGIC),
+         logger.output);
+#endif
+
+  if (!vgltf_platform_mutex_init(&logger.drain_mutex)) {
+    VGLTF_LOG_ERR("Couldn't create the log drain mutex");
+    goto close_output;
+  }
+
+  atomic_store(&logger.running, true);
+  if (!vgltf_platform_thread_create(&logger.drain_thread, "vgltf log",
+                                    drain_thread_function, nullptr)) {
+    atomic_store(&logger.running, false);
+    VGLTF_LOG_ERR("Couldn't create the log drain thread");
+    goto deinit_drain_mutex;
+  }
+
+  return true;
+deinit_drain_mutex:
+  vgltf_platform_mutex_deinit(&logger.drain_mutex);
+close_output:
+  if (logger.output != stderr) {
+    fclose(logger.output);
+    logger.output = stderr;
+  }
+  return false;
+}
+
+void vgltf_log_deinit(void) {
+  if (!atomic_load(&logger.running)) {
+    return;
+  }
+
+  atomic_store(&logger.running, false);
+  vgltf_platform_thread_join(&logger.drain_thread);
+  // Waits for a flush that is still draining, and keeps it off the output
+  // while it gets closed
+  vgltf_platform_mutex_lock(&logger.drain_mutex);
+  drain();
+  if (logger.output != stderr) {
+    fclose(logger.output);
+    logger.output = stderr;
+  }
+  vgltf_platform_mutex_unlock(&logger.drain_mutex);
+  vgltf_platform_mutex_deinit(&logger.drain_mutex);
+}
+
+void vgltf_log_flush(void) {
+  if (!atomic_load(&logger.running)) {
+    fflush(stderr);
+    return;
+  }
+
+  vgltf_platform_mutex_lock(&logger.drain_mutex);
+  drain();
+  vgltf_platform_mutex_unlock(&logger.drain_mutex);
+}
+
+void vgltf_log_write(enum vgltf_log_level level, const char *file, int line,
+                     const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  struct vgltf_log_ring *ring =
+      atomic_load(&logger.running) ? get_log_thread_ring() : nullptr;
+  if (ring) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) <
+        VGLTF_LOG_RING_CAPACITY) {
+      struct vgltf_log_record *record =
+          &ring->records[head % VGLTF_LOG_RING_CAPACITY];
+      record->sequence = atomic_fetch_add_explicit(&logger.next_sequence, 1,
+                                                   memory_order_relaxed);
+#ifdef VGLTF_LOG_BINARY
+      fill_record(record, level, file, line, format, true, args);
+#else
+      fill_record(record, level, file, line, format, false, args);
+#endif
+      atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+      goto end;
+    }
+
+    // Errors are never dropped, they're written right away instead
+    if (level < VGLTF_LOG_LEVEL_ERR) {
+      atomic_fetch_add_explicit(&ring->dropped_count, 1,
+                                memory_order_relaxed);
+      goto end;
+    }
+  }
+
+  struct vgltf_log_record record;
+  fill_record(&record, level, file, line, format, false, args);
+  write_text_record(stderr, &record);
+end:
+  va_end(args);
+}
+
+#ifdef VGLTF_TRACE
+#include "platform.h"
+#include <stdatomic.h>
+
+constexpr int VGLTF_TRACE_MAX_THREAD_COUNT = 32;
+constexpr int VGLTF_TRACE_EVENT_CAPACITY = 16384;
+
+struct vgltf_trace_event {
+  _Atomic(const char *) name;
+  atomic_uint_fast64_t begin_nanoseconds;
+  atomic_uint_fast64_t end_nanoseconds;
+};
+
+// Only written by its own thread, once full the oldest events get
+// overwritten. The event count works like a sequence lock, the dump discards
+// the events that got overwritten while it was reading them.
+struct vgltf_trace_thread_buffer {
+  struct vgltf_trace_event events[VGLTF_TRACE_EVENT_CAPACITY];
+  atomic_uint_fast64_t event_count;
+};
+
+static struct vgltf_trace_thread_buffer
+    trace_thread_buffers[VGLTF_TRACE_MAX_THREAD_COUNT];
+static atomic_int trace_thread_count;
+static thread_local struct vgltf_trace_thread_buffer *trace_thread_buffer;
+static thread_local bool trace_thread_registered;
+
+static struct vgltf_trace_thread_buffer *get_trace_thread_buffer(void) {
+  if (!trace_thread_registered) {
+    trace_thread_registered = true;
+    int thread_index = atomic_fetch_add(&trace_thread_count, 1);
+    if (thread_index < VGLTF_TRACE_MAX_THREAD_COUNT) {
+      trace_thread_buffer = &trace_thread_buffers[thread_index];
+    }
+  }
+
+  return trace_thread_buffer;
+}
+
+struct vgltf_trace_zone vgltf_trace_zone_begin(const char *name) {
+  return (struct vgltf_trace_zone){
+      .name = name,
+      .begin_nanoseconds = vgltf_platform_get_ticks_nanoseconds()};
+}
+
+void vgltf_trace_zone_end(struct vgltf_trace_zone *zone) {
+  uint64_t end_nanoseconds = vgltf_platform_get_ticks_nanoseconds();
+  struct vgltf_trace_thread_buffer *buffer = get_trace_thread_buffer();
+  if (!buffer) {
+    return;
+  }
+
+  uint64_t event_count =
+      atomic_load_explicit(&buffer->event_count, memory_order_relaxed);
+  struct vgltf_trace_event *event =
+      &buffer->events[event_count % VGLTF_TRACE_EVENT_CAPACITY];
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&event->name, zone->name, memory_order_relaxed);
+  atomic_store_explicit(&event->begin_nanoseconds, zone->begin_nanoseconds,
+                        memory_order_relaxed);
+  atomic_store_explicit(&event->end_nanoseconds, end_nanoseconds,
+                        memory_order_relaxed);
+  atomic_store_explicit(&buffer->event_count, event_count + 1,
+                        memory_order_release);
+}
+
+bool vgltf_trace_dump(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    VGLTF_LOG_ERR("Couldn't open trace file %s", path);
+    goto err;
+  }
+
+  fprintf(file, "{\"traceEvents\":[");
+  bool first_event = true;
+  int thread_count = atomic_load(&trace_thread_count);
+  if (thread_count > VGLTF_TRACE_MAX_THREAD_COUNT) {
+    thread_count = VGLTF_TRACE_MAX_THREAD_COUNT;
+  }
+  for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+    struct vgltf_trace_thread_buffer *buffer =
+        &trace_thread_buffers[thread_index];
+    uint64_t event_count =
+        atomic_load_explicit(&buffer->event_count, memory_order_acquire);
+    uint64_t first_event_index = event_count > VGLTF_TRACE_EVENT_CAPACITY
+                                     ? event_count - VGLTF_TRACE_EVENT_CAPACITY
+                                     : 0;
+    for (uint64_t event_index = first_event_index; event_index < event_count;
+         event_index++) {
+      struct vgltf_trace_event *event =
+          &buffer->events[event_index % VGLTF_TRACE_EVENT_CAPACITY];
+      const char *name =
+          atomic_load_explicit(&event->name, memory_order_relaxed);
+      uint64_t begin_nanoseconds =
+          atomic_load_explicit(&event->begin_nanoseconds, memory_order_relaxed);
+      uint64_t end_nanoseconds =
+          atomic_load_explicit(&event->end_nanoseconds, memory_order_relaxed);
+      atomic_thread_fence(memory_order_acquire);
+      // The owning thread started overwriting the slot
+      if (atomic_load_explicit(&buffer->event_count, memory_order_relaxed) >=
+          event_index + VGLTF_TRACE_EVENT_CAPACITY) {
+        continue;
+      }
+
+      fprintf(file,
+              "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f}",
+              first_event ? "" : ",", name, thread_index,
+              (double)begin_nanoseconds / 1000.0,
+              (double)(end_nanoseconds - begin_nanoseconds) / 1000.0);
+      first_event = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  if (fclose(file) != 0) {
+    VGLTF_LOG_ERR("Couldn't write trace file %s", path);
+    goto err;
+  }
+
+  VGLTF_LOG_INFO("Wrote trace to %s", path);
+  return true;
+err:
+  return false;
+}
+#endif
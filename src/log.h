@@ -11,16 +11,70 @@ enum vgltf_log_level {
 
 extern const char *vgltf_log_level_str[];
 
-#define VGLTF_LOG(level, ...)                                                    \
+// Messages below this level are compiled out
+#ifndef VGLTF_LOG_MIN_LEVEL
+#ifdef VGLTF_DEBUG
+#define VGLTF_LOG_MIN_LEVEL VGLTF_LOG_LEVEL_DBG
+#else
+#define VGLTF_LOG_MIN_LEVEL VGLTF_LOG_LEVEL_INFO
+#endif
+#endif
+
+// Between init and deinit messages are queued in per-thread ring buffers and
+// written by a background thread, outside of it they're written directly.
+// With the binary log build option the arguments are queued unformatted and
+// written to a binary log for tools/log_decode.c.
+bool vgltf_log_init(void);
+// Must be called once the other threads are done logging and flushing, the
+// drain mutex is destroyed and messages queued meanwhile may be lost
+void vgltf_log_deinit(void);
+// Blocks until the queued messages have been written
+void vgltf_log_flush(void);
+void vgltf_log_write(enum vgltf_log_level level, const char *file, int line,
+                     const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+#define VGLTF_LOG(level, ...)                                                  \
   do {                                                                         \
-    fprintf(stderr, "[%s %s:%d] ", vgltf_log_level_str[level], __FILE__,         \
-            __LINE__);                                                         \
-    fprintf(stderr, __VA_ARGS__);                                              \
-    fprintf(stderr, "\n");                                                     \
+    if ((level) >= VGLTF_LOG_MIN_LEVEL) {                                      \
+      vgltf_log_write(level, __FILE__, __LINE__, __VA_ARGS__);                 \
+    }                                                                          \
   } while (0)
 
 #define VGLTF_LOG_DBG(...) VGLTF_LOG(VGLTF_LOG_LEVEL_DBG, __VA_ARGS__)
 #define VGLTF_LOG_INFO(...) VGLTF_LOG(VGLTF_LOG_LEVEL_INFO, __VA_ARGS__)
 #define VGLTF_LOG_ERR(...) VGLTF_LOG(VGLTF_LOG_LEVEL_ERR, __VA_ARGS__)
 
+// Scoped CPU trace zones, enabled with the trace build option. A zone lasts
+// until the end of the enclosing block and its name must outlive the trace
+// dump, string literals and __func__ do.
+#ifdef VGLTF_TRACE
+#include <stdint.h>
+
+struct vgltf_trace_zone {
+  const char *name;
+  uint64_t begin_nanoseconds;
+};
+
+struct vgltf_trace_zone vgltf_trace_zone_begin(const char *name);
+void vgltf_trace_zone_end(struct vgltf_trace_zone *zone);
+
+// Writes the recorded zones of every thread as Chrome trace event JSON, which
+// can be opened with chrome://tracing or Perfetto
+bool vgltf_trace_dump(const char *path);
+
+#define VGLTF_TRACE_CONCAT_(a, b) a##b
+#define VGLTF_TRACE_CONCAT(a, b) VGLTF_TRACE_CONCAT_(a, b)
+#define VGLTF_TRACE_ZONE(name)                                                 \
+  struct vgltf_trace_zone VGLTF_TRACE_CONCAT(vgltf_trace_zone_, __LINE__)      \
+      __attribute__((cleanup(vgltf_trace_zone_end))) =                         \
+          vgltf_trace_zone_begin(name)
+#define VGLTF_TRACE_DUMP(path) vgltf_trace_dump(path)
+#else
+#define VGLTF_TRACE_ZONE(name)                                                 \
+  do {                                                                         \
+  } while (0)
+#define VGLTF_TRACE_DUMP(path) ((void)(path))
+#endif
+
 #endif // VGLTF_LOG_H
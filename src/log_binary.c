@@ -0,0 +1,478 @@
+#include "log_binary.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+enum vgltf_log_argument_type : uint8_t {
+  VGLTF_LOG_ARGUMENT_SIGNED,
+  VGLTF_LOG_ARGUMENT_UNSIGNED,
+  VGLTF_LOG_ARGUMENT_DOUBLE,
+  VGLTF_LOG_ARGUMENT_POINTER,
+  VGLTF_LOG_ARGUMENT_STRING,
+};
+
+enum vgltf_log_length {
+  VGLTF_LOG_LENGTH_DEFAULT,
+  VGLTF_LOG_LENGTH_LONG,
+  VGLTF_LOG_LENGTH_LONG_LONG,
+  VGLTF_LOG_LENGTH_SIZE,
+  VGLTF_LOG_LENGTH_INTMAX,
+  VGLTF_LOG_LENGTH_PTRDIFF,
+  VGLTF_LOG_LENGTH_LONG_DOUBLE,
+};
+
+static constexpr int MAX_FLAG_COUNT = 5;
+static constexpr int MAX_DIGIT_COUNT = 10;
+
+struct vgltf_log_conversion {
+  char flags[MAX_FLAG_COUNT + 1];
+  char width[MAX_DIGIT_COUNT + 1];
+  char precision[MAX_DIGIT_COUNT + 1];
+  bool has_precision;
+  bool width_from_argument;
+  bool precision_from_argument;
+  enum vgltf_log_length length;
+  char conversion;
+};
+
+static void parse_digits(const char **cursor, char *digits) {
+  int digit_count = 0;
+  while (**cursor >= '0' && **cursor <= '9') {
+    if (digit_count < MAX_DIGIT_COUNT) {
+      digits[digit_count++] = **cursor;
+    }
+    (*cursor)++;
+  }
+  digits[digit_count] = '\0';
+}
+
+// Parses the conversion specification following a '%', returns the character
+// after it
+static const char *parse_conversion(const char *cursor,
+                                    struct vgltf_log_conversion *conversion) {
+  *conversion = (struct vgltf_log_conversion){};
+
+  int flag_count = 0;
+  while (*cursor && strchr("-+ #0", *cursor)) {
+    if (flag_count < MAX_FLAG_COUNT) {
+      conversion->flags[flag_count++] = *cursor;
+    }
+    cursor++;
+  }
+
+  if (*cursor == '*') {
+    conversion->width_from_argument = true;
+    cursor++;
+  } else {
+    parse_digits(&cursor, conversion->width);
+  }
+
+  if (*cursor == '.') {
+    conversion->has_precision = true;
+    cursor++;
+    if (*cursor == '*') {
+      conversion->precision_from_argument = true;
+      cursor++;
+    } else {
+      parse_digits(&cursor, conversion->precision);
+    }
+  }
+
+  switch (*cursor) {
+  case 'h':
+    // Promoted to int
+    cursor += cursor[1] == 'h' ? 2 : 1;
+    break;
+  case 'l':
+    if (cursor[1] == 'l') {
+      conversion->length = VGLTF_LOG_LENGTH_LONG_LONG;
+      cursor += 2;
+    } else {
+      conversion->length = VGLTF_LOG_LENGTH_LONG;
+      cursor++;
+    }
+    break;
+  case 'z':
+    conversion->length = VGLTF_LOG_LENGTH_SIZE;
+    cursor++;
+    break;
+  case 'j':
+    conversion->length = VGLTF_LOG_LENGTH_INTMAX;
+    cursor++;
+    break;
+  case 't':
+    conversion->length = VGLTF_LOG_LENGTH_PTRDIFF;
+    cursor++;
+    break;
+  case 'L':
+    conversion->length = VGLTF_LOG_LENGTH_LONG_DOUBLE;
+    cursor++;
+    break;
+  default:
+    break;
+  }
+
+  conversion->conversion = *cursor;
+  return *cursor ? cursor + 1 : cursor;
+}
+
+struct vgltf_log_packer {
+  char *arguments;
+  size_t capacity;
+  size_t size;
+};
+
+static void pack(struct vgltf_log_packer *packer,
+                 enum vgltf_log_argument_type type, const void *value,
+                 size_t value_size) {
+  if (packer->size + 1 + value_size > packer->capacity) {
+    packer->size = packer->capacity;
+    return;
+  }
+
+  packer->arguments[packer->size++] = type;
+  memcpy(packer->arguments + packer->size, value, value_size);
+  packer->size += value_size;
+}
+
+static void pack_signed(struct vgltf_log_packer *packer, int64_t value) {
+  pack(packer, VGLTF_LOG_ARGUMENT_SIGNED, &value, sizeof(value));
+}
+
+static void pack_unsigned(struct vgltf_log_packer *packer, uint64_t value) {
+  pack(packer, VGLTF_LOG_ARGUMENT_UNSIGNED, &value, sizeof(value));
+}
+
+// Packed with their null terminator so they can be formatted in place
+static void pack_string(struct vgltf_log_packer *packer, const char *string) {
+  if (!string) {
+    string = "(null)";
+  }
+
+  size_t header_size = 1 + sizeof(uint16_t);
+  if (packer->size + header_size + 1 > packer->capacity) {
+    packer->size = packer->capacity;
+    return;
+  }
+
+  // Truncated to what's left
+  size_t length = strlen(string);
+  size_t available = packer->capacity - packer->size - header_size - 1;
+  if (length > available) {
+    length = available;
+  }
+  if (length >= UINT16_MAX) {
+    length = UINT16_MAX - 1;
+  }
+  uint16_t packed_size = length + 1;
+  packer->arguments[packer->size++] = VGLTF_LOG_ARGUMENT_STRING;
+  memcpy(packer->arguments + packer->size, &packed_size, sizeof(packed_size));
+  packer->size += sizeof(packed_size);
+  memcpy(packer->arguments + packer->size, string, length);
+  packer->size += length;
+  packer->arguments[packer->size++] = '\0';
+}
+
+size_t vgltf_log_binary_pack_arguments(char *arguments, size_t capacity,
+                                       const char *format, va_list args) {
+  struct vgltf_log_packer packer = {.arguments = arguments,
+                                    .capacity = capacity};
+  const char *cursor = format;
+  while ((cursor = strchr(cursor, '%'))) {
+    if (cursor[1] == '%') {
+      cursor += 2;
+      continue;
+    }
+
+    struct vgltf_log_conversion conversion;
+    cursor = parse_conversion(cursor + 1, &conversion);
+    if (conversion.width_from_argument) {
+      pack_signed(&packer, va_arg(args, int));
+    }
+    if (conversion.precision_from_argument) {
+      pack_signed(&packer, va_arg(args, int));
+    }
+
+    switch (conversion.conversion) {
+    case 'd':
+    case 'i':
+      switch (conversion.length) {
+      case VGLTF_LOG_LENGTH_LONG:
+        pack_signed(&packer, va_arg(args, long));
+        break;
+      case VGLTF_LOG_LENGTH_LONG_LONG:
+        pack_signed(&packer, va_arg(args, long long));
+        break;
+      case VGLTF_LOG_LENGTH_SIZE:
+      case VGLTF_LOG_LENGTH_PTRDIFF:
+        pack_signed(&packer, va_arg(args, ptrdiff_t));
+        break;
+      case VGLTF_LOG_LENGTH_INTMAX:
+        pack_signed(&packer, va_arg(args, intmax_t));
+        break;
+      default:
+        pack_signed(&packer, va_arg(args, int));
+        break;
+      }
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      switch (conversion.length) {
+      case VGLTF_LOG_LENGTH_LONG:
+        pack_unsigned(&packer, va_arg(args, unsigned long));
+        break;
+      case VGLTF_LOG_LENGTH_LONG_LONG:
+        pack_unsigned(&packer, va_arg(args, unsigned long long));
+        break;
+      case VGLTF_LOG_LENGTH_SIZE:
+        pack_unsigned(&packer, va_arg(args, size_t));
+        break;
+      case VGLTF_LOG_LENGTH_PTRDIFF:
+        pack_unsigned(&packer, va_arg(args, ptrdiff_t));
+        break;
+      case VGLTF_LOG_LENGTH_INTMAX:
+        pack_unsigned(&packer, va_arg(args, uintmax_t));
+        break;
+      default:
+        pack_unsigned(&packer, va_arg(args, unsigned int));
+        break;
+      }
+      break;
+    case 'c':
+      pack_signed(&packer, va_arg(args, int));
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      double value = conversion.length == VGLTF_LOG_LENGTH_LONG_DOUBLE
+                         ? (double)va_arg(args, long double)
+                         : va_arg(args, double);
+      pack(&packer, VGLTF_LOG_ARGUMENT_DOUBLE, &value, sizeof(value));
+      break;
+    }
+    case 'p': {
+      uint64_t value = (uintptr_t)va_arg(args, void *);
+      pack(&packer, VGLTF_LOG_ARGUMENT_POINTER, &value, sizeof(value));
+      break;
+    }
+    case 's':
+      pack_string(&packer, va_arg(args, const char *));
+      break;
+    default:
+      break;
+    }
+  }
+
+  return packer.size;
+}
+
+struct vgltf_log_unpacker {
+  const char *arguments;
+  size_t size;
+  size_t offset;
+};
+
+static bool unpack(struct vgltf_log_unpacker *unpacker,
+                   enum vgltf_log_argument_type expected_type, void *value,
+                   size_t value_size) {
+  if (unpacker->offset + 1 + value_size > unpacker->size ||
+      (uint8_t)unpacker->arguments[unpacker->offset] != expected_type) {
+    return false;
+  }
+
+  memcpy(value, unpacker->arguments + unpacker->offset + 1, value_size);
+  unpacker->offset += 1 + value_size;
+  return true;
+}
+
+static bool unpack_string(struct vgltf_log_unpacker *unpacker,
+                          const char **string) {
+  uint16_t packed_size;
+  if (!unpack(unpacker, VGLTF_LOG_ARGUMENT_STRING, &packed_size,
+              sizeof(packed_size)) ||
+      packed_size == 0 || unpacker->offset + packed_size > unpacker->size ||
+      unpacker->arguments[unpacker->offset + packed_size - 1] != '\0') {
+    return false;
+  }
+
+  *string = unpacker->arguments + unpacker->offset;
+  unpacker->offset += packed_size;
+  return true;
+}
+
+struct vgltf_log_writer {
+  char *message;
+  size_t capacity;
+  size_t length;
+};
+
+static void write_message(struct vgltf_log_writer *writer,
+                          const char *specification, ...)
+    __attribute__((format(printf, 2, 3)));
+static void write_message(struct vgltf_log_writer *writer,
+                          const char *specification, ...) {
+  bool has_room = writer->length < writer->capacity;
+  va_list args;
+  va_start(args, specification);
+  int length = vsnprintf(has_room ? writer->message + writer->length : nullptr,
+                         has_room ? writer->capacity - writer->length : 0,
+                         specification, args);
+  va_end(args);
+  if (length > 0) {
+    writer->length += length;
+  }
+}
+
+// Formats a single conversion, the specification is rebuilt with the width
+// and precision arguments inlined and integers widened to long long
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static bool
+format_conversion(struct vgltf_log_writer *writer,
+                  struct vgltf_log_unpacker *unpacker,
+                  const struct vgltf_log_conversion *conversion) {
+  int64_t width = 0;
+  int64_t precision = 0;
+  if (conversion->width_from_argument &&
+      !unpack(unpacker, VGLTF_LOG_ARGUMENT_SIGNED, &width, sizeof(width))) {
+    return false;
+  }
+  if (conversion->precision_from_argument &&
+      !unpack(unpacker, VGLTF_LOG_ARGUMENT_SIGNED, &precision,
+              sizeof(precision))) {
+    return false;
+  }
+
+  char width_digits[MAX_DIGIT_COUNT + 2];
+  char precision_digits[MAX_DIGIT_COUNT + 2];
+  if (conversion->width_from_argument) {
+    snprintf(width_digits, sizeof(width_digits), "%d", (int)width);
+  } else {
+    snprintf(width_digits, sizeof(width_digits), "%s", conversion->width);
+  }
+  if (conversion->precision_from_argument) {
+    snprintf(precision_digits, sizeof(precision_digits), "%d", (int)precision);
+  } else {
+    snprintf(precision_digits, sizeof(precision_digits), "%s",
+             conversion->precision);
+  }
+
+  bool integer_conversion = strchr("diuoxX", conversion->conversion);
+  char specification[MAX_FLAG_COUNT + 2 * (MAX_DIGIT_COUNT + 2) + 8];
+  snprintf(specification, sizeof(specification), "%%%s%s%s%s%s%c",
+           conversion->flags, width_digits,
+           conversion->has_precision ? "." : "", precision_digits,
+           integer_conversion ? "ll" : "", conversion->conversion);
+
+  switch (conversion->conversion) {
+  case 'd':
+  case 'i':
+  case 'c': {
+    int64_t value;
+    if (!unpack(unpacker, VGLTF_LOG_ARGUMENT_SIGNED, &value, sizeof(value))) {
+      return false;
+    }
+    if (conversion->conversion == 'c') {
+      write_message(writer, specification, (int)value);
+    } else {
+      write_message(writer, specification, (long long)value);
+    }
+    break;
+  }
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X': {
+    uint64_t value;
+    if (!unpack(unpacker, VGLTF_LOG_ARGUMENT_UNSIGNED, &value,
+                sizeof(value))) {
+      return false;
+    }
+    write_message(writer, specification, (unsigned long long)value);
+    break;
+  }
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A': {
+    double value;
+    if (!unpack(unpacker, VGLTF_LOG_ARGUMENT_DOUBLE, &value, sizeof(value))) {
+      return false;
+    }
+    write_message(writer, specification, value);
+    break;
+  }
+  case 'p': {
+    uint64_t value;
+    if (!unpack(unpacker, VGLTF_LOG_ARGUMENT_POINTER, &value,
+                sizeof(value))) {
+      return false;
+    }
+    write_message(writer, specification, (void *)(uintptr_t)value);
+    break;
+  }
+  case 's': {
+    const char *value;
+    if (!unpack_string(unpacker, &value)) {
+      return false;
+    }
+    write_message(writer, specification, value);
+    break;
+  }
+  default:
+    return false;
+  }
+
+  return true;
+}
+#pragma GCC diagnostic pop
+
+int vgltf_log_binary_format(char *message, size_t capacity,
+                            const char *format, const char *arguments,
+                            size_t arguments_size) {
+  struct vgltf_log_unpacker unpacker = {.arguments = arguments,
+                                        .size = arguments_size};
+  struct vgltf_log_writer writer = {.message = message, .capacity = capacity};
+  if (capacity > 0) {
+    message[0] = '\0';
+  }
+
+  const char *cursor = format;
+  while (*cursor) {
+    const char *conversion_begin = strchr(cursor, '%');
+    size_t literal_length = conversion_begin
+                                ? (size_t)(conversion_begin - cursor)
+                                : strlen(cursor);
+    write_message(&writer, "%.*s", (int)literal_length, cursor);
+    if (!conversion_begin) {
+      break;
+    }
+
+    if (conversion_begin[1] == '%') {
+      write_message(&writer, "%%");
+      cursor = conversion_begin + 2;
+      continue;
+    }
+
+    struct vgltf_log_conversion conversion;
+    cursor = parse_conversion(conversion_begin + 1, &conversion);
+    if (!format_conversion(&writer, &unpacker, &conversion)) {
+      // Unsupported or got truncated when packed
+      write_message(&writer, "<?>");
+    }
+  }
+
+  return (int)writer.length;
+}
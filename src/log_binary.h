@@ -0,0 +1,23 @@
+#ifndef VGLTF_LOG_BINARY_H
+#define VGLTF_LOG_BINARY_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// Binary log records are written with the native endianness:
+// level (u8), line (i32), file length (u16), file, format length (u16),
+// format, arguments size (u16), arguments
+static constexpr char VGLTF_LOG_BINARY_MAGIC[] = "VGLTFLOG1";
+
+// Packs the arguments of a printf style format so it can be formatted later,
+// possibly by another process. Strings are copied, %n isn't supported.
+// Returns the packed size.
+size_t vgltf_log_binary_pack_arguments(char *arguments, size_t capacity,
+                                       const char *format, va_list args);
+
+// Formats packed arguments, returns the formatted length like snprintf
+int vgltf_log_binary_format(char *message, size_t capacity,
+                            const char *format, const char *arguments,
+                            size_t arguments_size);
+
+#endif // VGLTF_LOG_BINARY_H
@@ -1,16 +1,211 @@
+#include "alloc.h"
 #include "engine.h"
 #include "log.h"
 #include "platform.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char TRACE_PATH[] = "vgltf_trace.json";
+static const char DEFAULT_MODEL_PATH[] = "assets/model.obj";
+static constexpr int HEADLESS_MAX_FRAME_COUNT = 1 << 20;
+// Not measured, the first frames pay for pipeline and cache warm up
+static constexpr int HEADLESS_WARMUP_FRAME_COUNT = 16;
+
+static int compare_frame_times(const void *lhs, const void *rhs) {
+  uint64_t a = *(const uint64_t *)lhs;
+  uint64_t b = *(const uint64_t *)rhs;
+  return (a > b) - (a < b);
+}
+
+static double nanoseconds_to_milliseconds(uint64_t nanoseconds) {
+  return (double)nanoseconds / 1e6;
+}
+
+struct headless_options {
+  int frame_count;
+  struct vgltf_window_size size;
+  int capture_interval;
+  const char *model_path;
+  bool depth_prepass;
+  bool cluster_culling;
+  bool lod_selection;
+};
+
+static bool parse_int(const char *text, int *value) {
+  char *end;
+  long parsed = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || parsed < INT_MIN ||
+      parsed > INT_MAX) {
+    return false;
+  }
+  *value = (int)parsed;
+  return true;
+}
+
+// The options after --headless. Without their flags, frames render without a
+// depth prepass, with cluster culling and with LOD selection.
+static bool parse_headless_options(int argc, char **argv,
+                                   struct headless_options *options) {
+  *options = (struct headless_options){.frame_count = 1000,
+                                       .size = {.width = 800, .height = 600},
+                                       .model_path = DEFAULT_MODEL_PATH,
+                                       .cluster_culling = true,
+                                       .lod_selection = true};
+  for (int arg_index = 2; arg_index < argc; arg_index++) {
+    const char *arg = argv[arg_index];
+    const char *value = arg_index + 1 < argc ? argv[arg_index + 1] : nullptr;
+    int *int_option = nullptr;
+    if (strcmp(arg, "--frames") == 0) {
+      int_option = &options->frame_count;
+    } else if (strcmp(arg, "--width") == 0) {
+      int_option = &options->size.width;
+    } else if (strcmp(arg, "--height") == 0) {
+      int_option = &options->size.height;
+    } else if (strcmp(arg, "--capture-interval") == 0) {
+      int_option = &options->capture_interval;
+    } else if (strcmp(arg, "--model") == 0 && value) {
+      options->model_path = value;
+      arg_index++;
+    } else if (strcmp(arg, "--depth-prepass") == 0 ||
+               strcmp(arg, "--no-depth-prepass") == 0) {
+      options->depth_prepass = strcmp(arg, "--depth-prepass") == 0;
+    } else if (strcmp(arg, "--cluster-culling") == 0 ||
+               strcmp(arg, "--no-cluster-culling") == 0) {
+      options->cluster_culling = strcmp(arg, "--cluster-culling") == 0;
+    } else if (strcmp(arg, "--lod") == 0 || strcmp(arg, "--no-lod") == 0) {
+      options->lod_selection = strcmp(arg, "--lod") == 0;
+    } else {
+      VGLTF_LOG_ERR("Unknown or incomplete option %s", arg);
+      goto err;
+    }
+
+    if (int_option) {
+      if (!value || !parse_int(value, int_option)) {
+        VGLTF_LOG_ERR("Option %s needs an integer value", arg);
+        goto err;
+      }
+      arg_index++;
+    }
+  }
+
+  if (options->frame_count <= 0 ||
+      options->frame_count > HEADLESS_MAX_FRAME_COUNT ||
+      options->size.width <= 0 || options->size.height <= 0 ||
+      options->capture_interval < 0) {
+    VGLTF_LOG_ERR("Option out of range");
+    goto err;
+  }
+  return true;
+err:
+  return false;
+}
+
+// Renders a fixed number of offscreen frames and prints frame time
+// statistics, every capture interval frames are written to
+// vgltf_frame_<index>.png. --depth-prepass renders with a depth prepass,
+// --no-cluster-culling only culls whole instances, and --no-lod draws the
+// most detailed LODs.
+static bool run_headless(int argc, char **argv) {
+  struct headless_options options;
+  if (!parse_headless_options(argc, argv, &options)) {
+    VGLTF_LOG_ERR("usage: %s --headless [--frames <count>] [--width <pixels>] "
+                  "[--height <pixels>] [--capture-interval <frames>] "
+                  "[--model <path>] [--[no-]depth-prepass] "
+                  "[--[no-]cluster-culling] [--[no-]lod]",
+                  argv[0]);
+    goto err;
+  }
+  int frame_count = options.frame_count;
+  struct vgltf_window_size size = options.size;
+  int capture_interval = options.capture_interval;
+
+  uint64_t *frame_times = vgltf_allocator_allocate_array(
+      &system_allocator, frame_count, sizeof(uint64_t));
+  if (!frame_times) {
+    VGLTF_LOG_ERR("Couldn't allocate frame times");
+    goto err;
+  }
+
+  struct vgltf_engine engine = {};
+  if (!vgltf_engine_init_headless(&engine, size, options.model_path)) {
+    VGLTF_LOG_ERR("Couldn't initialize the engine");
+    goto free_frame_times;
+  }
+  vgltf_renderer_set_depth_prepass(&engine.renderer, options.depth_prepass);
+  vgltf_renderer_set_cluster_culling(&engine.renderer,
+                                     options.cluster_culling);
+  vgltf_renderer_set_lod_selection(&engine.renderer, options.lod_selection);
+
+  for (int frame_index = -HEADLESS_WARMUP_FRAME_COUNT;
+       frame_index < frame_count; frame_index++) {
+    uint64_t frame_start = vgltf_platform_get_ticks_nanoseconds();
+    if (capture_interval > 0 && frame_index >= 0 &&
+        frame_index % capture_interval == 0) {
+      char path[64];
+      snprintf(path, sizeof(path), "vgltf_frame_%06d.png", frame_index);
+      vgltf_renderer_request_readback(&engine.renderer, path);
+    }
+    if (!vgltf_engine_run_frame(&engine)) {
+      VGLTF_LOG_ERR("Couldn't render frame %d", frame_index);
+      goto deinit_engine;
+    }
+    if (frame_index >= 0) {
+      frame_times[frame_index] =
+          vgltf_platform_get_ticks_nanoseconds() - frame_start;
+    }
+  }
+  vgltf_gpu_profiler_log_report(&engine.renderer.gpu_profiler);
+  vgltf_engine_deinit(&engine);
+
+  uint64_t total_time = 0;
+  for (int frame_index = 0; frame_index < frame_count; frame_index++) {
+    total_time += frame_times[frame_index];
+  }
+  qsort(frame_times, frame_count, sizeof(uint64_t), compare_frame_times);
+  double average_ms = nanoseconds_to_milliseconds(total_time) / frame_count;
+  printf("%d frames at %dx%d: min %.3f ms, average %.3f ms, median %.3f ms, "
+         "p99 %.3f ms, max %.3f ms, %.1f fps\n",
+         frame_count, size.width, size.height,
+         nanoseconds_to_milliseconds(frame_times[0]), average_ms,
+         nanoseconds_to_milliseconds(frame_times[frame_count / 2]),
+         nanoseconds_to_milliseconds(frame_times[frame_count * 99 / 100]),
+         nanoseconds_to_milliseconds(frame_times[frame_count - 1]),
+         1000.0 / average_ms);
+  vgltf_allocator_free(&system_allocator, frame_times);
+  return true;
+deinit_engine:
+  vgltf_engine_deinit(&engine);
+free_frame_times:
+  vgltf_allocator_free(&system_allocator, frame_times);
+err:
+  return false;
+}
+
+int main(int argc, char **argv) {
+  // Falls back to writing messages directly
+  if (!vgltf_log_init()) {
+    VGLTF_LOG_ERR("Couldn't start the asynchronous logger");
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+    bool succeeded = run_headless(argc, argv);
+    VGLTF_TRACE_DUMP(TRACE_PATH);
+    vgltf_log_deinit();
+    return succeeded ? 0 : -1;
+  }
 
-int main(void) {
   struct vgltf_platform platform = {};
   if (!vgltf_platform_init(&platform)) {
     VGLTF_LOG_ERR("Platform initialization failed");
     goto err;
   }
 
+  // vgltf [model path]
+  const char *model_path = argc > 1 ? argv[1] : DEFAULT_MODEL_PATH;
   struct vgltf_engine engine = {};
-  if (!vgltf_engine_init(&engine, &platform)) {
+  if (!vgltf_engine_init(&engine, &platform, model_path)) {
     VGLTF_LOG_ERR("Couldn't initialize the engine");
     goto deinit_platform;
   }
@@ -23,6 +218,21 @@ int main(void) {
                                            event.key.key == VGLTF_KEY_ESCAPE)) {
         goto out_main_loop;
       }
+      if (event.type == VGLTF_EVENT_KEY_DOWN && event.key.key == VGLTF_KEY_T) {
+        VGLTF_TRACE_DUMP(TRACE_PATH);
+      }
+      if (event.type == VGLTF_EVENT_KEY_DOWN && event.key.key == VGLTF_KEY_P) {
+        vgltf_renderer_set_depth_prepass(&engine.renderer,
+                                         !engine.renderer.depth_prepass);
+      }
+      if (event.type == VGLTF_EVENT_KEY_DOWN && event.key.key == VGLTF_KEY_C) {
+        vgltf_renderer_set_cluster_culling(&engine.renderer,
+                                           !engine.renderer.cluster_culling);
+      }
+      if (event.type == VGLTF_EVENT_KEY_DOWN && event.key.key == VGLTF_KEY_L) {
+        vgltf_renderer_set_lod_selection(&engine.renderer,
+                                         !engine.renderer.lod_selection);
+      }
     }
 
     vgltf_engine_run_frame(&engine);
@@ -31,9 +241,12 @@ out_main_loop:
   VGLTF_LOG_INFO("Exiting main loop");
   vgltf_engine_deinit(&engine);
   vgltf_platform_deinit(&platform);
+  VGLTF_TRACE_DUMP(TRACE_PATH);
+  vgltf_log_deinit();
   return 0;
 deinit_platform:
   vgltf_platform_deinit(&platform);
 err:
+  vgltf_log_deinit();
   return -1;
 }
@@ -21,6 +21,29 @@ vgltf_vec3 vgltf_vec3_normalized(vgltf_vec3 vec) {
   return (vgltf_vec3){
       .x = vec.x / length, .y = vec.y / length, .z = vec.z / length};
 }
+uint16_t vgltf_float_to_half(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t magnitude = bits & 0x7fffffff;
+  if (magnitude > 0x7f800000) {
+    return sign | 0x7e00;
+  }
+  // From halfway between the largest half, 65504, and 65536 up
+  if (magnitude >= 0x477ff000) {
+    return sign | 0x7c00;
+  }
+  // Below 2^-14 halves are subnormal, multiples of 2^-24
+  if (magnitude < 0x38800000) {
+    float absolute;
+    memcpy(&absolute, &magnitude, sizeof(absolute));
+    return sign | (uint16_t)lrintf(absolute * 0x1p24f);
+  }
+  // Rebiases the exponent and rounds the mantissa to even, a carry moves to
+  // the exponent
+  uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+  return sign | (uint16_t)((rounded - 0x38000000) >> 13);
+}
 void vgltf_mat4_multiply(vgltf_mat4 out, vgltf_mat4 lhs, vgltf_mat4 rhs) {
   for (int i = 0; i < 4; ++i) {
     for (int j = 0; j < 4; ++j) {
@@ -101,3 +124,34 @@ void vgltf_mat4_perspective(vgltf_mat4 out, vgltf_mat_value_type fov_radians,
   out[14] = -(2.0f * far * near) / (far - near);
   out[15] = 0.0f;
 }
+
+static vgltf_plane plane_normalized(vgltf_vec_value_type a,
+                                    vgltf_vec_value_type b,
+                                    vgltf_vec_value_type c,
+                                    vgltf_vec_value_type d) {
+  vgltf_vec_value_type length = sqrtf(a * a + b * b + c * c);
+  return (vgltf_plane){.normal = {a / length, b / length, c / length},
+                       .distance = d / length};
+}
+void vgltf_frustum_from_matrix(vgltf_frustum *out, vgltf_mat4 matrix) {
+  // Matrices are laid out like the shaders expect them, element (row, column)
+  // lives at column * 4 + row
+#define ROW(r, c) matrix[(c) * 4 + (r)]
+  for (int sign_index = 0; sign_index < 2; sign_index++) {
+    vgltf_vec_value_type sign = sign_index == 0 ? 1.f : -1.f;
+    out->planes[VGLTF_FRUSTUM_PLANE_LEFT + sign_index] = plane_normalized(
+        ROW(3, 0) + sign * ROW(0, 0), ROW(3, 1) + sign * ROW(0, 1),
+        ROW(3, 2) + sign * ROW(0, 2), ROW(3, 3) + sign * ROW(0, 3));
+    out->planes[VGLTF_FRUSTUM_PLANE_BOTTOM + sign_index] = plane_normalized(
+        ROW(3, 0) + sign * ROW(1, 0), ROW(3, 1) + sign * ROW(1, 1),
+        ROW(3, 2) + sign * ROW(1, 2), ROW(3, 3) + sign * ROW(1, 3));
+  }
+
+  // Vulkan clip space depth is [0, w]
+  out->planes[VGLTF_FRUSTUM_PLANE_NEAR] =
+      plane_normalized(ROW(2, 0), ROW(2, 1), ROW(2, 2), ROW(2, 3));
+  out->planes[VGLTF_FRUSTUM_PLANE_FAR] =
+      plane_normalized(ROW(3, 0) - ROW(2, 0), ROW(3, 1) - ROW(2, 1),
+                       ROW(3, 2) - ROW(2, 2), ROW(3, 3) - ROW(2, 3));
+#undef ROW
+}
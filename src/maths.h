@@ -1,11 +1,14 @@
 #ifndef VGLTF_MATHS_H
 #define VGLTF_MATHS_H
 
+#include <stdint.h>
+
 typedef float vgltf_vec_value_type;
 
 constexpr double VGLTF_MATHS_PI = 3.14159265358979323846;
 #define VGLTF_MATHS_DEG_TO_RAD(deg) (deg * VGLTF_MATHS_PI / 180.0)
 #define VGLTF_MAX(x, y) ((x) > (y) ? (x) : (y))
+#define VGLTF_MIN(x, y) ((x) < (y) ? (x) : (y))
 
 typedef struct {
   vgltf_vec_value_type x;
@@ -24,6 +27,9 @@ vgltf_vec_value_type vgltf_vec3_dot(vgltf_vec3 lhs, vgltf_vec3 rhs);
 vgltf_vec_value_type vgltf_vec3_length(vgltf_vec3 vec);
 vgltf_vec3 vgltf_vec3_normalized(vgltf_vec3 vec);
 
+// IEEE 754 half precision bits of the value, rounded to the nearest
+uint16_t vgltf_float_to_half(float value);
+
 typedef vgltf_vec_value_type vgltf_mat_value_type;
 
 // row major
@@ -37,6 +43,27 @@ void vgltf_mat4_perspective(vgltf_mat4 out, vgltf_mat_value_type fov,
                           vgltf_mat_value_type aspect_ratio,
                           vgltf_mat_value_type near, vgltf_mat_value_type far);
 
+typedef struct {
+  vgltf_vec3 normal;
+  vgltf_vec_value_type distance;
+} vgltf_plane;
+
+enum vgltf_frustum_plane {
+  VGLTF_FRUSTUM_PLANE_LEFT,
+  VGLTF_FRUSTUM_PLANE_RIGHT,
+  VGLTF_FRUSTUM_PLANE_BOTTOM,
+  VGLTF_FRUSTUM_PLANE_TOP,
+  VGLTF_FRUSTUM_PLANE_NEAR,
+  VGLTF_FRUSTUM_PLANE_FAR,
+  VGLTF_FRUSTUM_PLANE_COUNT
+};
+typedef struct {
+  vgltf_plane planes[VGLTF_FRUSTUM_PLANE_COUNT];
+} vgltf_frustum;
+// Extracts the normalized frustum planes of a projection * view (* model)
+// matrix, plane normals point inside the frustum
+void vgltf_frustum_from_matrix(vgltf_frustum *out, vgltf_mat4 matrix);
+
 // clang-format off
 #define VGLTF_MAT4_IDENTITY { \
   1, 0, 0, 0, \
@@ -0,0 +1,340 @@
+#include "meshlet.h"
+#include "log.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+static constexpr uint32_t MAX_CORNER_COUNT =
+    3 * VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT;
+// At most three quarters full
+static constexpr uint32_t MAX_HASH_CAPACITY = 1 << 16;
+static_assert(4 * MAX_CORNER_COUNT <= 3 * MAX_HASH_CAPACITY,
+              "The vertex hash table must fit every corner");
+static constexpr uint32_t EMPTY_HASH_KEY = UINT32_MAX;
+static constexpr uint32_t NO_TRIANGLE = UINT32_MAX;
+// Below this, the normals of a meshlet spread over more than a half space, and
+// its cone never culls it
+static constexpr float MIN_CONE_COSINE = 0.1f;
+
+bool vgltf_meshlet_builder_init(struct vgltf_meshlet_builder *builder,
+                                struct vgltf_allocator *allocator) {
+  assert(builder);
+  assert(allocator);
+  size_t hash_size = MAX_HASH_CAPACITY * sizeof(uint32_t);
+  size_t corner_size = MAX_CORNER_COUNT * sizeof(uint32_t);
+  builder->memory = vgltf_allocator_allocate(
+      allocator, 2 * hash_size + 7 * corner_size +
+                     VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT * sizeof(bool));
+  if (!builder->memory) {
+    VGLTF_LOG_ERR("Couldn't allocate the meshlet builder memory");
+    return false;
+  }
+
+  char *memory = builder->memory;
+  builder->hash_keys = (uint32_t *)memory;
+  memory += hash_size;
+  builder->hash_values = (uint32_t *)memory;
+  memory += hash_size;
+  builder->corners = (uint32_t *)memory;
+  memory += corner_size;
+  builder->adjacency = (uint32_t *)memory;
+  memory += corner_size;
+  builder->stamps = (uint32_t *)memory;
+  memory += corner_size;
+  builder->reordered_indices = (uint32_t *)memory;
+  memory += corner_size;
+  builder->adjacency_offsets = (uint32_t *)memory;
+  memory += corner_size;
+  builder->live_triangle_counts = (uint32_t *)memory;
+  memory += corner_size;
+  builder->emitted = (bool *)memory;
+  return true;
+}
+
+void vgltf_meshlet_builder_deinit(struct vgltf_meshlet_builder *builder,
+                                  struct vgltf_allocator *allocator) {
+  assert(builder);
+  assert(allocator);
+  vgltf_allocator_free(allocator, builder->memory);
+}
+
+// Numbers the vertices of the triangles from 0 in order of appearance
+static uint32_t number_vertices(struct vgltf_meshlet_builder *builder,
+                                const uint32_t *indices,
+                                uint32_t index_count) {
+  uint32_t hash_bit_count = 1;
+  while (3u << hash_bit_count < 4 * index_count) {
+    hash_bit_count++;
+  }
+  uint32_t hash_capacity = 1u << hash_bit_count;
+  memset(builder->hash_keys, 0xff, hash_capacity * sizeof(uint32_t));
+
+  uint32_t mask = hash_capacity - 1;
+  uint32_t vertex_count = 0;
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    uint32_t index = indices[corner];
+    // Fibonacci hashing, the high bits of the product are the best mixed
+    uint32_t slot = (index * 2654435761u) >> (32 - hash_bit_count);
+    while (builder->hash_keys[slot] != EMPTY_HASH_KEY &&
+           builder->hash_keys[slot] != index) {
+      slot = (slot + 1) & mask;
+    }
+    if (builder->hash_keys[slot] == EMPTY_HASH_KEY) {
+      builder->hash_keys[slot] = index;
+      builder->hash_values[slot] = vertex_count++;
+    }
+    builder->corners[corner] = builder->hash_values[slot];
+  }
+  return vertex_count;
+}
+
+// Triangles of each vertex. The triangles of vertex v that aren't emitted
+// yet are adjacency[adjacency_offsets[v]..adjacency_offsets[v] +
+// live_triangle_counts[v]].
+static void build_adjacency(struct vgltf_meshlet_builder *builder,
+                            uint32_t index_count, uint32_t vertex_count) {
+  uint32_t *offsets = builder->adjacency_offsets;
+  uint32_t *counts = builder->live_triangle_counts;
+  memset(counts, 0, vertex_count * sizeof(uint32_t));
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    counts[builder->corners[corner]]++;
+  }
+  uint32_t offset = 0;
+  for (uint32_t vertex = 0; vertex < vertex_count; vertex++) {
+    offsets[vertex] = offset;
+    offset += counts[vertex];
+  }
+  memset(counts, 0, vertex_count * sizeof(uint32_t));
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    uint32_t vertex = builder->corners[corner];
+    builder->adjacency[offsets[vertex] + counts[vertex]++] = corner / 3;
+  }
+}
+
+// Swaps the triangle with the last live triangle of each of its vertices, so
+// that neighbours are only searched among the triangles left
+static void remove_adjacency(struct vgltf_meshlet_builder *builder,
+                             uint32_t triangle) {
+  for (int corner = 0; corner < 3; corner++) {
+    uint32_t vertex = builder->corners[triangle * 3 + corner];
+    uint32_t *triangles =
+        &builder->adjacency[builder->adjacency_offsets[vertex]];
+    uint32_t last = --builder->live_triangle_counts[vertex];
+    for (uint32_t i = 0; i < last; i++) {
+      if (triangles[i] == triangle) {
+        triangles[i] = triangles[last];
+        triangles[last] = triangle;
+        break;
+      }
+    }
+  }
+}
+
+// Vertices of the triangle that aren't in the meshlet stamped with stamp,
+// repeated corners of degenerate triangles count once
+static uint32_t new_vertex_count(const struct vgltf_meshlet_builder *builder,
+                                 uint32_t triangle, uint32_t stamp) {
+  const uint32_t *corners = &builder->corners[triangle * 3];
+  uint32_t count = builder->stamps[corners[0]] != stamp;
+  count += builder->stamps[corners[1]] != stamp && corners[1] != corners[0];
+  count += builder->stamps[corners[2]] != stamp && corners[2] != corners[0] &&
+           corners[2] != corners[1];
+  return count;
+}
+
+// Triangle not emitted yet, using one of the vertices, that adds the fewest
+// vertices to the meshlet, NO_TRIANGLE if there's none. Ties go to the
+// triangle whose vertices have the fewest triangles left, which finishes
+// vertices instead of leaving them to be duplicated in another meshlet.
+static uint32_t find_neighbor_triangle(
+    const struct vgltf_meshlet_builder *builder, const uint32_t *vertices,
+    uint32_t vertex_count, uint32_t stamp, uint32_t *best_new_vertex_count) {
+  uint32_t best_triangle = NO_TRIANGLE;
+  uint32_t best_live_count = UINT32_MAX;
+  *best_new_vertex_count = 4;
+  for (uint32_t vertex_index = 0; vertex_index < vertex_count;
+       vertex_index++) {
+    uint32_t vertex = vertices[vertex_index];
+    const uint32_t *triangles =
+        &builder->adjacency[builder->adjacency_offsets[vertex]];
+    for (uint32_t i = 0; i < builder->live_triangle_counts[vertex]; i++) {
+      uint32_t triangle = triangles[i];
+      uint32_t count = new_vertex_count(builder, triangle, stamp);
+      if (count > *best_new_vertex_count) {
+        continue;
+      }
+      const uint32_t *corners = &builder->corners[triangle * 3];
+      uint32_t live_count = builder->live_triangle_counts[corners[0]] +
+                            builder->live_triangle_counts[corners[1]] +
+                            builder->live_triangle_counts[corners[2]];
+      if (count < *best_new_vertex_count || live_count < best_live_count) {
+        best_triangle = triangle;
+        best_live_count = live_count;
+        *best_new_vertex_count = count;
+      }
+    }
+  }
+  return best_triangle;
+}
+
+uint32_t vgltf_meshlet_build(struct vgltf_meshlet_builder *builder,
+                             uint32_t *indices, uint32_t index_count,
+                             struct vgltf_meshlet *meshlets) {
+  assert(builder);
+  assert(indices || index_count == 0);
+  assert(index_count % 3 == 0);
+  assert(index_count <= MAX_CORNER_COUNT);
+  uint32_t triangle_count = index_count / 3;
+  uint32_t vertex_count = number_vertices(builder, indices, index_count);
+  build_adjacency(builder, index_count, vertex_count);
+  memset(builder->stamps, 0, vertex_count * sizeof(uint32_t));
+  memset(builder->emitted, 0, triangle_count * sizeof(bool));
+
+  uint32_t meshlet_count = 0;
+  uint32_t meshlet_vertices[VGLTF_MESHLET_MAX_VERTEX_COUNT];
+  uint32_t meshlet_vertex_count = 0;
+  uint32_t meshlet_triangle_count = 0;
+  uint32_t meshlet_first_triangle = 0;
+  // Vertices of the current meshlet are stamped with its number plus one
+  uint32_t stamp = 1;
+  uint32_t next_unemitted_triangle = 0;
+  for (uint32_t emitted_count = 0; emitted_count < triangle_count;
+       emitted_count++) {
+    uint32_t added_vertex_count = 0;
+    uint32_t triangle =
+        find_neighbor_triangle(builder, meshlet_vertices, meshlet_vertex_count,
+                               stamp, &added_vertex_count);
+    if (triangle == NO_TRIANGLE) {
+      while (builder->emitted[next_unemitted_triangle]) {
+        next_unemitted_triangle++;
+      }
+      triangle = next_unemitted_triangle;
+      added_vertex_count = new_vertex_count(builder, triangle, stamp);
+    }
+
+    if (meshlet_vertex_count + added_vertex_count >
+            VGLTF_MESHLET_MAX_VERTEX_COUNT ||
+        meshlet_triangle_count == VGLTF_MESHLET_MAX_TRIANGLE_COUNT) {
+      meshlets[meshlet_count++] = (struct vgltf_meshlet){
+          .first_index = meshlet_first_triangle * 3,
+          .triangle_count = meshlet_triangle_count};
+      meshlet_first_triangle += meshlet_triangle_count;
+      meshlet_vertex_count = 0;
+      meshlet_triangle_count = 0;
+      stamp++;
+    }
+
+    uint32_t *reordered_triangle =
+        &builder->reordered_indices[(meshlet_first_triangle +
+                                     meshlet_triangle_count) *
+                                    3];
+    for (int corner = 0; corner < 3; corner++) {
+      uint32_t vertex = builder->corners[triangle * 3 + corner];
+      if (builder->stamps[vertex] != stamp) {
+        builder->stamps[vertex] = stamp;
+        meshlet_vertices[meshlet_vertex_count++] = vertex;
+      }
+      reordered_triangle[corner] = indices[triangle * 3 + corner];
+    }
+    builder->emitted[triangle] = true;
+    remove_adjacency(builder, triangle);
+    meshlet_triangle_count++;
+  }
+
+  if (meshlet_triangle_count > 0) {
+    meshlets[meshlet_count++] =
+        (struct vgltf_meshlet){.first_index = meshlet_first_triangle * 3,
+                               .triangle_count = meshlet_triangle_count};
+  }
+  assert(meshlet_count <=
+         triangle_count / VGLTF_MESHLET_MIN_CLOSED_TRIANGLE_COUNT + 1);
+  memcpy(indices, builder->reordered_indices, index_count * sizeof(uint32_t));
+  return meshlet_count;
+}
+
+struct vgltf_meshlet_bounds
+vgltf_meshlet_compute_bounds(const vgltf_vec3 *corners,
+                             uint32_t triangle_count) {
+  struct vgltf_meshlet_bounds bounds = {.cone_cutoff = 1.f};
+  if (triangle_count == 0) {
+    return bounds;
+  }
+
+  // The sphere is centered on the bounding box of the corners
+  uint32_t corner_count = triangle_count * 3;
+  vgltf_vec3 min = corners[0];
+  vgltf_vec3 max = corners[0];
+  for (uint32_t corner = 1; corner < corner_count; corner++) {
+    min = (vgltf_vec3){fminf(min.x, corners[corner].x),
+                       fminf(min.y, corners[corner].y),
+                       fminf(min.z, corners[corner].z)};
+    max = (vgltf_vec3){fmaxf(max.x, corners[corner].x),
+                       fmaxf(max.y, corners[corner].y),
+                       fmaxf(max.z, corners[corner].z)};
+  }
+  bounds.center = (vgltf_vec3){(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f,
+                               (min.z + max.z) * 0.5f};
+  for (uint32_t corner = 0; corner < corner_count; corner++) {
+    vgltf_vec3 offset = vgltf_vec3_sub(corners[corner], bounds.center);
+    bounds.radius = fmaxf(bounds.radius, vgltf_vec3_length(offset));
+  }
+
+  // The axis is the center of the bounding box of the unit normals,
+  // degenerate triangles have no normal and face every direction
+  vgltf_vec3 normal_min = {1.f, 1.f, 1.f};
+  vgltf_vec3 normal_max = {-1.f, -1.f, -1.f};
+  for (uint32_t triangle = 0; triangle < triangle_count; triangle++) {
+    const vgltf_vec3 *p = &corners[triangle * 3];
+    vgltf_vec3 normal = vgltf_vec3_cross(vgltf_vec3_sub(p[1], p[0]),
+                                         vgltf_vec3_sub(p[2], p[0]));
+    if (vgltf_vec3_length(normal) == 0.f) {
+      return bounds;
+    }
+    normal = vgltf_vec3_normalized(normal);
+    normal_min = (vgltf_vec3){fminf(normal_min.x, normal.x),
+                              fminf(normal_min.y, normal.y),
+                              fminf(normal_min.z, normal.z)};
+    normal_max = (vgltf_vec3){fmaxf(normal_max.x, normal.x),
+                              fmaxf(normal_max.y, normal.y),
+                              fmaxf(normal_max.z, normal.z)};
+  }
+  vgltf_vec3 axis = {(normal_min.x + normal_max.x) * 0.5f,
+                     (normal_min.y + normal_max.y) * 0.5f,
+                     (normal_min.z + normal_max.z) * 0.5f};
+  if (vgltf_vec3_length(axis) == 0.f) {
+    return bounds;
+  }
+  axis = vgltf_vec3_normalized(axis);
+
+  float min_cosine = 1.f;
+  for (uint32_t triangle = 0; triangle < triangle_count; triangle++) {
+    const vgltf_vec3 *p = &corners[triangle * 3];
+    vgltf_vec3 normal = vgltf_vec3_normalized(vgltf_vec3_cross(
+        vgltf_vec3_sub(p[1], p[0]), vgltf_vec3_sub(p[2], p[0])));
+    min_cosine = fminf(min_cosine, vgltf_vec3_dot(normal, axis));
+  }
+  if (min_cosine <= MIN_CONE_COSINE) {
+    return bounds;
+  }
+
+  // The apex is moved back along the axis until it's behind the plane of
+  // every triangle, so the test holds for points close to the meshlet
+  float apex_distance = 0.f;
+  for (uint32_t triangle = 0; triangle < triangle_count; triangle++) {
+    const vgltf_vec3 *p = &corners[triangle * 3];
+    vgltf_vec3 normal = vgltf_vec3_normalized(vgltf_vec3_cross(
+        vgltf_vec3_sub(p[1], p[0]), vgltf_vec3_sub(p[2], p[0])));
+    float distance =
+        vgltf_vec3_dot(vgltf_vec3_sub(bounds.center, p[0]), normal) /
+        vgltf_vec3_dot(axis, normal);
+    apex_distance = fmaxf(apex_distance, distance);
+  }
+  bounds.cone_apex = (vgltf_vec3){bounds.center.x - axis.x * apex_distance,
+                                  bounds.center.y - axis.y * apex_distance,
+                                  bounds.center.z - axis.z * apex_distance};
+  bounds.cone_axis = axis;
+  // The normals are within acos(min_cosine) of the axis, the directions that
+  // see them all from behind are within 90 degrees minus that of the axis
+  bounds.cone_cutoff = sqrtf(1.f - min_cosine * min_cosine);
+  return bounds;
+}
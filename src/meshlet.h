@@ -0,0 +1,76 @@
+#ifndef VGLTF_MESHLET_H
+#define VGLTF_MESHLET_H
+
+#include "alloc.h"
+#include "maths.h"
+#include <stdint.h>
+
+// Meshlets are small clusters of neighbouring triangles, culled one by one
+
+constexpr uint32_t VGLTF_MESHLET_MAX_VERTEX_COUNT = 64;
+constexpr uint32_t VGLTF_MESHLET_MAX_TRIANGLE_COUNT = 124;
+// Most triangles a single vgltf_meshlet_build call splits, larger meshes are
+// split in several calls
+constexpr uint32_t VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT = 1 << 14;
+// A meshlet is only closed before the triangle limit when the next triangle
+// would take it past the vertex limit, so it has at least MAX_VERTEX_COUNT - 2
+// vertices, and at least a third as many triangles, rounded up
+constexpr uint32_t VGLTF_MESHLET_MIN_CLOSED_TRIANGLE_COUNT =
+    (VGLTF_MESHLET_MAX_VERTEX_COUNT - 2 + 2) / 3;
+// Most meshlets a single vgltf_meshlet_build call makes
+constexpr uint32_t VGLTF_MESHLET_BUILD_MAX_MESHLET_COUNT =
+    VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT /
+        VGLTF_MESHLET_MIN_CLOSED_TRIANGLE_COUNT +
+    1;
+
+// A range of the reordered indices
+struct vgltf_meshlet {
+  uint32_t first_index;
+  uint32_t triangle_count;
+};
+
+// The triangles of a meshlet are all back facing when seen from any point p
+// with dot(normalize(cone_apex - p), cone_axis) > cone_cutoff. Meshlets whose
+// normals spread too much have a cutoff of 1, they always pass.
+struct vgltf_meshlet_bounds {
+  vgltf_vec3 center;
+  vgltf_vec_value_type radius;
+  vgltf_vec3 cone_apex;
+  vgltf_vec3 cone_axis;
+  vgltf_vec_value_type cone_cutoff;
+};
+
+// Scratch memory of the builder, sized for the largest call
+struct vgltf_meshlet_builder {
+  char *memory;
+  uint32_t *hash_keys;
+  uint32_t *hash_values;
+  uint32_t *corners;
+  uint32_t *adjacency_offsets;
+  uint32_t *adjacency;
+  uint32_t *live_triangle_counts;
+  uint32_t *stamps;
+  uint32_t *reordered_indices;
+  bool *emitted;
+};
+
+bool vgltf_meshlet_builder_init(struct vgltf_meshlet_builder *builder,
+                                struct vgltf_allocator *allocator);
+void vgltf_meshlet_builder_deinit(struct vgltf_meshlet_builder *builder,
+                                  struct vgltf_allocator *allocator);
+
+// Greedily grows meshlets with the triangles sharing the most vertices with
+// them, and falls back to the index order when none is left. The
+// triangles are reordered in place so that each meshlet is a contiguous range
+// of indices, the winding of each triangle is kept. Returns the meshlet count.
+uint32_t vgltf_meshlet_build(struct vgltf_meshlet_builder *builder,
+                             uint32_t *indices, uint32_t index_count,
+                             struct vgltf_meshlet *meshlets);
+
+// Bounding sphere and normal cone of triangles given by their corner
+// positions, counter clockwise triangles face their normal
+struct vgltf_meshlet_bounds
+vgltf_meshlet_compute_bounds(const vgltf_vec3 *corners,
+                             uint32_t triangle_count);
+
+#endif // VGLTF_MESHLET_H
@@ -0,0 +1,545 @@
+#include "meshopt.h"
+#include "log.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static constexpr unsigned char VERTEX_HEADER = 0xa0;
+static constexpr unsigned char TRIANGLES_HEADER = 0xe0;
+static constexpr unsigned char INDICES_HEADER = 0xd0;
+static constexpr unsigned char MAX_INDEX_VERSION = 1;
+
+// Attribute bytes are encoded in groups of 16 values, in blocks of up to 8KB
+// and 256 vertices
+static constexpr uint32_t GROUP_SIZE = 16;
+static constexpr uint32_t BLOCK_SIZE = 8192;
+static constexpr uint32_t MAX_BLOCK_VERTEX_COUNT = 256;
+static constexpr uint32_t MAX_VERTEX_SIZE = 256;
+// Most bytes a group reads, 8 of 4 bits values and 16 literals. The stream
+// ends with a tail at least that long, so groups are checked once.
+static constexpr size_t GROUP_DECODE_LIMIT = 24;
+static constexpr size_t MIN_TAIL_SIZE = 32;
+
+// Decodes 16 values of 2 or 4 bits, most significant first. The all ones
+// value escapes to the next literal byte stored after the packed values.
+#if defined(__SSSE3__)
+static const unsigned char *decode_packed_group(const unsigned char *data,
+                                                unsigned char *values,
+                                                int bits) {
+  __m128i low_nibble_mask = _mm_set1_epi8(0x0f);
+  __m128i packed = _mm_loadl_epi64((const __m128i *)data);
+  __m128i unpacked = _mm_unpacklo_epi8(
+      _mm_and_si128(_mm_srli_epi16(packed, 4), low_nibble_mask),
+      _mm_and_si128(packed, low_nibble_mask));
+  if (bits == 2) {
+    __m128i low_pair_mask = _mm_set1_epi8(0x03);
+    unpacked = _mm_unpacklo_epi8(
+        _mm_and_si128(_mm_srli_epi16(unpacked, 2), low_pair_mask),
+        _mm_and_si128(unpacked, low_pair_mask));
+  }
+
+  // Escaped values gather their literal by rank, the inclusive prefix count
+  // of escapes minus one. Shuffle indices with the high bit set give 0.
+  __m128i escapes =
+      _mm_cmpeq_epi8(unpacked, _mm_set1_epi8((char)((1 << bits) - 1)));
+  __m128i ranks = _mm_and_si128(escapes, _mm_set1_epi8(1));
+  ranks = _mm_add_epi8(ranks, _mm_slli_si128(ranks, 1));
+  ranks = _mm_add_epi8(ranks, _mm_slli_si128(ranks, 2));
+  ranks = _mm_add_epi8(ranks, _mm_slli_si128(ranks, 4));
+  ranks = _mm_add_epi8(ranks, _mm_slli_si128(ranks, 8));
+  __m128i shuffle =
+      _mm_or_si128(_mm_sub_epi8(ranks, _mm_set1_epi8(1)),
+                   _mm_andnot_si128(escapes, _mm_set1_epi8((char)0x80)));
+
+  const unsigned char *literals = data + GROUP_SIZE * bits / 8;
+  __m128i gathered = _mm_shuffle_epi8(
+      _mm_loadu_si128((const __m128i *)literals), shuffle);
+  _mm_storeu_si128((__m128i *)values,
+                   _mm_or_si128(_mm_andnot_si128(escapes, unpacked), gathered));
+  return literals + __builtin_popcount(_mm_movemask_epi8(escapes));
+}
+#else
+static const unsigned char *decode_packed_group(const unsigned char *data,
+                                                unsigned char *values,
+                                                int bits) {
+  const unsigned char *literals = data + GROUP_SIZE * bits / 8;
+  unsigned char escape = (1 << bits) - 1;
+  for (uint32_t value_index = 0; value_index < GROUP_SIZE; value_index++) {
+    uint32_t bit_offset = value_index * bits;
+    unsigned char value =
+        (data[bit_offset / 8] >> (8 - bits - bit_offset % 8)) & escape;
+    values[value_index] = value == escape ? *literals++ : value;
+  }
+  return literals;
+}
+#endif
+
+// Decodes value_count bytes, a multiple of the group size. A 2 bits header
+// per group tells whether its values are zeros, 2 bits, 4 bits or raw bytes.
+static const unsigned char *decode_bytes(const unsigned char *data,
+                                         const unsigned char *data_end,
+                                         unsigned char *values,
+                                         uint32_t value_count) {
+  uint32_t group_count = value_count / GROUP_SIZE;
+  size_t header_size = (group_count + 3) / 4;
+  if ((size_t)(data_end - data) < header_size) {
+    return nullptr;
+  }
+  const unsigned char *header = data;
+  data += header_size;
+
+  for (uint32_t group = 0; group < group_count; group++) {
+    if ((size_t)(data_end - data) < GROUP_DECODE_LIMIT) {
+      return nullptr;
+    }
+    unsigned char *group_values = values + group * GROUP_SIZE;
+    switch ((header[group / 4] >> (group % 4 * 2)) & 3) {
+    case 0:
+      memset(group_values, 0, GROUP_SIZE);
+      break;
+    case 1:
+      data = decode_packed_group(data, group_values, 2);
+      break;
+    case 2:
+      data = decode_packed_group(data, group_values, 4);
+      break;
+    default:
+      memcpy(group_values, data, GROUP_SIZE);
+      data += GROUP_SIZE;
+      break;
+    }
+  }
+  return data;
+}
+
+// Decoded bytes are zigzag encoded deltas to the same byte of the previous
+// vertex. Four byte streams are summed and interleaved into vertices[0, 4) at
+// once, previous holds the bytes of the vertex before the first one.
+static void accumulate_deltas(
+    unsigned char deltas[4][MAX_BLOCK_VERTEX_COUNT], unsigned char *vertices,
+    uint32_t vertex_count, uint32_t vertex_size,
+    const unsigned char previous[4]) {
+#if defined(__SSE2__)
+  __m128i ones = _mm_set1_epi8(1);
+  __m128i high_bits_mask = _mm_set1_epi8(0x7f);
+  __m128i sums[4];
+  for (int stream = 0; stream < 4; stream++) {
+    sums[stream] = _mm_set1_epi8((char)previous[stream]);
+  }
+
+  for (uint32_t first_vertex = 0; first_vertex < vertex_count;
+       first_vertex += GROUP_SIZE) {
+    __m128i bytes[4];
+    for (int stream = 0; stream < 4; stream++) {
+      __m128i v =
+          _mm_loadu_si128((const __m128i *)&deltas[stream][first_vertex]);
+      v = _mm_xor_si128(
+          _mm_and_si128(_mm_srli_epi16(v, 1), high_bits_mask),
+          _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, ones)));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+      bytes[stream] = _mm_add_epi8(v, sums[stream]);
+      // The last byte carries over to the next group
+      __m128i last = _mm_unpackhi_epi8(bytes[stream], bytes[stream]);
+      last = _mm_unpackhi_epi16(last, last);
+      sums[stream] = _mm_shuffle_epi32(last, 0xff);
+    }
+
+    __m128i low_01 = _mm_unpacklo_epi8(bytes[0], bytes[1]);
+    __m128i high_01 = _mm_unpackhi_epi8(bytes[0], bytes[1]);
+    __m128i low_23 = _mm_unpacklo_epi8(bytes[2], bytes[3]);
+    __m128i high_23 = _mm_unpackhi_epi8(bytes[2], bytes[3]);
+    uint32_t words[GROUP_SIZE];
+    _mm_storeu_si128((__m128i *)&words[0], _mm_unpacklo_epi16(low_01, low_23));
+    _mm_storeu_si128((__m128i *)&words[4], _mm_unpackhi_epi16(low_01, low_23));
+    _mm_storeu_si128((__m128i *)&words[8],
+                     _mm_unpacklo_epi16(high_01, high_23));
+    _mm_storeu_si128((__m128i *)&words[12],
+                     _mm_unpackhi_epi16(high_01, high_23));
+    uint32_t group_vertex_count = vertex_count - first_vertex < GROUP_SIZE
+                                      ? vertex_count - first_vertex
+                                      : GROUP_SIZE;
+    for (uint32_t i = 0; i < group_vertex_count; i++) {
+      memcpy(vertices + (size_t)(first_vertex + i) * vertex_size, &words[i],
+             sizeof(uint32_t));
+    }
+  }
+#else
+  for (int stream = 0; stream < 4; stream++) {
+    unsigned char sum = previous[stream];
+    for (uint32_t i = 0; i < vertex_count; i++) {
+      unsigned char delta = deltas[stream][i];
+      sum += (delta >> 1) ^ -(delta & 1);
+      vertices[(size_t)i * vertex_size + stream] = sum;
+    }
+  }
+#endif
+}
+
+// Vertex sizes are multiples of 4, so byte streams go 4 at a time
+static const unsigned char *
+decode_vertex_block(const unsigned char *data, const unsigned char *data_end,
+                    unsigned char *vertices, uint32_t vertex_count,
+                    uint32_t vertex_size,
+                    unsigned char previous_vertex[MAX_VERTEX_SIZE]) {
+  unsigned char deltas[4][MAX_BLOCK_VERTEX_COUNT];
+  uint32_t aligned_vertex_count =
+      (vertex_count + GROUP_SIZE - 1) & ~(GROUP_SIZE - 1);
+  for (uint32_t byte = 0; byte < vertex_size; byte += 4) {
+    for (int stream = 0; stream < 4; stream++) {
+      data = decode_bytes(data, data_end, deltas[stream], aligned_vertex_count);
+      if (!data) {
+        return nullptr;
+      }
+    }
+    accumulate_deltas(deltas, vertices + byte, vertex_count, vertex_size,
+                      previous_vertex + byte);
+  }
+  memcpy(previous_vertex, vertices + (size_t)(vertex_count - 1) * vertex_size,
+         vertex_size);
+  return data;
+}
+
+static bool decode_vertices(unsigned char *vertices, uint32_t vertex_count,
+                            uint32_t vertex_size, const unsigned char *data,
+                            size_t data_size) {
+  assert(vertex_size > 0 && vertex_size <= MAX_VERTEX_SIZE &&
+         vertex_size % 4 == 0);
+  // Only version 0 is allowed by EXT_meshopt_compression
+  if (data_size < 1 + vertex_size || data[0] != VERTEX_HEADER) {
+    return false;
+  }
+  const unsigned char *data_end = data + data_size;
+  data++;
+
+  // The first vertex is predicted from the last bytes of the stream
+  unsigned char previous_vertex[MAX_VERTEX_SIZE];
+  memcpy(previous_vertex, data_end - vertex_size, vertex_size);
+  uint32_t block_vertex_count = (BLOCK_SIZE / vertex_size) & ~(GROUP_SIZE - 1);
+  if (block_vertex_count > MAX_BLOCK_VERTEX_COUNT) {
+    block_vertex_count = MAX_BLOCK_VERTEX_COUNT;
+  }
+  for (uint32_t first_vertex = 0; first_vertex < vertex_count;
+       first_vertex += block_vertex_count) {
+    uint32_t count = vertex_count - first_vertex < block_vertex_count
+                         ? vertex_count - first_vertex
+                         : block_vertex_count;
+    data = decode_vertex_block(data, data_end,
+                               vertices + (size_t)first_vertex * vertex_size,
+                               count, vertex_size, previous_vertex);
+    if (!data) {
+      return false;
+    }
+  }
+
+  size_t tail_size = vertex_size > MIN_TAIL_SIZE ? vertex_size : MIN_TAIL_SIZE;
+  return (size_t)(data_end - data) == tail_size;
+}
+
+static void write_index(void *indices, uint32_t index_size, size_t position,
+                        uint32_t index) {
+  if (index_size == 2) {
+    ((uint16_t *)indices)[position] = (uint16_t)index;
+  } else {
+    ((uint32_t *)indices)[position] = index;
+  }
+}
+
+// LEB128 like, at most 5 bytes
+static uint32_t decode_varint(const unsigned char **data) {
+  unsigned char lead = *(*data)++;
+  if (lead < 128) {
+    return lead;
+  }
+  uint32_t value = lead & 127;
+  for (int shift = 7; shift < 35; shift += 7) {
+    unsigned char group = *(*data)++;
+    value |= (uint32_t)(group & 127) << shift;
+    if (group < 128) {
+      break;
+    }
+  }
+  return value;
+}
+
+static uint32_t decode_index_delta(const unsigned char **data,
+                                   uint32_t last_index) {
+  uint32_t value = decode_varint(data);
+  return last_index + ((value >> 1) ^ -(value & 1));
+}
+
+struct triangle_fifos {
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  uint32_t edge_offset;
+  uint32_t vertex_offset;
+};
+
+static void push_edge(struct triangle_fifos *fifos, uint32_t a, uint32_t b) {
+  fifos->edges[fifos->edge_offset][0] = a;
+  fifos->edges[fifos->edge_offset][1] = b;
+  fifos->edge_offset = (fifos->edge_offset + 1) & 15;
+}
+
+// Only vertices that are new or explicitly encoded enter the FIFO
+static void push_vertex(struct triangle_fifos *fifos, uint32_t vertex,
+                        bool push) {
+  fifos->vertices[fifos->vertex_offset] = vertex;
+  fifos->vertex_offset = (fifos->vertex_offset + push) & 15;
+}
+
+// Every triangle has a code byte. Below 0xf0 it reuses a recent edge and takes
+// its third vertex from the vertex FIFO, as the next new vertex or explicitly.
+// Above, its three vertices are new, cached or explicit, as told by the
+// auxiliary code read from the table ending the stream or from the data.
+static bool decode_triangles(void *indices, uint32_t index_count,
+                             uint32_t index_size, const unsigned char *data,
+                             size_t data_size) {
+  assert(index_count % 3 == 0);
+  assert(index_size == 2 || index_size == 4);
+  uint32_t triangle_count = index_count / 3;
+  if (data_size < 1 + (size_t)triangle_count + 16 ||
+      (data[0] & 0xf0) != TRIANGLES_HEADER ||
+      (data[0] & 0x0f) > MAX_INDEX_VERSION) {
+    return false;
+  }
+  // Version 1 spends third vertex codes 13 and 14 on the last explicit
+  // index minus and plus one
+  int max_cached_third_vertex = (data[0] & 0x0f) >= 1 ? 13 : 15;
+
+  struct triangle_fifos fifos;
+  memset(&fifos, 0xff, sizeof(fifos));
+  fifos.edge_offset = 0;
+  fifos.vertex_offset = 0;
+  uint32_t next_vertex = 0;
+  uint32_t last_index = 0;
+
+  const unsigned char *codes = data + 1;
+  const unsigned char *extra = codes + triangle_count;
+  // A triangle reads at most 16 bytes, the size of the table
+  const unsigned char *extra_end = data + data_size - 16;
+  const unsigned char *aux_table = extra_end;
+  for (uint32_t triangle = 0; triangle < triangle_count; triangle++) {
+    if (extra > extra_end) {
+      return false;
+    }
+    unsigned char code = *codes++;
+    uint32_t a, b, c;
+    if (code < 0xf0) {
+      const uint32_t *edge =
+          fifos.edges[(fifos.edge_offset - 1 - (code >> 4)) & 15];
+      a = edge[0];
+      b = edge[1];
+      int third = code & 15;
+      if (third < max_cached_third_vertex) {
+        c = third == 0 ? next_vertex++
+                       : fifos.vertices[(fifos.vertex_offset - 1 - third) & 15];
+        push_vertex(&fifos, c, third == 0);
+      } else {
+        // 13 - (13 ^ 3) is -1, 14 - (14 ^ 3) is 1
+        c = last_index = third != 15 ? last_index + (third - (third ^ 3))
+                                     : decode_index_delta(&extra, last_index);
+        push_vertex(&fifos, c, true);
+      }
+      push_edge(&fifos, c, b);
+      push_edge(&fifos, a, c);
+    } else {
+      bool explicit_first = code == 0xff;
+      unsigned char aux = code < 0xfe ? aux_table[code & 15] : *extra++;
+      int second = aux >> 4;
+      int third = aux & 15;
+      // A zero auxiliary code out of the table restarts the vertex numbering
+      if (code >= 0xfe && aux == 0) {
+        next_vertex = 0;
+      }
+      // New vertices are numbered before the explicit ones are read
+      a = explicit_first ? 0 : next_vertex++;
+      b = second == 0 ? next_vertex++
+                      : fifos.vertices[(fifos.vertex_offset - second) & 15];
+      c = third == 0 ? next_vertex++
+                     : fifos.vertices[(fifos.vertex_offset - third) & 15];
+      if (explicit_first) {
+        a = last_index = decode_index_delta(&extra, last_index);
+      }
+      if (second == 15) {
+        b = last_index = decode_index_delta(&extra, last_index);
+      }
+      if (third == 15) {
+        c = last_index = decode_index_delta(&extra, last_index);
+      }
+      push_vertex(&fifos, a, true);
+      push_vertex(&fifos, b, second == 0 || second == 15);
+      push_vertex(&fifos, c, third == 0 || third == 15);
+      push_edge(&fifos, b, a);
+      push_edge(&fifos, c, b);
+      push_edge(&fifos, a, c);
+    }
+    write_index(indices, index_size, triangle * 3, a);
+    write_index(indices, index_size, triangle * 3 + 1, b);
+    write_index(indices, index_size, triangle * 3 + 2, c);
+  }
+  return extra == extra_end;
+}
+
+// Every index is a zigzag encoded delta to one of two baselines, picked by
+// its lowest bit
+static bool decode_indices(void *indices, uint32_t index_count,
+                           uint32_t index_size, const unsigned char *data,
+                           size_t data_size) {
+  assert(index_size == 2 || index_size == 4);
+  if (data_size < 1 + (size_t)index_count + 4 ||
+      (data[0] & 0xf0) != INDICES_HEADER ||
+      (data[0] & 0x0f) > MAX_INDEX_VERSION) {
+    return false;
+  }
+
+  // An index reads at most 5 bytes, the stream ends with 4 bytes of padding
+  const unsigned char *values = data + 1;
+  const unsigned char *values_end = data + data_size - 4;
+  uint32_t baselines[2] = {};
+  for (uint32_t index = 0; index < index_count; index++) {
+    if (values >= values_end) {
+      return false;
+    }
+    uint32_t value = decode_varint(&values);
+    uint32_t *baseline = &baselines[value & 1];
+    value >>= 1;
+    *baseline += (value >> 1) ^ -(value & 1);
+    write_index(indices, index_size, index, *baseline);
+  }
+  return values == values_end;
+}
+
+// Rounds half away from zero
+static int round_to_int(float value) {
+  return (int)(value + (value >= 0.f ? 0.5f : -0.5f));
+}
+
+// X and Y are the octahedral coordinates, Z holds the value of 1
+static void decode_octahedral_vector(float x, float y, float one,
+                                     float max_value, int decoded[3]) {
+  float z = one - fabsf(x) - fabsf(y);
+  // Vectors with a negative Z are folded over the diagonals
+  float fold = z >= 0.f ? 0.f : z;
+  x += x >= 0.f ? fold : -fold;
+  y += y >= 0.f ? fold : -fold;
+  float scale = max_value / sqrtf(x * x + y * y + z * z);
+  decoded[0] = round_to_int(x * scale);
+  decoded[1] = round_to_int(y * scale);
+  decoded[2] = round_to_int(z * scale);
+}
+
+static void filter_octahedral(void *data, uint32_t count,
+                              uint32_t byte_stride) {
+  assert(byte_stride == 4 || byte_stride == 8);
+  int decoded[3];
+  if (byte_stride == 4) {
+    int8_t *vectors = data;
+    for (uint32_t i = 0; i < count; i++) {
+      int8_t *v = &vectors[i * 4];
+      decode_octahedral_vector(v[0], v[1], v[2], INT8_MAX, decoded);
+      for (int component = 0; component < 3; component++) {
+        v[component] = (int8_t)decoded[component];
+      }
+    }
+  } else {
+    int16_t *vectors = data;
+    for (uint32_t i = 0; i < count; i++) {
+      int16_t *v = &vectors[i * 4];
+      decode_octahedral_vector(v[0], v[1], v[2], INT16_MAX, decoded);
+      for (int component = 0; component < 3; component++) {
+        v[component] = (int16_t)decoded[component];
+      }
+    }
+  }
+}
+
+// W holds the scale of the three stored components in its high bits and the
+// index of the dropped, largest, component in its 2 low bits
+static void filter_quaternion(void *data, uint32_t count,
+                              uint32_t byte_stride) {
+  assert(byte_stride == 8);
+  (void)byte_stride;
+  int16_t *quaternions = data;
+  for (uint32_t i = 0; i < count; i++) {
+    int16_t *q = &quaternions[i * 4];
+    float scale = 1.f / sqrtf(2.f) / (float)(q[3] | 3);
+    float x = q[0] * scale;
+    float y = q[1] * scale;
+    float z = q[2] * scale;
+    float ww = 1.f - x * x - y * y - z * z;
+    float w = sqrtf(ww >= 0.f ? ww : 0.f);
+
+    int dropped = q[3] & 3;
+    q[(dropped + 1) & 3] = (int16_t)round_to_int(x * INT16_MAX);
+    q[(dropped + 2) & 3] = (int16_t)round_to_int(y * INT16_MAX);
+    q[(dropped + 3) & 3] = (int16_t)round_to_int(z * INT16_MAX);
+    q[dropped] = (int16_t)(int)(w * INT16_MAX + 0.5f);
+  }
+}
+
+// Plain loop over the 32 bits words, vectorized by the compiler
+static void filter_exponential(void *data, uint32_t count,
+                               uint32_t byte_stride) {
+  assert(byte_stride % 4 == 0);
+  uint32_t *words = data;
+  size_t word_count = (size_t)count * (byte_stride / 4);
+  for (size_t i = 0; i < word_count; i++) {
+    int32_t mantissa = (int32_t)(words[i] << 8) >> 8;
+    int32_t exponent = (int32_t)words[i] >> 24;
+    // 2^exponent built from its bits, exponents stay in [-128, 127]
+    uint32_t power_bits = (uint32_t)(exponent + 127) << 23;
+    float power;
+    memcpy(&power, &power_bits, sizeof(power));
+    float value = power * (float)mantissa;
+    memcpy(&words[i], &value, sizeof(value));
+  }
+}
+
+bool vgltf_meshopt_decode(void *destination, uint32_t count,
+                          uint32_t byte_stride, enum vgltf_meshopt_mode mode,
+                          enum vgltf_meshopt_filter filter,
+                          const unsigned char *source, size_t source_size) {
+  assert(destination);
+  assert(source);
+  bool decoded = false;
+  switch (mode) {
+  case VGLTF_MESHOPT_MODE_ATTRIBUTES:
+    decoded = decode_vertices(destination, count, byte_stride, source,
+                              source_size);
+    break;
+  case VGLTF_MESHOPT_MODE_TRIANGLES:
+    decoded = decode_triangles(destination, count, byte_stride, source,
+                               source_size);
+    break;
+  case VGLTF_MESHOPT_MODE_INDICES:
+    decoded =
+        decode_indices(destination, count, byte_stride, source, source_size);
+    break;
+  }
+  if (!decoded) {
+    VGLTF_LOG_ERR("Malformed or unsupported meshopt stream");
+    return false;
+  }
+
+  switch (filter) {
+  case VGLTF_MESHOPT_FILTER_NONE:
+    break;
+  case VGLTF_MESHOPT_FILTER_OCTAHEDRAL:
+    filter_octahedral(destination, count, byte_stride);
+    break;
+  case VGLTF_MESHOPT_FILTER_QUATERNION:
+    filter_quaternion(destination, count, byte_stride);
+    break;
+  case VGLTF_MESHOPT_FILTER_EXPONENTIAL:
+    filter_exponential(destination, count, byte_stride);
+    break;
+  }
+  return true;
+}
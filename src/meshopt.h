@@ -0,0 +1,41 @@
+#ifndef VGLTF_MESHOPT_H
+#define VGLTF_MESHOPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoders of the meshoptimizer codecs, as stored by the glTF
+// EXT_meshopt_compression extension
+
+enum vgltf_meshopt_mode {
+  // Vertex attributes, delta encoded bytewise in blocks of vertices
+  VGLTF_MESHOPT_MODE_ATTRIBUTES,
+  // Triangle lists, encoded with edge and vertex FIFOs
+  VGLTF_MESHOPT_MODE_TRIANGLES,
+  // Any index sequence, delta encoded against two baselines
+  VGLTF_MESHOPT_MODE_INDICES,
+};
+
+// Applied in place to the decoded attributes
+enum vgltf_meshopt_filter {
+  VGLTF_MESHOPT_FILTER_NONE,
+  // Unit vectors, the normalized 8 or 16 bits XYZ are rebuilt from an
+  // octahedral encoding, W is kept
+  VGLTF_MESHOPT_FILTER_OCTAHEDRAL,
+  // Unit quaternions, 16 bits XYZW rebuilt from their three smallest
+  // components
+  VGLTF_MESHOPT_FILTER_QUATERNION,
+  // 32 bits floats rebuilt from a 24 bits mantissa and an 8 bits exponent
+  VGLTF_MESHOPT_FILTER_EXPONENTIAL,
+};
+
+// Decodes count elements of byte_stride bytes into destination and applies
+// the filter. Indices are 2 or 4 bytes, attributes a multiple of 4 bytes up to
+// 256. Returns false if the stream is malformed, the destination content is
+// unspecified then.
+bool vgltf_meshopt_decode(void *destination, uint32_t count,
+                          uint32_t byte_stride, enum vgltf_meshopt_mode mode,
+                          enum vgltf_meshopt_filter filter,
+                          const unsigned char *source, size_t source_size);
+
+#endif // VGLTF_MESHOPT_H
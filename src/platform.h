@@ -8,6 +8,7 @@
 #define VGLTF_PANIC(...)                                                         \
   do {                                                                         \
     VGLTF_LOG_ERR("PANIC " __VA_ARGS__);                                         \
+    vgltf_log_flush();                                                         \
     exit(1);                                                                   \
   } while (0)
 
@@ -74,7 +75,38 @@ bool vgltf_platform_poll_event(struct vgltf_platform *platform,
 bool vgltf_platform_get_window_size(struct vgltf_platform *platform,
                                   struct vgltf_window_size *window_size);
 bool vgltf_platform_get_current_time_nanoseconds(long *time);
+// Monotonic, only meaningful relative to other calls
+uint64_t vgltf_platform_get_ticks_nanoseconds(void);
+void vgltf_platform_sleep_milliseconds(uint32_t milliseconds);
 char *vgltf_platform_read_file_to_string(const char *filepath, size_t *out_size);
+void vgltf_platform_free_file_data(char *file_data);
+int vgltf_platform_get_cpu_count(void);
+
+struct vgltf_platform_thread;
+typedef int (*vgltf_platform_thread_function)(void *data);
+bool vgltf_platform_thread_create(struct vgltf_platform_thread *thread,
+                                  const char *name,
+                                  vgltf_platform_thread_function function,
+                                  void *data);
+void vgltf_platform_thread_join(struct vgltf_platform_thread *thread);
+
+struct vgltf_platform_mutex;
+bool vgltf_platform_mutex_init(struct vgltf_platform_mutex *mutex);
+void vgltf_platform_mutex_deinit(struct vgltf_platform_mutex *mutex);
+void vgltf_platform_mutex_lock(struct vgltf_platform_mutex *mutex);
+void vgltf_platform_mutex_unlock(struct vgltf_platform_mutex *mutex);
+
+struct vgltf_platform_condition;
+bool vgltf_platform_condition_init(struct vgltf_platform_condition *condition);
+void vgltf_platform_condition_deinit(
+    struct vgltf_platform_condition *condition);
+void vgltf_platform_condition_wait(struct vgltf_platform_condition *condition,
+                                   struct vgltf_platform_mutex *mutex);
+void vgltf_platform_condition_signal(
+    struct vgltf_platform_condition *condition);
+void vgltf_platform_condition_broadcast(
+    struct vgltf_platform_condition *condition);
+
 const char *const *
 vgltf_platform_get_vulkan_instance_extensions(struct vgltf_platform *platform,
                                             uint32_t *count);
@@ -3,6 +3,7 @@
 #include "platform.h"
 
 bool vgltf_platform_init(struct vgltf_platform *platform) {
+  VGLTF_TRACE_ZONE(__func__);
   VGLTF_LOG_INFO("Initializing SDL platform...");
 
   if (!SDL_Init(SDL_INIT_VIDEO)) {
@@ -82,6 +83,14 @@ err:
   return false;
 }
 
+uint64_t vgltf_platform_get_ticks_nanoseconds(void) {
+  return SDL_GetTicksNS();
+}
+
+void vgltf_platform_sleep_milliseconds(uint32_t milliseconds) {
+  SDL_Delay(milliseconds);
+}
+
 char *vgltf_platform_read_file_to_string(const char *filepath,
                                          size_t *out_size) {
   char *file_data = SDL_LoadFile(filepath, out_size);
@@ -93,6 +102,71 @@ char *vgltf_platform_read_file_to_string(const char *filepath,
   return file_data;
 }
 
+void vgltf_platform_free_file_data(char *file_data) { SDL_free(file_data); }
+
+int vgltf_platform_get_cpu_count(void) { return SDL_GetNumLogicalCPUCores(); }
+
+bool vgltf_platform_thread_create(struct vgltf_platform_thread *thread,
+                                  const char *name,
+                                  vgltf_platform_thread_function function,
+                                  void *data) {
+  thread->thread = SDL_CreateThread(function, name, data);
+  if (!thread->thread) {
+    VGLTF_LOG_ERR("Couldn't create thread: %s", SDL_GetError());
+    return false;
+  }
+
+  return true;
+}
+void vgltf_platform_thread_join(struct vgltf_platform_thread *thread) {
+  SDL_WaitThread(thread->thread, nullptr);
+}
+
+bool vgltf_platform_mutex_init(struct vgltf_platform_mutex *mutex) {
+  mutex->mutex = SDL_CreateMutex();
+  if (!mutex->mutex) {
+    VGLTF_LOG_ERR("Couldn't create mutex: %s", SDL_GetError());
+    return false;
+  }
+
+  return true;
+}
+void vgltf_platform_mutex_deinit(struct vgltf_platform_mutex *mutex) {
+  SDL_DestroyMutex(mutex->mutex);
+}
+void vgltf_platform_mutex_lock(struct vgltf_platform_mutex *mutex) {
+  SDL_LockMutex(mutex->mutex);
+}
+void vgltf_platform_mutex_unlock(struct vgltf_platform_mutex *mutex) {
+  SDL_UnlockMutex(mutex->mutex);
+}
+
+bool vgltf_platform_condition_init(struct vgltf_platform_condition *condition) {
+  condition->condition = SDL_CreateCondition();
+  if (!condition->condition) {
+    VGLTF_LOG_ERR("Couldn't create condition variable: %s", SDL_GetError());
+    return false;
+  }
+
+  return true;
+}
+void vgltf_platform_condition_deinit(
+    struct vgltf_platform_condition *condition) {
+  SDL_DestroyCondition(condition->condition);
+}
+void vgltf_platform_condition_wait(struct vgltf_platform_condition *condition,
+                                   struct vgltf_platform_mutex *mutex) {
+  SDL_WaitCondition(condition->condition, mutex->mutex);
+}
+void vgltf_platform_condition_signal(
+    struct vgltf_platform_condition *condition) {
+  SDL_SignalCondition(condition->condition);
+}
+void vgltf_platform_condition_broadcast(
+    struct vgltf_platform_condition *condition) {
+  SDL_BroadcastCondition(condition->condition);
+}
+
 #include <SDL3/SDL_vulkan.h>
 
 const char *const *
@@ -7,4 +7,16 @@ struct vgltf_platform {
   SDL_Window *window;
 };
 
+struct vgltf_platform_thread {
+  SDL_Thread *thread;
+};
+
+struct vgltf_platform_mutex {
+  SDL_Mutex *mutex;
+};
+
+struct vgltf_platform_condition {
+  SDL_Condition *condition;
+};
+
 #endif // VGLTF_PLATFORM_SDL_H
@@ -0,0 +1,119 @@
+#include "cpu_culling.h"
+#include "../simd.h"
+#include <string.h>
+
+// 32 bits lanes
+#define VGLTF_CPU_CULLING_LANE_COUNT (VGLTF_SIMD_VECTOR_SIZE / 4)
+
+static_assert(VGLTF_CPU_CULLING_BATCH_SIZE % VGLTF_CPU_CULLING_LANE_COUNT == 0,
+              "The batch size must be a multiple of the lane count");
+
+typedef float vgltf_cpu_culling_floatv
+    __attribute__((vector_size(VGLTF_CPU_CULLING_LANE_COUNT * sizeof(float))));
+typedef int32_t vgltf_cpu_culling_intv __attribute__((
+    vector_size(VGLTF_CPU_CULLING_LANE_COUNT * sizeof(int32_t))));
+
+static vgltf_cpu_culling_floatv load_lanes(const float *values) {
+  vgltf_cpu_culling_floatv lanes;
+  memcpy(&lanes, values, sizeof(lanes));
+  return lanes;
+}
+
+static vgltf_cpu_culling_floatv broadcast_lanes(float value) {
+  return (vgltf_cpu_culling_floatv){} + value;
+}
+
+void vgltf_cpu_culling_set_sphere(struct vgltf_cpu_culling *culling,
+                                  uint32_t index, vgltf_vec3 center,
+                                  vgltf_vec_value_type radius) {
+  culling->center_x[index] = center.x;
+  culling->center_y[index] = center.y;
+  culling->center_z[index] = center.z;
+  culling->radius[index] = radius;
+}
+
+// Each batch writes its visible indices at the start of its own range of
+// visible_indices, they are compacted once every batch is done
+static void cull_batch(void *data, uint32_t begin, uint32_t end) {
+  struct vgltf_cpu_culling *culling = data;
+
+  vgltf_cpu_culling_floatv plane_x[VGLTF_FRUSTUM_PLANE_COUNT];
+  vgltf_cpu_culling_floatv plane_y[VGLTF_FRUSTUM_PLANE_COUNT];
+  vgltf_cpu_culling_floatv plane_z[VGLTF_FRUSTUM_PLANE_COUNT];
+  vgltf_cpu_culling_floatv plane_distance[VGLTF_FRUSTUM_PLANE_COUNT];
+  for (int plane_index = 0; plane_index < VGLTF_FRUSTUM_PLANE_COUNT;
+       plane_index++) {
+    const vgltf_plane *plane = &culling->frustum.planes[plane_index];
+    plane_x[plane_index] = broadcast_lanes(plane->normal.x);
+    plane_y[plane_index] = broadcast_lanes(plane->normal.y);
+    plane_z[plane_index] = broadcast_lanes(plane->normal.z);
+    plane_distance[plane_index] = broadcast_lanes(plane->distance);
+  }
+
+  // A job can span several batches when it runs inline
+  for (uint32_t batch_begin = begin; batch_begin < end;
+       batch_begin += VGLTF_CPU_CULLING_BATCH_SIZE) {
+    uint32_t batch_end = end - batch_begin < VGLTF_CPU_CULLING_BATCH_SIZE
+                             ? end
+                             : batch_begin + VGLTF_CPU_CULLING_BATCH_SIZE;
+    uint32_t *visible_indices = &culling->visible_indices[batch_begin];
+    uint32_t visible_count = 0;
+    // The arrays are padded up to their capacity, the lanes past the end are
+    // computed and ignored
+    for (uint32_t first_sphere = batch_begin; first_sphere < batch_end;
+         first_sphere += VGLTF_CPU_CULLING_LANE_COUNT) {
+      vgltf_cpu_culling_floatv center_x =
+          load_lanes(&culling->center_x[first_sphere]);
+      vgltf_cpu_culling_floatv center_y =
+          load_lanes(&culling->center_y[first_sphere]);
+      vgltf_cpu_culling_floatv center_z =
+          load_lanes(&culling->center_z[first_sphere]);
+      vgltf_cpu_culling_floatv negative_radius =
+          -load_lanes(&culling->radius[first_sphere]);
+
+      vgltf_cpu_culling_intv inside = (vgltf_cpu_culling_intv){} - 1;
+      for (int plane_index = 0; plane_index < VGLTF_FRUSTUM_PLANE_COUNT;
+           plane_index++) {
+        vgltf_cpu_culling_floatv distance =
+            plane_x[plane_index] * center_x +
+            plane_y[plane_index] * center_y +
+            plane_z[plane_index] * center_z + plane_distance[plane_index];
+        inside &= distance >= negative_radius;
+      }
+
+      for (int lane = 0; lane < VGLTF_CPU_CULLING_LANE_COUNT; lane++) {
+        uint32_t sphere_index = first_sphere + lane;
+        if (inside[lane] && sphere_index < batch_end) {
+          visible_indices[visible_count++] = sphere_index;
+        }
+      }
+    }
+
+    culling->batch_visible_counts[batch_begin / VGLTF_CPU_CULLING_BATCH_SIZE] =
+        visible_count;
+  }
+}
+
+void vgltf_cpu_culling_cull(struct vgltf_cpu_culling *culling,
+                            struct vgltf_job_system *job_system,
+                            const vgltf_frustum *frustum) {
+  VGLTF_TRACE_ZONE(__func__);
+  culling->frustum = *frustum;
+  vgltf_job_system_parallel_for(job_system, culling->sphere_count,
+                                VGLTF_CPU_CULLING_BATCH_SIZE, cull_batch,
+                                culling);
+
+  // Compacting in batch order keeps the visible list sorted no matter which
+  // thread ran which batch
+  culling->visible_count = 0;
+  uint32_t batch_count =
+      (culling->sphere_count + VGLTF_CPU_CULLING_BATCH_SIZE - 1) /
+      VGLTF_CPU_CULLING_BATCH_SIZE;
+  for (uint32_t batch_index = 0; batch_index < batch_count; batch_index++) {
+    memmove(&culling->visible_indices[culling->visible_count],
+            &culling->visible_indices[batch_index *
+                                      VGLTF_CPU_CULLING_BATCH_SIZE],
+            culling->batch_visible_counts[batch_index] * sizeof(uint32_t));
+    culling->visible_count += culling->batch_visible_counts[batch_index];
+  }
+}
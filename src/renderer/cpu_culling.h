@@ -0,0 +1,43 @@
+#ifndef VGLTF_RENDERER_CPU_CULLING_H
+#define VGLTF_RENDERER_CPU_CULLING_H
+
+#include "../job.h"
+#include "../maths.h"
+#include <stdint.h>
+
+constexpr int VGLTF_CPU_CULLING_MAX_SPHERE_COUNT = 4096;
+constexpr int VGLTF_CPU_CULLING_BATCH_SIZE = 256;
+static_assert(VGLTF_CPU_CULLING_MAX_SPHERE_COUNT %
+                      VGLTF_CPU_CULLING_BATCH_SIZE ==
+                  0,
+              "The sphere capacity must be a multiple of the batch size");
+
+// Bounding spheres stored as a structure of arrays so the frustum test runs
+// on several spheres per instruction
+struct vgltf_cpu_culling {
+  alignas(32) float center_x[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT];
+  alignas(32) float center_y[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT];
+  alignas(32) float center_z[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT];
+  alignas(32) float radius[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT];
+  uint32_t sphere_count;
+
+  // Indices of the visible spheres in ascending order
+  uint32_t visible_indices[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT];
+  uint32_t visible_count;
+
+  uint32_t batch_visible_counts[VGLTF_CPU_CULLING_MAX_SPHERE_COUNT /
+                                VGLTF_CPU_CULLING_BATCH_SIZE];
+  vgltf_frustum frustum;
+};
+
+void vgltf_cpu_culling_set_sphere(struct vgltf_cpu_culling *culling,
+                                  uint32_t index, vgltf_vec3 center,
+                                  vgltf_vec_value_type radius);
+
+// Tests every sphere against the frustum planes, batches are spread over the
+// job system
+void vgltf_cpu_culling_cull(struct vgltf_cpu_culling *culling,
+                            struct vgltf_job_system *job_system,
+                            const vgltf_frustum *frustum);
+
+#endif // VGLTF_RENDERER_CPU_CULLING_H
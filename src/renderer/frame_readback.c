@@ -0,0 +1,172 @@
+#include "frame_readback.h"
+#include "../alloc.h"
+#include "../image.h"
+#include "../log.h"
+#include <assert.h>
+#include <string.h>
+
+static constexpr uint32_t CHANNEL_COUNT = 4;
+
+// The pixels follow the write in the same allocation
+struct frame_write {
+  struct vgltf_image image;
+  char path[VGLTF_FRAME_READBACK_MAX_PATH_LENGTH];
+};
+
+static void write_frame(void *data, uint32_t begin, uint32_t end) {
+  (void)begin;
+  (void)end;
+  VGLTF_TRACE_ZONE(__func__);
+  struct frame_write *write = data;
+  if (!vgltf_image_write_to_file(&write->image, SV(write->path))) {
+    VGLTF_LOG_ERR("Couldn't write frame to %s", write->path);
+  }
+  vgltf_allocator_free(&system_allocator, write);
+}
+
+bool vgltf_frame_readback_init(struct vgltf_frame_readback *readback,
+                               VmaAllocator allocator,
+                               struct vgltf_job_system *job_system,
+                               uint32_t width, uint32_t height,
+                               uint32_t frame_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(readback);
+  assert(frame_count <= VGLTF_FRAME_READBACK_MAX_FRAME_COUNT);
+
+  *readback = (struct vgltf_frame_readback){.allocator = allocator,
+                                            .job_system = job_system,
+                                            .width = width,
+                                            .height = height,
+                                            .frame_count = frame_count};
+
+  uint32_t frame_index = 0;
+  for (; frame_index < frame_count; frame_index++) {
+    struct vgltf_frame_readback_frame *frame = &readback->frames[frame_index];
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = (VkDeviceSize)width * height * CHANNEL_COUNT,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+    // Read back on the CPU, cached memory keeps the copy out fast
+    VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                 VMA_ALLOCATION_CREATE_MAPPED_BIT};
+    VmaAllocationInfo allocation_info;
+    if (vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &frame->buffer,
+                        &frame->allocation,
+                        &allocation_info) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Couldn't create readback buffer");
+      goto destroy_buffers;
+    }
+    frame->mapped_data = allocation_info.pMappedData;
+  }
+
+  return true;
+destroy_buffers:
+  for (uint32_t to_destroy_index = 0; to_destroy_index < frame_index;
+       to_destroy_index++) {
+    vmaDestroyBuffer(allocator, readback->frames[to_destroy_index].buffer,
+                     readback->frames[to_destroy_index].allocation);
+  }
+  return false;
+}
+
+void vgltf_frame_readback_deinit(struct vgltf_frame_readback *readback) {
+  for (uint32_t frame_index = 0; frame_index < readback->frame_count;
+       frame_index++) {
+    vgltf_frame_readback_resolve(readback, frame_index);
+  }
+  vgltf_frame_readback_wait(readback);
+  for (uint32_t frame_index = 0; frame_index < readback->frame_count;
+       frame_index++) {
+    vmaDestroyBuffer(readback->allocator, readback->frames[frame_index].buffer,
+                     readback->frames[frame_index].allocation);
+  }
+}
+
+bool vgltf_frame_readback_request(struct vgltf_frame_readback *readback,
+                                  const char *path) {
+  size_t path_length = strlen(path);
+  if (path_length >= VGLTF_FRAME_READBACK_MAX_PATH_LENGTH) {
+    VGLTF_LOG_ERR("Readback path too long: %s", path);
+    return false;
+  }
+
+  memcpy(readback->requested_path, path, path_length + 1);
+  readback->requested = true;
+  return true;
+}
+
+void vgltf_frame_readback_resolve(struct vgltf_frame_readback *readback,
+                                  uint32_t frame_index) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_frame_readback_frame *frame = &readback->frames[frame_index];
+  if (!frame->copy_pending) {
+    return;
+  }
+  frame->copy_pending = false;
+
+  // The buffer gets reused by the next frame, the job gets its own copy
+  size_t pixels_size =
+      (size_t)readback->width * readback->height * CHANNEL_COUNT;
+  struct frame_write *write = vgltf_allocator_allocate(
+      &system_allocator, sizeof(struct frame_write) + pixels_size);
+  if (!write) {
+    VGLTF_LOG_ERR("Couldn't allocate frame write for %s", frame->path);
+    return;
+  }
+
+  vmaInvalidateAllocation(readback->allocator, frame->allocation, 0,
+                          VK_WHOLE_SIZE);
+  write->image = (struct vgltf_image){.data = (unsigned char *)(write + 1),
+                                      .width = readback->width,
+                                      .height = readback->height,
+                                      .format = VGLTF_IMAGE_FORMAT_R8G8B8A8};
+  memcpy(write->image.data, frame->mapped_data, pixels_size);
+  memcpy(write->path, frame->path, sizeof(write->path));
+  vgltf_job_system_submit(readback->job_system,
+                          &(const struct vgltf_job){
+                              .function = write_frame,
+                              .data = write,
+                              .begin = 0,
+                              .end = 1,
+                              .counter = &readback->write_counter});
+}
+
+void vgltf_frame_readback_record(struct vgltf_frame_readback *readback,
+                                 VkCommandBuffer command_buffer,
+                                 uint32_t frame_index, VkImage image) {
+  if (!readback->requested) {
+    return;
+  }
+  readback->requested = false;
+
+  struct vgltf_frame_readback_frame *frame = &readback->frames[frame_index];
+  assert(!frame->copy_pending);
+  VkBufferImageCopy region = {
+      .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .layerCount = 1},
+      .imageExtent = {readback->width, readback->height, 1}};
+  vkCmdCopyImageToBuffer(command_buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame->buffer, 1,
+                         &region);
+  VkBufferMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = frame->buffer,
+      .size = VK_WHOLE_SIZE};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier,
+                       0, nullptr);
+
+  memcpy(frame->path, readback->requested_path, sizeof(frame->path));
+  frame->copy_pending = true;
+}
+
+void vgltf_frame_readback_wait(struct vgltf_frame_readback *readback) {
+  vgltf_job_system_wait(readback->job_system, &readback->write_counter);
+}
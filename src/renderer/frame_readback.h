@@ -0,0 +1,67 @@
+#ifndef VGLTF_RENDERER_FRAME_READBACK_H
+#define VGLTF_RENDERER_FRAME_READBACK_H
+
+#include "../job.h"
+#include "vma_usage.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+constexpr int VGLTF_FRAME_READBACK_MAX_FRAME_COUNT = 4;
+constexpr int VGLTF_FRAME_READBACK_MAX_PATH_LENGTH = 256;
+
+struct vgltf_frame_readback_frame {
+  VkBuffer buffer;
+  VmaAllocation allocation;
+  void *mapped_data;
+  char path[VGLTF_FRAME_READBACK_MAX_PATH_LENGTH];
+  bool copy_pending;
+};
+
+// Requested frames are copied to a host visible buffer per frame in flight,
+// copied out once that frame's fence has been waited on and written to a file
+// by a job, so the frame loop never waits on the GPU nor on the file system
+struct vgltf_frame_readback {
+  VmaAllocator allocator;
+  struct vgltf_job_system *job_system;
+  uint32_t width;
+  uint32_t height;
+
+  struct vgltf_frame_readback_frame
+      frames[VGLTF_FRAME_READBACK_MAX_FRAME_COUNT];
+  uint32_t frame_count;
+
+  char requested_path[VGLTF_FRAME_READBACK_MAX_PATH_LENGTH];
+  bool requested;
+  struct vgltf_job_counter write_counter;
+};
+
+// Frames are read as 8 bits per channel RGBA
+bool vgltf_frame_readback_init(struct vgltf_frame_readback *readback,
+                               VmaAllocator allocator,
+                               struct vgltf_job_system *job_system,
+                               uint32_t width, uint32_t height,
+                               uint32_t frame_count);
+// Writes the frames still waiting to be resolved, the device must be idle,
+// and waits for every write
+void vgltf_frame_readback_deinit(struct vgltf_frame_readback *readback);
+
+// The next recorded frame gets written to path, see vgltf_image_write_to_file
+// for the supported formats
+bool vgltf_frame_readback_request(struct vgltf_frame_readback *readback,
+                                  const char *path);
+
+// Hands the frame last copied for this frame in flight to a write job, the
+// frame's fence must have been waited on
+void vgltf_frame_readback_resolve(struct vgltf_frame_readback *readback,
+                                  uint32_t frame_index);
+
+// Records the copy of the image if a frame got requested, the image must be
+// in the TRANSFER_SRC_OPTIMAL layout with its writes visible to transfers
+void vgltf_frame_readback_record(struct vgltf_frame_readback *readback,
+                                 VkCommandBuffer command_buffer,
+                                 uint32_t frame_index, VkImage image);
+
+// Waits for the written files
+void vgltf_frame_readback_wait(struct vgltf_frame_readback *readback);
+
+#endif // VGLTF_RENDERER_FRAME_READBACK_H
@@ -0,0 +1,522 @@
+#include "geometry_streaming.h"
+#include "../alloc.h"
+#include "../log.h"
+#include <assert.h>
+#include <string.h>
+
+static constexpr VkDeviceSize STREAM_ALIGNMENT = 256;
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+static constexpr uint32_t NO_RESOURCE = UINT32_MAX;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize element_size(const struct vgltf_geometry_pool *pool) {
+  VkDeviceSize size = 0;
+  for (uint32_t stream_index = 0; stream_index < pool->stream_count;
+       stream_index++) {
+    size += pool->streams[stream_index].element_size;
+  }
+  return size;
+}
+
+static void destroy_frames(struct vgltf_geometry_streaming *streaming,
+                           uint32_t frame_count) {
+  for (uint32_t frame_index = 0; frame_index < frame_count; frame_index++) {
+    struct vgltf_geometry_streaming_frame *frame =
+        &streaming->frames[frame_index];
+    vgltf_allocator_free(&system_allocator, frame->regions);
+    vgltf_allocator_free(&system_allocator, frame->uploads);
+    vmaDestroyBuffer(streaming->allocator, frame->staging_buffer,
+                     frame->staging_allocation);
+  }
+}
+
+bool vgltf_geometry_streaming_init(struct vgltf_geometry_streaming *streaming,
+                                   VmaAllocator allocator,
+                                   struct vgltf_job_system *job_system,
+                                   uint32_t resource_capacity,
+                                   VkDeviceSize staging_size,
+                                   uint32_t frame_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(streaming);
+  assert(frame_count <= VGLTF_GEOMETRY_STREAMING_MAX_FRAME_COUNT);
+  *streaming = (struct vgltf_geometry_streaming){
+      .allocator = allocator,
+      .job_system = job_system,
+      .resource_capacity = resource_capacity,
+      .frame_count = frame_count,
+      .staging_size = staging_size};
+
+  uint32_t capacity = resource_capacity > 0 ? resource_capacity : 1;
+  streaming->resources = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(struct vgltf_geometry_resource));
+  streaming->requests = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(uint32_t));
+  if (!streaming->resources || !streaming->requests) {
+    VGLTF_LOG_ERR("Couldn't allocate the streamed resources");
+    goto free_resources;
+  }
+
+  uint32_t frame_index = 0;
+  for (; frame_index < frame_count; frame_index++) {
+    struct vgltf_geometry_streaming_frame *frame =
+        &streaming->frames[frame_index];
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = staging_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+    VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                 VMA_ALLOCATION_CREATE_MAPPED_BIT};
+    VmaAllocationInfo allocation_info;
+    if (vmaCreateBuffer(allocator, &buffer_info, &alloc_info,
+                        &frame->staging_buffer, &frame->staging_allocation,
+                        &allocation_info) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Couldn't create geometry staging buffer");
+      goto destroy_frames;
+    }
+    frame->mapped_staging = allocation_info.pMappedData;
+
+    // A resource is uploaded by one copy per stream
+    frame->uploads = vgltf_allocator_allocate_array(
+        &system_allocator,
+        (size_t)capacity * VGLTF_GEOMETRY_STREAMING_MAX_STREAM_COUNT,
+        sizeof(struct vgltf_geometry_upload));
+    frame->regions = vgltf_allocator_allocate_array(
+        &system_allocator,
+        (size_t)capacity * VGLTF_GEOMETRY_STREAMING_MAX_STREAM_COUNT,
+        sizeof(VkBufferCopy));
+    if (!frame->uploads || !frame->regions) {
+      VGLTF_LOG_ERR("Couldn't allocate the geometry uploads");
+      frame_index++;
+      goto destroy_frames;
+    }
+  }
+
+  return true;
+destroy_frames:
+  destroy_frames(streaming, frame_index);
+free_resources:
+  vgltf_allocator_free(&system_allocator, streaming->requests);
+  vgltf_allocator_free(&system_allocator, streaming->resources);
+  return false;
+}
+
+void vgltf_geometry_streaming_deinit(
+    struct vgltf_geometry_streaming *streaming) {
+  for (uint32_t pool_index = 0; pool_index < streaming->pool_count;
+       pool_index++) {
+    struct vgltf_geometry_pool *pool = &streaming->pools[pool_index];
+    vgltf_allocator_free(&system_allocator, pool->free_counts);
+    vgltf_allocator_free(&system_allocator, pool->free_firsts);
+    vmaDestroyBuffer(streaming->allocator, pool->buffer, pool->allocation);
+  }
+  destroy_frames(streaming, streaming->frame_count);
+  vgltf_allocator_free(&system_allocator, streaming->requests);
+  vgltf_allocator_free(&system_allocator, streaming->resources);
+}
+
+bool vgltf_geometry_streaming_add_pool(
+    struct vgltf_geometry_streaming *streaming, uint32_t capacity,
+    VkBufferUsageFlags usage, const struct vgltf_geometry_stream *streams,
+    uint32_t stream_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(streaming->pool_count < VGLTF_GEOMETRY_STREAMING_MAX_POOL_COUNT);
+  assert(stream_count <= VGLTF_GEOMETRY_STREAMING_MAX_STREAM_COUNT);
+  struct vgltf_geometry_pool *pool = &streaming->pools[streaming->pool_count];
+  *pool = (struct vgltf_geometry_pool){
+      .capacity = capacity,
+      .stream_count = stream_count,
+      .least_recently_used = NO_RESOURCE,
+      .most_recently_used = NO_RESOURCE};
+  VkDeviceSize size = 0;
+  for (uint32_t stream_index = 0; stream_index < stream_count;
+       stream_index++) {
+    pool->streams[stream_index] = streams[stream_index];
+    pool->streams[stream_index].offset = size;
+    size = align_up(size + (VkDeviceSize)capacity *
+                               streams[stream_index].element_size,
+                    STREAM_ALIGNMENT);
+  }
+
+  // Freeing a range splits at most one free range in two
+  pool->free_firsts = vgltf_allocator_allocate_array(
+      &system_allocator, streaming->resource_capacity + 1, sizeof(uint32_t));
+  pool->free_counts = vgltf_allocator_allocate_array(
+      &system_allocator, streaming->resource_capacity + 1, sizeof(uint32_t));
+  if (!pool->free_firsts || !pool->free_counts) {
+    VGLTF_LOG_ERR("Couldn't allocate the free ranges of a geometry pool");
+    goto free_ranges;
+  }
+  pool->free_firsts[0] = 0;
+  pool->free_counts[0] = capacity;
+  pool->free_range_count = capacity > 0 ? 1 : 0;
+
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = size > 0 ? size : 1,
+      .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+  VmaAllocationCreateInfo alloc_info = {
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
+  if (vmaCreateBuffer(streaming->allocator, &buffer_info, &alloc_info,
+                      &pool->buffer, &pool->allocation,
+                      nullptr) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create geometry pool buffer");
+    goto free_ranges;
+  }
+
+  streaming->pool_count++;
+  return true;
+free_ranges:
+  vgltf_allocator_free(&system_allocator, pool->free_counts);
+  vgltf_allocator_free(&system_allocator, pool->free_firsts);
+  return false;
+}
+
+uint32_t vgltf_geometry_streaming_add_resource(
+    struct vgltf_geometry_streaming *streaming, uint32_t pool_index,
+    uint32_t first_element, uint32_t element_count) {
+  assert(streaming->resource_count < streaming->resource_capacity);
+  assert(pool_index < streaming->pool_count);
+  assert(element_count <= streaming->pools[pool_index].capacity);
+  uint32_t resource_index = streaming->resource_count++;
+  streaming->resources[resource_index] = (struct vgltf_geometry_resource){
+      .pool_index = pool_index,
+      .first_element = first_element,
+      .element_count = element_count,
+      .pool_first_element = VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT,
+      .less_recently_used = NO_RESOURCE,
+      .more_recently_used = NO_RESOURCE};
+  return resource_index;
+}
+
+// First fit
+static bool pool_allocate(struct vgltf_geometry_pool *pool,
+                          uint32_t element_count, uint32_t *first_element) {
+  for (uint32_t range_index = 0; range_index < pool->free_range_count;
+       range_index++) {
+    if (pool->free_counts[range_index] < element_count) {
+      continue;
+    }
+
+    *first_element = pool->free_firsts[range_index];
+    pool->free_firsts[range_index] += element_count;
+    pool->free_counts[range_index] -= element_count;
+    if (pool->free_counts[range_index] == 0) {
+      size_t moved_count = pool->free_range_count - range_index - 1;
+      memmove(&pool->free_firsts[range_index],
+              &pool->free_firsts[range_index + 1],
+              moved_count * sizeof(uint32_t));
+      memmove(&pool->free_counts[range_index],
+              &pool->free_counts[range_index + 1],
+              moved_count * sizeof(uint32_t));
+      pool->free_range_count--;
+    }
+    return true;
+  }
+  return false;
+}
+
+// Merges the range with its free neighbours
+static void pool_free(struct vgltf_geometry_pool *pool, uint32_t first_element,
+                      uint32_t element_count) {
+  uint32_t next = 0;
+  while (next < pool->free_range_count &&
+         pool->free_firsts[next] < first_element) {
+    next++;
+  }
+  bool merges_previous =
+      next > 0 && pool->free_firsts[next - 1] + pool->free_counts[next - 1] ==
+                      first_element;
+  bool merges_next = next < pool->free_range_count &&
+                     first_element + element_count == pool->free_firsts[next];
+  if (merges_previous && merges_next) {
+    pool->free_counts[next - 1] += element_count + pool->free_counts[next];
+    size_t moved_count = pool->free_range_count - next - 1;
+    memmove(&pool->free_firsts[next], &pool->free_firsts[next + 1],
+            moved_count * sizeof(uint32_t));
+    memmove(&pool->free_counts[next], &pool->free_counts[next + 1],
+            moved_count * sizeof(uint32_t));
+    pool->free_range_count--;
+  } else if (merges_previous) {
+    pool->free_counts[next - 1] += element_count;
+  } else if (merges_next) {
+    pool->free_firsts[next] = first_element;
+    pool->free_counts[next] += element_count;
+  } else {
+    size_t moved_count = pool->free_range_count - next;
+    memmove(&pool->free_firsts[next + 1], &pool->free_firsts[next],
+            moved_count * sizeof(uint32_t));
+    memmove(&pool->free_counts[next + 1], &pool->free_counts[next],
+            moved_count * sizeof(uint32_t));
+    pool->free_firsts[next] = first_element;
+    pool->free_counts[next] = element_count;
+    pool->free_range_count++;
+  }
+}
+
+static void unlink_resource(struct vgltf_geometry_streaming *streaming,
+                            uint32_t resource_index) {
+  struct vgltf_geometry_resource *resource =
+      &streaming->resources[resource_index];
+  struct vgltf_geometry_pool *pool = &streaming->pools[resource->pool_index];
+  if (resource->less_recently_used == NO_RESOURCE) {
+    pool->least_recently_used = resource->more_recently_used;
+  } else {
+    streaming->resources[resource->less_recently_used].more_recently_used =
+        resource->more_recently_used;
+  }
+  if (resource->more_recently_used == NO_RESOURCE) {
+    pool->most_recently_used = resource->less_recently_used;
+  } else {
+    streaming->resources[resource->more_recently_used].less_recently_used =
+        resource->less_recently_used;
+  }
+  resource->less_recently_used = NO_RESOURCE;
+  resource->more_recently_used = NO_RESOURCE;
+}
+
+static void link_most_recently_used(struct vgltf_geometry_streaming *streaming,
+                                    uint32_t resource_index) {
+  struct vgltf_geometry_resource *resource =
+      &streaming->resources[resource_index];
+  struct vgltf_geometry_pool *pool = &streaming->pools[resource->pool_index];
+  resource->less_recently_used = pool->most_recently_used;
+  resource->more_recently_used = NO_RESOURCE;
+  if (pool->most_recently_used == NO_RESOURCE) {
+    pool->least_recently_used = resource_index;
+  } else {
+    streaming->resources[pool->most_recently_used].more_recently_used =
+        resource_index;
+  }
+  pool->most_recently_used = resource_index;
+}
+
+// Frees the range of the least recently used resource of the pool, unless
+// a frame in flight may still read it
+static bool evict_least_recently_used(
+    struct vgltf_geometry_streaming *streaming, uint32_t pool_index) {
+  struct vgltf_geometry_pool *pool = &streaming->pools[pool_index];
+  uint32_t resource_index = pool->least_recently_used;
+  if (resource_index == NO_RESOURCE) {
+    return false;
+  }
+  struct vgltf_geometry_resource *resource =
+      &streaming->resources[resource_index];
+  // The frames up to frame - frame_count have completed
+  if (resource->last_used_frame + streaming->frame_count > streaming->frame) {
+    return false;
+  }
+
+  unlink_resource(streaming, resource_index);
+  pool_free(pool, resource->pool_first_element, resource->element_count);
+  resource->pool_first_element = VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT;
+  resource->uploaded_element_count = 0;
+  streaming->evicted_resource_count++;
+  return true;
+}
+
+void vgltf_geometry_streaming_begin_frame(
+    struct vgltf_geometry_streaming *streaming, uint32_t frame_index) {
+  assert(frame_index < streaming->frame_count);
+  streaming->frame++;
+  streaming->frame_index = frame_index;
+  struct vgltf_geometry_streaming_frame *frame =
+      &streaming->frames[frame_index];
+  frame->staging_used_size = 0;
+  frame->upload_count = 0;
+}
+
+void vgltf_geometry_streaming_request(
+    struct vgltf_geometry_streaming *streaming, uint32_t resource_index) {
+  struct vgltf_geometry_resource *resource =
+      &streaming->resources[resource_index];
+  resource->last_used_frame = streaming->frame;
+  if (resource->pool_first_element != VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT) {
+    unlink_resource(streaming, resource_index);
+    link_most_recently_used(streaming, resource_index);
+  }
+  if (resource->uploaded_element_count < resource->element_count &&
+      !resource->requested) {
+    resource->requested = true;
+    streaming->requests[streaming->request_count++] = resource_index;
+  }
+}
+
+static void copy_uploads(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  const struct vgltf_geometry_streaming_frame *frame = data;
+  for (uint32_t upload_index = begin; upload_index < end; upload_index++) {
+    const VkBufferCopy *region = &frame->regions[upload_index];
+    memcpy((char *)frame->mapped_staging + region->srcOffset,
+           frame->uploads[upload_index].source, region->size);
+  }
+}
+
+void vgltf_geometry_streaming_stage(
+    struct vgltf_geometry_streaming *streaming) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_geometry_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  for (uint32_t request_index = 0; request_index < streaming->request_count;
+       request_index++) {
+    uint32_t resource_index = streaming->requests[request_index];
+    struct vgltf_geometry_resource *resource =
+        &streaming->resources[resource_index];
+    resource->requested = false;
+    struct vgltf_geometry_pool *pool = &streaming->pools[resource->pool_index];
+
+    if (resource->pool_first_element ==
+        VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT) {
+      uint32_t first_element;
+      bool allocated = false;
+      while (!(allocated = pool_allocate(pool, resource->element_count,
+                                         &first_element)) &&
+             evict_least_recently_used(streaming, resource->pool_index)) {
+      }
+      if (!allocated) {
+        continue;
+      }
+      resource->pool_first_element = first_element;
+      link_most_recently_used(streaming, resource_index);
+    }
+
+    // Uploads what the staging buffer has room for
+    VkDeviceSize size_per_element = element_size(pool);
+    VkDeviceSize available_size =
+        streaming->staging_size - frame->staging_used_size;
+    uint32_t element_count =
+        resource->element_count - resource->uploaded_element_count;
+    // Each stream copy may be padded to the staging alignment
+    VkDeviceSize padding = pool->stream_count * STAGING_ALIGNMENT;
+    if (available_size <= padding) {
+      continue;
+    }
+    if ((VkDeviceSize)element_count * size_per_element >
+        available_size - padding) {
+      element_count =
+          (uint32_t)((available_size - padding) / size_per_element);
+    }
+    if (element_count == 0) {
+      continue;
+    }
+
+    for (uint32_t stream_index = 0; stream_index < pool->stream_count;
+         stream_index++) {
+      const struct vgltf_geometry_stream *stream =
+          &pool->streams[stream_index];
+      uint32_t first_element =
+          resource->first_element + resource->uploaded_element_count;
+      uint32_t pool_first_element =
+          resource->pool_first_element + resource->uploaded_element_count;
+      frame->uploads[frame->upload_count] = (struct vgltf_geometry_upload){
+          .pool_index = resource->pool_index,
+          .source =
+              stream->source + (size_t)first_element * stream->element_size,
+          .resource_index = resource_index,
+          .uploaded_element_count = resource->uploaded_element_count};
+      frame->regions[frame->upload_count] = (VkBufferCopy){
+          .srcOffset = frame->staging_used_size,
+          .dstOffset = stream->offset + (VkDeviceSize)pool_first_element *
+                                            stream->element_size,
+          .size = (VkDeviceSize)element_count * stream->element_size};
+      frame->staging_used_size =
+          align_up(frame->staging_used_size +
+                       frame->regions[frame->upload_count].size,
+                   STAGING_ALIGNMENT);
+      frame->upload_count++;
+    }
+    resource->uploaded_element_count += element_count;
+    streaming->uploaded_size += (VkDeviceSize)element_count * size_per_element;
+  }
+  streaming->request_count = 0;
+
+  vgltf_job_system_parallel_for(streaming->job_system, frame->upload_count, 1,
+                                copy_uploads, frame);
+  vmaFlushAllocation(streaming->allocator, frame->staging_allocation, 0,
+                     VK_WHOLE_SIZE);
+}
+
+void vgltf_geometry_streaming_record(
+    struct vgltf_geometry_streaming *streaming,
+    VkCommandBuffer command_buffer) {
+  const struct vgltf_geometry_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  if (frame->upload_count == 0) {
+    return;
+  }
+
+  // Consecutive uploads to the same pool share a copy command
+  uint32_t first_upload = 0;
+  for (uint32_t upload_index = 1; upload_index <= frame->upload_count;
+       upload_index++) {
+    uint32_t pool_index = frame->uploads[first_upload].pool_index;
+    if (upload_index < frame->upload_count &&
+        frame->uploads[upload_index].pool_index == pool_index) {
+      continue;
+    }
+    vkCmdCopyBuffer(command_buffer, frame->staging_buffer,
+                    streaming->pools[pool_index].buffer,
+                    upload_index - first_upload, &frame->regions[first_upload]);
+    first_upload = upload_index;
+  }
+
+  VkMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                       VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void vgltf_geometry_streaming_cancel(
+    struct vgltf_geometry_streaming *streaming) {
+  struct vgltf_geometry_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  // The uploads of a resource all hold its count from before the frame
+  for (uint32_t upload_index = 0; upload_index < frame->upload_count;
+       upload_index++) {
+    const struct vgltf_geometry_upload *upload = &frame->uploads[upload_index];
+    streaming->resources[upload->resource_index].uploaded_element_count =
+        upload->uploaded_element_count;
+  }
+  frame->staging_used_size = 0;
+  frame->upload_count = 0;
+}
+
+bool vgltf_geometry_streaming_is_resident(
+    const struct vgltf_geometry_streaming *streaming, uint32_t resource_index) {
+  // Evicted resources have no element uploaded, empty ones never get a range
+  const struct vgltf_geometry_resource *resource =
+      &streaming->resources[resource_index];
+  return resource->uploaded_element_count == resource->element_count;
+}
+
+void vgltf_geometry_streaming_log_report(
+    struct vgltf_geometry_streaming *streaming) {
+  for (uint32_t pool_index = 0; pool_index < streaming->pool_count;
+       pool_index++) {
+    const struct vgltf_geometry_pool *pool = &streaming->pools[pool_index];
+    uint32_t free_count = 0;
+    for (uint32_t range_index = 0; range_index < pool->free_range_count;
+         range_index++) {
+      free_count += pool->free_counts[range_index];
+    }
+    VGLTF_LOG_INFO("Geometry pool %u: %u/%u elements used, %u free ranges",
+                   pool_index, pool->capacity - free_count, pool->capacity,
+                   pool->free_range_count);
+  }
+  VGLTF_LOG_INFO("Geometry streaming: %.1f MiB uploaded, %u evictions",
+                 streaming->uploaded_size / (1024.0 * 1024.0),
+                 streaming->evicted_resource_count);
+  streaming->uploaded_size = 0;
+  streaming->evicted_resource_count = 0;
+}
@@ -0,0 +1,162 @@
+#ifndef VGLTF_RENDERER_GEOMETRY_STREAMING_H
+#define VGLTF_RENDERER_GEOMETRY_STREAMING_H
+
+#include "../job.h"
+#include "vma_usage.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+constexpr int VGLTF_GEOMETRY_STREAMING_MAX_POOL_COUNT = 2;
+constexpr int VGLTF_GEOMETRY_STREAMING_MAX_STREAM_COUNT = 2;
+constexpr int VGLTF_GEOMETRY_STREAMING_MAX_FRAME_COUNT = 4;
+constexpr uint32_t VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT = UINT32_MAX;
+
+// An element of a pool is one value of each of its streams. A stream is an
+// array in the backing store, and another one in the pool buffer.
+struct vgltf_geometry_stream {
+  const char *source;
+  uint32_t element_size;
+  // Of the stream in the pool buffer, set when the pool is added
+  VkDeviceSize offset;
+};
+
+// A fixed size device local buffer, resident resources own ranges of its
+// elements
+struct vgltf_geometry_pool {
+  VkBuffer buffer;
+  VmaAllocation allocation;
+  uint32_t capacity;
+  struct vgltf_geometry_stream
+      streams[VGLTF_GEOMETRY_STREAMING_MAX_STREAM_COUNT];
+  uint32_t stream_count;
+  // Free element ranges in ascending order, never adjacent
+  uint32_t *free_firsts;
+  uint32_t *free_counts;
+  uint32_t free_range_count;
+  // Resources with a range, from the least to the most recently used
+  uint32_t least_recently_used;
+  uint32_t most_recently_used;
+};
+
+// A range of the backing store elements of a pool, copied to the pool when
+// it gets requested
+struct vgltf_geometry_resource {
+  uint32_t pool_index;
+  uint32_t first_element;
+  uint32_t element_count;
+  // Range of the resource in the pool, or VGLTF_GEOMETRY_STREAMING_NOT_RESIDENT
+  uint32_t pool_first_element;
+  // Large resources take several frames of staging, they are resident once
+  // every element is uploaded
+  uint32_t uploaded_element_count;
+  uint64_t last_used_frame;
+  // Neighbours in the recently used list of the pool
+  uint32_t less_recently_used;
+  uint32_t more_recently_used;
+  bool requested;
+};
+
+// A copy from the backing store to the pool, through the staging buffer
+struct vgltf_geometry_upload {
+  uint32_t pool_index;
+  const char *source;
+  uint32_t resource_index;
+  // Of the resource before the frame staged it, restored by a cancel
+  uint32_t uploaded_element_count;
+};
+
+struct vgltf_geometry_streaming_frame {
+  VkBuffer staging_buffer;
+  VmaAllocation staging_allocation;
+  void *mapped_staging;
+  VkDeviceSize staging_used_size;
+  // uploads[i] is copied by regions[i]
+  struct vgltf_geometry_upload *uploads;
+  VkBufferCopy *regions;
+  uint32_t upload_count;
+};
+
+// Geometry loaded on demand into fixed size pools. The resources requested
+// by a frame are copied to a staging buffer of its frame in flight by jobs,
+// up to the staging size, and then to their pool by the frame command buffer.
+// Pools full of used resources evict the least recently used one, when no
+// frame in flight uses it anymore.
+struct vgltf_geometry_streaming {
+  VmaAllocator allocator;
+  struct vgltf_job_system *job_system;
+  struct vgltf_geometry_pool pools[VGLTF_GEOMETRY_STREAMING_MAX_POOL_COUNT];
+  uint32_t pool_count;
+  struct vgltf_geometry_resource *resources;
+  uint32_t resource_count;
+  uint32_t resource_capacity;
+  // Not yet resident resources requested by the current frame, in request
+  // order
+  uint32_t *requests;
+  uint32_t request_count;
+
+  struct vgltf_geometry_streaming_frame
+      frames[VGLTF_GEOMETRY_STREAMING_MAX_FRAME_COUNT];
+  uint32_t frame_count;
+  uint32_t frame_index;
+  VkDeviceSize staging_size;
+  // Counts the frames begun
+  uint64_t frame;
+  // Since the last report
+  uint64_t uploaded_size;
+  uint32_t evicted_resource_count;
+};
+
+// Every frame in flight gets a staging buffer of staging_size bytes
+bool vgltf_geometry_streaming_init(struct vgltf_geometry_streaming *streaming,
+                                   VmaAllocator allocator,
+                                   struct vgltf_job_system *job_system,
+                                   uint32_t resource_capacity,
+                                   VkDeviceSize staging_size,
+                                   uint32_t frame_count);
+// The device must be idle
+void vgltf_geometry_streaming_deinit(
+    struct vgltf_geometry_streaming *streaming);
+
+// Creates a pool of capacity elements made of the given streams, whose
+// sources must outlive the streaming. Pools get consecutive indices from 0.
+bool vgltf_geometry_streaming_add_pool(
+    struct vgltf_geometry_streaming *streaming, uint32_t capacity,
+    VkBufferUsageFlags usage, const struct vgltf_geometry_stream *streams,
+    uint32_t stream_count);
+// Returns the index of the resource, which must fit in its pool. Resources
+// get consecutive indices from 0.
+uint32_t vgltf_geometry_streaming_add_resource(
+    struct vgltf_geometry_streaming *streaming, uint32_t pool_index,
+    uint32_t first_element, uint32_t element_count);
+
+// Starts a frame once the fence of its frame in flight has been waited on
+void vgltf_geometry_streaming_begin_frame(
+    struct vgltf_geometry_streaming *streaming, uint32_t frame_index);
+// Keeps the resource from being evicted by the frames in flight, and queues
+// its upload if it isn't resident
+void vgltf_geometry_streaming_request(
+    struct vgltf_geometry_streaming *streaming, uint32_t resource_index);
+// Stages the requested resources in request order while the staging buffer
+// of the frame has room. The staged resources are resident for the commands
+// recorded after vgltf_geometry_streaming_record.
+void vgltf_geometry_streaming_stage(
+    struct vgltf_geometry_streaming *streaming);
+// Records the copies of the staged resources to their pool, outside of a
+// render pass
+void vgltf_geometry_streaming_record(
+    struct vgltf_geometry_streaming *streaming,
+    VkCommandBuffer command_buffer);
+// Forgets the uploads staged by the frame, for a frame that won't be
+// submitted. The resources they completed aren't resident anymore.
+void vgltf_geometry_streaming_cancel(
+    struct vgltf_geometry_streaming *streaming);
+
+// Empty resources are always resident, without a range in their pool
+bool vgltf_geometry_streaming_is_resident(
+    const struct vgltf_geometry_streaming *streaming, uint32_t resource_index);
+
+// Logs the pool usage and the traffic since the last report
+void vgltf_geometry_streaming_log_report(
+    struct vgltf_geometry_streaming *streaming);
+
+#endif // VGLTF_RENDERER_GEOMETRY_STREAMING_H
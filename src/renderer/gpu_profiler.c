@@ -0,0 +1,314 @@
+#include "gpu_profiler.h"
+#include "../log.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+static constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+static const char *STATISTIC_NAMES[VGLTF_GPU_PROFILER_STATISTIC_COUNT] = {
+    [VGLTF_GPU_PROFILER_STATISTIC_VERTEX_SHADER_INVOCATIONS] =
+        "vertex shader invocations",
+    [VGLTF_GPU_PROFILER_STATISTIC_CLIPPING_INVOCATIONS] =
+        "clipping invocations",
+    [VGLTF_GPU_PROFILER_STATISTIC_CLIPPING_PRIMITIVES] = "clipping primitives",
+    [VGLTF_GPU_PROFILER_STATISTIC_FRAGMENT_SHADER_INVOCATIONS] =
+        "fragment shader invocations",
+};
+
+bool vgltf_gpu_profiler_init(struct vgltf_gpu_profiler *profiler,
+                             VkDevice device, float timestamp_period,
+                             uint32_t timestamp_valid_bits,
+                             bool statistics_supported, uint32_t frame_count,
+                             const char *const *pass_names,
+                             uint32_t pass_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(profiler);
+  assert(frame_count <= VGLTF_GPU_PROFILER_MAX_FRAME_COUNT);
+  assert(pass_count <= VGLTF_GPU_PROFILER_MAX_PASS_COUNT);
+
+  *profiler = (struct vgltf_gpu_profiler){
+      .device = device,
+      .timestamp_period = timestamp_period,
+      .timestamp_mask = timestamp_valid_bits < 64
+                            ? (1ull << timestamp_valid_bits) - 1
+                            : UINT64_MAX,
+      .timestamps_supported =
+          timestamp_period > 0.f && timestamp_valid_bits > 0,
+      .statistics_supported = statistics_supported,
+      .frame_count = frame_count,
+      .pass_count = pass_count};
+  for (uint32_t pass = 0; pass < pass_count; pass++) {
+    profiler->passes[pass].name = pass_names[pass];
+  }
+
+  uint32_t frame_index = 0;
+  for (; frame_index < frame_count; frame_index++) {
+    struct vgltf_gpu_profiler_frame *frame = &profiler->frames[frame_index];
+    if (profiler->timestamps_supported) {
+      VkQueryPoolCreateInfo create_info = {
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_TIMESTAMP,
+          .queryCount = pass_count * 2};
+      if (vkCreateQueryPool(device, &create_info, nullptr,
+                            &frame->timestamp_query_pool) != VK_SUCCESS) {
+        VGLTF_LOG_ERR("Couldn't create timestamp query pool");
+        goto destroy_query_pools;
+      }
+    }
+
+    if (profiler->statistics_supported) {
+      VkQueryPoolCreateInfo create_info = {
+          .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+          .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+          .queryCount = 1,
+          .pipelineStatistics = STATISTIC_FLAGS};
+      if (vkCreateQueryPool(device, &create_info, nullptr,
+                            &frame->statistics_query_pool) != VK_SUCCESS) {
+        VGLTF_LOG_ERR("Couldn't create pipeline statistics query pool");
+        vkDestroyQueryPool(device, frame->timestamp_query_pool, nullptr);
+        goto destroy_query_pools;
+      }
+    }
+  }
+
+  VGLTF_LOG_INFO("GPU profiler timestamps: %d, pipeline statistics: %d",
+                 profiler->timestamps_supported,
+                 profiler->statistics_supported);
+  return true;
+destroy_query_pools:
+  for (uint32_t created_frame_index = 0; created_frame_index < frame_index;
+       created_frame_index++) {
+    struct vgltf_gpu_profiler_frame *frame =
+        &profiler->frames[created_frame_index];
+    vkDestroyQueryPool(device, frame->statistics_query_pool, nullptr);
+    vkDestroyQueryPool(device, frame->timestamp_query_pool, nullptr);
+  }
+  return false;
+}
+
+void vgltf_gpu_profiler_deinit(struct vgltf_gpu_profiler *profiler) {
+  assert(profiler);
+  for (uint32_t frame_index = 0; frame_index < profiler->frame_count;
+       frame_index++) {
+    struct vgltf_gpu_profiler_frame *frame = &profiler->frames[frame_index];
+    vkDestroyQueryPool(profiler->device, frame->statistics_query_pool,
+                       nullptr);
+    vkDestroyQueryPool(profiler->device, frame->timestamp_query_pool,
+                       nullptr);
+  }
+}
+
+static void push_duration(struct vgltf_gpu_profiler_pass *pass,
+                          float duration_ms) {
+  pass->durations_ms[pass->next_duration_index] = duration_ms;
+  pass->next_duration_index =
+      (pass->next_duration_index + 1) % VGLTF_GPU_PROFILER_HISTORY_LENGTH;
+  if (pass->duration_count < VGLTF_GPU_PROFILER_HISTORY_LENGTH) {
+    pass->duration_count++;
+  }
+}
+
+static bool resolve_frame(struct vgltf_gpu_profiler *profiler,
+                          struct vgltf_gpu_profiler_frame *frame) {
+  bool resolved = false;
+
+  // Passes skipped by the frame leave their queries unavailable, so each
+  // written pass is read on its own. The frame's fence has been waited on,
+  // VK_NOT_READY only happens if the frame never got submitted.
+  for (uint32_t pass = 0; pass < profiler->pass_count; pass++) {
+    if ((frame->written_pass_mask & (1u << pass)) == 0) {
+      continue;
+    }
+    uint64_t timestamps[2];
+    if (vkGetQueryPoolResults(profiler->device, frame->timestamp_query_pool,
+                              pass * 2, 2, sizeof(timestamps), timestamps,
+                              sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+      continue;
+    }
+    // The bits past the valid ones are undefined, the masked difference also
+    // holds across a wrap around
+    uint64_t ticks =
+        (timestamps[1] - timestamps[0]) & profiler->timestamp_mask;
+    push_duration(&profiler->passes[pass],
+                  (float)((double)ticks * profiler->timestamp_period /
+                          1000000.0));
+    resolved = true;
+  }
+
+  if (frame->statistics_written) {
+    uint64_t statistics[VGLTF_GPU_PROFILER_STATISTIC_COUNT];
+    if (vkGetQueryPoolResults(profiler->device, frame->statistics_query_pool,
+                              0, 1, sizeof(statistics), statistics,
+                              sizeof(statistics),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      for (int statistic = 0; statistic < VGLTF_GPU_PROFILER_STATISTIC_COUNT;
+           statistic++) {
+        profiler->statistics[statistic] = statistics[statistic];
+      }
+      resolved = true;
+    }
+  }
+
+  return resolved;
+}
+
+bool vgltf_gpu_profiler_begin_frame(struct vgltf_gpu_profiler *profiler,
+                                    VkCommandBuffer command_buffer,
+                                    uint32_t frame_index) {
+  assert(profiler);
+  assert(frame_index < profiler->frame_count);
+  profiler->current_frame = frame_index;
+  struct vgltf_gpu_profiler_frame *frame = &profiler->frames[frame_index];
+
+  bool resolved = resolve_frame(profiler, frame);
+  if (resolved) {
+    profiler->resolved_frame_count++;
+  }
+
+  frame->written_pass_mask = 0;
+  frame->statistics_written = false;
+  if (profiler->timestamps_supported) {
+    vkCmdResetQueryPool(command_buffer, frame->timestamp_query_pool, 0,
+                        profiler->pass_count * 2);
+  }
+  if (profiler->statistics_supported) {
+    vkCmdResetQueryPool(command_buffer, frame->statistics_query_pool, 0, 1);
+  }
+
+  return resolved;
+}
+
+void vgltf_gpu_profiler_begin_pass(struct vgltf_gpu_profiler *profiler,
+                                   VkCommandBuffer command_buffer,
+                                   uint32_t pass) {
+  assert(profiler);
+  assert(pass < profiler->pass_count);
+  if (!profiler->timestamps_supported) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(
+      command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      profiler->frames[profiler->current_frame].timestamp_query_pool,
+      pass * 2);
+}
+
+void vgltf_gpu_profiler_end_pass(struct vgltf_gpu_profiler *profiler,
+                                 VkCommandBuffer command_buffer,
+                                 uint32_t pass) {
+  assert(profiler);
+  assert(pass < profiler->pass_count);
+  if (!profiler->timestamps_supported) {
+    return;
+  }
+
+  struct vgltf_gpu_profiler_frame *frame =
+      &profiler->frames[profiler->current_frame];
+  vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frame->timestamp_query_pool, pass * 2 + 1);
+  frame->written_pass_mask |= 1u << pass;
+}
+
+void vgltf_gpu_profiler_begin_statistics(struct vgltf_gpu_profiler *profiler,
+                                         VkCommandBuffer command_buffer) {
+  assert(profiler);
+  if (!profiler->statistics_supported) {
+    return;
+  }
+
+  vkCmdBeginQuery(
+      command_buffer,
+      profiler->frames[profiler->current_frame].statistics_query_pool, 0, 0);
+  profiler->statistics_active = true;
+}
+
+void vgltf_gpu_profiler_end_statistics(struct vgltf_gpu_profiler *profiler,
+                                       VkCommandBuffer command_buffer) {
+  assert(profiler);
+  if (!profiler->statistics_supported) {
+    return;
+  }
+
+  struct vgltf_gpu_profiler_frame *frame =
+      &profiler->frames[profiler->current_frame];
+  vkCmdEndQuery(command_buffer, frame->statistics_query_pool, 0);
+  frame->statistics_written = true;
+  profiler->statistics_active = false;
+}
+
+VkQueryPipelineStatisticFlags vgltf_gpu_profiler_get_inherited_statistics(
+    const struct vgltf_gpu_profiler *profiler) {
+  assert(profiler);
+  return profiler->statistics_active ? STATISTIC_FLAGS : 0;
+}
+
+static int compare_durations(const void *lhs, const void *rhs) {
+  float lhs_duration = *(const float *)lhs;
+  float rhs_duration = *(const float *)rhs;
+  return (lhs_duration > rhs_duration) - (lhs_duration < rhs_duration);
+}
+
+bool vgltf_gpu_profiler_get_pass_timings(
+    const struct vgltf_gpu_profiler *profiler, uint32_t pass,
+    struct vgltf_gpu_profiler_pass_timings *timings) {
+  assert(profiler);
+  assert(pass < profiler->pass_count);
+  assert(timings);
+  const struct vgltf_gpu_profiler_pass *profiler_pass =
+      &profiler->passes[pass];
+  uint32_t duration_count = profiler_pass->duration_count;
+  if (duration_count == 0) {
+    return false;
+  }
+
+  float durations_ms[VGLTF_GPU_PROFILER_HISTORY_LENGTH];
+  float total_ms = 0.f;
+  for (uint32_t duration_index = 0; duration_index < duration_count;
+       duration_index++) {
+    durations_ms[duration_index] = profiler_pass->durations_ms[duration_index];
+    total_ms += durations_ms[duration_index];
+  }
+  qsort(durations_ms, duration_count, sizeof(float), compare_durations);
+
+  uint32_t p99_index = (uint32_t)ceilf(0.99f * (float)duration_count) - 1;
+  *timings = (struct vgltf_gpu_profiler_pass_timings){
+      .min_ms = durations_ms[0],
+      .average_ms = total_ms / (float)duration_count,
+      .p99_ms = durations_ms[p99_index]};
+  return true;
+}
+
+void vgltf_gpu_profiler_log_report(const struct vgltf_gpu_profiler *profiler) {
+  assert(profiler);
+  for (uint32_t pass = 0; pass < profiler->pass_count; pass++) {
+    struct vgltf_gpu_profiler_pass_timings timings;
+    if (!vgltf_gpu_profiler_get_pass_timings(profiler, pass, &timings)) {
+      continue;
+    }
+    VGLTF_LOG_INFO("GPU %s: min %.3fms, avg %.3fms, p99 %.3fms",
+                   profiler->passes[pass].name, timings.min_ms,
+                   timings.average_ms, timings.p99_ms);
+  }
+
+  if (profiler->statistics_supported) {
+    for (int statistic = 0; statistic < VGLTF_GPU_PROFILER_STATISTIC_COUNT;
+         statistic++) {
+      VGLTF_LOG_INFO("GPU %s: %llu", STATISTIC_NAMES[statistic],
+                     (unsigned long long)profiler->statistics[statistic]);
+    }
+  }
+}
+
+void vgltf_gpu_profiler_clear_history(struct vgltf_gpu_profiler *profiler) {
+  assert(profiler);
+  for (uint32_t pass = 0; pass < profiler->pass_count; pass++) {
+    profiler->passes[pass].duration_count = 0;
+    profiler->passes[pass].next_duration_index = 0;
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef VGLTF_RENDERER_GPU_PROFILER_H
+#define VGLTF_RENDERER_GPU_PROFILER_H
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+constexpr int VGLTF_GPU_PROFILER_MAX_FRAME_COUNT = 4;
+constexpr int VGLTF_GPU_PROFILER_MAX_PASS_COUNT = 16;
+constexpr int VGLTF_GPU_PROFILER_HISTORY_LENGTH = 128;
+
+// In the order Vulkan writes them, which is the order of the flag bits
+enum vgltf_gpu_profiler_statistic {
+  VGLTF_GPU_PROFILER_STATISTIC_VERTEX_SHADER_INVOCATIONS,
+  VGLTF_GPU_PROFILER_STATISTIC_CLIPPING_INVOCATIONS,
+  VGLTF_GPU_PROFILER_STATISTIC_CLIPPING_PRIMITIVES,
+  VGLTF_GPU_PROFILER_STATISTIC_FRAGMENT_SHADER_INVOCATIONS,
+  VGLTF_GPU_PROFILER_STATISTIC_COUNT
+};
+
+struct vgltf_gpu_profiler_pass {
+  const char *name;
+  // Ring buffer of the last resolved durations
+  float durations_ms[VGLTF_GPU_PROFILER_HISTORY_LENGTH];
+  uint32_t duration_count;
+  uint32_t next_duration_index;
+};
+
+struct vgltf_gpu_profiler_pass_timings {
+  float min_ms;
+  float average_ms;
+  float p99_ms;
+};
+
+struct vgltf_gpu_profiler_frame {
+  VkQueryPool timestamp_query_pool;
+  VkQueryPool statistics_query_pool;
+  uint32_t written_pass_mask;
+  bool statistics_written;
+};
+
+// Queries are written per frame in flight and read back once that frame's
+// fence has been waited on, so reading them never stalls
+struct vgltf_gpu_profiler {
+  VkDevice device;
+  float timestamp_period;
+  // Timestamps wrap around past their valid bits
+  uint64_t timestamp_mask;
+  bool timestamps_supported;
+  bool statistics_supported;
+  bool statistics_active;
+
+  struct vgltf_gpu_profiler_frame frames[VGLTF_GPU_PROFILER_MAX_FRAME_COUNT];
+  uint32_t frame_count;
+  uint32_t current_frame;
+
+  struct vgltf_gpu_profiler_pass passes[VGLTF_GPU_PROFILER_MAX_PASS_COUNT];
+  uint32_t pass_count;
+
+  // Statistics of the last resolved frame
+  uint64_t statistics[VGLTF_GPU_PROFILER_STATISTIC_COUNT];
+  uint64_t resolved_frame_count;
+};
+
+// Passes aren't timed when timestamp_period or timestamp_valid_bits is 0
+bool vgltf_gpu_profiler_init(struct vgltf_gpu_profiler *profiler,
+                             VkDevice device, float timestamp_period,
+                             uint32_t timestamp_valid_bits,
+                             bool statistics_supported, uint32_t frame_count,
+                             const char *const *pass_names,
+                             uint32_t pass_count);
+void vgltf_gpu_profiler_deinit(struct vgltf_gpu_profiler *profiler);
+
+// Resolves the queries last written for this frame in flight and resets them,
+// must be recorded outside of a render pass. Returns true when a frame got
+// resolved.
+bool vgltf_gpu_profiler_begin_frame(struct vgltf_gpu_profiler *profiler,
+                                    VkCommandBuffer command_buffer,
+                                    uint32_t frame_index);
+void vgltf_gpu_profiler_begin_pass(struct vgltf_gpu_profiler *profiler,
+                                   VkCommandBuffer command_buffer,
+                                   uint32_t pass);
+void vgltf_gpu_profiler_end_pass(struct vgltf_gpu_profiler *profiler,
+                                 VkCommandBuffer command_buffer,
+                                 uint32_t pass);
+
+// Pipeline statistics are collected once per frame, secondary command buffers
+// recorded in between have to inherit the returned statistics
+void vgltf_gpu_profiler_begin_statistics(struct vgltf_gpu_profiler *profiler,
+                                         VkCommandBuffer command_buffer);
+void vgltf_gpu_profiler_end_statistics(struct vgltf_gpu_profiler *profiler,
+                                       VkCommandBuffer command_buffer);
+VkQueryPipelineStatisticFlags
+vgltf_gpu_profiler_get_inherited_statistics(
+    const struct vgltf_gpu_profiler *profiler);
+
+bool vgltf_gpu_profiler_get_pass_timings(
+    const struct vgltf_gpu_profiler *profiler, uint32_t pass,
+    struct vgltf_gpu_profiler_pass_timings *timings);
+void vgltf_gpu_profiler_log_report(const struct vgltf_gpu_profiler *profiler);
+// Forgets the resolved durations, frames already in flight are still resolved
+// into the new history
+void vgltf_gpu_profiler_clear_history(struct vgltf_gpu_profiler *profiler);
+
+#endif // VGLTF_RENDERER_GPU_PROFILER_H
@@ -1,10 +1,19 @@
 #include "renderer.h"
+#include "../gltf.h"
+#include "../gltf_accessor.h"
 #include "../image.h"
 #include "../log.h"
 #include "../maths.h"
+#include "../meshlet.h"
 #include "../platform.h"
+#include "../simplify.h"
+#include "../str.h"
+#include "../string_interner.h"
 #include "vma_usage.h"
+#include <float.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <string.h>
 
 #define TINYOBJ_LOADER_C_IMPLEMENTATION
 #include "vendor/tiny_obj_loader_c.h"
@@ -12,35 +21,85 @@
 #include <assert.h>
 #include <vulkan/vulkan_core.h>
 
-static const char MODEL_PATH[] = "assets/model.obj";
+// Default texture of the OBJ models
 static const char TEXTURE_PATH[] = "assets/texture.png";
 
-VkVertexInputBindingDescription vgltf_vertex_binding_description() {
-  return (VkVertexInputBindingDescription){
-      .binding = 0,
+struct vgltf_vertex_layout vgltf_vertex_layout_float(void) {
+  return (struct vgltf_vertex_layout){
+      .formats = {[VGLTF_VERTEX_ATTRIBUTE_POSITION] =
+                      VK_FORMAT_R32G32B32_SFLOAT,
+                  [VGLTF_VERTEX_ATTRIBUTE_COLOR] = VK_FORMAT_R32G32B32_SFLOAT,
+                  [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] =
+                      VK_FORMAT_R32G32_SFLOAT},
+      .offsets = {[VGLTF_VERTEX_ATTRIBUTE_POSITION] =
+                      offsetof(struct vgltf_vertex, position),
+                  [VGLTF_VERTEX_ATTRIBUTE_COLOR] =
+                      offsetof(struct vgltf_vertex, color),
+                  [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] =
+                      offsetof(struct vgltf_vertex, texture_coordinates)},
       .stride = sizeof(struct vgltf_vertex),
-      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+      .position_stride = sizeof(vgltf_vec3)};
+}
+
+struct vgltf_vertex_layout
+vgltf_vertex_layout_compact(bool has_colors, bool has_texture_coordinates,
+                            bool half_texture_coordinates) {
+  struct vgltf_vertex_layout layout = {
+      .formats = {[VGLTF_VERTEX_ATTRIBUTE_POSITION] =
+                      VK_FORMAT_R16G16B16A16_SNORM,
+                  [VGLTF_VERTEX_ATTRIBUTE_COLOR] = VK_FORMAT_R8G8B8A8_UNORM,
+                  [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] =
+                      half_texture_coordinates ? VK_FORMAT_R16G16_SFLOAT
+                                               : VK_FORMAT_R32G32_SFLOAT},
+      .constant = {[VGLTF_VERTEX_ATTRIBUTE_COLOR] = !has_colors,
+                   [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] =
+                       !has_texture_coordinates},
+      .mesh_relative_positions = true};
+  // Each attribute is 8 or 4 bytes, the constants are white and 0, 0
+  uint32_t sizes[VGLTF_VERTEX_ATTRIBUTE_COUNT] = {
+      8, 4, half_texture_coordinates ? 4 : 8};
+  for (int attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+       attribute++) {
+    uint32_t *size =
+        layout.constant[attribute] ? &layout.constant_size : &layout.stride;
+    layout.offsets[attribute] = *size;
+    *size += sizes[attribute];
+  }
+  layout.position_stride = sizes[VGLTF_VERTEX_ATTRIBUTE_POSITION];
+  if (!has_colors) {
+    uint32_t offset = layout.offsets[VGLTF_VERTEX_ATTRIBUTE_COLOR];
+    memset(&layout.constant_values[offset], 0xff,
+           sizes[VGLTF_VERTEX_ATTRIBUTE_COLOR]);
+  }
+  return layout;
 }
+
+struct vgltf_vertex_input_binding_descriptions
+vgltf_vertex_binding_descriptions(const struct vgltf_vertex_layout *layout) {
+  return (struct vgltf_vertex_input_binding_descriptions){
+      .descriptions = {{.binding = 0,
+                        .stride = layout->stride,
+                        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX},
+                       {.binding = 1,
+                        .stride = 0,
+                        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX}},
+      .count = layout->constant_size > 0 ? 2 : 1};
+}
+
+// Attribute locations match the attribute enum
 struct vgltf_vertex_input_attribute_descriptions
-vgltf_vertex_attribute_descriptions(void) {
-  return (struct vgltf_vertex_input_attribute_descriptions){
-      .descriptions = {(VkVertexInputAttributeDescription){
-                           .binding = 0,
-                           .location = 0,
-                           .format = VK_FORMAT_R32G32B32_SFLOAT,
-                           .offset = offsetof(struct vgltf_vertex, position)},
-                       (VkVertexInputAttributeDescription){
-                           .binding = 0,
-                           .location = 1,
-                           .format = VK_FORMAT_R32G32B32_SFLOAT,
-                           .offset = offsetof(struct vgltf_vertex, color)},
-                       (VkVertexInputAttributeDescription){
-                           .binding = 0,
-                           .location = 2,
-                           .format = VK_FORMAT_R32G32_SFLOAT,
-                           .offset = offsetof(struct vgltf_vertex,
-                                              texture_coordinates)}},
-      .count = 3};
+vgltf_vertex_attribute_descriptions(const struct vgltf_vertex_layout *layout) {
+  struct vgltf_vertex_input_attribute_descriptions descriptions = {
+      .count = VGLTF_VERTEX_ATTRIBUTE_COUNT};
+  for (uint32_t attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+       attribute++) {
+    descriptions.descriptions[attribute] = (VkVertexInputAttributeDescription){
+        .binding = layout->constant[attribute] ? 1 : 0,
+        .location = attribute,
+        .format = layout->formats[attribute],
+        .offset = layout->offsets[attribute]};
+  }
+  return descriptions;
 }
 
 static const char *VALIDATION_LAYERS[] = {"VK_LAYER_KHRONOS_validation"};
@@ -53,6 +112,12 @@ static constexpr bool enable_validation_layers = true;
 static constexpr bool enable_validation_layers = false;
 #endif
 
+#ifdef VGLTF_COMPACT_VERTICES
+static constexpr bool use_compact_vertices = true;
+#else
+static constexpr bool use_compact_vertices = false;
+#endif
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL
 debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
                VkDebugUtilsMessageTypeFlagBitsEXT message_type,
@@ -211,10 +276,12 @@ static bool fetch_required_instance_extensions(
   }
   supported_instance_extensions_debug_print(&supported_extensions);
 
+  // Headless rendering doesn't need any window system extension
   uint32_t platform_required_extension_count = 0;
   const char *const *platform_required_extensions =
-      vgltf_platform_get_vulkan_instance_extensions(
-          platform, &platform_required_extension_count);
+      platform ? vgltf_platform_get_vulkan_instance_extensions(
+                     platform, &platform_required_extension_count)
+               : nullptr;
   for (uint32_t platform_required_extension_index = 0;
        platform_required_extension_index < platform_required_extension_count;
        platform_required_extension_index++) {
@@ -272,6 +339,7 @@ static void populate_debug_messenger_create_info(
 
 static bool vgltf_vk_instance_init(struct vgltf_vk_instance *instance,
                                    struct vgltf_platform *platform) {
+  VGLTF_TRACE_ZONE(__func__);
   VGLTF_LOG_INFO("Creating vulkan instance...");
   if (enable_validation_layers && !are_validation_layer_supported()) {
     VGLTF_LOG_ERR("Requested validation layers aren't supported");
@@ -397,6 +465,7 @@ err:
 struct queue_family_indices {
   uint32_t graphics_family;
   uint32_t present_family;
+  uint32_t graphics_timestamp_valid_bits;
   bool has_graphics_family;
   bool has_present_family;
 };
@@ -428,12 +497,19 @@ bool queue_family_indices_for_device(struct queue_family_indices *indices,
     VkQueueFamilyProperties *queue_family =
         &queue_family_properties[queue_family_index];
 
-    VkBool32 present_support;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, queue_family_index, surface,
-                                         &present_support);
+    // Without a surface nothing gets presented, the present queue is the
+    // graphics queue
+    VkBool32 present_support =
+        (queue_family->queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+    if (surface != VK_NULL_HANDLE) {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, queue_family_index, surface,
+                                           &present_support);
+    }
 
     if (queue_family->queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices->graphics_family = queue_family_index;
+      indices->graphics_timestamp_valid_bits =
+          queue_family->timestampValidBits;
       indices->has_graphics_family = true;
     }
 
@@ -517,20 +593,36 @@ static const char *DEVICE_EXTENSIONS[] = {
 };
 static constexpr int DEVICE_EXTENSION_COUNT =
     sizeof(DEVICE_EXTENSIONS) / sizeof(DEVICE_EXTENSIONS[0]);
-static bool are_device_extensions_supported(VkPhysicalDevice device) {
+// The swapchain extension is only required when rendering to a surface
+static uint32_t required_device_extensions(const char **extensions,
+                                           VkSurfaceKHR surface) {
+  uint32_t extension_count = 0;
+  for (int extension_index = 0; extension_index < DEVICE_EXTENSION_COUNT;
+       extension_index++) {
+    if (surface == VK_NULL_HANDLE &&
+        strcmp(DEVICE_EXTENSIONS[extension_index],
+               VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
+      continue;
+    }
+    extensions[extension_count++] = DEVICE_EXTENSIONS[extension_index];
+  }
+  return extension_count;
+}
+static bool are_device_extensions_supported(VkPhysicalDevice device,
+                                            VkSurfaceKHR surface) {
   struct supported_extensions supported_extensions = {};
   if (!supported_extensions_init(&supported_extensions, device)) {
     goto err;
   }
 
+  const char *extensions[DEVICE_EXTENSION_COUNT];
+  uint32_t extension_count = required_device_extensions(extensions, surface);
   for (uint32_t required_extension_index = 0;
-       required_extension_index < DEVICE_EXTENSION_COUNT;
+       required_extension_index < extension_count;
        required_extension_index++) {
     if (!supported_extensions_includes_extension(
-            &supported_extensions,
-            DEVICE_EXTENSIONS[required_extension_index])) {
-      VGLTF_LOG_DBG("Unsupported: %s",
-                    DEVICE_EXTENSIONS[required_extension_index]);
+            &supported_extensions, extensions[required_extension_index])) {
+      VGLTF_LOG_DBG("Unsupported: %s", extensions[required_extension_index]);
       goto err;
     }
   }
@@ -598,17 +690,38 @@ err:
   return false;
 }
 
+// Draws read their instance through firstInstance, materials index a
+// partially bound texture array. There is no fallback without these.
+static bool is_bindless_supported(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &vulkan12_features};
+  vkGetPhysicalDeviceFeatures2(device, &features);
+  return features.features.drawIndirectFirstInstance &&
+         vulkan12_features.runtimeDescriptorArray &&
+         vulkan12_features.descriptorBindingPartiallyBound &&
+         vulkan12_features.shaderSampledImageArrayNonUniformIndexing;
+}
+
 static bool is_physical_device_suitable(VkPhysicalDevice device,
                                         VkSurfaceKHR surface) {
   struct queue_family_indices indices = {};
   queue_family_indices_for_device(&indices, device, surface);
 
   VGLTF_LOG_DBG("Checking for physical device extension support");
-  bool extensions_supported = are_device_extensions_supported(device);
+  bool extensions_supported = are_device_extensions_supported(device, surface);
   VGLTF_LOG_DBG("Supported: %d", extensions_supported);
 
-  bool swapchain_adequate = false;
-  if (extensions_supported) {
+  bool swapchain_adequate = surface == VK_NULL_HANDLE;
+  if (extensions_supported && !swapchain_adequate) {
 
     VGLTF_LOG_DBG("Checking for swapchain support details");
     struct swapchain_support_details swapchain_support_details = {};
@@ -625,8 +738,12 @@ static bool is_physical_device_suitable(VkPhysicalDevice device,
   VkPhysicalDeviceFeatures supported_features;
   vkGetPhysicalDeviceFeatures(device, &supported_features);
 
+  bool bindless_supported = is_bindless_supported(device);
+  VGLTF_LOG_DBG("Bindless descriptors supported: %d", bindless_supported);
+
   return queue_family_indices_is_complete(&indices) && extensions_supported &&
-         swapchain_adequate && supported_features.samplerAnisotropy;
+         swapchain_adequate && supported_features.samplerAnisotropy &&
+         bindless_supported;
 err:
   return false;
 }
@@ -654,7 +771,8 @@ static bool pick_physical_device(VkPhysicalDevice *physical_device,
   }
 
   if (vk_physical_device == VK_NULL_HANDLE) {
-    VGLTF_LOG_ERR("Failed to find a suitable GPU");
+    VGLTF_LOG_ERR("Failed to find a suitable GPU, the renderer needs Vulkan "
+                  "1.2 descriptor indexing and drawIndirectFirstInstance");
     goto err;
   }
 
@@ -665,13 +783,71 @@ err:
   return false;
 }
 
-static bool create_logical_device(VkDevice *device, VkQueue *graphics_queue,
-                                  VkQueue *present_queue,
-                                  VkPhysicalDevice physical_device,
+static void query_device_capabilities(struct vgltf_vk_device *device) {
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->physical_device, &properties);
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  if (properties.apiVersion >= VK_API_VERSION_1_2) {
+    features.pNext = &vulkan12_features;
+  }
+  vkGetPhysicalDeviceFeatures2(device->physical_device, &features);
+
+  device->max_draw_indirect_count = properties.limits.maxDrawIndirectCount;
+  device->multi_draw_indirect_supported = features.features.multiDrawIndirect;
+  device->draw_indirect_count_supported = vulkan12_features.drawIndirectCount;
+  VGLTF_LOG_INFO("Multi draw indirect: %d, draw indirect count: %d",
+                 device->multi_draw_indirect_supported,
+                 device->draw_indirect_count_supported);
+
+  // The physical device was picked with bindless support
+  device->max_bindless_texture_count = VGLTF_RENDERER_MAX_TEXTURE_COUNT;
+  uint32_t texture_limits[] = {
+      properties.limits.maxPerStageDescriptorSamplers,
+      properties.limits.maxPerStageDescriptorSampledImages,
+      properties.limits.maxDescriptorSetSamplers,
+      properties.limits.maxDescriptorSetSampledImages};
+  for (size_t limit_index = 0;
+       limit_index < sizeof(texture_limits) / sizeof(texture_limits[0]);
+       limit_index++) {
+    if (texture_limits[limit_index] < device->max_bindless_texture_count) {
+      device->max_bindless_texture_count = texture_limits[limit_index];
+    }
+  }
+  VGLTF_LOG_INFO("Max bindless texture count: %u",
+                 device->max_bindless_texture_count);
+
+  device->timestamp_period = properties.limits.timestampComputeAndGraphics
+                                 ? properties.limits.timestampPeriod
+                                 : 0.f;
+  // The triangle pass statistics are collected across secondary command
+  // buffers
+  device->pipeline_statistics_supported =
+      features.features.pipelineStatisticsQuery &&
+      features.features.inheritedQueries;
+
+  // Lets VMA report the heap budgets the texture streaming sizes itself to,
+  // VMA reads them through vkGetPhysicalDeviceMemoryProperties2
+  struct supported_extensions supported_extensions = {};
+  device->memory_budget_supported =
+      properties.apiVersion >= VK_API_VERSION_1_1 &&
+      supported_extensions_init(&supported_extensions,
+                                device->physical_device) &&
+      supported_extensions_includes_extension(
+          &supported_extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  VGLTF_LOG_INFO("Memory budget: %d", device->memory_budget_supported);
+}
+
+static bool create_logical_device(struct vgltf_vk_device *device,
                                   VkSurfaceKHR surface) {
   struct queue_family_indices queue_family_indices = {};
-  queue_family_indices_for_device(&queue_family_indices, physical_device,
-                                  surface);
+  queue_family_indices_for_device(&queue_family_indices,
+                                  device->physical_device, surface);
+  device->timestamp_valid_bits =
+      queue_family_indices.graphics_timestamp_valid_bits;
   static constexpr int MAX_QUEUE_FAMILY_COUNT = 2;
 
   uint32_t unique_queue_families[MAX_QUEUE_FAMILY_COUNT] = {};
@@ -703,26 +879,42 @@ static bool create_logical_device(VkDevice *device, VkQueue *graphics_queue,
         .pQueuePriorities = &queue_priority};
   }
 
+  VkPhysicalDeviceVulkan12Features vulkan12_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .drawIndirectCount = device->draw_indirect_count_supported,
+      .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+      .descriptorBindingPartiallyBound = VK_TRUE,
+      .runtimeDescriptorArray = VK_TRUE};
   VkPhysicalDeviceFeatures device_features = {
       .samplerAnisotropy = VK_TRUE,
+      .multiDrawIndirect = device->multi_draw_indirect_supported,
+      .drawIndirectFirstInstance = VK_TRUE,
+      .pipelineStatisticsQuery = device->pipeline_statistics_supported,
+      .inheritedQueries = device->pipeline_statistics_supported,
   };
+  const char *extensions[DEVICE_EXTENSION_COUNT + 1];
+  uint32_t extension_count = required_device_extensions(extensions, surface);
+  if (device->memory_budget_supported) {
+    extensions[extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+  }
   VkDeviceCreateInfo create_info = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = &vulkan12_features,
       .pQueueCreateInfos = queue_create_infos,
       .queueCreateInfoCount = queue_create_info_count,
       .pEnabledFeatures = &device_features,
-      .ppEnabledExtensionNames = DEVICE_EXTENSIONS,
-      .enabledExtensionCount = DEVICE_EXTENSION_COUNT};
-  if (vkCreateDevice(physical_device, &create_info, nullptr, device) !=
-      VK_SUCCESS) {
+      .ppEnabledExtensionNames = extensions,
+      .enabledExtensionCount = extension_count};
+  if (vkCreateDevice(device->physical_device, &create_info, nullptr,
+                     &device->device) != VK_SUCCESS) {
     VGLTF_LOG_ERR("Failed to create logical device");
     goto err;
   }
 
-  vkGetDeviceQueue(*device, queue_family_indices.graphics_family, 0,
-                   graphics_queue);
-  vkGetDeviceQueue(*device, queue_family_indices.present_family, 0,
-                   present_queue);
+  vkGetDeviceQueue(device->device, queue_family_indices.graphics_family, 0,
+                   &device->graphics_queue);
+  vkGetDeviceQueue(device->device, queue_family_indices.present_family, 0,
+                   &device->present_queue);
 
   return true;
 err:
@@ -736,6 +928,10 @@ static bool create_allocator(VmaAllocator *allocator,
                                         .instance = instance->instance,
                                         .physicalDevice =
                                             device->physical_device};
+  if (device->memory_budget_supported) {
+    create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    create_info.vulkanApiVersion = VK_API_VERSION_1_1;
+  }
 
   if (vmaCreateAllocator(&create_info, allocator) != VK_SUCCESS) {
     VGLTF_LOG_ERR("Couldn't create VMA allocator");
@@ -749,6 +945,7 @@ err:
 static bool vgltf_vk_surface_init(struct vgltf_vk_surface *surface,
                                   struct vgltf_vk_instance *instance,
                                   struct vgltf_platform *platform) {
+  VGLTF_TRACE_ZONE(__func__);
   if (!vgltf_platform_create_vulkan_surface(platform, instance->instance,
                                             &surface->surface)) {
     VGLTF_LOG_ERR("Couldn't create surface");
@@ -762,7 +959,10 @@ err:
 
 static void vgltf_vk_surface_deinit(struct vgltf_vk_surface *surface,
                                     struct vgltf_vk_instance *instance) {
-  vkDestroySurfaceKHR(instance->instance, surface->surface, nullptr);
+  // Headless instances don't enable VK_KHR_surface
+  if (surface->surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance->instance, surface->surface, nullptr);
+  }
 }
 
 static VkSurfaceFormatKHR
@@ -1004,10 +1204,12 @@ static VkFormat find_depth_format(struct vgltf_renderer *renderer) {
                                                   VK_FORMAT_D32_SFLOAT_S8_UINT,
                                                   VK_FORMAT_D24_UNORM_S8_UINT},
                                3, VK_IMAGE_TILING_OPTIMAL,
-                               VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+                               VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                   VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
 
 static bool vgltf_renderer_create_render_pass(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkAttachmentDescription color_attachment = {
       .format = renderer->swapchain.swapchain_image_format,
       .samples = VK_SAMPLE_COUNT_1_BIT,
@@ -1016,40 +1218,86 @@ static bool vgltf_renderer_create_render_pass(struct vgltf_renderer *renderer) {
       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+      // Headless frames are left ready to be copied from
+      .finalLayout = renderer->headless
+                         ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                         : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
   VkAttachmentReference color_attachment_ref = {
       .attachment = 0,
       .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
   };
+  // The depth buffer is kept for building the depth pyramid used for
+  // occlusion culling
   VkAttachmentDescription depth_attachment = {
       .format = find_depth_format(renderer),
       .samples = VK_SAMPLE_COUNT_1_BIT,
       .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-      .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
       .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
       .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
       .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+      .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
   VkAttachmentReference depth_attachment_ref = {
       .attachment = 1,
       .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
   };
 
-  VkSubpassDescription subpass = {
-      .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-      .pColorAttachments = &color_attachment_ref,
-      .colorAttachmentCount = 1,
-      .pDepthStencilAttachment = &depth_attachment_ref};
-  VkSubpassDependency dependency = {
-      .srcSubpass = VK_SUBPASS_EXTERNAL,
-      .dstSubpass = 0,
-      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-      .srcAccessMask = 0,
-      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+  // The depth prepass subpass only writes depth, the main subpass shades
+  VkSubpassDescription subpasses[VGLTF_RENDERER_SUBPASS_COUNT] = {
+      [VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS] =
+          {.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+           .pDepthStencilAttachment = &depth_attachment_ref},
+      [VGLTF_RENDERER_SUBPASS_MAIN] = {
+          .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+          .pColorAttachments = &color_attachment_ref,
+          .colorAttachmentCount = 1,
+          .pDepthStencilAttachment = &depth_attachment_ref}};
+  VkSubpassDependency dependencies[] = {
+      // The depth pyramid of the previous frame is built from the depth
+      // buffer
+      (VkSubpassDependency){
+          .srcSubpass = VK_SUBPASS_EXTERNAL,
+          .dstSubpass = VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS,
+          .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+          .srcAccessMask = 0,
+          .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT},
+      (VkSubpassDependency){
+          .srcSubpass = VK_SUBPASS_EXTERNAL,
+          .dstSubpass = VGLTF_RENDERER_SUBPASS_MAIN,
+          .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .srcAccessMask = 0,
+          .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+      // The main subpass tests against the prepass depths, and writes depth
+      // itself when the prepass is disabled
+      (VkSubpassDependency){
+          .srcSubpass = VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS,
+          .dstSubpass = VGLTF_RENDERER_SUBPASS_MAIN,
+          .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+          .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT},
+      // The color target may then be copied for a frame readback
+      (VkSubpassDependency){
+          .srcSubpass = VGLTF_RENDERER_SUBPASS_MAIN,
+          .dstSubpass = VK_SUBPASS_EXTERNAL,
+          .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                           VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          .dstAccessMask =
+              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT}};
+  int dependency_count = sizeof(dependencies) / sizeof(dependencies[0]);
 
   VkAttachmentDescription attachments[] = {color_attachment, depth_attachment};
   int attachment_count = sizeof(attachments) / sizeof(attachments[0]);
@@ -1057,10 +1305,10 @@ static bool vgltf_renderer_create_render_pass(struct vgltf_renderer *renderer) {
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
       .attachmentCount = attachment_count,
       .pAttachments = attachments,
-      .subpassCount = 1,
-      .pSubpasses = &subpass,
-      .dependencyCount = 1,
-      .pDependencies = &dependency};
+      .subpassCount = VGLTF_RENDERER_SUBPASS_COUNT,
+      .pSubpasses = subpasses,
+      .dependencyCount = dependency_count,
+      .pDependencies = dependencies};
 
   if (vkCreateRenderPass(renderer->device.device, &render_pass_info, nullptr,
                          &renderer->render_pass) != VK_SUCCESS) {
@@ -1075,25 +1323,48 @@ err:
 
 static bool
 vgltf_renderer_create_descriptor_set_layout(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkDescriptorSetLayoutBinding ubo_layout_binding = {
       .binding = 0,
       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
       .descriptorCount = 1,
       .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
   };
-  VkDescriptorSetLayoutBinding sampler_layout_binding = {
+  VkDescriptorSetLayoutBinding instance_layout_binding = {
       .binding = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+  };
+  VkDescriptorSetLayoutBinding material_layout_binding = {
+      .binding = 2,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
       .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+  };
+  VkDescriptorSetLayoutBinding texture_layout_binding = {
+      .binding = 3,
+      .descriptorCount = renderer->device.max_bindless_texture_count,
       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
       .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
   };
 
-  VkDescriptorSetLayoutBinding bindings[] = {ubo_layout_binding,
-                                             sampler_layout_binding};
+  VkDescriptorSetLayoutBinding bindings[] = {
+      ubo_layout_binding, instance_layout_binding, material_layout_binding,
+      texture_layout_binding};
   int binding_count = sizeof(bindings) / sizeof(bindings[0]);
 
+  // Only the loaded textures are written to the texture array
+  VkDescriptorBindingFlags binding_flags[] = {
+      0, 0, 0, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT};
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+      .bindingCount = binding_count,
+      .pBindingFlags = binding_flags};
+
   VkDescriptorSetLayoutCreateInfo layout_info = {
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .pNext = &binding_flags_info,
       .bindingCount = binding_count,
       .pBindings = bindings};
 
@@ -1110,12 +1381,16 @@ err:
 
 static bool
 vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   static unsigned char triangle_shader_vert_code[] = {
 #embed "../../compiled_shaders/triangle.vert.spv"
   };
   static unsigned char triangle_shader_frag_code[] = {
 #embed "../../compiled_shaders/triangle.frag.spv"
   };
+  static unsigned char depth_shader_vert_code[] = {
+#embed "../../compiled_shaders/depth.vert.spv"
+  };
 
   VkShaderModule triangle_shader_vert_module;
   if (!create_shader_module(renderer->device.device, triangle_shader_vert_code,
@@ -1133,6 +1408,14 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
     goto destroy_vert_shader_module;
   }
 
+  VkShaderModule depth_shader_vert_module;
+  if (!create_shader_module(renderer->device.device, depth_shader_vert_code,
+                            sizeof(depth_shader_vert_code),
+                            &depth_shader_vert_module)) {
+    VGLTF_LOG_ERR("Couldn't create depth vert shader module");
+    goto destroy_frag_shader_module;
+  }
+
   VkPipelineShaderStageCreateInfo triangle_shader_vert_stage_create_info = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
       .stage = VK_SHADER_STAGE_VERTEX_BIT,
@@ -1146,6 +1429,12 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
   VkPipelineShaderStageCreateInfo shader_stages[] = {
       triangle_shader_vert_stage_create_info,
       triangle_shader_frag_stage_create_info};
+  // No fragment shader, the rasterizer writes the depths
+  VkPipelineShaderStageCreateInfo depth_shader_stages[] = {
+      {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+       .stage = VK_SHADER_STAGE_VERTEX_BIT,
+       .module = depth_shader_vert_module,
+       .pName = "main"}};
 
   VkDynamicState dynamic_states[] = {
       VK_DYNAMIC_STATE_VIEWPORT,
@@ -1157,19 +1446,39 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
       .dynamicStateCount = sizeof(dynamic_states) / sizeof(dynamic_states[0]),
       .pDynamicStates = dynamic_states};
 
-  VkVertexInputBindingDescription vertex_binding_description =
-      vgltf_vertex_binding_description();
+  // The vertex layout is chosen by the model loader
+  struct vgltf_vertex_input_binding_descriptions vertex_binding_descriptions =
+      vgltf_vertex_binding_descriptions(&renderer->vertex_layout);
   struct vgltf_vertex_input_attribute_descriptions
-      vertex_attribute_descriptions = vgltf_vertex_attribute_descriptions();
+      vertex_attribute_descriptions =
+          vgltf_vertex_attribute_descriptions(&renderer->vertex_layout);
 
   VkPipelineVertexInputStateCreateInfo vertex_input_info = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-      .vertexBindingDescriptionCount = 1,
+      .vertexBindingDescriptionCount = vertex_binding_descriptions.count,
       .vertexAttributeDescriptionCount = vertex_attribute_descriptions.count,
-      .pVertexBindingDescriptions = &vertex_binding_description,
+      .pVertexBindingDescriptions = vertex_binding_descriptions.descriptions,
       .pVertexAttributeDescriptions =
           vertex_attribute_descriptions.descriptions};
 
+  // The depth pipeline only reads the position stream
+  VkVertexInputBindingDescription position_binding_description = {
+      .binding = 0,
+      .stride = renderer->vertex_layout.position_stride,
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
+  VkVertexInputAttributeDescription position_attribute_description = {
+      .binding = 0,
+      .location = VGLTF_VERTEX_ATTRIBUTE_POSITION,
+      .format =
+          renderer->vertex_layout.formats[VGLTF_VERTEX_ATTRIBUTE_POSITION],
+      .offset = 0};
+  VkPipelineVertexInputStateCreateInfo position_vertex_input_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = 1,
+      .vertexAttributeDescriptionCount = 1,
+      .pVertexBindingDescriptions = &position_binding_description,
+      .pVertexAttributeDescriptions = &position_attribute_description};
+
   VkPipelineInputAssemblyStateCreateInfo input_assembly = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
       .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
@@ -1211,6 +1520,16 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
       .depthBoundsTestEnable = VK_FALSE,
       .stencilTestEnable = VK_FALSE,
   };
+  // The prepass already wrote the nearest depths, only the fragments at that
+  // depth are shaded
+  VkPipelineDepthStencilStateCreateInfo depth_equal_stencil = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = VK_FALSE,
+      .depthCompareOp = VK_COMPARE_OP_EQUAL,
+      .depthBoundsTestEnable = VK_FALSE,
+      .stencilTestEnable = VK_FALSE,
+  };
 
   VkPipelineColorBlendStateCreateInfo color_blending = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
@@ -1227,10 +1546,11 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
                              nullptr,
                              &renderer->pipeline_layout) != VK_SUCCESS) {
     VGLTF_LOG_ERR("Couldn't create pipeline layout");
-    goto destroy_frag_shader_module;
+    goto destroy_depth_shader_module;
   }
 
-  VkGraphicsPipelineCreateInfo pipeline_info = {
+  // The pipelines share the fixed function state and the layout
+  VkGraphicsPipelineCreateInfo graphics_pipeline_info = {
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
       .stageCount = 2,
       .pStages = shader_stages,
@@ -1244,16 +1564,57 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
       .pDynamicState = &dynamic_state,
       .layout = renderer->pipeline_layout,
       .renderPass = renderer->render_pass,
-      .subpass = 0,
+      .subpass = VGLTF_RENDERER_SUBPASS_MAIN,
   };
-
-  if (vkCreateGraphicsPipelines(renderer->device.device, VK_NULL_HANDLE, 1,
-                                &pipeline_info, nullptr,
-                                &renderer->graphics_pipeline) != VK_SUCCESS) {
+  VkGraphicsPipelineCreateInfo depth_equal_graphics_pipeline_info =
+      graphics_pipeline_info;
+  depth_equal_graphics_pipeline_info.pDepthStencilState = &depth_equal_stencil;
+  // The prepass subpass has no color attachment, so no color blend state
+  VkGraphicsPipelineCreateInfo depth_pipeline_info = graphics_pipeline_info;
+  depth_pipeline_info.stageCount = 1;
+  depth_pipeline_info.pStages = depth_shader_stages;
+  depth_pipeline_info.pVertexInputState = &position_vertex_input_info;
+  depth_pipeline_info.pColorBlendState = nullptr;
+  depth_pipeline_info.subpass = VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS;
+
+  // Each pipeline once per winding, the mirrored instances are drawn with
+  // clockwise front faces
+  VkPipelineRasterizationStateCreateInfo
+      rasterizers[VGLTF_RENDERER_WINDING_COUNT] = {rasterizer, rasterizer};
+  rasterizers[VGLTF_RENDERER_WINDING_CLOCKWISE].frontFace =
+      VK_FRONT_FACE_CLOCKWISE;
+  static constexpr uint32_t pipeline_kind_count = 3;
+  VkGraphicsPipelineCreateInfo
+      pipeline_infos[VGLTF_RENDERER_WINDING_COUNT * pipeline_kind_count];
+  for (uint32_t winding = 0; winding < VGLTF_RENDERER_WINDING_COUNT;
+       winding++) {
+    VkGraphicsPipelineCreateInfo *winding_pipeline_infos =
+        &pipeline_infos[winding * pipeline_kind_count];
+    winding_pipeline_infos[0] = graphics_pipeline_info;
+    winding_pipeline_infos[1] = depth_equal_graphics_pipeline_info;
+    winding_pipeline_infos[2] = depth_pipeline_info;
+    for (uint32_t kind = 0; kind < pipeline_kind_count; kind++) {
+      winding_pipeline_infos[kind].pRasterizationState = &rasterizers[winding];
+    }
+  }
+  VkPipeline pipelines[VGLTF_RENDERER_WINDING_COUNT * pipeline_kind_count];
+  if (vkCreateGraphicsPipelines(
+          renderer->device.device, VK_NULL_HANDLE,
+          VGLTF_RENDERER_WINDING_COUNT * pipeline_kind_count, pipeline_infos,
+          nullptr, pipelines) != VK_SUCCESS) {
     VGLTF_LOG_ERR("Couldn't create pipeline");
     goto destroy_pipeline_layout;
   }
+  for (uint32_t winding = 0; winding < VGLTF_RENDERER_WINDING_COUNT;
+       winding++) {
+    VkPipeline *winding_pipelines = &pipelines[winding * pipeline_kind_count];
+    renderer->graphics_pipelines[winding] = winding_pipelines[0];
+    renderer->depth_equal_graphics_pipelines[winding] = winding_pipelines[1];
+    renderer->depth_pipelines[winding] = winding_pipelines[2];
+  }
 
+  vkDestroyShaderModule(renderer->device.device, depth_shader_vert_module,
+                        nullptr);
   vkDestroyShaderModule(renderer->device.device, triangle_shader_frag_module,
                         nullptr);
   vkDestroyShaderModule(renderer->device.device, triangle_shader_vert_module,
@@ -1262,6 +1623,9 @@ vgltf_renderer_create_graphics_pipeline(struct vgltf_renderer *renderer) {
 destroy_pipeline_layout:
   vkDestroyPipelineLayout(renderer->device.device, renderer->pipeline_layout,
                           nullptr);
+destroy_depth_shader_module:
+  vkDestroyShaderModule(renderer->device.device, depth_shader_vert_module,
+                        nullptr);
 destroy_frag_shader_module:
   vkDestroyShaderModule(renderer->device.device, triangle_shader_frag_module,
                         nullptr);
@@ -1274,6 +1638,7 @@ err:
 
 static bool
 vgltf_renderer_create_framebuffers(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   for (uint32_t i = 0; i < renderer->swapchain.swapchain_image_count; i++) {
     VkImageView attachments[] = {renderer->swapchain.swapchain_image_views[i],
                                  renderer->depth_image_view};
@@ -1303,6 +1668,7 @@ err:
 
 static bool
 vgltf_renderer_create_command_pool(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   struct queue_family_indices queue_family_indices = {};
   if (!queue_family_indices_for_device(&queue_family_indices,
                                        renderer->device.physical_device,
@@ -1456,6 +1822,13 @@ static bool transition_image_layout(struct vgltf_renderer *renderer,
                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     destination_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
+             new_layout == VK_IMAGE_LAYOUT_GENERAL) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask =
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    destination_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
   } else {
     goto err;
   }
@@ -1469,33 +1842,15 @@ err:
   return false;
 }
 
-void copy_buffer_to_image(struct vgltf_renderer *renderer, VkBuffer buffer,
-                          VkImage image, uint32_t width, uint32_t height) {
-  VkCommandBuffer command_buffer = begin_single_time_commands(renderer);
-  VkBufferImageCopy region = {
-      .bufferOffset = 0,
-      .bufferRowLength = 0,
-      .bufferImageHeight = 0,
-      .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .mipLevel = 0,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1},
-      .imageOffset = {0, 0, 0},
-      .imageExtent = {width, height, 1}};
-
-  vkCmdCopyBufferToImage(command_buffer, buffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-  end_single_time_commands(renderer, command_buffer);
-}
-
 static bool
 vgltf_renderer_create_depth_resources(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkFormat depth_format = find_depth_format(renderer);
   vgltf_renderer_create_image(
       renderer, renderer->swapchain.swapchain_extent.width,
       renderer->swapchain.swapchain_extent.height, 1, depth_format,
-      VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->depth_image);
   create_image_view(&renderer->device, renderer->depth_image.image,
                     depth_format, &renderer->depth_image_view,
@@ -1535,148 +1890,40 @@ err:
   return false;
 }
 
-static void generate_mipmaps(struct vgltf_renderer *renderer, VkImage image,
-                             VkFormat image_format, int32_t texture_width,
-                             int32_t texture_height, uint32_t mip_levels) {
-  VkFormatProperties format_properties;
-  vkGetPhysicalDeviceFormatProperties(renderer->device.physical_device,
-                                      image_format, &format_properties);
-  if (!(format_properties.optimalTilingFeatures &
-        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-    VGLTF_PANIC("Texture image format does not support linear blitting!");
+// Appends the image to the bindless texture array, its levels are streamed
+// from then on
+static bool vgltf_renderer_upload_texture(struct vgltf_renderer *renderer,
+                                          const struct vgltf_image *image,
+                                          uint32_t *texture_index) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (renderer->texture_streaming.texture_count ==
+      renderer->device.max_bindless_texture_count) {
+    VGLTF_LOG_ERR("Texture array is full");
+    return false;
   }
 
-  VkCommandBuffer command_buffer = begin_single_time_commands(renderer);
-  VkImageMemoryBarrier barrier = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-      .image = image,
-      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1,
-                           .levelCount = 1}};
-
-  int32_t mip_width = texture_width;
-  int32_t mip_height = texture_height;
-
-  for (uint32_t i = 1; i < mip_levels; i++) {
-    barrier.subresourceRange.baseMipLevel = i - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                         nullptr, 1, &barrier);
-    VkImageBlit blit = {
-        .srcOffsets = {{0, 0, 0}, {mip_width, mip_height, 1}},
-        .srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .mipLevel = i - 1,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1},
-        .dstOffsets = {{0, 0, 0},
-                       {mip_width > 1 ? mip_width / 2 : 1,
-                        mip_height > 1 ? mip_height / 2 : 1, 1}},
-        .dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                           .mipLevel = i,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1},
-    };
-    vkCmdBlitImage(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                   image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
-                   VK_FILTER_LINEAR);
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                         0, nullptr, 1, &barrier);
-    if (mip_width > 1)
-      mip_width /= 2;
-    if (mip_height > 1)
-      mip_height /= 2;
-  }
-  barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
-                       nullptr, 1, &barrier);
-
-  end_single_time_commands(renderer, command_buffer);
+  return vgltf_texture_streaming_add(&renderer->texture_streaming, image,
+                                     texture_index);
 }
 
-static bool
-vgltf_renderer_create_texture_image(struct vgltf_renderer *renderer) {
+static bool vgltf_renderer_load_texture(struct vgltf_renderer *renderer,
+                                        struct vgltf_string_view path,
+                                        uint32_t *texture_index) {
   struct vgltf_image image;
-  if (!vgltf_image_load_from_file(&image, SV(TEXTURE_PATH))) {
-    VGLTF_LOG_ERR("Couldn't load image from file");
-    goto err;
-  }
-  renderer->mip_level_count =
-      floor(log2(VGLTF_MAX(image.width, image.height))) + 1;
-
-  VkDeviceSize image_size = image.width * image.height * 4;
-  struct vgltf_renderer_allocated_buffer staging_buffer = {};
-  if (!vgltf_renderer_create_buffer(renderer, image_size,
-                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                    &staging_buffer)) {
-    VGLTF_LOG_ERR("Couldn't create staging buffer");
-    goto deinit_image;
+  if (!vgltf_image_load_from_file(&image, path)) {
+    VGLTF_LOG_ERR("Couldn't load image from file %s", path.data);
+    return false;
   }
 
-  void *data;
-  vmaMapMemory(renderer->device.allocator, staging_buffer.allocation, &data);
-  memcpy(data, image.data, image_size);
-  vmaUnmapMemory(renderer->device.allocator, staging_buffer.allocation);
-
-  vgltf_renderer_create_image(
-      renderer, image.width, image.height, renderer->mip_level_count,
-      VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-      VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-          VK_IMAGE_USAGE_SAMPLED_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->texture_image);
-
-  transition_image_layout(renderer, renderer->texture_image.image,
-                          VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          renderer->mip_level_count);
-  copy_buffer_to_image(renderer, staging_buffer.buffer,
-                       renderer->texture_image.image, image.width,
-                       image.height);
-
-  generate_mipmaps(renderer, renderer->texture_image.image,
-                   VK_FORMAT_R8G8B8A8_SRGB, image.width, image.height,
-                   renderer->mip_level_count);
-
-  vmaDestroyBuffer(renderer->device.allocator, staging_buffer.buffer,
-                   staging_buffer.allocation);
-  vgltf_image_deinit(&image);
-  return true;
-deinit_image:
+  bool uploaded =
+      vgltf_renderer_upload_texture(renderer, &image, texture_index);
   vgltf_image_deinit(&image);
-err:
-  return false;
-}
-
-static bool
-vgltf_renderer_create_texture_image_view(struct vgltf_renderer *renderer) {
-  return create_image_view(
-      &renderer->device, renderer->texture_image.image, VK_FORMAT_R8G8B8A8_SRGB,
-      &renderer->texture_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
-      renderer->mip_level_count);
+  return uploaded;
 }
 
 static bool
 vgltf_renderer_create_texture_sampler(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkPhysicalDeviceProperties properties = {};
   vkGetPhysicalDeviceProperties(renderer->device.physical_device, &properties);
 
@@ -1696,7 +1943,7 @@ vgltf_renderer_create_texture_sampler(struct vgltf_renderer *renderer) {
       .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
       .mipLodBias = 0.f,
       .minLod = 0.f,
-      .maxLod = renderer->mip_level_count};
+      .maxLod = VK_LOD_CLAMP_NONE};
 
   if (vkCreateSampler(renderer->device.device, &sampler_info, nullptr,
                       &renderer->texture_sampler) != VK_SUCCESS) {
@@ -1712,6 +1959,7 @@ static void get_file_data(void *ctx, const char *filename, const int is_mtl,
                           const char *obj_filename, char **data, size_t *len) {
   (void)ctx;
   (void)is_mtl;
+  (void)obj_filename;
 
   if (!filename) {
     VGLTF_LOG_ERR("Null filename");
@@ -1719,10 +1967,353 @@ static void get_file_data(void *ctx, const char *filename, const int is_mtl,
     *len = 0;
     return;
   }
-  *data = vgltf_platform_read_file_to_string(obj_filename, len);
+  // The material library path is already relative to the working directory
+  *data = vgltf_platform_read_file_to_string(filename, len);
+  // Names and texture paths are used as UTF-8 from then on
+  if (*data && !vgltf_string_view_utf8_validate((struct vgltf_string_view){
+                   .data = *data, .length = *len})) {
+    VGLTF_LOG_ERR("%s isn't valid UTF-8", filename);
+    vgltf_platform_free_file_data(*data);
+    *data = nullptr;
+    *len = 0;
+  }
+}
+
+// Material 0 is the default material, the OBJ material i becomes material
+// i + 1
+static bool load_obj_materials(struct vgltf_renderer *renderer,
+                               struct vgltf_string_view model_directory,
+                               const tinyobj_material_t *materials,
+                               size_t material_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (material_count + 1 > VGLTF_RENDERER_MAX_MATERIAL_COUNT) {
+    VGLTF_LOG_ERR("Material array cannot fit all the materials of the model");
+    goto err;
+  }
+
+  uint32_t default_texture_index;
+  if (!vgltf_renderer_load_texture(renderer, SV(TEXTURE_PATH),
+                                   &default_texture_index)) {
+    VGLTF_LOG_ERR("Couldn't load the default texture");
+    goto err;
+  }
+  renderer->materials[renderer->material_count++] =
+      (struct vgltf_renderer_material){
+          .base_color_factor = {1.f, 1.f, 1.f, 1.f},
+          .base_color_texture_index = default_texture_index};
+
+  for (size_t material_index = 0; material_index < material_count;
+       material_index++) {
+    const tinyobj_material_t *material = &materials[material_index];
+    uint32_t texture_index = default_texture_index;
+    if (material->diffuse_texname) {
+      struct vgltf_string texture_path = vgltf_string_concatenate(
+          &system_allocator, model_directory, SV(material->diffuse_texname));
+      if (!vgltf_renderer_load_texture(
+              renderer, vgltf_string_view_from_string(texture_path),
+              &texture_index)) {
+        VGLTF_LOG_ERR("Couldn't load texture %s, using the default texture",
+                      texture_path.data);
+        texture_index = default_texture_index;
+      }
+      vgltf_string_deinit(&system_allocator, &texture_path);
+    }
+
+    renderer->materials[renderer->material_count++] =
+        (struct vgltf_renderer_material){
+            .base_color_factor = {material->diffuse[0], material->diffuse[1],
+                                  material->diffuse[2], 1.f},
+            .base_color_texture_index = texture_index};
+  }
+
+  return true;
+err:
+  return false;
+}
+
+static void set_mesh_bounds(struct vgltf_renderer_mesh *mesh, vgltf_vec3 min,
+                            vgltf_vec3 max, vgltf_vec_value_type radius) {
+  mesh->bounding_sphere_center = (vgltf_vec3){
+      (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+  mesh->bounding_sphere_radius = radius;
+  mesh->bounding_box_half_extent = (vgltf_vec3){
+      (max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f};
+}
+
+static void compute_mesh_bounds(struct vgltf_renderer_mesh *mesh,
+                                const struct vgltf_vertex *vertices,
+                                int vertex_count) {
+  if (vertex_count == 0) {
+    set_mesh_bounds(mesh, (vgltf_vec3){}, (vgltf_vec3){}, 0.f);
+    return;
+  }
+
+  vgltf_vec3 min = vertices[0].position;
+  vgltf_vec3 max = vertices[0].position;
+  for (int vertex_index = 1; vertex_index < vertex_count; vertex_index++) {
+    vgltf_vec3 position = vertices[vertex_index].position;
+    min = (vgltf_vec3){fminf(min.x, position.x), fminf(min.y, position.y),
+                       fminf(min.z, position.z)};
+    max = (vgltf_vec3){fmaxf(max.x, position.x), fmaxf(max.y, position.y),
+                       fmaxf(max.z, position.z)};
+  }
+
+  vgltf_vec3 center = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f,
+                       (min.z + max.z) * 0.5f};
+  vgltf_vec_value_type radius = 0.f;
+  for (int vertex_index = 0; vertex_index < vertex_count; vertex_index++) {
+    radius = fmaxf(radius, vgltf_vec3_length(vgltf_vec3_sub(
+                               vertices[vertex_index].position, center)));
+  }
+  set_mesh_bounds(mesh, min, max, radius);
+}
+
+// Vertices follow the vertex layout, then come the constant attribute values
+// and the position stream
+static size_t position_stream_offset(const struct vgltf_vertex_layout *layout,
+                                     size_t vertex_count) {
+  return vertex_count * layout->stride + layout->constant_size;
+}
+
+static size_t vertex_buffer_size(const struct vgltf_vertex_layout *layout,
+                                 size_t vertex_count) {
+  return position_stream_offset(layout, vertex_count) +
+         vertex_count * layout->position_stride;
+}
+
+static void *allocate_vertices(const struct vgltf_vertex_layout *layout,
+                               size_t vertex_count) {
+  char *vertices = vgltf_allocator_allocate(
+      &system_allocator,
+      VGLTF_MAX(vertex_buffer_size(layout, vertex_count), 1u));
+  if (vertices) {
+    memcpy(vertices + vertex_count * layout->stride, layout->constant_values,
+           layout->constant_size);
+  }
+  return vertices;
+}
+
+// Copies the positions of the vertices [first_vertex, first_vertex + count)
+// to the position stream
+static void write_position_stream(const struct vgltf_renderer *renderer,
+                                  size_t first_vertex, size_t count) {
+  const struct vgltf_vertex_layout *layout = &renderer->vertex_layout;
+  const char *vertices = (const char *)renderer->vertices +
+                         first_vertex * layout->stride +
+                         layout->offsets[VGLTF_VERTEX_ATTRIBUTE_POSITION];
+  char *positions =
+      (char *)renderer->vertices +
+      position_stream_offset(layout, (size_t)renderer->vertex_count) +
+      first_vertex * layout->position_stride;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(positions + i * layout->position_stride,
+           vertices + i * layout->stride, layout->position_stride);
+  }
+}
+
+// Component of a position as the vertex input format converts it
+static float read_position_component(VkFormat format, const char *position,
+                                     int component) {
+  float float_value;
+  int16_t short_value;
+  uint16_t unsigned_short_value;
+  switch (format) {
+  case VK_FORMAT_R32G32B32_SFLOAT:
+    memcpy(&float_value, position + component * sizeof(float), sizeof(float));
+    return float_value;
+  case VK_FORMAT_R8G8B8A8_SNORM:
+    return fmaxf((int8_t)position[component] / 127.f, -1.f);
+  case VK_FORMAT_R8G8B8A8_UNORM:
+    return (uint8_t)position[component] / 255.f;
+  case VK_FORMAT_R8G8B8A8_SSCALED:
+    return (int8_t)position[component];
+  case VK_FORMAT_R8G8B8A8_USCALED:
+    return (uint8_t)position[component];
+  case VK_FORMAT_R16G16B16A16_SNORM:
+    memcpy(&short_value, position + component * sizeof(int16_t),
+           sizeof(int16_t));
+    return fmaxf(short_value / 32767.f, -1.f);
+  case VK_FORMAT_R16G16B16A16_UNORM:
+    memcpy(&unsigned_short_value, position + component * sizeof(uint16_t),
+           sizeof(uint16_t));
+    return unsigned_short_value / 65535.f;
+  case VK_FORMAT_R16G16B16A16_SSCALED:
+    memcpy(&short_value, position + component * sizeof(int16_t),
+           sizeof(int16_t));
+    return short_value;
+  case VK_FORMAT_R16G16B16A16_USCALED:
+    memcpy(&unsigned_short_value, position + component * sizeof(uint16_t),
+           sizeof(uint16_t));
+    return unsigned_short_value;
+  default:
+    return 0.f;
+  }
+}
+
+// Position of a vertex as the vertex shaders read it, from the position
+// stream
+static vgltf_vec3 read_stream_position(const struct vgltf_renderer *renderer,
+                                       size_t vertex) {
+  const struct vgltf_vertex_layout *layout = &renderer->vertex_layout;
+  VkFormat format = layout->formats[VGLTF_VERTEX_ATTRIBUTE_POSITION];
+  const char *position =
+      (const char *)renderer->vertices +
+      position_stream_offset(layout, (size_t)renderer->vertex_count) +
+      vertex * layout->position_stride;
+  return (vgltf_vec3){read_position_component(format, position, 0),
+                      read_position_component(format, position, 1),
+                      read_position_component(format, position, 2)};
+}
+
+static int16_t quantize_snorm16(float value) {
+  return (int16_t)lrintf(fminf(fmaxf(value, -1.f), 1.f) * INT16_MAX);
+}
+
+static unsigned char quantize_unorm8(float value) {
+  return (unsigned char)lrintf(fminf(fmaxf(value, 0.f), 1.f) * UINT8_MAX);
+}
+
+// Below 2 in magnitude, half floats are at most 2^-10 apart, a texel of a 1024
+// texels wide texture. Texture coordinates past it are stored as floats.
+static constexpr float HALF_TEXTURE_COORDINATE_LIMIT = 2.f;
+
+static bool half_texture_coordinate(float value) {
+  return fabsf(value) < HALF_TEXTURE_COORDINATE_LIMIT;
+}
+
+// Writes count values of an attribute of a mesh in the compact layout, values
+// are value_stride floats apart
+static void encode_compact_attribute(const struct vgltf_vertex_layout *layout,
+                                     const struct vgltf_renderer_mesh *mesh,
+                                     enum vgltf_vertex_attribute attribute,
+                                     const float *values, size_t value_stride,
+                                     uint32_t count, char *vertices) {
+  char *destination = vertices + layout->offsets[attribute];
+  switch (attribute) {
+  case VGLTF_VERTEX_ATTRIBUTE_POSITION: {
+    // Flat meshes collapse to their center along the flat axes
+    vgltf_vec3 center = mesh->bounding_sphere_center;
+    vgltf_vec3 extent = mesh->bounding_box_half_extent;
+    vgltf_vec3 inverse_extent = {extent.x > 0.f ? 1.f / extent.x : 0.f,
+                                 extent.y > 0.f ? 1.f / extent.y : 0.f,
+                                 extent.z > 0.f ? 1.f / extent.z : 0.f};
+    for (uint32_t i = 0; i < count; i++) {
+      const float *value = values + i * value_stride;
+      int16_t position[4] = {
+          quantize_snorm16((value[0] - center.x) * inverse_extent.x),
+          quantize_snorm16((value[1] - center.y) * inverse_extent.y),
+          quantize_snorm16((value[2] - center.z) * inverse_extent.z),
+          INT16_MAX};
+      memcpy(destination + i * layout->stride, position, sizeof(position));
+    }
+    break;
+  }
+  case VGLTF_VERTEX_ATTRIBUTE_COLOR:
+    for (uint32_t i = 0; i < count; i++) {
+      const float *value = values + i * value_stride;
+      unsigned char color[4] = {quantize_unorm8(value[0]),
+                                quantize_unorm8(value[1]),
+                                quantize_unorm8(value[2]), UINT8_MAX};
+      memcpy(destination + i * layout->stride, color, sizeof(color));
+    }
+    break;
+  case VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES:
+    for (uint32_t i = 0; i < count; i++) {
+      const float *value = values + i * value_stride;
+      if (layout->formats[attribute] == VK_FORMAT_R32G32_SFLOAT) {
+        memcpy(destination + i * layout->stride, value, 2 * sizeof(float));
+        continue;
+      }
+      uint16_t texture_coordinates[2] = {vgltf_float_to_half(value[0]),
+                                         vgltf_float_to_half(value[1])};
+      memcpy(destination + i * layout->stride, texture_coordinates,
+             sizeof(texture_coordinates));
+    }
+    break;
+  case VGLTF_VERTEX_ATTRIBUTE_COUNT:
+    break;
+  }
+}
+
+// Bounds the largest singular value of the upper 3x3 with the Gershgorin
+// circles of its Gram matrix, exact unless node scales shear the rows
+static vgltf_vec_value_type transform_max_scale(const vgltf_mat4 m) {
+  vgltf_vec3 rows[3];
+  for (int axis = 0; axis < 3; axis++) {
+    rows[axis] = (vgltf_vec3){m[axis * 4], m[axis * 4 + 1], m[axis * 4 + 2]};
+  }
+  vgltf_vec_value_type squared_scale = 0.f;
+  for (int i = 0; i < 3; i++) {
+    vgltf_vec_value_type sum = 0.f;
+    for (int j = 0; j < 3; j++) {
+      sum += fabsf(vgltf_vec3_dot(rows[i], rows[j]));
+    }
+    squared_scale = fmaxf(squared_scale, sum);
+  }
+  return sqrtf(squared_scale);
+}
+
+// Bounding sphere of an instance in model space, the radius is scaled by an
+// upper bound of the largest scale of the transform
+static void instance_bounding_sphere(
+    const struct vgltf_renderer *renderer,
+    const struct vgltf_renderer_instance *instance, vgltf_vec3 *center,
+    vgltf_vec_value_type *radius) {
+  const struct vgltf_renderer_mesh *mesh =
+      &renderer->meshes[instance->mesh_index];
+  const vgltf_mat_value_type *m = instance->transform;
+  vgltf_vec3 c = mesh->bounding_sphere_center;
+  *center = (vgltf_vec3){c.x * m[0] + c.y * m[4] + c.z * m[8] + m[12],
+                         c.x * m[1] + c.y * m[5] + c.z * m[9] + m[13],
+                         c.x * m[2] + c.y * m[6] + c.z * m[10] + m[14]};
+  *radius = mesh->bounding_sphere_radius * instance->max_scale;
+}
+
+// Whether the upper 3x3 has a negative determinant, which flips the winding of
+// the triangles
+static bool transform_mirrors(const vgltf_mat4 m) {
+  vgltf_vec3 x_axis = {m[0], m[1], m[2]};
+  vgltf_vec3 y_axis = {m[4], m[5], m[6]};
+  vgltf_vec3 z_axis = {m[8], m[9], m[10]};
+  return vgltf_vec3_dot(vgltf_vec3_cross(x_axis, y_axis), z_axis) < 0.f;
+}
+
+// Appends an instance of a mesh along with its CPU culling bounding sphere
+static bool push_instance(struct vgltf_renderer *renderer, uint32_t mesh_index,
+                          const vgltf_mat4 transform) {
+  if (renderer->instance_count == VGLTF_RENDERER_MAX_INSTANCE_COUNT) {
+    VGLTF_LOG_ERR("Instance array cannot fit all the instances of the model");
+    return false;
+  }
+  struct vgltf_renderer_instance *instance =
+      &renderer->instances[renderer->instance_count];
+  instance->mesh_index = mesh_index;
+  memcpy(instance->transform, transform, sizeof(vgltf_mat4));
+  instance->max_scale = transform_max_scale(transform);
+
+  vgltf_vec3 center;
+  vgltf_vec_value_type radius;
+  instance_bounding_sphere(renderer, instance, &center, &radius);
+  vgltf_cpu_culling_set_sphere(&renderer->cpu_culling,
+                               renderer->instance_count, center, radius);
+  renderer->instance_count++;
+  renderer->cpu_culling.sphere_count = renderer->instance_count;
+  return true;
+}
+
+// Length of the directory part of a path, trailing separator included
+static size_t path_directory_length(const char *path) {
+  const char *last_separator = strrchr(path, '/');
+#ifdef VGLTF_PLATFORM_WINDOWS
+  const char *last_backslash = strrchr(path, '\\');
+  last_separator = last_backslash > last_separator ? last_backslash
+                                                   : last_separator;
+#endif
+  return last_separator ? last_separator + 1 - path : 0;
 }
 
-static bool load_model(struct vgltf_renderer *renderer) {
+static bool load_obj_model(struct vgltf_renderer *renderer, const char *path) {
+  VGLTF_TRACE_ZONE(__func__);
   tinyobj_attrib_t attrib;
   tinyobj_shape_t *shapes = nullptr;
   size_t shape_count;
@@ -1730,14 +2321,77 @@ static bool load_model(struct vgltf_renderer *renderer) {
   size_t material_count;
 
   if ((tinyobj_parse_obj(&attrib, &shapes, &shape_count, &materials,
-                         &material_count, MODEL_PATH, get_file_data, nullptr,
+                         &material_count, path, get_file_data, nullptr,
                          TINYOBJ_FLAG_TRIANGULATE)) != TINYOBJ_SUCCESS) {
     VGLTF_LOG_ERR("Couldn't load obj");
     return false;
   }
 
+  struct vgltf_string_view model_directory = {
+      .data = path, .length = path_directory_length(path)};
+  if (!load_obj_materials(renderer, model_directory, materials,
+                          material_count)) {
+    VGLTF_LOG_ERR("Couldn't load the materials of the model");
+    goto free_model;
+  }
+
+  // Faces aren't indexed, every face corner is a vertex
+  size_t corner_count = 0;
+  for (size_t shape_index = 0; shape_index < shape_count; shape_index++) {
+    corner_count += (size_t)shapes[shape_index].length * 3;
+  }
+  if (corner_count > INT32_MAX) {
+    VGLTF_LOG_ERR("Model has too many vertices");
+    goto free_model;
+  }
+  size_t vertex_capacity = VGLTF_MAX(corner_count, 1u);
+  // OBJ vertices have no color, their v texture coordinate is flipped
+  bool half_texture_coordinates = true;
+  for (size_t texture_coordinate_index = 0;
+       use_compact_vertices && half_texture_coordinates &&
+       texture_coordinate_index < attrib.num_texcoords;
+       texture_coordinate_index++) {
+    const float *texture_coordinate =
+        &attrib.texcoords[2 * texture_coordinate_index];
+    half_texture_coordinates =
+        half_texture_coordinate(texture_coordinate[0]) &&
+        half_texture_coordinate(1.f - texture_coordinate[1]);
+  }
+  renderer->vertex_layout =
+      use_compact_vertices
+          ? vgltf_vertex_layout_compact(false, true, half_texture_coordinates)
+          : vgltf_vertex_layout_float();
+  // Every corner becomes a vertex, corner_count is the final vertex count
+  renderer->vertices =
+      allocate_vertices(&renderer->vertex_layout, corner_count);
+  struct vgltf_vertex *vertices =
+      use_compact_vertices
+          ? vgltf_allocator_allocate_array(&system_allocator, vertex_capacity,
+                                           sizeof(struct vgltf_vertex))
+          : renderer->vertices;
+  renderer->indices = vgltf_allocator_allocate_array(
+      &system_allocator, vertex_capacity, sizeof(uint32_t));
+  if (!vertices || !renderer->vertices || !renderer->indices) {
+    VGLTF_LOG_ERR("Couldn't allocate the vertices and indices of the model");
+    goto free_vertices;
+  }
+
   for (size_t shape_index = 0; shape_index < shape_count; shape_index++) {
     tinyobj_shape_t *shape = &shapes[shape_index];
+    if (renderer->mesh_count == VGLTF_RENDERER_MAX_MESH_COUNT) {
+      VGLTF_LOG_ERR("Mesh array cannot fit all the shapes of the model");
+      goto free_vertices;
+    }
+
+    struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->mesh_count++];
+    mesh->first_index = renderer->index_count;
+    mesh->vertex_offset = renderer->vertex_count;
+    // The whole shape uses the material of its first face
+    int material_id =
+        shape->length > 0 ? attrib.material_ids[shape->face_offset] : -1;
+    mesh->material_index = material_id < 0 ? 0 : (uint32_t)material_id + 1;
+
     unsigned int face_offset = shape->face_offset;
     for (size_t face_index = face_offset;
          face_index < face_offset + shape->length; face_index++) {
@@ -1769,92 +2423,1364 @@ static bool load_model(struct vgltf_renderer *renderer) {
       }
 
       for (int k = 0; k < 3; k++) {
-        renderer->vertices[renderer->vertex_count++] = (struct vgltf_vertex){
+        // Indices are relative to the mesh, vertex_offset rebases them into
+        // the shared vertex buffer
+        renderer->indices[renderer->index_count++] =
+            renderer->vertex_count - mesh->vertex_offset;
+        vertices[renderer->vertex_count++] = (struct vgltf_vertex){
             .position = {v[k][0], v[k][1], v[k][2]},
             .texture_coordinates = {t[k][0], 1.f - t[k][1]},
             .color = {1.f, 1.f, 1.f}};
-        renderer->indices[renderer->index_count++] = renderer->index_count;
       }
     }
-    tinyobj_attrib_free(&attrib);
-    tinyobj_shapes_free(shapes, shape_count);
-    tinyobj_materials_free(materials, material_count);
+
+    mesh->index_count = renderer->index_count - mesh->first_index;
+    uint32_t mesh_vertex_count = renderer->vertex_count - mesh->vertex_offset;
+    mesh->vertex_count = mesh_vertex_count;
+    compute_mesh_bounds(mesh, &vertices[mesh->vertex_offset],
+                        (int)mesh_vertex_count);
+    if (use_compact_vertices) {
+      // The mesh bounds are needed to quantize the positions
+      char *compact_vertices =
+          (char *)renderer->vertices +
+          (size_t)mesh->vertex_offset * renderer->vertex_layout.stride;
+      static constexpr size_t VALUE_STRIDE =
+          sizeof(struct vgltf_vertex) / sizeof(float);
+      encode_compact_attribute(
+          &renderer->vertex_layout, mesh, VGLTF_VERTEX_ATTRIBUTE_POSITION,
+          &vertices[mesh->vertex_offset].position.x, VALUE_STRIDE,
+          mesh_vertex_count, compact_vertices);
+      encode_compact_attribute(
+          &renderer->vertex_layout, mesh,
+          VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES,
+          &vertices[mesh->vertex_offset].texture_coordinates.x, VALUE_STRIDE,
+          mesh_vertex_count, compact_vertices);
+    }
+
+    if (!push_instance(renderer, renderer->mesh_count - 1,
+                       (const vgltf_mat4)VGLTF_MAT4_IDENTITY)) {
+      goto free_vertices;
+    }
+  }
+  // OBJ instances aren't transformed
+  renderer->first_mirrored_instance = renderer->instance_count;
+  write_position_stream(renderer, 0, (size_t)renderer->vertex_count);
+
+  if (use_compact_vertices) {
+    vgltf_allocator_free(&system_allocator, vertices);
   }
+  tinyobj_attrib_free(&attrib);
+  tinyobj_shapes_free(shapes, shape_count);
+  tinyobj_materials_free(materials, material_count);
   return true;
+free_vertices:
+  if (use_compact_vertices) {
+    vgltf_allocator_free(&system_allocator, vertices);
+  }
+free_model:
+  tinyobj_attrib_free(&attrib);
+  tinyobj_shapes_free(shapes, shape_count);
+  tinyobj_materials_free(materials, material_count);
+  return false;
 }
 
-static bool
-vgltf_renderer_create_vertex_buffer(struct vgltf_renderer *renderer) {
-  VkDeviceSize buffer_size =
-      renderer->vertex_count * sizeof(struct vgltf_vertex);
+// Every scene node with a mesh becomes one instance per triangle primitive,
+// with the world transform of the node. Primitives used by several nodes are
+// imported once.
+struct gltf_draw {
+  uint32_t primitive;
+  vgltf_mat4 world_matrix;
+};
 
-  struct vgltf_renderer_allocated_buffer staging_buffer = {};
-  if (!vgltf_renderer_create_buffer(renderer, buffer_size,
-                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                    &staging_buffer)) {
-    VGLTF_LOG_ERR("Failed to create transfer buffer");
+// Accessors are decoded in chunks of this many elements, so that a single
+// large primitive is spread over every thread
+static constexpr uint32_t GLTF_IMPORT_CHUNK_ELEMENT_COUNT = 16384;
+static constexpr uint32_t GLTF_MAX_STRING_COUNT = 1 << 16;
+static constexpr size_t GLTF_MAX_STRING_BYTE_COUNT = 1 << 22;
+
+// glTF attribute of each vertex attribute, and how many components the
+// vertex shader (triangle.vert) reads
+static const enum vgltf_gltf_attribute
+    GLTF_VERTEX_ATTRIBUTES[VGLTF_VERTEX_ATTRIBUTE_COUNT] = {
+        [VGLTF_VERTEX_ATTRIBUTE_POSITION] = VGLTF_GLTF_ATTRIBUTE_POSITION,
+        [VGLTF_VERTEX_ATTRIBUTE_COLOR] = VGLTF_GLTF_ATTRIBUTE_COLOR_0,
+        [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] =
+            VGLTF_GLTF_ATTRIBUTE_TEXCOORD_0};
+static const uint32_t VERTEX_ATTRIBUTE_COMPONENT_COUNTS
+    [VGLTF_VERTEX_ATTRIBUTE_COUNT] = {
+        [VGLTF_VERTEX_ATTRIBUTE_POSITION] = 3,
+        [VGLTF_VERTEX_ATTRIBUTE_COLOR] = 3,
+        [VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES] = 2};
+
+// How a vertex attribute of a glTF model is stored, integer components are
+// copied as is
+struct gltf_attribute_encoding {
+  // VGLTF_GLTF_COMPONENT_TYPE_FLOAT if the components are converted to floats
+  enum vgltf_gltf_component_type component_type;
+  uint32_t component_count;
+};
+
+struct gltf_import_chunk {
+  uint32_t mesh_index;
+  uint32_t first_element;
+  uint32_t element_count;
+  bool indices;
+};
+
+struct gltf_import {
+  struct vgltf_renderer *renderer;
+  const struct vgltf_gltf *gltf;
+  // glTF primitive of each renderer mesh
+  const uint32_t *mesh_primitives;
+  const struct gltf_import_chunk *chunks;
+  struct gltf_attribute_encoding encodings[VGLTF_VERTEX_ATTRIBUTE_COUNT];
+  atomic_bool failed;
+  // Whether the compact layout stores the texture coordinates as half floats
+  atomic_bool half_texture_coordinates;
+};
+
+static bool path_has_extension(const char *path, const char *extension) {
+  size_t path_length = strlen(path);
+  size_t extension_length = strlen(extension);
+  return path_length >= extension_length &&
+         strcmp(path + path_length - extension_length, extension) == 0;
+}
+
+// Material 0 is a white default material, the glTF material i becomes
+// material i + 1. Images shared by several materials are uploaded once.
+static bool load_gltf_materials(struct vgltf_renderer *renderer,
+                                const struct vgltf_gltf *gltf,
+                                const struct vgltf_string_interner *interner) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (gltf->material_count + 1 > VGLTF_RENDERER_MAX_MATERIAL_COUNT) {
+    VGLTF_LOG_ERR("Material array cannot fit all the materials of the model");
     goto err;
   }
 
-  void *data;
-  vmaMapMemory(renderer->device.allocator, staging_buffer.allocation, &data);
-  memcpy(data, renderer->vertices,
-         renderer->vertex_count * sizeof(struct vgltf_vertex));
-  vmaUnmapMemory(renderer->device.allocator, staging_buffer.allocation);
+  unsigned char white_pixel[4] = {255, 255, 255, 255};
+  struct vgltf_image white_image = {.data = white_pixel,
+                                    .width = 1,
+                                    .height = 1,
+                                    .format = VGLTF_IMAGE_FORMAT_R8G8B8A8};
+  uint32_t default_texture_index;
+  if (!vgltf_renderer_upload_texture(renderer, &white_image,
+                                     &default_texture_index)) {
+    VGLTF_LOG_ERR("Couldn't create the default texture");
+    goto err;
+  }
+  renderer->materials[renderer->material_count++] =
+      (struct vgltf_renderer_material){
+          .base_color_factor = {1.f, 1.f, 1.f, 1.f},
+          .base_color_texture_index = default_texture_index};
 
-  if (!vgltf_renderer_create_buffer(
-          renderer, buffer_size,
-          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->vertex_buffer)) {
-    VGLTF_LOG_ERR("Failed to create vertex buffer");
-    goto destroy_staging_buffer;
+  uint32_t *image_texture_indices = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(gltf->image_count, 1u), sizeof(uint32_t));
+  if (!image_texture_indices) {
+    VGLTF_LOG_ERR("Couldn't allocate the texture indices of the images");
+    goto err;
   }
+  for (uint32_t image_index = 0; image_index < gltf->image_count;
+       image_index++) {
+    image_texture_indices[image_index] = VGLTF_GLTF_INDEX_NONE;
+  }
+
+  for (uint32_t material_index = 0; material_index < gltf->material_count;
+       material_index++) {
+    const struct vgltf_gltf_material *material =
+        &gltf->materials[material_index];
+    uint32_t texture_index = default_texture_index;
+    uint32_t texture = material->base_color_texture.texture;
+    uint32_t image_index = texture == VGLTF_GLTF_INDEX_NONE
+                               ? VGLTF_GLTF_INDEX_NONE
+                               : gltf->textures[texture].source;
+    if (image_index != VGLTF_GLTF_INDEX_NONE &&
+        image_texture_indices[image_index] != VGLTF_GLTF_INDEX_NONE) {
+      texture_index = image_texture_indices[image_index];
+    } else if (image_index != VGLTF_GLTF_INDEX_NONE) {
+      const struct vgltf_gltf_image *gltf_image = &gltf->images[image_index];
+      bool loaded;
+      if (gltf_image->path != VGLTF_STRING_ID_INVALID) {
+        loaded = vgltf_renderer_load_texture(
+            renderer, vgltf_string_interner_get(interner, gltf_image->path),
+            &texture_index);
+      } else {
+        struct vgltf_image image;
+        loaded = vgltf_image_load_from_memory(&image, gltf_image->data,
+                                              gltf_image->data_size);
+        if (loaded) {
+          loaded =
+              vgltf_renderer_upload_texture(renderer, &image, &texture_index);
+          vgltf_image_deinit(&image);
+        }
+      }
 
-  vgltf_renderer_copy_buffer(renderer, staging_buffer.buffer,
-                             renderer->vertex_buffer.buffer, buffer_size);
-  vmaDestroyBuffer(renderer->device.allocator, staging_buffer.buffer,
-                   staging_buffer.allocation);
+      if (!loaded) {
+        VGLTF_LOG_ERR("Couldn't load glTF image %u, using the default texture",
+                      image_index);
+        texture_index = default_texture_index;
+      }
+      image_texture_indices[image_index] = texture_index;
+    }
+
+    struct vgltf_renderer_material *renderer_material =
+        &renderer->materials[renderer->material_count++];
+    memcpy(renderer_material->base_color_factor, material->base_color_factor,
+           sizeof(renderer_material->base_color_factor));
+    renderer_material->base_color_texture_index = texture_index;
+  }
+
+  vgltf_allocator_free(&system_allocator, image_texture_indices);
   return true;
-destroy_staging_buffer:
-  vmaDestroyBuffer(renderer->device.allocator, staging_buffer.buffer,
-                   staging_buffer.allocation);
 err:
   return false;
 }
 
-static bool
-vgltf_renderer_create_index_buffer(struct vgltf_renderer *renderer) {
-  VkDeviceSize buffer_size = renderer->index_count * sizeof(uint16_t);
-  struct vgltf_renderer_allocated_buffer staging_buffer = {};
-  if (!vgltf_renderer_create_buffer(renderer, buffer_size,
-                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                    &staging_buffer)) {
-    VGLTF_LOG_ERR("Failed to create transfer buffer");
+// Walks the node hierarchy of the scene and appends a draw for every triangle
+// primitive with positions
+static bool collect_gltf_draws(const struct vgltf_gltf *gltf,
+                               const struct vgltf_gltf_scene *scene,
+                               struct gltf_draw *draws, uint32_t *draw_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct node_visit {
+    uint32_t node;
+    vgltf_mat4 parent_world_matrix;
+  };
+
+  // Nodes are trees, so every node is visited at most once and the stack
+  // never holds more than node_count entries
+  struct node_visit *stack = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(gltf->node_count, 1u),
+      sizeof(struct node_visit));
+  if (!stack) {
+    VGLTF_LOG_ERR("Couldn't allocate the glTF node stack");
     goto err;
   }
 
-  void *data;
-  vmaMapMemory(renderer->device.allocator, staging_buffer.allocation, &data);
-  memcpy(data, renderer->indices, renderer->index_count * sizeof(uint16_t));
-  vmaUnmapMemory(renderer->device.allocator, staging_buffer.allocation);
+  uint32_t stack_size = 0;
+  uint32_t visited_node_count = 0;
+  for (uint32_t scene_node_index = 0; scene_node_index < scene->node_count;
+       scene_node_index++) {
+    if (stack_size == gltf->node_count) {
+      goto invalid_hierarchy;
+    }
+    struct node_visit *root = &stack[stack_size++];
+    root->node = gltf->scene_nodes[scene->first_node + scene_node_index];
+    memcpy(root->parent_world_matrix, (const vgltf_mat4)VGLTF_MAT4_IDENTITY,
+           sizeof(vgltf_mat4));
+  }
 
-  if (!vgltf_renderer_create_buffer(
-          renderer, buffer_size,
-          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->index_buffer)) {
-    VGLTF_LOG_ERR("Failed to create index buffer");
+  while (stack_size > 0) {
+    struct node_visit visit = stack[--stack_size];
+    if (visited_node_count++ == gltf->node_count) {
+      goto invalid_hierarchy;
+    }
+
+    const struct vgltf_gltf_node *node = &gltf->nodes[visit.node];
+    // Points are row vectors, the parent transform applies last
+    vgltf_mat4 local_matrix;
+    memcpy(local_matrix, node->matrix, sizeof(vgltf_mat4));
+    vgltf_mat4 world_matrix;
+    vgltf_mat4_multiply(world_matrix, local_matrix, visit.parent_world_matrix);
+
+    if (node->mesh != VGLTF_GLTF_INDEX_NONE) {
+      const struct vgltf_gltf_mesh *mesh = &gltf->meshes[node->mesh];
+      for (uint32_t primitive_index = mesh->first_primitive;
+           primitive_index < mesh->first_primitive + mesh->primitive_count;
+           primitive_index++) {
+        const struct vgltf_gltf_primitive *primitive =
+            &gltf->primitives[primitive_index];
+        if (primitive->mode != VGLTF_GLTF_PRIMITIVE_MODE_TRIANGLES ||
+            primitive->attributes[VGLTF_GLTF_ATTRIBUTE_POSITION] ==
+                VGLTF_GLTF_INDEX_NONE) {
+          VGLTF_LOG_INFO("Skipping glTF primitive %u, only triangle lists "
+                         "with positions are rendered",
+                         primitive_index);
+          continue;
+        }
+
+        if (*draw_count == VGLTF_RENDERER_MAX_INSTANCE_COUNT) {
+          VGLTF_LOG_ERR("Instance array cannot fit all the primitives of the "
+                        "model");
+          goto free_stack;
+        }
+        struct gltf_draw *draw = &draws[(*draw_count)++];
+        draw->primitive = primitive_index;
+        memcpy(draw->world_matrix, world_matrix, sizeof(vgltf_mat4));
+      }
+    }
+
+    for (uint32_t child_index = 0; child_index < node->child_count;
+         child_index++) {
+      if (stack_size == gltf->node_count) {
+        goto invalid_hierarchy;
+      }
+      struct node_visit *child = &stack[stack_size++];
+      child->node = gltf->node_children[node->first_child + child_index];
+      memcpy(child->parent_world_matrix, world_matrix, sizeof(vgltf_mat4));
+    }
+  }
+
+  vgltf_allocator_free(&system_allocator, stack);
+  return true;
+invalid_hierarchy:
+  VGLTF_LOG_ERR("glTF node hierarchy isn't a forest");
+free_stack:
+  vgltf_allocator_free(&system_allocator, stack);
+err:
+  return false;
+}
+
+static VkFormat
+quantized_vertex_format(enum vgltf_gltf_component_type component_type,
+                        bool normalized, uint32_t component_count) {
+  bool four = component_count == 4;
+  switch (component_type) {
+  case VGLTF_GLTF_COMPONENT_TYPE_BYTE:
+    return normalized ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R8G8B8A8_SSCALED;
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return normalized ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_USCALED;
+  case VGLTF_GLTF_COMPONENT_TYPE_SHORT:
+    return normalized ? (four ? VK_FORMAT_R16G16B16A16_SNORM
+                              : VK_FORMAT_R16G16_SNORM)
+                      : (four ? VK_FORMAT_R16G16B16A16_SSCALED
+                              : VK_FORMAT_R16G16_SSCALED);
+  case VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return normalized ? (four ? VK_FORMAT_R16G16B16A16_UNORM
+                              : VK_FORMAT_R16G16_UNORM)
+                      : (four ? VK_FORMAT_R16G16B16A16_USCALED
+                              : VK_FORMAT_R16G16_USCALED);
+  default:
+    return VK_FORMAT_UNDEFINED;
+  }
+}
+
+// Keeps the integer components of an attribute when every primitive stores it
+// with the same component type and the device can fetch that format, the
+// attribute is converted to floats otherwise. Attributes are 4 bytes aligned,
+// so integer components are padded to 4 bytes.
+static void choose_gltf_attribute_encoding(
+    const struct vgltf_renderer *renderer, const struct vgltf_gltf *gltf,
+    const uint32_t *mesh_primitives, uint32_t mesh_count,
+    enum vgltf_vertex_attribute attribute,
+    struct gltf_attribute_encoding *encoding, VkFormat *format) {
+  uint32_t component_count = VERTEX_ATTRIBUTE_COMPONENT_COUNTS[attribute];
+  *encoding = (struct gltf_attribute_encoding){
+      .component_type = VGLTF_GLTF_COMPONENT_TYPE_FLOAT,
+      .component_count = component_count};
+  *format = component_count == 3 ? VK_FORMAT_R32G32B32_SFLOAT
+                                 : VK_FORMAT_R32G32_SFLOAT;
+
+  bool found = false;
+  enum vgltf_gltf_component_type component_type = 0;
+  bool normalized = false;
+  uint32_t max_accessor_component_count = 0;
+  for (uint32_t mesh_index = 0; mesh_index < mesh_count; mesh_index++) {
+    uint32_t accessor_index =
+        gltf->primitives[mesh_primitives[mesh_index]]
+            .attributes[GLTF_VERTEX_ATTRIBUTES[attribute]];
+    if (accessor_index == VGLTF_GLTF_INDEX_NONE) {
+      continue;
+    }
+    const struct vgltf_gltf_accessor *accessor =
+        &gltf->accessors[accessor_index];
+    uint32_t accessor_component_count =
+        vgltf_gltf_accessor_type_component_count(accessor->type);
+    if (accessor_component_count < component_count ||
+        (found && (accessor->component_type != component_type ||
+                   accessor->normalized != normalized))) {
+      return;
+    }
+    found = true;
+    component_type = accessor->component_type;
+    normalized = accessor->normalized;
+    max_accessor_component_count =
+        VGLTF_MAX(max_accessor_component_count, accessor_component_count);
+  }
+
+  // Missing attributes take the smallest format holding their default value
+  if (!found && attribute == VGLTF_VERTEX_ATTRIBUTE_COLOR) {
+    component_type = VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    normalized = true;
+  } else if (!found &&
+             attribute == VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES) {
+    component_type = VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+    normalized = true;
+  }
+
+  // White, the default color, is all ones in unsigned normalized formats
+  if (attribute == VGLTF_VERTEX_ATTRIBUTE_COLOR &&
+      (!normalized ||
+       (component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+        component_type != VGLTF_GLTF_COMPONENT_TYPE_UNSIGNED_SHORT))) {
+    return;
+  }
+
+  uint32_t component_size = vgltf_gltf_component_type_size(component_type);
+  if (component_size == 0 || component_size == 4) {
+    return;
+  }
+  uint32_t components_per_word = 4 / component_size;
+  uint32_t padded_component_count =
+      (component_count + components_per_word - 1) / components_per_word *
+      components_per_word;
+  if (max_accessor_component_count > padded_component_count) {
+    return;
+  }
+
+  VkFormat quantized_format = quantized_vertex_format(
+      component_type, normalized, padded_component_count);
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(renderer->device.physical_device,
+                                      quantized_format, &properties);
+  if (!(properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)) {
+    VGLTF_LOG_INFO("Vertex format %d isn't supported, converting vertex "
+                   "attribute %d to floats",
+                   quantized_format, attribute);
+    return;
+  }
+
+  *encoding = (struct gltf_attribute_encoding){
+      .component_type = component_type,
+      .component_count = padded_component_count};
+  *format = quantized_format;
+}
+
+// Clears half_texture_coordinates when a texture coordinate of the meshes is
+// past what half floats hold to a texel
+static void scan_gltf_texture_coordinates(void *data, uint32_t begin,
+                                          uint32_t end) {
+  static constexpr uint32_t BATCH_VERTEX_COUNT = 1024;
+  struct gltf_import *import = data;
+  float values[BATCH_VERTEX_COUNT * 2];
+  for (uint32_t mesh_index = begin; mesh_index < end; mesh_index++) {
+    uint32_t accessor_index =
+        import->gltf->primitives[import->mesh_primitives[mesh_index]]
+            .attributes[VGLTF_GLTF_ATTRIBUTE_TEXCOORD_0];
+    if (accessor_index == VGLTF_GLTF_INDEX_NONE) {
+      continue;
+    }
+    uint32_t vertex_count = import->gltf->accessors[accessor_index].count;
+    for (uint32_t batch_start = 0; batch_start < vertex_count;
+         batch_start += BATCH_VERTEX_COUNT) {
+      if (!atomic_load_explicit(&import->half_texture_coordinates,
+                                memory_order_relaxed)) {
+        return;
+      }
+      uint32_t batch_count = vertex_count - batch_start < BATCH_VERTEX_COUNT
+                                 ? vertex_count - batch_start
+                                 : BATCH_VERTEX_COUNT;
+      if (!vgltf_gltf_accessor_read_floats(import->gltf, accessor_index,
+                                           batch_start, batch_count, values, 2,
+                                           2)) {
+        atomic_store_explicit(&import->failed, true, memory_order_relaxed);
+        return;
+      }
+      for (uint32_t i = 0; i < batch_count * 2; i++) {
+        if (!half_texture_coordinate(values[i])) {
+          atomic_store_explicit(&import->half_texture_coordinates, false,
+                                memory_order_relaxed);
+          return;
+        }
+      }
+    }
+  }
+}
+
+static void choose_gltf_vertex_layout(struct gltf_import *import,
+                                      uint32_t mesh_count) {
+  struct vgltf_vertex_layout *layout = &import->renderer->vertex_layout;
+  if (use_compact_vertices) {
+    bool has_attributes[VGLTF_VERTEX_ATTRIBUTE_COUNT] = {};
+    for (uint32_t mesh_index = 0; mesh_index < mesh_count; mesh_index++) {
+      const struct vgltf_gltf_primitive *primitive =
+          &import->gltf->primitives[import->mesh_primitives[mesh_index]];
+      for (int attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+           attribute++) {
+        has_attributes[attribute] |=
+            primitive->attributes[GLTF_VERTEX_ATTRIBUTES[attribute]] !=
+            VGLTF_GLTF_INDEX_NONE;
+      }
+    }
+    atomic_init(&import->half_texture_coordinates, true);
+    vgltf_job_system_parallel_for(import->renderer->job_system, mesh_count, 1,
+                                  scan_gltf_texture_coordinates, import);
+    *layout = vgltf_vertex_layout_compact(
+        has_attributes[VGLTF_VERTEX_ATTRIBUTE_COLOR],
+        has_attributes[VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES],
+        atomic_load(&import->half_texture_coordinates));
+    return;
+  }
+
+  *layout = (struct vgltf_vertex_layout){};
+  for (int attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+       attribute++) {
+    struct gltf_attribute_encoding *encoding = &import->encodings[attribute];
+    choose_gltf_attribute_encoding(
+        import->renderer, import->gltf, import->mesh_primitives, mesh_count,
+        attribute, encoding, &layout->formats[attribute]);
+    uint32_t size = encoding->component_count *
+                    vgltf_gltf_component_type_size(encoding->component_type);
+    layout->offsets[attribute] = layout->stride;
+    layout->stride += size;
+    if (attribute == VGLTF_VERTEX_ATTRIBUTE_POSITION) {
+      layout->position_stride = size;
+    }
+  }
+}
+
+// Converts the attributes of a chunk of vertices to floats a batch at a time,
+// and encodes them in the compact layout. The mesh bounds must be known.
+static bool
+import_gltf_compact_vertex_chunk(struct gltf_import *import,
+                                 const struct gltf_import_chunk *chunk) {
+  static constexpr uint32_t BATCH_VERTEX_COUNT = 256;
+  const struct vgltf_gltf *gltf = import->gltf;
+  const struct vgltf_gltf_primitive *primitive =
+      &gltf->primitives[import->mesh_primitives[chunk->mesh_index]];
+  const struct vgltf_renderer_mesh *mesh =
+      &import->renderer->meshes[chunk->mesh_index];
+  const struct vgltf_vertex_layout *layout = &import->renderer->vertex_layout;
+  char *vertices = (char *)import->renderer->vertices +
+                   ((size_t)mesh->vertex_offset + chunk->first_element) *
+                       layout->stride;
+
+  float values[BATCH_VERTEX_COUNT * 3];
+  for (int attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+       attribute++) {
+    if (layout->constant[attribute]) {
+      continue;
+    }
+    uint32_t component_count = VERTEX_ATTRIBUTE_COMPONENT_COUNTS[attribute];
+    uint32_t accessor_index =
+        primitive->attributes[GLTF_VERTEX_ATTRIBUTES[attribute]];
+    for (uint32_t batch_start = 0; batch_start < chunk->element_count;
+         batch_start += BATCH_VERTEX_COUNT) {
+      uint32_t batch_count =
+          chunk->element_count - batch_start < BATCH_VERTEX_COUNT
+              ? chunk->element_count - batch_start
+              : BATCH_VERTEX_COUNT;
+      if (accessor_index != VGLTF_GLTF_INDEX_NONE) {
+        if (!vgltf_gltf_accessor_read_floats(
+                gltf, accessor_index, chunk->first_element + batch_start,
+                batch_count, values, component_count, component_count)) {
+          return false;
+        }
+      } else {
+        // Vertices without color are white, without texture coordinates they
+        // sample the texel at 0, 0
+        float value = attribute == VGLTF_VERTEX_ATTRIBUTE_COLOR ? 1.f : 0.f;
+        for (uint32_t i = 0; i < batch_count * component_count; i++) {
+          values[i] = value;
+        }
+      }
+      encode_compact_attribute(layout, mesh, attribute, values,
+                               component_count, batch_count,
+                               vertices + (size_t)batch_start * layout->stride);
+    }
+  }
+
+  return true;
+}
+
+// Decodes the attributes of a chunk of vertices straight into the interleaved
+// vertex array
+static bool import_gltf_vertex_chunk(struct gltf_import *import,
+                                     const struct gltf_import_chunk *chunk) {
+  if (use_compact_vertices) {
+    return import_gltf_compact_vertex_chunk(import, chunk);
+  }
+
+  const struct vgltf_gltf *gltf = import->gltf;
+  const struct vgltf_gltf_primitive *primitive =
+      &gltf->primitives[import->mesh_primitives[chunk->mesh_index]];
+  const struct vgltf_renderer_mesh *mesh =
+      &import->renderer->meshes[chunk->mesh_index];
+  const struct vgltf_vertex_layout *layout = &import->renderer->vertex_layout;
+  char *vertices = (char *)import->renderer->vertices +
+                   ((size_t)mesh->vertex_offset + chunk->first_element) *
+                       layout->stride;
+
+  for (int attribute = 0; attribute < VGLTF_VERTEX_ATTRIBUTE_COUNT;
+       attribute++) {
+    const struct gltf_attribute_encoding *encoding =
+        &import->encodings[attribute];
+    char *values = vertices + layout->offsets[attribute];
+    uint32_t accessor_index =
+        primitive->attributes[GLTF_VERTEX_ATTRIBUTES[attribute]];
+    if (accessor_index != VGLTF_GLTF_INDEX_NONE) {
+      bool read =
+          encoding->component_type == VGLTF_GLTF_COMPONENT_TYPE_FLOAT
+              ? vgltf_gltf_accessor_read_floats(
+                    gltf, accessor_index, chunk->first_element,
+                    chunk->element_count, (float *)values,
+                    encoding->component_count, layout->stride / sizeof(float))
+              : vgltf_gltf_accessor_read_components(
+                    gltf, accessor_index, chunk->first_element,
+                    chunk->element_count, values, encoding->component_count,
+                    layout->stride);
+      if (!read) {
+        return false;
+      }
+      continue;
+    }
+
+    // Vertices without color are white, without texture coordinates they
+    // sample the texel at 0, 0
+    size_t value_size =
+        encoding->component_count *
+        vgltf_gltf_component_type_size(encoding->component_type);
+    for (uint32_t i = 0; i < chunk->element_count; i++) {
+      char *value = values + i * layout->stride;
+      if (attribute != VGLTF_VERTEX_ATTRIBUTE_COLOR) {
+        memset(value, 0, value_size);
+      } else if (encoding->component_type == VGLTF_GLTF_COMPONENT_TYPE_FLOAT) {
+        memcpy(value, &(vgltf_vec3){1.f, 1.f, 1.f}, sizeof(vgltf_vec3));
+      } else {
+        memset(value, 0xff, value_size);
+      }
+    }
+  }
+
+  return true;
+}
+
+// Widens a chunk of indices to 32 bits, non indexed primitives get sequential
+// indices
+static bool import_gltf_index_chunk(struct gltf_import *import,
+                                    const struct gltf_import_chunk *chunk) {
+  const struct vgltf_gltf *gltf = import->gltf;
+  uint32_t primitive_index = import->mesh_primitives[chunk->mesh_index];
+  const struct vgltf_gltf_primitive *primitive =
+      &gltf->primitives[primitive_index];
+  const struct vgltf_renderer_mesh *mesh =
+      &import->renderer->meshes[chunk->mesh_index];
+  uint32_t *indices =
+      &import->renderer->indices[mesh->first_index + chunk->first_element];
+
+  if (primitive->indices == VGLTF_GLTF_INDEX_NONE) {
+    for (uint32_t i = 0; i < chunk->element_count; i++) {
+      indices[i] = chunk->first_element + i;
+    }
+    return true;
+  }
+
+  uint32_t max_index;
+  if (!vgltf_gltf_accessor_read_indices(gltf, primitive->indices,
+                                        chunk->first_element,
+                                        chunk->element_count, indices,
+                                        &max_index)) {
+    return false;
+  }
+
+  uint32_t vertex_count =
+      gltf->accessors[primitive->attributes[VGLTF_GLTF_ATTRIBUTE_POSITION]]
+          .count;
+  if (max_index >= vertex_count) {
+    VGLTF_LOG_ERR("glTF primitive %u indexes vertex %u out of %u",
+                  primitive_index, max_index, vertex_count);
+    return false;
+  }
+
+  return true;
+}
+
+static void import_gltf_chunks(void *data, uint32_t begin, uint32_t end) {
+  struct gltf_import *import = data;
+  for (uint32_t chunk_index = begin; chunk_index < end; chunk_index++) {
+    const struct gltf_import_chunk *chunk = &import->chunks[chunk_index];
+    if (chunk->indices) {
+      if (!import_gltf_index_chunk(import, chunk)) {
+        atomic_store_explicit(&import->failed, true, memory_order_relaxed);
+      }
+      continue;
+    }
+    if (!import_gltf_vertex_chunk(import, chunk)) {
+      atomic_store_explicit(&import->failed, true, memory_order_relaxed);
+      continue;
+    }
+    const struct vgltf_renderer_mesh *mesh =
+        &import->renderer->meshes[chunk->mesh_index];
+    write_position_stream(import->renderer,
+                          (size_t)mesh->vertex_offset + chunk->first_element,
+                          chunk->element_count);
+  }
+}
+
+// Quantized vertices aren't floats, so the positions are decoded again a batch
+// at a time, once for the bounding box and once for the radius
+static bool compute_gltf_position_bounds(const struct vgltf_gltf *gltf,
+                                         uint32_t accessor_index,
+                                         struct vgltf_renderer_mesh *mesh) {
+  static constexpr uint32_t BATCH_VERTEX_COUNT = 1024;
+  uint32_t vertex_count = gltf->accessors[accessor_index].count;
+  vgltf_vec3 positions[BATCH_VERTEX_COUNT];
+  vgltf_vec3 min = {INFINITY, INFINITY, INFINITY};
+  vgltf_vec3 max = {-INFINITY, -INFINITY, -INFINITY};
+  vgltf_vec3 center = {};
+  vgltf_vec_value_type radius = 0.f;
+  for (int pass = 0; pass < 2; pass++) {
+    for (uint32_t batch_start = 0; batch_start < vertex_count;
+         batch_start += BATCH_VERTEX_COUNT) {
+      uint32_t batch_count = vertex_count - batch_start < BATCH_VERTEX_COUNT
+                                 ? vertex_count - batch_start
+                                 : BATCH_VERTEX_COUNT;
+      if (!vgltf_gltf_accessor_read_floats(gltf, accessor_index, batch_start,
+                                           batch_count, &positions[0].x, 3,
+                                           3)) {
+        return false;
+      }
+      for (uint32_t i = 0; i < batch_count; i++) {
+        vgltf_vec3 position = positions[i];
+        if (pass == 0) {
+          min = (vgltf_vec3){fminf(min.x, position.x),
+                             fminf(min.y, position.y),
+                             fminf(min.z, position.z)};
+          max = (vgltf_vec3){fmaxf(max.x, position.x),
+                             fmaxf(max.y, position.y),
+                             fmaxf(max.z, position.z)};
+        } else {
+          radius = fmaxf(radius,
+                         vgltf_vec3_length(vgltf_vec3_sub(position, center)));
+        }
+      }
+    }
+    if (pass == 0) {
+      center = (vgltf_vec3){(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f,
+                            (min.z + max.z) * 0.5f};
+    }
+  }
+
+  if (vertex_count == 0) {
+    min = max = (vgltf_vec3){};
+  }
+  set_mesh_bounds(mesh, min, max, radius);
+  return true;
+}
+
+static void compute_gltf_mesh_bounds(void *data, uint32_t begin,
+                                     uint32_t end) {
+  struct gltf_import *import = data;
+  for (uint32_t mesh_index = begin; mesh_index < end; mesh_index++) {
+    const struct vgltf_gltf_primitive *primitive =
+        &import->gltf->primitives[import->mesh_primitives[mesh_index]];
+    if (!compute_gltf_position_bounds(
+            import->gltf, primitive->attributes[VGLTF_GLTF_ATTRIBUTE_POSITION],
+            &import->renderer->meshes[mesh_index])) {
+      atomic_store_explicit(&import->failed, true, memory_order_relaxed);
+    }
+  }
+}
+
+// Sizes the meshes and splits their vertices and indices into import chunks,
+// chunks is null to only count them
+static bool plan_gltf_import(struct vgltf_renderer *renderer,
+                             const struct vgltf_gltf *gltf,
+                             const uint32_t *mesh_primitives,
+                             uint32_t mesh_count,
+                             struct gltf_import_chunk *chunks,
+                             uint32_t *chunk_count) {
+  uint64_t vertex_count = 0;
+  uint64_t index_count = 0;
+  *chunk_count = 0;
+  for (uint32_t mesh_index = 0; mesh_index < mesh_count; mesh_index++) {
+    const struct vgltf_gltf_primitive *primitive =
+        &gltf->primitives[mesh_primitives[mesh_index]];
+    uint32_t mesh_vertex_count =
+        gltf->accessors[primitive->attributes[VGLTF_GLTF_ATTRIBUTE_POSITION]]
+            .count;
+    uint32_t mesh_index_count =
+        primitive->indices == VGLTF_GLTF_INDEX_NONE
+            ? mesh_vertex_count
+            : gltf->accessors[primitive->indices].count;
+    if (vertex_count + mesh_vertex_count > INT32_MAX ||
+        index_count + mesh_index_count > INT32_MAX) {
+      VGLTF_LOG_ERR("Model has too many vertices or indices");
+      return false;
+    }
+
+    if (chunks) {
+      renderer->meshes[mesh_index] = (struct vgltf_renderer_mesh){
+          .first_index = index_count,
+          .index_count = mesh_index_count,
+          .vertex_offset = vertex_count,
+          .vertex_count = mesh_vertex_count,
+          .material_index = primitive->material == VGLTF_GLTF_INDEX_NONE
+                                ? 0
+                                : primitive->material + 1};
+    }
+    vertex_count += mesh_vertex_count;
+    index_count += mesh_index_count;
+
+    for (int pass = 0; pass < 2; pass++) {
+      uint32_t element_count = pass == 0 ? mesh_vertex_count : mesh_index_count;
+      for (uint32_t first_element = 0; first_element < element_count;
+           first_element += GLTF_IMPORT_CHUNK_ELEMENT_COUNT) {
+        if (chunks) {
+          chunks[*chunk_count] = (struct gltf_import_chunk){
+              .mesh_index = mesh_index,
+              .first_element = first_element,
+              .element_count =
+                  element_count - first_element <
+                          GLTF_IMPORT_CHUNK_ELEMENT_COUNT
+                      ? element_count - first_element
+                      : GLTF_IMPORT_CHUNK_ELEMENT_COUNT,
+              .indices = pass == 1};
+        }
+        (*chunk_count)++;
+      }
+    }
+  }
+
+  renderer->vertex_count = vertex_count;
+  renderer->index_count = index_count;
+  return true;
+}
+
+// Gives every primitive drawn a mesh, in the order of their first draw
+static bool assign_gltf_meshes(const struct vgltf_gltf *gltf,
+                               const struct gltf_draw *draws,
+                               uint32_t draw_count, uint32_t *draw_meshes,
+                               uint32_t *mesh_primitives,
+                               uint32_t *mesh_count) {
+  uint32_t *primitive_meshes = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(gltf->primitive_count, 1u),
+      sizeof(uint32_t));
+  if (!primitive_meshes) {
+    VGLTF_LOG_ERR("Couldn't allocate the meshes of the glTF primitives");
+    return false;
+  }
+  for (uint32_t primitive_index = 0; primitive_index < gltf->primitive_count;
+       primitive_index++) {
+    primitive_meshes[primitive_index] = VGLTF_GLTF_INDEX_NONE;
+  }
+
+  *mesh_count = 0;
+  for (uint32_t draw_index = 0; draw_index < draw_count; draw_index++) {
+    uint32_t primitive_index = draws[draw_index].primitive;
+    if (primitive_meshes[primitive_index] == VGLTF_GLTF_INDEX_NONE) {
+      if (*mesh_count == VGLTF_RENDERER_MAX_MESH_COUNT) {
+        VGLTF_LOG_ERR("Mesh array cannot fit all the primitives of the "
+                      "model");
+        vgltf_allocator_free(&system_allocator, primitive_meshes);
+        return false;
+      }
+      mesh_primitives[*mesh_count] = primitive_index;
+      primitive_meshes[primitive_index] = (*mesh_count)++;
+    }
+    draw_meshes[draw_index] = primitive_meshes[primitive_index];
+  }
+
+  vgltf_allocator_free(&system_allocator, primitive_meshes);
+  return true;
+}
+
+// Loads the default scene of a .gltf or .glb file, accessors are decoded in
+// parallel on the job system
+static bool load_gltf_model(struct vgltf_renderer *renderer, const char *path) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_string_interner interner;
+  if (!vgltf_string_interner_init(&interner, &system_allocator,
+                                  GLTF_MAX_STRING_COUNT,
+                                  GLTF_MAX_STRING_BYTE_COUNT)) {
+    VGLTF_LOG_ERR("Couldn't initialize the glTF string interner");
+    goto err;
+  }
+
+  struct vgltf_gltf gltf;
+  if (!vgltf_gltf_load(&gltf, &system_allocator, &interner,
+                       renderer->job_system, path)) {
+    VGLTF_LOG_ERR("Couldn't load glTF file %s", path);
+    goto deinit_interner;
+  }
+
+  uint32_t scene_index = gltf.scene != VGLTF_GLTF_INDEX_NONE ? gltf.scene : 0;
+  if (scene_index >= gltf.scene_count) {
+    VGLTF_LOG_ERR("glTF file %s has no scene", path);
+    goto deinit_gltf;
+  }
+
+  if (!load_gltf_materials(renderer, &gltf, &interner)) {
+    VGLTF_LOG_ERR("Couldn't load the materials of the model");
+    goto deinit_gltf;
+  }
+
+  struct gltf_draw *draws = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_RENDERER_MAX_INSTANCE_COUNT,
+      sizeof(struct gltf_draw));
+  uint32_t *draw_meshes = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_RENDERER_MAX_INSTANCE_COUNT, sizeof(uint32_t));
+  uint32_t *mesh_primitives = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_RENDERER_MAX_MESH_COUNT, sizeof(uint32_t));
+  if (!draws || !draw_meshes || !mesh_primitives) {
+    VGLTF_LOG_ERR("Couldn't allocate the glTF draws");
+    goto free_draws;
+  }
+
+  uint32_t draw_count = 0;
+  uint32_t mesh_count;
+  if (!collect_gltf_draws(&gltf, &gltf.scenes[scene_index], draws,
+                          &draw_count) ||
+      !assign_gltf_meshes(&gltf, draws, draw_count, draw_meshes,
+                          mesh_primitives, &mesh_count)) {
+    goto free_draws;
+  }
+
+  uint32_t chunk_count;
+  if (!plan_gltf_import(renderer, &gltf, mesh_primitives, mesh_count, nullptr,
+                        &chunk_count)) {
+    goto free_draws;
+  }
+  struct gltf_import import = {.renderer = renderer,
+                               .gltf = &gltf,
+                               .mesh_primitives = mesh_primitives};
+  atomic_init(&import.failed, false);
+  choose_gltf_vertex_layout(&import, mesh_count);
+
+  struct gltf_import_chunk *chunks = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(chunk_count, 1u),
+      sizeof(struct gltf_import_chunk));
+  renderer->vertices =
+      allocate_vertices(&renderer->vertex_layout, renderer->vertex_count);
+  renderer->indices = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(renderer->index_count, 1),
+      sizeof(uint32_t));
+  if (!chunks || !renderer->vertices || !renderer->indices) {
+    VGLTF_LOG_ERR("Couldn't allocate the vertices and indices of the model");
+    goto free_chunks;
+  }
+  plan_gltf_import(renderer, &gltf, mesh_primitives, mesh_count, chunks,
+                   &chunk_count);
+  renderer->mesh_count = mesh_count;
+
+  // Compact vertices are quantized against the mesh bounds
+  import.chunks = chunks;
+  vgltf_job_system_parallel_for(renderer->job_system, mesh_count, 1,
+                                compute_gltf_mesh_bounds, &import);
+  if (!atomic_load(&import.failed)) {
+    vgltf_job_system_parallel_for(renderer->job_system, chunk_count, 1,
+                                  import_gltf_chunks, &import);
+  }
+  if (atomic_load(&import.failed)) {
+    VGLTF_LOG_ERR("Couldn't decode the primitives of glTF file %s", path);
+    goto free_chunks;
+  }
+
+  // Can't fail, draws were capped to the instance capacity
+  for (uint32_t draw_index = 0; draw_index < draw_count; draw_index++) {
+    if (!transform_mirrors(draws[draw_index].world_matrix)) {
+      push_instance(renderer, draw_meshes[draw_index],
+                    draws[draw_index].world_matrix);
+    }
+  }
+  renderer->first_mirrored_instance = renderer->instance_count;
+  for (uint32_t draw_index = 0; draw_index < draw_count; draw_index++) {
+    if (transform_mirrors(draws[draw_index].world_matrix)) {
+      push_instance(renderer, draw_meshes[draw_index],
+                    draws[draw_index].world_matrix);
+    }
+  }
+
+  vgltf_allocator_free(&system_allocator, chunks);
+  vgltf_allocator_free(&system_allocator, mesh_primitives);
+  vgltf_allocator_free(&system_allocator, draw_meshes);
+  vgltf_allocator_free(&system_allocator, draws);
+  vgltf_gltf_deinit(&gltf, &system_allocator);
+  vgltf_string_interner_deinit(&interner, &system_allocator);
+  return true;
+free_chunks:
+  vgltf_allocator_free(&system_allocator, chunks);
+free_draws:
+  vgltf_allocator_free(&system_allocator, mesh_primitives);
+  vgltf_allocator_free(&system_allocator, draw_meshes);
+  vgltf_allocator_free(&system_allocator, draws);
+deinit_gltf:
+  vgltf_gltf_deinit(&gltf, &system_allocator);
+deinit_interner:
+  vgltf_string_interner_deinit(&interner, &system_allocator);
+err:
+  return false;
+}
+
+static bool load_model(struct vgltf_renderer *renderer, const char *path) {
+  if (path_has_extension(path, ".gltf") || path_has_extension(path, ".glb")) {
+    return load_gltf_model(renderer, path);
+  }
+
+  return load_obj_model(renderer, path);
+}
+
+struct lod_build {
+  struct vgltf_renderer *renderer;
+  // Each mesh writes its simplified indices in its own index range, which
+  // bounds the size of its LODs
+  uint32_t *lod_indices;
+};
+
+// Simplifies each LOD from the previous one, its error adds up with theirs.
+// The first index of the LODs is in lod_indices until they are appended to
+// the index buffer.
+static void generate_mesh_lods(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct lod_build *build = data;
+  struct vgltf_renderer *renderer = build->renderer;
+  for (uint32_t mesh_index = begin; mesh_index < end; mesh_index++) {
+    struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    const uint32_t *indices = &renderer->indices[mesh->first_index];
+    uint32_t index_count = mesh->index_count / 3 * 3;
+    uint32_t vertex_count = 0;
+    for (uint32_t corner = 0; corner < index_count; corner++) {
+      vertex_count = VGLTF_MAX(vertex_count, indices[corner] + 1);
+    }
+    if (vertex_count == 0) {
+      continue;
+    }
+
+    vgltf_vec3 *positions = vgltf_allocator_allocate_array(
+        &system_allocator, vertex_count, sizeof(vgltf_vec3));
+    uint32_t *simplified_indices = vgltf_allocator_allocate_array(
+        &system_allocator, index_count, sizeof(uint32_t));
+    if (!positions || !simplified_indices) {
+      VGLTF_LOG_ERR("Couldn't allocate the LOD generation memory");
+      goto free_arrays;
+    }
+    // The error is measured in the space of the mesh bounds, the normalized
+    // positions of the compact layout are moved back to it
+    for (uint32_t vertex = 0; vertex < vertex_count; vertex++) {
+      vgltf_vec3 position = read_stream_position(
+          renderer, (size_t)mesh->vertex_offset + vertex);
+      if (renderer->vertex_layout.mesh_relative_positions) {
+        vgltf_vec3 center = mesh->bounding_sphere_center;
+        vgltf_vec3 half_extent = mesh->bounding_box_half_extent;
+        position = (vgltf_vec3){center.x + position.x * half_extent.x,
+                                center.y + position.y * half_extent.y,
+                                center.z + position.z * half_extent.z};
+      }
+      positions[vertex] = position;
+    }
+
+    uint32_t *lod_indices = &build->lod_indices[mesh->first_index];
+    uint32_t used_index_count = 0;
+    while (mesh->lod_count < VGLTF_RENDERER_MAX_LOD_COUNT) {
+      const struct vgltf_renderer_mesh_lod *previous =
+          &mesh->lods[mesh->lod_count - 1];
+      const uint32_t *source =
+          mesh->lod_count == 1 ? indices : &lod_indices[previous->first_index];
+      vgltf_vec_value_type max_error =
+          mesh->bounding_sphere_radius * VGLTF_RENDERER_LOD_MAX_RELATIVE_ERROR -
+          previous->error;
+      struct vgltf_simplify_result result;
+      if (max_error <= 0.f) {
+        break;
+      }
+      if (!vgltf_simplify(&system_allocator, simplified_indices, source,
+                          previous->index_count, positions, vertex_count,
+                          previous->index_count / 2, max_error, &result)) {
+        VGLTF_LOG_ERR("Couldn't simplify a mesh");
+        break;
+      }
+      // Stops once the simplification stalls on locked vertices or the error
+      // limit
+      if (result.index_count == 0 ||
+          result.index_count > previous->index_count / 5 * 4 ||
+          used_index_count + result.index_count > index_count) {
+        break;
+      }
+      memcpy(&lod_indices[used_index_count], simplified_indices,
+             result.index_count * sizeof(uint32_t));
+      mesh->lods[mesh->lod_count++] = (struct vgltf_renderer_mesh_lod){
+          .first_index = used_index_count,
+          .index_count = result.index_count,
+          .error = previous->error + result.error};
+      used_index_count += result.index_count;
+    }
+  free_arrays:
+    vgltf_allocator_free(&system_allocator, simplified_indices);
+    vgltf_allocator_free(&system_allocator, positions);
+  }
+}
+
+// Simplified LODs of every mesh, appended to the index buffer after the full
+// detail meshes
+static bool generate_lods(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    mesh->lods[0] = (struct vgltf_renderer_mesh_lod){
+        .first_index = mesh->first_index,
+        .index_count = mesh->index_count / 3 * 3};
+    mesh->lod_count = 1;
+  }
+  // LODs are at most as large as their mesh
+  if ((uint64_t)renderer->index_count * 2 > INT32_MAX) {
+    VGLTF_LOG_INFO("The model has too many indices to generate LODs");
+    return true;
+  }
+
+  struct lod_build build = {
+      .renderer = renderer,
+      .lod_indices = vgltf_allocator_allocate_array(
+          &system_allocator, VGLTF_MAX(renderer->index_count, 1),
+          sizeof(uint32_t))};
+  if (!build.lod_indices) {
+    VGLTF_LOG_ERR("Couldn't allocate the LOD indices");
+    return false;
+  }
+  vgltf_job_system_parallel_for(renderer->job_system, renderer->mesh_count, 1,
+                                generate_mesh_lods, &build);
+
+  uint64_t lod_index_count = 0;
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    const struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    for (uint32_t lod_index = 1; lod_index < mesh->lod_count; lod_index++) {
+      lod_index_count += mesh->lods[lod_index].index_count;
+    }
+  }
+  if (lod_index_count == 0) {
+    vgltf_allocator_free(&system_allocator, build.lod_indices);
+    return true;
+  }
+  uint32_t *indices = vgltf_allocator_reallocate(
+      &system_allocator, renderer->indices,
+      renderer->index_count * sizeof(uint32_t),
+      (renderer->index_count + lod_index_count) * sizeof(uint32_t));
+  if (!indices) {
+    VGLTF_LOG_ERR("Couldn't grow the index array for the LODs");
+    vgltf_allocator_free(&system_allocator, build.lod_indices);
+    return false;
+  }
+  renderer->indices = indices;
+
+  uint32_t original_index_count = renderer->index_count;
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    for (uint32_t lod_index = 1; lod_index < mesh->lod_count; lod_index++) {
+      struct vgltf_renderer_mesh_lod *lod = &mesh->lods[lod_index];
+      memcpy(&renderer->indices[renderer->index_count],
+             &build.lod_indices[mesh->first_index + lod->first_index],
+             lod->index_count * sizeof(uint32_t));
+      lod->first_index = renderer->index_count;
+      renderer->index_count += lod->index_count;
+    }
+  }
+  VGLTF_LOG_INFO("LODs add %u indices to the %u of the meshes",
+                 renderer->index_count - original_index_count,
+                 original_index_count);
+  vgltf_allocator_free(&system_allocator, build.lod_indices);
+  return true;
+}
+
+// Triangles of a mesh LOD split into meshlets by one job, LODs larger than the
+// meshlet builder handles are split over several chunks
+struct meshlet_chunk {
+  uint32_t mesh_index;
+  uint32_t lod_index;
+  // In the index buffer
+  uint32_t first_index;
+  uint32_t index_count;
+  // Where the chunk writes its meshlets, and how many it wrote
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+};
+
+struct meshlet_build {
+  struct vgltf_renderer *renderer;
+  struct meshlet_chunk *chunks;
+  // One per job system thread
+  struct vgltf_meshlet_builder *builders;
+};
+
+static void build_meshlet_chunks(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct meshlet_build *build = data;
+  struct vgltf_renderer *renderer = build->renderer;
+  struct vgltf_meshlet_builder *builder =
+      &build->builders[vgltf_job_system_get_thread_index()];
+  struct vgltf_meshlet meshlets[VGLTF_MESHLET_BUILD_MAX_MESHLET_COUNT];
+  vgltf_vec3 corners[3 * VGLTF_MESHLET_MAX_TRIANGLE_COUNT];
+  for (uint32_t chunk_index = begin; chunk_index < end; chunk_index++) {
+    struct meshlet_chunk *chunk = &build->chunks[chunk_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[chunk->mesh_index];
+    const struct vgltf_renderer_mesh_lod *lod = &mesh->lods[chunk->lod_index];
+    uint32_t *indices = &renderer->indices[chunk->first_index];
+    chunk->meshlet_count =
+        vgltf_meshlet_build(builder, indices, chunk->index_count, meshlets);
+
+    for (uint32_t meshlet_index = 0; meshlet_index < chunk->meshlet_count;
+         meshlet_index++) {
+      const struct vgltf_meshlet *meshlet = &meshlets[meshlet_index];
+      for (uint32_t corner = 0; corner < meshlet->triangle_count * 3;
+           corner++) {
+        corners[corner] = read_stream_position(
+            renderer, (size_t)mesh->vertex_offset +
+                          indices[meshlet->first_index + corner]);
+      }
+      struct vgltf_meshlet_bounds bounds =
+          vgltf_meshlet_compute_bounds(corners, meshlet->triangle_count);
+      renderer->meshlets[chunk->first_meshlet + meshlet_index] =
+          (struct vgltf_renderer_gpu_meshlet){
+              .bounding_sphere = {bounds.center.x, bounds.center.y,
+                                  bounds.center.z, bounds.radius},
+              .cone_apex = {bounds.cone_apex.x, bounds.cone_apex.y,
+                            bounds.cone_apex.z},
+              .cone_cutoff = bounds.cone_cutoff,
+              .cone_axis = {bounds.cone_axis.x, bounds.cone_axis.y,
+                            bounds.cone_axis.z},
+              .first_index = chunk->first_index - lod->first_index +
+                             meshlet->first_index,
+              .triangle_count = meshlet->triangle_count};
+    }
+  }
+}
+
+// Splits every mesh LOD into meshlets for the cluster culling, the triangles
+// of each LOD are reordered so that its meshlets are contiguous index ranges
+static bool build_meshlets(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  uint32_t chunk_count = 0;
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    for (uint32_t lod_index = 0; lod_index < mesh->lod_count; lod_index++) {
+      struct vgltf_renderer_mesh_lod *lod = &mesh->lods[lod_index];
+      lod->first_meshlet = 0;
+      lod->meshlet_count = 0;
+      chunk_count += (lod->index_count / 3 +
+                      VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT - 1) /
+                     VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT;
+    }
+  }
+  // Chunks write their meshlets at the most the chunks before them can make
+  size_t meshlet_capacity =
+      (size_t)chunk_count * VGLTF_MESHLET_BUILD_MAX_MESHLET_COUNT;
+
+  int thread_count = vgltf_job_system_get_thread_count(renderer->job_system);
+  struct meshlet_build build = {.renderer = renderer};
+  build.chunks = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(chunk_count, 1u),
+      sizeof(struct meshlet_chunk));
+  renderer->meshlets = vgltf_allocator_allocate_array(
+      &system_allocator, VGLTF_MAX(meshlet_capacity, (size_t)1),
+      sizeof(struct vgltf_renderer_gpu_meshlet));
+  build.builders = vgltf_allocator_allocate_array(
+      &system_allocator, thread_count, sizeof(struct vgltf_meshlet_builder));
+  if (!build.chunks || !renderer->meshlets || !build.builders) {
+    VGLTF_LOG_ERR("Couldn't allocate the meshlets");
+    goto free_arrays;
+  }
+
+  int initialized_builder_count = 0;
+  for (; initialized_builder_count < thread_count;
+       initialized_builder_count++) {
+    if (!vgltf_meshlet_builder_init(&build.builders[initialized_builder_count],
+                                    &system_allocator)) {
+      VGLTF_LOG_ERR("Couldn't create the meshlet builders");
+      goto deinit_builders;
+    }
+  }
+
+  uint32_t chunk_index = 0;
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    const struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    for (uint32_t lod_index = 0; lod_index < mesh->lod_count; lod_index++) {
+      const struct vgltf_renderer_mesh_lod *lod = &mesh->lods[lod_index];
+      for (uint32_t first_index = 0; first_index < lod->index_count;
+           first_index += 3 * VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT) {
+        uint32_t chunk_index_count = lod->index_count - first_index;
+        if (chunk_index_count > 3 * VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT) {
+          chunk_index_count = 3 * VGLTF_MESHLET_BUILD_MAX_TRIANGLE_COUNT;
+        }
+        build.chunks[chunk_index] = (struct meshlet_chunk){
+            .mesh_index = mesh_index,
+            .lod_index = lod_index,
+            .first_index = lod->first_index + first_index,
+            .index_count = chunk_index_count,
+            .first_meshlet =
+                chunk_index * VGLTF_MESHLET_BUILD_MAX_MESHLET_COUNT};
+        chunk_index++;
+      }
+    }
+  }
+  vgltf_job_system_parallel_for(renderer->job_system, chunk_count, 1,
+                                build_meshlet_chunks, &build);
+
+  // Packs the meshlets of each LOD together, in chunk order
+  renderer->meshlet_count = 0;
+  for (chunk_index = 0; chunk_index < chunk_count; chunk_index++) {
+    const struct meshlet_chunk *chunk = &build.chunks[chunk_index];
+    struct vgltf_renderer_mesh_lod *lod =
+        &renderer->meshes[chunk->mesh_index].lods[chunk->lod_index];
+    if (chunk->first_index == lod->first_index) {
+      lod->first_meshlet = renderer->meshlet_count;
+    }
+    memmove(&renderer->meshlets[renderer->meshlet_count],
+            &renderer->meshlets[chunk->first_meshlet],
+            chunk->meshlet_count * sizeof(struct vgltf_renderer_gpu_meshlet));
+    renderer->meshlet_count += chunk->meshlet_count;
+    lod->meshlet_count += chunk->meshlet_count;
+  }
+  VGLTF_LOG_INFO("%u meshlets, %.1f triangles per meshlet",
+                 renderer->meshlet_count,
+                 renderer->index_count / 3.f /
+                     VGLTF_MAX(renderer->meshlet_count, 1u));
+
+  for (int builder_index = 0; builder_index < thread_count; builder_index++) {
+    vgltf_meshlet_builder_deinit(&build.builders[builder_index],
+                                 &system_allocator);
+  }
+  vgltf_allocator_free(&system_allocator, build.builders);
+  vgltf_allocator_free(&system_allocator, build.chunks);
+  return true;
+deinit_builders:
+  for (int builder_index = 0; builder_index < initialized_builder_count;
+       builder_index++) {
+    vgltf_meshlet_builder_deinit(&build.builders[builder_index],
+                                 &system_allocator);
+  }
+free_arrays:
+  vgltf_allocator_free(&system_allocator, build.builders);
+  vgltf_allocator_free(&system_allocator, renderer->meshlets);
+  renderer->meshlets = nullptr;
+  vgltf_allocator_free(&system_allocator, build.chunks);
+  return false;
+}
+
+// Creates a device local buffer and fills it with data through a staging buffer
+static bool vgltf_renderer_create_buffer_with_data(
+    struct vgltf_renderer *renderer, const void *data, VkDeviceSize size,
+    VkBufferUsageFlags usage, struct vgltf_renderer_allocated_buffer *buffer) {
+  struct vgltf_renderer_allocated_buffer staging_buffer = {};
+  if (!vgltf_renderer_create_buffer(renderer, size,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    &staging_buffer)) {
+    VGLTF_LOG_ERR("Failed to create transfer buffer");
+    goto err;
+  }
+
+  void *mapped_data;
+  vmaMapMemory(renderer->device.allocator, staging_buffer.allocation,
+               &mapped_data);
+  memcpy(mapped_data, data, size);
+  vmaUnmapMemory(renderer->device.allocator, staging_buffer.allocation);
+
+  if (!vgltf_renderer_create_buffer(
+          renderer, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer)) {
+    VGLTF_LOG_ERR("Failed to create buffer");
     goto destroy_staging_buffer;
   }
-  vgltf_renderer_copy_buffer(renderer, staging_buffer.buffer,
-                             renderer->index_buffer.buffer, buffer_size);
+
+  vgltf_renderer_copy_buffer(renderer, staging_buffer.buffer, buffer->buffer,
+                             size);
   vmaDestroyBuffer(renderer->device.allocator, staging_buffer.buffer,
                    staging_buffer.allocation);
   return true;
-
 destroy_staging_buffer:
   vmaDestroyBuffer(renderer->device.allocator, staging_buffer.buffer,
                    staging_buffer.allocation);
@@ -1862,27 +3788,339 @@ err:
   return false;
 }
 
+// Pools of the geometry streaming, in the order they are added
+enum geometry_pool { GEOMETRY_POOL_VERTEX, GEOMETRY_POOL_INDEX };
+// Streams of the vertex pool, binding 0 of the main pass and of the depth
+// prepass
+enum geometry_vertex_stream {
+  GEOMETRY_VERTEX_STREAM_ATTRIBUTES,
+  GEOMETRY_VERTEX_STREAM_POSITIONS
+};
+
+// Splits the geometry pool size between the vertices and the indices in
+// proportion to their size in the model, a pool holds at most the whole
+// model. Every mesh must fit: the vertex pool holds the largest vertex range,
+// which all the LODs of its mesh share, and the index pool the largest LOD
+// next to the coarsest LOD of its mesh, which the frame requests first as a
+// fallback and can't evict.
+static void geometry_pool_capacities(const struct vgltf_renderer *renderer,
+                                     uint32_t *vertex_capacity,
+                                     uint32_t *index_capacity) {
+  const struct vgltf_vertex_layout *layout = &renderer->vertex_layout;
+  uint64_t vertex_size = layout->stride + layout->position_stride;
+  uint64_t vertex_bytes = (uint64_t)renderer->vertex_count * vertex_size;
+  uint64_t index_bytes = (uint64_t)renderer->index_count * sizeof(uint32_t);
+  uint64_t model_size = vertex_bytes + index_bytes;
+  *vertex_capacity = renderer->vertex_count;
+  *index_capacity = renderer->index_count;
+  if (model_size > VGLTF_RENDERER_GEOMETRY_POOL_SIZE) {
+    double vertex_share = (double)vertex_bytes / (double)model_size;
+    *vertex_capacity = (uint32_t)(VGLTF_RENDERER_GEOMETRY_POOL_SIZE *
+                                  vertex_share / (double)vertex_size);
+    *index_capacity =
+        (uint32_t)(VGLTF_RENDERER_GEOMETRY_POOL_SIZE * (1. - vertex_share) /
+                   sizeof(uint32_t));
+  }
+
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    const struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    *vertex_capacity = VGLTF_MAX(*vertex_capacity, mesh->vertex_count);
+    uint32_t coarsest_index_count = mesh->lods[mesh->lod_count - 1].index_count;
+    for (uint32_t lod_index = 0; lod_index + 1 < mesh->lod_count;
+         lod_index++) {
+      *index_capacity =
+          VGLTF_MAX(*index_capacity,
+                    mesh->lods[lod_index].index_count + coarsest_index_count);
+    }
+    *index_capacity = VGLTF_MAX(*index_capacity, coarsest_index_count);
+  }
+}
+
+// The vertices and indices stay in system memory, the visible meshes and
+// their selected LODs are uploaded to fixed size pools as they are drawn
+static bool
+vgltf_renderer_create_geometry_streaming(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  static_assert(VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT <=
+                    VGLTF_GEOMETRY_STREAMING_MAX_FRAME_COUNT,
+                "Frames in flight need their own staging buffer");
+  uint32_t resource_count = renderer->mesh_count;
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    resource_count += renderer->meshes[mesh_index].lod_count;
+  }
+  struct vgltf_geometry_streaming *streaming = &renderer->geometry_streaming;
+  if (!vgltf_geometry_streaming_init(
+          streaming, renderer->device.allocator, renderer->job_system,
+          resource_count, VGLTF_RENDERER_GEOMETRY_STAGING_SIZE,
+          VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT)) {
+    VGLTF_LOG_ERR("Couldn't create the geometry streaming");
+    goto err;
+  }
+
+  uint32_t vertex_capacity;
+  uint32_t index_capacity;
+  geometry_pool_capacities(renderer, &vertex_capacity, &index_capacity);
+  const struct vgltf_vertex_layout *layout = &renderer->vertex_layout;
+  const char *vertices = renderer->vertices;
+  struct vgltf_geometry_stream vertex_streams[] = {
+      [GEOMETRY_VERTEX_STREAM_ATTRIBUTES] = {.source = vertices,
+                                             .element_size = layout->stride},
+      [GEOMETRY_VERTEX_STREAM_POSITIONS] =
+          {.source = vertices + position_stream_offset(
+                                    layout, (size_t)renderer->vertex_count),
+           .element_size = layout->position_stride}};
+  struct vgltf_geometry_stream index_stream = {
+      .source = (const char *)renderer->indices,
+      .element_size = sizeof(uint32_t)};
+  if (!vgltf_geometry_streaming_add_pool(streaming, vertex_capacity,
+                                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                         vertex_streams, 2) ||
+      // The cluster culling copies the indices of the visible meshlets
+      !vgltf_geometry_streaming_add_pool(
+          streaming, index_capacity,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          &index_stream, 1)) {
+    VGLTF_LOG_ERR("Couldn't create the geometry pools");
+    goto deinit_streaming;
+  }
+  VGLTF_LOG_INFO("Geometry pools of %u vertices and %u indices for %d and %d",
+                 vertex_capacity, index_capacity, renderer->vertex_count,
+                 renderer->index_count);
+
+  for (uint32_t mesh_index = 0; mesh_index < renderer->mesh_count;
+       mesh_index++) {
+    struct vgltf_renderer_mesh *mesh = &renderer->meshes[mesh_index];
+    mesh->vertex_resource = vgltf_geometry_streaming_add_resource(
+        streaming, GEOMETRY_POOL_VERTEX, mesh->vertex_offset,
+        mesh->vertex_count);
+    for (uint32_t lod_index = 0; lod_index < mesh->lod_count; lod_index++) {
+      struct vgltf_renderer_mesh_lod *lod = &mesh->lods[lod_index];
+      lod->index_resource = vgltf_geometry_streaming_add_resource(
+          streaming, GEOMETRY_POOL_INDEX, lod->first_index, lod->index_count);
+    }
+  }
+
+  if (layout->constant_size > 0 &&
+      !vgltf_renderer_create_buffer_with_data(
+          renderer, layout->constant_values, layout->constant_size,
+          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+          &renderer->constant_vertex_buffer)) {
+    VGLTF_LOG_ERR("Failed to create constant vertex buffer");
+    goto deinit_streaming;
+  }
+
+  return true;
+deinit_streaming:
+  vgltf_geometry_streaming_deinit(streaming);
+err:
+  return false;
+}
+
+static bool
+vgltf_renderer_create_meshlet_buffer(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (!vgltf_renderer_create_buffer_with_data(
+          renderer, renderer->meshlets,
+          VGLTF_MAX(renderer->meshlet_count, 1u) *
+              sizeof(struct vgltf_renderer_gpu_meshlet),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->meshlet_buffer)) {
+    VGLTF_LOG_ERR("Failed to create meshlet buffer");
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+vgltf_renderer_create_instance_buffer(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  uint32_t instance_capacity = VGLTF_MAX(renderer->instance_count, 1u);
+  struct vgltf_renderer_gpu_instance *gpu_instances =
+      vgltf_allocator_allocate_array(&system_allocator, instance_capacity,
+                                     sizeof(struct vgltf_renderer_gpu_instance));
+  for (uint32_t instance_index = 0; instance_index < renderer->instance_count;
+       instance_index++) {
+    const struct vgltf_renderer_instance *instance =
+        &renderer->instances[instance_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[instance->mesh_index];
+    vgltf_vec3 center;
+    vgltf_vec_value_type radius;
+    instance_bounding_sphere(renderer, instance, &center, &radius);
+    struct vgltf_renderer_gpu_instance *gpu_instance =
+        &gpu_instances[instance_index];
+    *gpu_instance = (struct vgltf_renderer_gpu_instance){
+        .bounding_sphere = {center.x, center.y, center.z, radius},
+        .material_index = mesh->material_index};
+    memcpy(gpu_instance->transform, instance->transform, sizeof(vgltf_mat4));
+    if (renderer->vertex_layout.mesh_relative_positions) {
+      // Maps the normalized positions back to model space before the instance
+      // transform: scales the columns by the half extent, and moves the
+      // translation to the bounding box center
+      const vgltf_mat_value_type *transform = instance->transform;
+      float *gpu_transform = gpu_instance->transform;
+      float scales[3] = {mesh->bounding_box_half_extent.x,
+                         mesh->bounding_box_half_extent.y,
+                         mesh->bounding_box_half_extent.z};
+      float offsets[3] = {mesh->bounding_sphere_center.x,
+                          mesh->bounding_sphere_center.y,
+                          mesh->bounding_sphere_center.z};
+      for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 3; column++) {
+          gpu_transform[column * 4 + row] = transform[column * 4 + row] *
+                                            scales[column];
+          gpu_transform[12 + row] += transform[column * 4 + row] *
+                                     offsets[column];
+        }
+      }
+    }
+  }
+
+  bool instance_buffer_created = vgltf_renderer_create_buffer_with_data(
+      renderer, gpu_instances,
+      instance_capacity * sizeof(struct vgltf_renderer_gpu_instance),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->instance_buffer);
+  vgltf_allocator_free(&system_allocator, gpu_instances);
+  if (!instance_buffer_created) {
+    VGLTF_LOG_ERR("Failed to create instance buffer");
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+vgltf_renderer_create_material_buffer(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (!vgltf_renderer_create_buffer_with_data(
+          renderer, renderer->materials,
+          renderer->material_count * sizeof(struct vgltf_renderer_material),
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &renderer->material_buffer)) {
+    VGLTF_LOG_ERR("Failed to create material buffer");
+    return false;
+  }
+
+  return true;
+}
+
 static bool
 vgltf_renderer_create_command_buffer(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkCommandBufferAllocateInfo allocate_info = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
       .commandPool = renderer->command_pool,
       .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
       .commandBufferCount = VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT};
 
-  if (vkAllocateCommandBuffers(renderer->device.device, &allocate_info,
-                               renderer->command_buffer) != VK_SUCCESS) {
-    VGLTF_LOG_ERR("Couldn't allocate command buffers");
+  if (vkAllocateCommandBuffers(renderer->device.device, &allocate_info,
+                               renderer->command_buffer) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't allocate command buffers");
+    goto err;
+  }
+
+  return true;
+err:
+  return false;
+}
+
+static bool vgltf_renderer_create_thread_command_pool(
+    struct vgltf_renderer *renderer, uint32_t queue_family_index,
+    struct vgltf_renderer_thread_command_pool *thread_command_pool) {
+  VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      .queueFamilyIndex = queue_family_index};
+  if (vkCreateCommandPool(renderer->device.device, &pool_info, nullptr,
+                          &thread_command_pool->command_pool) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create thread command pool");
+    goto err;
+  }
+
+  // A single thread can end up recording every chunk of every subpass
+  VkCommandBufferAllocateInfo allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = thread_command_pool->command_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+      .commandBufferCount = VGLTF_RENDERER_SUBPASS_COUNT *
+                            VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT};
+  if (vkAllocateCommandBuffers(
+          renderer->device.device, &allocate_info,
+          thread_command_pool->secondary_command_buffers) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't allocate secondary command buffers");
+    goto destroy_command_pool;
+  }
+
+  thread_command_pool->used_secondary_command_buffer_count = 0;
+  return true;
+destroy_command_pool:
+  vkDestroyCommandPool(renderer->device.device,
+                       thread_command_pool->command_pool, nullptr);
+err:
+  return false;
+}
+
+static void vgltf_renderer_destroy_thread_command_pools(
+    struct vgltf_renderer *renderer) {
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    for (int thread_index = 0; thread_index < renderer->recording_thread_count;
+         thread_index++) {
+      vkDestroyCommandPool(
+          renderer->device.device,
+          renderer->thread_command_pools[frame_index][thread_index]
+              .command_pool,
+          nullptr);
+    }
+  }
+  renderer->recording_thread_count = 0;
+}
+
+static bool
+vgltf_renderer_create_thread_command_pools(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct queue_family_indices queue_family_indices = {};
+  if (!queue_family_indices_for_device(&queue_family_indices,
+                                       renderer->device.physical_device,
+                                       renderer->surface.surface)) {
+    VGLTF_LOG_ERR("Couldn't fetch queue family indices");
     goto err;
   }
 
+  int thread_count = vgltf_job_system_get_thread_count(renderer->job_system);
+  renderer->recording_thread_count = 0;
+  for (int thread_index = 0; thread_index < thread_count; thread_index++) {
+    for (int frame_index = 0;
+         frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT;
+         frame_index++) {
+      if (!vgltf_renderer_create_thread_command_pool(
+              renderer, queue_family_indices.graphics_family,
+              &renderer->thread_command_pools[frame_index][thread_index])) {
+        for (int created_frame_index = 0; created_frame_index < frame_index;
+             created_frame_index++) {
+          vkDestroyCommandPool(
+              renderer->device.device,
+              renderer->thread_command_pools[created_frame_index][thread_index]
+                  .command_pool,
+              nullptr);
+        }
+        goto destroy_thread_command_pools;
+      }
+    }
+    renderer->recording_thread_count++;
+  }
+
   return true;
+destroy_thread_command_pools:
+  vgltf_renderer_destroy_thread_command_pools(renderer);
 err:
   return false;
 }
 
 static bool
 vgltf_renderer_create_sync_objects(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkSemaphoreCreateInfo semaphore_info = {
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
   };
@@ -1909,57 +4147,1349 @@ vgltf_renderer_create_sync_objects(struct vgltf_renderer *renderer) {
     }
   }
 
-  return true;
-err:
-  for (int frame_in_flight_to_delete_index = 0;
-       frame_in_flight_to_delete_index < frame_in_flight_index;
-       frame_in_flight_to_delete_index++) {
-    vkDestroyFence(renderer->device.device,
-                   renderer->in_flight_fences[frame_in_flight_index], nullptr);
-    vkDestroySemaphore(
-        renderer->device.device,
-        renderer->render_finished_semaphores[frame_in_flight_index], nullptr);
-    vkDestroySemaphore(
-        renderer->device.device,
-        renderer->image_available_semaphores[frame_in_flight_index], nullptr);
+  return true;
+err:
+  for (int frame_in_flight_to_delete_index = 0;
+       frame_in_flight_to_delete_index < frame_in_flight_index;
+       frame_in_flight_to_delete_index++) {
+    vkDestroyFence(renderer->device.device,
+                   renderer->in_flight_fences[frame_in_flight_index], nullptr);
+    vkDestroySemaphore(
+        renderer->device.device,
+        renderer->render_finished_semaphores[frame_in_flight_index], nullptr);
+    vkDestroySemaphore(
+        renderer->device.device,
+        renderer->image_available_semaphores[frame_in_flight_index], nullptr);
+  }
+  return false;
+}
+
+// Offscreen images can be copied from once rendered, so frames can be read
+// back
+static bool create_offscreen_images(struct vgltf_vk_swapchain *swapchain,
+                                    struct vgltf_vk_device *device,
+                                    struct vgltf_window_size *window_size) {
+  swapchain->swapchain = VK_NULL_HANDLE;
+  swapchain->swapchain_image_format = VK_FORMAT_R8G8B8A8_SRGB;
+  swapchain->swapchain_extent =
+      (VkExtent2D){.width = window_size->width, .height = window_size->height};
+  swapchain->swapchain_image_count = VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT;
+
+  uint32_t image_index;
+  for (image_index = 0; image_index < swapchain->swapchain_image_count;
+       image_index++) {
+    struct vgltf_renderer_allocated_image *image =
+        &swapchain->offscreen_images[image_index];
+    if (vmaCreateImage(
+            device->allocator,
+            &(const VkImageCreateInfo){
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .extent = {swapchain->swapchain_extent.width,
+                           swapchain->swapchain_extent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .format = swapchain->swapchain_image_format,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+            },
+            &(const VmaAllocationCreateInfo){.usage =
+                                                 VMA_MEMORY_USAGE_GPU_ONLY},
+            &image->image, &image->allocation, &image->info) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Couldn't create offscreen image");
+      goto err;
+    }
+    swapchain->swapchain_images[image_index] = image->image;
+  }
+
+  return true;
+err:
+  for (uint32_t to_remove_index = 0; to_remove_index < image_index;
+       to_remove_index++) {
+    vmaDestroyImage(device->allocator,
+                    swapchain->offscreen_images[to_remove_index].image,
+                    swapchain->offscreen_images[to_remove_index].allocation);
+  }
+  return false;
+}
+
+static void destroy_offscreen_images(struct vgltf_vk_swapchain *swapchain,
+                                     struct vgltf_vk_device *device) {
+  for (uint32_t image_index = 0; image_index < swapchain->swapchain_image_count;
+       image_index++) {
+    vmaDestroyImage(device->allocator,
+                    swapchain->offscreen_images[image_index].image,
+                    swapchain->offscreen_images[image_index].allocation);
+  }
+}
+
+static bool vgltf_vk_swapchain_init(struct vgltf_vk_swapchain *swapchain,
+                                    struct vgltf_vk_device *device,
+                                    struct vgltf_vk_surface *surface,
+                                    struct vgltf_window_size *window_size) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (surface->surface == VK_NULL_HANDLE) {
+    if (!create_offscreen_images(swapchain, device, window_size)) {
+      goto err;
+    }
+  } else if (!create_swapchain(swapchain, device, surface, window_size)) {
+    VGLTF_LOG_ERR("Couldn't create swapchain");
+    goto err;
+  }
+
+  if (!create_swapchain_image_views(swapchain, device)) {
+    VGLTF_LOG_ERR("Couldn't create image views");
+    goto destroy_swapchain;
+  }
+
+  return true;
+destroy_swapchain:
+  if (swapchain->swapchain == VK_NULL_HANDLE) {
+    destroy_offscreen_images(swapchain, device);
+  }
+  vkDestroySwapchainKHR(device->device, swapchain->swapchain, nullptr);
+err:
+  return false;
+}
+
+static void vgltf_vk_swapchain_deinit(struct vgltf_vk_swapchain *swapchain,
+                                      struct vgltf_vk_device *device) {
+  for (uint32_t swapchain_image_view_index = 0;
+       swapchain_image_view_index < swapchain->swapchain_image_count;
+       swapchain_image_view_index++) {
+    vkDestroyImageView(
+        device->device,
+        swapchain->swapchain_image_views[swapchain_image_view_index], nullptr);
+  }
+  if (swapchain->swapchain == VK_NULL_HANDLE) {
+    destroy_offscreen_images(swapchain, device);
+  }
+  vkDestroySwapchainKHR(device->device, swapchain->swapchain, nullptr);
+}
+
+static bool create_compute_pipeline(
+    struct vgltf_renderer *renderer, const unsigned char *code, int code_size,
+    VkDescriptorSetLayout descriptor_set_layout, uint32_t push_constant_size,
+    const VkSpecializationInfo *specialization_info,
+    VkPipelineLayout *pipeline_layout, VkPipeline *pipeline) {
+  VkShaderModule shader_module;
+  if (!create_shader_module(renderer->device.device, code, code_size,
+                            &shader_module)) {
+    VGLTF_LOG_ERR("Couldn't create compute shader module");
+    goto err;
+  }
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &descriptor_set_layout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges =
+          &(const VkPushConstantRange){.stageFlags =
+                                           VK_SHADER_STAGE_COMPUTE_BIT,
+                                       .offset = 0,
+                                       .size = push_constant_size}};
+  if (vkCreatePipelineLayout(renderer->device.device, &pipeline_layout_info,
+                             nullptr, pipeline_layout) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create compute pipeline layout");
+    goto destroy_shader_module;
+  }
+
+  VkComputePipelineCreateInfo pipeline_info = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage = {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main",
+                .pSpecializationInfo = specialization_info},
+      .layout = *pipeline_layout};
+  if (vkCreateComputePipelines(renderer->device.device, VK_NULL_HANDLE, 1,
+                               &pipeline_info, nullptr,
+                               pipeline) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create compute pipeline");
+    goto destroy_pipeline_layout;
+  }
+
+  vkDestroyShaderModule(renderer->device.device, shader_module, nullptr);
+  return true;
+destroy_pipeline_layout:
+  vkDestroyPipelineLayout(renderer->device.device, *pipeline_layout, nullptr);
+destroy_shader_module:
+  vkDestroyShaderModule(renderer->device.device, shader_module, nullptr);
+err:
+  return false;
+}
+
+static bool create_image_level_view(struct vgltf_vk_device *device,
+                                    VkImage image, VkFormat format,
+                                    uint32_t mip_level,
+                                    VkImageView *image_view) {
+  VkImageViewCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = format,
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = mip_level,
+                           .levelCount = 1,
+                           .layerCount = 1}};
+  return vkCreateImageView(device->device, &create_info, nullptr,
+                           image_view) == VK_SUCCESS;
+}
+
+static void vgltf_renderer_destroy_depth_pyramid(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  for (uint32_t level = 0; level < culling->depth_pyramid_level_count;
+       level++) {
+    vkDestroyImageView(renderer->device.device,
+                       culling->depth_pyramid_level_views[level], nullptr);
+  }
+  vkDestroyImageView(renderer->device.device, culling->depth_pyramid_view,
+                     nullptr);
+  vmaDestroyImage(renderer->device.allocator, culling->depth_pyramid.image,
+                  culling->depth_pyramid.allocation);
+  culling->depth_pyramid_level_count = 0;
+  culling->depth_pyramid_valid = false;
+}
+
+// The depth pyramid level 0 is half the size of the depth buffer, each level
+// keeps the farthest depth of the texels it covers in the previous level
+static bool vgltf_renderer_create_depth_pyramid(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  VkExtent2D depth_extent = renderer->swapchain.swapchain_extent;
+  culling->depth_pyramid_width = VGLTF_MAX((depth_extent.width + 1) / 2, 1u);
+  culling->depth_pyramid_height = VGLTF_MAX((depth_extent.height + 1) / 2, 1u);
+  uint32_t level_count =
+      floor(log2(VGLTF_MAX(culling->depth_pyramid_width,
+                           culling->depth_pyramid_height))) +
+      1;
+  if (level_count > VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT) {
+    level_count = VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT;
+  }
+
+  vgltf_renderer_create_image(
+      renderer, culling->depth_pyramid_width, culling->depth_pyramid_height,
+      level_count, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culling->depth_pyramid);
+  if (!create_image_view(&renderer->device, culling->depth_pyramid.image,
+                         VK_FORMAT_R32_SFLOAT, &culling->depth_pyramid_view,
+                         VK_IMAGE_ASPECT_COLOR_BIT, level_count)) {
+    VGLTF_LOG_ERR("Couldn't create depth pyramid view");
+    goto destroy_image;
+  }
+
+  for (culling->depth_pyramid_level_count = 0;
+       culling->depth_pyramid_level_count < level_count;
+       culling->depth_pyramid_level_count++) {
+    uint32_t level = culling->depth_pyramid_level_count;
+    if (!create_image_level_view(&renderer->device,
+                                 culling->depth_pyramid.image,
+                                 VK_FORMAT_R32_SFLOAT, level,
+                                 &culling->depth_pyramid_level_views[level])) {
+      VGLTF_LOG_ERR("Couldn't create depth pyramid level view");
+      goto destroy_views;
+    }
+  }
+
+  transition_image_layout(renderer, culling->depth_pyramid.image,
+                          VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_GENERAL, level_count);
+
+  for (uint32_t level = 0; level < level_count; level++) {
+    VkDescriptorImageInfo source_info = {
+        .sampler = culling->depth_pyramid_sampler,
+        .imageView = level == 0 ? renderer->depth_image_view
+                                : culling->depth_pyramid_level_views[level - 1],
+        .imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+                                  : VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo destination_info = {
+        .imageView = culling->depth_pyramid_level_views[level],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet descriptor_writes[] = {
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->depth_pyramid_descriptor_sets[level],
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &source_info},
+        (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->depth_pyramid_descriptor_sets[level],
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &destination_info}};
+    vkUpdateDescriptorSets(
+        renderer->device.device,
+        sizeof(descriptor_writes) / sizeof(descriptor_writes[0]),
+        descriptor_writes, 0, nullptr);
+  }
+
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    VkDescriptorImageInfo pyramid_info = {
+        .sampler = culling->depth_pyramid_sampler,
+        .imageView = culling->depth_pyramid_view,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    vkUpdateDescriptorSets(
+        renderer->device.device, 1,
+        &(const VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->cull_descriptor_sets[frame_index],
+            .dstBinding = 4,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &pyramid_info},
+        0, nullptr);
+    vkUpdateDescriptorSets(
+        renderer->device.device, 1,
+        &(const VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+            .dstBinding = 3,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &pyramid_info},
+        0, nullptr);
+  }
+
+  culling->depth_pyramid_valid = false;
+  return true;
+destroy_views:
+  for (uint32_t level = 0; level < culling->depth_pyramid_level_count;
+       level++) {
+    vkDestroyImageView(renderer->device.device,
+                       culling->depth_pyramid_level_views[level], nullptr);
+  }
+  culling->depth_pyramid_level_count = 0;
+  vkDestroyImageView(renderer->device.device, culling->depth_pyramid_view,
+                     nullptr);
+destroy_image:
+  vmaDestroyImage(renderer->device.allocator, culling->depth_pyramid.image,
+                  culling->depth_pyramid.allocation);
+  return false;
+}
+
+static bool vgltf_renderer_create_gpu_culling_descriptor_set_layouts(
+    struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  VkDescriptorSetLayoutBinding cull_bindings[] = {
+      {.binding = 0,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 2,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 3,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 4,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 5,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 6,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT}};
+  VkDescriptorSetLayoutCreateInfo cull_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = sizeof(cull_bindings) / sizeof(cull_bindings[0]),
+      .pBindings = cull_bindings};
+  if (vkCreateDescriptorSetLayout(renderer->device.device, &cull_layout_info,
+                                  nullptr,
+                                  &culling->cull_descriptor_set_layout) !=
+      VK_SUCCESS) {
+    VGLTF_LOG_ERR("Failed to create cull descriptor set layout");
+    goto err;
+  }
+
+  VkDescriptorSetLayoutBinding cluster_cull_bindings[] = {
+      {.binding = 0,
+       .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 2,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 3,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 4,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 5,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 6,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 7,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT}};
+  VkDescriptorSetLayoutCreateInfo cluster_cull_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount =
+          sizeof(cluster_cull_bindings) / sizeof(cluster_cull_bindings[0]),
+      .pBindings = cluster_cull_bindings};
+  if (vkCreateDescriptorSetLayout(
+          renderer->device.device, &cluster_cull_layout_info, nullptr,
+          &culling->cluster_cull_descriptor_set_layout) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Failed to create cluster cull descriptor set layout");
+    goto destroy_cull_descriptor_set_layout;
+  }
+
+  VkDescriptorSetLayoutBinding depth_pyramid_bindings[] = {
+      {.binding = 0,
+       .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+      {.binding = 1,
+       .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = 1,
+       .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT}};
+  VkDescriptorSetLayoutCreateInfo depth_pyramid_layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount =
+          sizeof(depth_pyramid_bindings) / sizeof(depth_pyramid_bindings[0]),
+      .pBindings = depth_pyramid_bindings};
+  if (vkCreateDescriptorSetLayout(
+          renderer->device.device, &depth_pyramid_layout_info, nullptr,
+          &culling->depth_pyramid_descriptor_set_layout) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Failed to create depth pyramid descriptor set layout");
+    goto destroy_cluster_cull_descriptor_set_layout;
+  }
+
+  return true;
+destroy_cluster_cull_descriptor_set_layout:
+  vkDestroyDescriptorSetLayout(renderer->device.device,
+                               culling->cluster_cull_descriptor_set_layout,
+                               nullptr);
+destroy_cull_descriptor_set_layout:
+  vkDestroyDescriptorSetLayout(renderer->device.device,
+                               culling->cull_descriptor_set_layout, nullptr);
+err:
+  return false;
+}
+
+static bool
+vgltf_renderer_create_gpu_culling_pipelines(struct vgltf_renderer *renderer) {
+  static unsigned char cull_shader_code[] = {
+#embed "../../compiled_shaders/cull.comp.spv"
+  };
+  static unsigned char cluster_cull_shader_code[] = {
+#embed "../../compiled_shaders/cluster_cull.comp.spv"
+  };
+  static unsigned char depth_pyramid_shader_code[] = {
+#embed "../../compiled_shaders/depth_pyramid.comp.spv"
+  };
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+
+  VkBool32 compact_draws = renderer->device.draw_indirect_count_supported;
+  VkSpecializationInfo cull_specialization_info = {
+      .mapEntryCount = 1,
+      .pMapEntries = &(const VkSpecializationMapEntry){
+          .constantID = 0, .offset = 0, .size = sizeof(VkBool32)},
+      .dataSize = sizeof(VkBool32),
+      .pData = &compact_draws};
+  if (!create_compute_pipeline(
+          renderer, cull_shader_code, sizeof(cull_shader_code),
+          culling->cull_descriptor_set_layout,
+          sizeof(struct vgltf_renderer_cull_push_constants),
+          &cull_specialization_info, &culling->cull_pipeline_layout,
+          &culling->cull_pipeline)) {
+    VGLTF_LOG_ERR("Couldn't create cull pipeline");
+    goto err;
+  }
+
+  if (!create_compute_pipeline(
+          renderer, cluster_cull_shader_code, sizeof(cluster_cull_shader_code),
+          culling->cluster_cull_descriptor_set_layout,
+          sizeof(struct vgltf_renderer_cluster_cull_push_constants), nullptr,
+          &culling->cluster_cull_pipeline_layout,
+          &culling->cluster_cull_pipeline)) {
+    VGLTF_LOG_ERR("Couldn't create cluster cull pipeline");
+    goto destroy_cull_pipeline;
+  }
+
+  if (!create_compute_pipeline(
+          renderer, depth_pyramid_shader_code,
+          sizeof(depth_pyramid_shader_code),
+          culling->depth_pyramid_descriptor_set_layout,
+          sizeof(struct vgltf_renderer_depth_pyramid_push_constants), nullptr,
+          &culling->depth_pyramid_pipeline_layout,
+          &culling->depth_pyramid_pipeline)) {
+    VGLTF_LOG_ERR("Couldn't create depth pyramid pipeline");
+    goto destroy_cluster_cull_pipeline;
+  }
+
+  return true;
+destroy_cluster_cull_pipeline:
+  vkDestroyPipeline(renderer->device.device, culling->cluster_cull_pipeline,
+                    nullptr);
+  vkDestroyPipelineLayout(renderer->device.device,
+                          culling->cluster_cull_pipeline_layout, nullptr);
+destroy_cull_pipeline:
+  vkDestroyPipeline(renderer->device.device, culling->cull_pipeline, nullptr);
+  vkDestroyPipelineLayout(renderer->device.device,
+                          culling->cull_pipeline_layout, nullptr);
+err:
+  return false;
+}
+
+static bool vgltf_renderer_create_gpu_culling_descriptor_sets(
+    struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  VkDescriptorPoolSize pool_sizes[] = {
+      {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+       .descriptorCount = 2 * VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT},
+      // 5 for the cull sets and 6 for the cluster cull sets
+      {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+       .descriptorCount = 11 * VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT},
+      {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+       .descriptorCount = 2 * VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT +
+                          VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT},
+      {.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+       .descriptorCount = VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT}};
+  VkDescriptorPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .poolSizeCount = sizeof(pool_sizes) / sizeof(pool_sizes[0]),
+      .pPoolSizes = pool_sizes,
+      .maxSets = 2 * VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT +
+                 VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT};
+  if (vkCreateDescriptorPool(renderer->device.device, &pool_info, nullptr,
+                             &culling->descriptor_pool) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create culling descriptor pool");
+    goto err;
+  }
+
+  VkDescriptorSetLayout cull_layouts[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    cull_layouts[frame_index] = culling->cull_descriptor_set_layout;
+  }
+  if (vkAllocateDescriptorSets(
+          renderer->device.device,
+          &(const VkDescriptorSetAllocateInfo){
+              .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+              .descriptorPool = culling->descriptor_pool,
+              .descriptorSetCount = VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT,
+              .pSetLayouts = cull_layouts},
+          culling->cull_descriptor_sets) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't allocate cull descriptor sets");
+    goto destroy_descriptor_pool;
+  }
+
+  VkDescriptorSetLayout
+      cluster_cull_layouts[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    cluster_cull_layouts[frame_index] =
+        culling->cluster_cull_descriptor_set_layout;
+  }
+  if (vkAllocateDescriptorSets(
+          renderer->device.device,
+          &(const VkDescriptorSetAllocateInfo){
+              .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+              .descriptorPool = culling->descriptor_pool,
+              .descriptorSetCount = VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT,
+              .pSetLayouts = cluster_cull_layouts},
+          culling->cluster_cull_descriptor_sets) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't allocate cluster cull descriptor sets");
+    goto destroy_descriptor_pool;
+  }
+
+  VkDescriptorSetLayout
+      depth_pyramid_layouts[VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT];
+  for (int level = 0; level < VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT;
+       level++) {
+    depth_pyramid_layouts[level] = culling->depth_pyramid_descriptor_set_layout;
+  }
+  if (vkAllocateDescriptorSets(
+          renderer->device.device,
+          &(const VkDescriptorSetAllocateInfo){
+              .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+              .descriptorPool = culling->descriptor_pool,
+              .descriptorSetCount =
+                  VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT,
+              .pSetLayouts = depth_pyramid_layouts},
+          culling->depth_pyramid_descriptor_sets) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't allocate depth pyramid descriptor sets");
+    goto destroy_descriptor_pool;
+  }
+
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    VkDescriptorBufferInfo uniform_buffer_info = {
+        .buffer = renderer->uniform_buffers[frame_index].buffer,
+        .range = sizeof(struct vgltf_renderer_uniform_buffer_object)};
+    VkDescriptorBufferInfo instance_buffer_info = {
+        .buffer = renderer->instance_buffer.buffer, .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo draw_command_buffer_info = {
+        .buffer = culling->draw_command_buffers[frame_index].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo draw_count_buffer_info = {
+        .buffer = culling->draw_count_buffers[frame_index].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo visible_instance_buffer_info = {
+        .buffer = culling->visible_instance_buffers[frame_index].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo candidate_draw_buffer_info = {
+        .buffer = culling->candidate_draw_buffers[frame_index].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo meshlet_buffer_info = {
+        .buffer = renderer->meshlet_buffer.buffer, .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo index_buffer_info = {
+        .buffer =
+            renderer->geometry_streaming.pools[GEOMETRY_POOL_INDEX].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo compacted_index_buffer_info = {
+        .buffer = culling->compacted_index_buffers[frame_index].buffer,
+        .range = VK_WHOLE_SIZE};
+    VkWriteDescriptorSet descriptor_writes[] = {
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 0,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &uniform_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &instance_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 2,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &draw_command_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 3,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &draw_count_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 5,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &visible_instance_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cull_descriptor_sets[frame_index],
+         .dstBinding = 6,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &candidate_draw_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 0,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &uniform_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &instance_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 2,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &draw_command_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 4,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &candidate_draw_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 5,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &meshlet_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 6,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &index_buffer_info},
+        {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = culling->cluster_cull_descriptor_sets[frame_index],
+         .dstBinding = 7,
+         .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+         .descriptorCount = 1,
+         .pBufferInfo = &compacted_index_buffer_info}};
+    vkUpdateDescriptorSets(
+        renderer->device.device,
+        sizeof(descriptor_writes) / sizeof(descriptor_writes[0]),
+        descriptor_writes, 0, nullptr);
+  }
+
+  return true;
+destroy_descriptor_pool:
+  vkDestroyDescriptorPool(renderer->device.device, culling->descriptor_pool,
+                          nullptr);
+err:
+  return false;
+}
+
+static bool
+vgltf_renderer_create_gpu_culling_buffers(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  uint32_t instance_capacity = VGLTF_MAX(renderer->instance_count, 1u);
+  // Enough for every instance to be fully visible, up to the limit
+  uint64_t instance_index_count = 0;
+  for (uint32_t instance_index = 0; instance_index < renderer->instance_count;
+       instance_index++) {
+    instance_index_count +=
+        renderer->meshes[renderer->instances[instance_index].mesh_index]
+            .index_count;
+  }
+  if (instance_index_count > VGLTF_RENDERER_MAX_COMPACTED_INDEX_COUNT) {
+    instance_index_count = VGLTF_RENDERER_MAX_COMPACTED_INDEX_COUNT;
+  }
+  culling->compacted_index_capacity =
+      VGLTF_MAX((uint32_t)instance_index_count, 1u);
+  int frame_index = 0;
+  for (; frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT;
+       frame_index++) {
+    if (!vgltf_renderer_create_buffer(
+            renderer,
+            instance_capacity * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &culling->draw_command_buffers[frame_index])) {
+      VGLTF_LOG_ERR("Couldn't create draw command buffer");
+      goto destroy_frame_buffers;
+    }
+
+    if (!vgltf_renderer_create_buffer(
+            renderer, VGLTF_RENDERER_WINDING_COUNT * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &culling->draw_count_buffers[frame_index])) {
+      VGLTF_LOG_ERR("Couldn't create draw count buffer");
+      vmaDestroyBuffer(renderer->device.allocator,
+                       culling->draw_command_buffers[frame_index].buffer,
+                       culling->draw_command_buffers[frame_index].allocation);
+      goto destroy_frame_buffers;
+    }
+
+    // Written every frame with the CPU culling results
+    if (!vgltf_renderer_create_buffer(
+            renderer, instance_capacity * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &culling->visible_instance_buffers[frame_index])) {
+      VGLTF_LOG_ERR("Couldn't create visible instance buffer");
+      vmaDestroyBuffer(renderer->device.allocator,
+                       culling->draw_count_buffers[frame_index].buffer,
+                       culling->draw_count_buffers[frame_index].allocation);
+      vmaDestroyBuffer(renderer->device.allocator,
+                       culling->draw_command_buffers[frame_index].buffer,
+                       culling->draw_command_buffers[frame_index].allocation);
+      goto destroy_frame_buffers;
+    }
+    vmaMapMemory(renderer->device.allocator,
+                 culling->visible_instance_buffers[frame_index].allocation,
+                 &culling->mapped_visible_instance_buffers[frame_index]);
+
+    // Written every frame with the selected LODs
+    if (!vgltf_renderer_create_buffer(
+            renderer,
+            instance_capacity *
+                sizeof(struct vgltf_renderer_gpu_candidate_draw),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &culling->candidate_draw_buffers[frame_index])) {
+      VGLTF_LOG_ERR("Couldn't create candidate draw buffer");
+      goto destroy_visible_instance_buffer;
+    }
+    vmaMapMemory(renderer->device.allocator,
+                 culling->candidate_draw_buffers[frame_index].allocation,
+                 &culling->mapped_candidate_draw_buffers[frame_index]);
+
+    if (!vgltf_renderer_create_buffer(
+            renderer, culling->compacted_index_capacity * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &culling->compacted_index_buffers[frame_index])) {
+      VGLTF_LOG_ERR("Couldn't create compacted index buffer");
+      vmaUnmapMemory(renderer->device.allocator,
+                     culling->candidate_draw_buffers[frame_index].allocation);
+      vmaDestroyBuffer(renderer->device.allocator,
+                       culling->candidate_draw_buffers[frame_index].buffer,
+                       culling->candidate_draw_buffers[frame_index].allocation);
+      goto destroy_visible_instance_buffer;
+    }
+  }
+
+  return true;
+destroy_visible_instance_buffer:
+  vmaUnmapMemory(renderer->device.allocator,
+                 culling->visible_instance_buffers[frame_index].allocation);
+  vmaDestroyBuffer(renderer->device.allocator,
+                   culling->visible_instance_buffers[frame_index].buffer,
+                   culling->visible_instance_buffers[frame_index].allocation);
+  vmaDestroyBuffer(renderer->device.allocator,
+                   culling->draw_count_buffers[frame_index].buffer,
+                   culling->draw_count_buffers[frame_index].allocation);
+  vmaDestroyBuffer(renderer->device.allocator,
+                   culling->draw_command_buffers[frame_index].buffer,
+                   culling->draw_command_buffers[frame_index].allocation);
+destroy_frame_buffers:
+  for (int frame_to_destroy_index = 0; frame_to_destroy_index < frame_index;
+       frame_to_destroy_index++) {
+    vmaDestroyBuffer(
+        renderer->device.allocator,
+        culling->compacted_index_buffers[frame_to_destroy_index].buffer,
+        culling->compacted_index_buffers[frame_to_destroy_index].allocation);
+    vmaUnmapMemory(
+        renderer->device.allocator,
+        culling->candidate_draw_buffers[frame_to_destroy_index].allocation);
+    vmaDestroyBuffer(
+        renderer->device.allocator,
+        culling->candidate_draw_buffers[frame_to_destroy_index].buffer,
+        culling->candidate_draw_buffers[frame_to_destroy_index].allocation);
+    vmaUnmapMemory(
+        renderer->device.allocator,
+        culling->visible_instance_buffers[frame_to_destroy_index].allocation);
+    vmaDestroyBuffer(
+        renderer->device.allocator,
+        culling->visible_instance_buffers[frame_to_destroy_index].buffer,
+        culling->visible_instance_buffers[frame_to_destroy_index].allocation);
+    vmaDestroyBuffer(
+        renderer->device.allocator,
+        culling->draw_count_buffers[frame_to_destroy_index].buffer,
+        culling->draw_count_buffers[frame_to_destroy_index].allocation);
+    vmaDestroyBuffer(
+        renderer->device.allocator,
+        culling->draw_command_buffers[frame_to_destroy_index].buffer,
+        culling->draw_command_buffers[frame_to_destroy_index].allocation);
+  }
+  return false;
+}
+
+static void
+vgltf_renderer_destroy_gpu_culling_buffers(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  for (int frame_index = 0;
+       frame_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; frame_index++) {
+    vmaDestroyBuffer(renderer->device.allocator,
+                     culling->compacted_index_buffers[frame_index].buffer,
+                     culling->compacted_index_buffers[frame_index].allocation);
+    vmaUnmapMemory(renderer->device.allocator,
+                   culling->candidate_draw_buffers[frame_index].allocation);
+    vmaDestroyBuffer(renderer->device.allocator,
+                     culling->candidate_draw_buffers[frame_index].buffer,
+                     culling->candidate_draw_buffers[frame_index].allocation);
+    vmaUnmapMemory(renderer->device.allocator,
+                   culling->visible_instance_buffers[frame_index].allocation);
+    vmaDestroyBuffer(renderer->device.allocator,
+                     culling->visible_instance_buffers[frame_index].buffer,
+                     culling->visible_instance_buffers[frame_index].allocation);
+    vmaDestroyBuffer(renderer->device.allocator,
+                     culling->draw_count_buffers[frame_index].buffer,
+                     culling->draw_count_buffers[frame_index].allocation);
+    vmaDestroyBuffer(renderer->device.allocator,
+                     culling->draw_command_buffers[frame_index].buffer,
+                     culling->draw_command_buffers[frame_index].allocation);
+  }
+}
+
+static void
+vgltf_renderer_destroy_gpu_culling_pipelines(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  vkDestroyPipeline(renderer->device.device, culling->depth_pyramid_pipeline,
+                    nullptr);
+  vkDestroyPipelineLayout(renderer->device.device,
+                          culling->depth_pyramid_pipeline_layout, nullptr);
+  vkDestroyPipeline(renderer->device.device, culling->cluster_cull_pipeline,
+                    nullptr);
+  vkDestroyPipelineLayout(renderer->device.device,
+                          culling->cluster_cull_pipeline_layout, nullptr);
+  vkDestroyPipeline(renderer->device.device, culling->cull_pipeline, nullptr);
+  vkDestroyPipelineLayout(renderer->device.device,
+                          culling->cull_pipeline_layout, nullptr);
+}
+
+static void vgltf_renderer_destroy_gpu_culling_descriptor_set_layouts(
+    struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  vkDestroyDescriptorSetLayout(renderer->device.device,
+                               culling->depth_pyramid_descriptor_set_layout,
+                               nullptr);
+  vkDestroyDescriptorSetLayout(renderer->device.device,
+                               culling->cluster_cull_descriptor_set_layout,
+                               nullptr);
+  vkDestroyDescriptorSetLayout(renderer->device.device,
+                               culling->cull_descriptor_set_layout, nullptr);
+}
+
+// Requires the uniform buffers, the depth buffer and the instances
+static bool vgltf_renderer_create_gpu_culling(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  VkSamplerCreateInfo sampler_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = VK_FILTER_NEAREST,
+      .minFilter = VK_FILTER_NEAREST,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .maxLod = VK_LOD_CLAMP_NONE};
+  if (vkCreateSampler(renderer->device.device, &sampler_info, nullptr,
+                      &culling->depth_pyramid_sampler) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create depth pyramid sampler");
+    goto err;
+  }
+
+  if (!vgltf_renderer_create_gpu_culling_descriptor_set_layouts(renderer)) {
+    goto destroy_sampler;
+  }
+
+  if (!vgltf_renderer_create_gpu_culling_pipelines(renderer)) {
+    goto destroy_descriptor_set_layouts;
+  }
+
+  if (!vgltf_renderer_create_gpu_culling_buffers(renderer)) {
+    goto destroy_pipelines;
+  }
+
+  if (!vgltf_renderer_create_gpu_culling_descriptor_sets(renderer)) {
+    goto destroy_buffers;
+  }
+
+  if (!vgltf_renderer_create_depth_pyramid(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create depth pyramid");
+    goto destroy_descriptor_pool;
+  }
+
+  return true;
+destroy_descriptor_pool:
+  vkDestroyDescriptorPool(renderer->device.device, culling->descriptor_pool,
+                          nullptr);
+destroy_buffers:
+  vgltf_renderer_destroy_gpu_culling_buffers(renderer);
+destroy_pipelines:
+  vgltf_renderer_destroy_gpu_culling_pipelines(renderer);
+destroy_descriptor_set_layouts:
+  vgltf_renderer_destroy_gpu_culling_descriptor_set_layouts(renderer);
+destroy_sampler:
+  vkDestroySampler(renderer->device.device, culling->depth_pyramid_sampler,
+                   nullptr);
+err:
+  return false;
+}
+
+// The depth pyramid is destroyed along with the swapchain resources
+static void vgltf_renderer_destroy_gpu_culling(struct vgltf_renderer *renderer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  vkDestroyDescriptorPool(renderer->device.device, culling->descriptor_pool,
+                          nullptr);
+  vgltf_renderer_destroy_gpu_culling_buffers(renderer);
+  vgltf_renderer_destroy_gpu_culling_pipelines(renderer);
+  vgltf_renderer_destroy_gpu_culling_descriptor_set_layouts(renderer);
+  vkDestroySampler(renderer->device.device, culling->depth_pyramid_sampler,
+                   nullptr);
+}
+
+// Least detailed LOD of the instance whose error stays under the pixel limit
+// at the nearest point of its bounding sphere. The error is projected along
+// the screen height, the largest of the instance scales applies to it.
+static uint32_t select_lod(const struct vgltf_renderer *renderer,
+                           uint32_t instance_index) {
+  const struct vgltf_renderer_instance *instance =
+      &renderer->instances[instance_index];
+  const struct vgltf_renderer_mesh *mesh =
+      &renderer->meshes[instance->mesh_index];
+  if (!renderer->lod_selection || mesh->lod_count <= 1) {
+    return 0;
+  }
+
+  const struct vgltf_cpu_culling *cpu_culling = &renderer->cpu_culling;
+  vgltf_vec3 center = {cpu_culling->center_x[instance_index],
+                       cpu_culling->center_y[instance_index],
+                       cpu_culling->center_z[instance_index]};
+  vgltf_vec_value_type distance =
+      vgltf_vec3_length(vgltf_vec3_sub(center, renderer->camera_position)) -
+      cpu_culling->radius[instance_index];
+  if (distance <= 0.f) {
+    return 0;
+  }
+
+  vgltf_vec_value_type pixels_per_error =
+      instance->max_scale * renderer->projection_pixel_scale / distance;
+  uint32_t lod_index = 0;
+  while (lod_index + 1 < mesh->lod_count &&
+         mesh->lods[lod_index + 1].error * pixels_per_error <=
+             VGLTF_RENDERER_LOD_MAX_PIXEL_ERROR) {
+    lod_index++;
+  }
+  return lod_index;
+}
+
+// Resident LOD nearest to the selected one, the finer one first, or nullptr
+// when none is
+static const struct vgltf_renderer_mesh_lod *
+resident_lod(const struct vgltf_renderer *renderer,
+             const struct vgltf_renderer_mesh *mesh, uint32_t lod_index) {
+  const struct vgltf_geometry_streaming *streaming =
+      &renderer->geometry_streaming;
+  if (!vgltf_geometry_streaming_is_resident(streaming, mesh->vertex_resource)) {
+    return nullptr;
+  }
+  for (uint32_t distance = 0; distance < mesh->lod_count; distance++) {
+    if (distance <= lod_index &&
+        vgltf_geometry_streaming_is_resident(
+            streaming, mesh->lods[lod_index - distance].index_resource)) {
+      return &mesh->lods[lod_index - distance];
+    }
+    if (lod_index + distance < mesh->lod_count &&
+        vgltf_geometry_streaming_is_resident(
+            streaming, mesh->lods[lod_index + distance].index_resource)) {
+      return &mesh->lods[lod_index + distance];
+    }
+  }
+  return nullptr;
+}
+
+// Requests the base color texture of each visible instance at the size its
+// bounding sphere covers on screen, at the distance of its nearest point, as
+// if the texture spread over the diameter of the sphere. Then stages the
+// levels the requests call for and points the descriptor set of the frame at
+// the resident ones.
+static void vgltf_renderer_stream_textures(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  const struct vgltf_cpu_culling *cpu_culling = &renderer->cpu_culling;
+  struct vgltf_texture_streaming *streaming = &renderer->texture_streaming;
+  for (uint32_t draw_index = 0; draw_index < cpu_culling->visible_count;
+       draw_index++) {
+    uint32_t instance_index = cpu_culling->visible_indices[draw_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->instances[instance_index].mesh_index];
+    const struct vgltf_renderer_material *material =
+        &renderer->materials[mesh->material_index];
+    vgltf_vec3 center = {cpu_culling->center_x[instance_index],
+                         cpu_culling->center_y[instance_index],
+                         cpu_culling->center_z[instance_index]};
+    vgltf_vec_value_type radius = cpu_culling->radius[instance_index];
+    vgltf_vec_value_type distance =
+        vgltf_vec3_length(vgltf_vec3_sub(center, renderer->camera_position)) -
+        radius;
+    float pixel_size = FLT_MAX;
+    if (distance > 0.f) {
+      pixel_size = 2.f * radius * renderer->projection_pixel_scale / distance;
+    }
+    vgltf_texture_streaming_request(
+        streaming, material->base_color_texture_index, pixel_size);
   }
-  return false;
+
+  vgltf_texture_streaming_update(streaming);
+  vgltf_texture_streaming_write_descriptors(
+      streaming, renderer->descriptor_sets[renderer->current_frame], 3,
+      renderer->texture_sampler);
 }
 
-static bool vgltf_vk_swapchain_init(struct vgltf_vk_swapchain *swapchain,
-                                    struct vgltf_vk_device *device,
-                                    struct vgltf_vk_surface *surface,
-                                    struct vgltf_window_size *window_size) {
-  if (!create_swapchain(swapchain, device, surface, window_size)) {
-    VGLTF_LOG_ERR("Couldn't create swapchain");
-    goto err;
+// Selects the LOD of each visible instance and streams in their geometry.
+// Instances draw the resident LOD nearest to their selection until it is
+// uploaded, and nothing before any of their LODs is. With cluster culling,
+// lays out the meshlets of the LODs one after the other for the cluster
+// culling, and their compacted indices likewise. Frames whose visible LODs
+// don't fit in the compacted index buffer draw whole LODs.
+static void
+vgltf_renderer_write_candidate_draws(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  const struct vgltf_cpu_culling *cpu_culling = &renderer->cpu_culling;
+  struct vgltf_geometry_streaming *streaming = &renderer->geometry_streaming;
+  culling->cluster_draws = false;
+  culling->cluster_count = 0;
+  // Mirrored instances are last, and the visible ones stay in instance order
+  culling->first_mirrored_draw = 0;
+  while (culling->first_mirrored_draw < cpu_culling->visible_count &&
+         cpu_culling->visible_indices[culling->first_mirrored_draw] <
+             renderer->first_mirrored_instance) {
+    culling->first_mirrored_draw++;
+  }
+
+  // The coarsest LODs are requested first, so that every visible instance
+  // gets something to draw before the staging buffer fills up with details
+  uint32_t selected_lods[VGLTF_RENDERER_MAX_INSTANCE_COUNT];
+  for (uint32_t draw_index = 0; draw_index < cpu_culling->visible_count;
+       draw_index++) {
+    uint32_t instance_index = cpu_culling->visible_indices[draw_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->instances[instance_index].mesh_index];
+    selected_lods[draw_index] = select_lod(renderer, instance_index);
+    vgltf_geometry_streaming_request(streaming, mesh->vertex_resource);
+    vgltf_geometry_streaming_request(
+        streaming, mesh->lods[mesh->lod_count - 1].index_resource);
+  }
+  for (uint32_t draw_index = 0; draw_index < cpu_culling->visible_count;
+       draw_index++) {
+    uint32_t instance_index = cpu_culling->visible_indices[draw_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->instances[instance_index].mesh_index];
+    vgltf_geometry_streaming_request(
+        streaming, mesh->lods[selected_lods[draw_index]].index_resource);
+  }
+  vgltf_geometry_streaming_stage(streaming);
+
+  // The candidate draws are mapped device memory, they are only written
+  const struct vgltf_renderer_mesh_lod
+      *lods[VGLTF_RENDERER_MAX_INSTANCE_COUNT];
+  uint64_t index_count = 0;
+  for (uint32_t draw_index = 0; draw_index < cpu_culling->visible_count;
+       draw_index++) {
+    uint32_t instance_index = cpu_culling->visible_indices[draw_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->instances[instance_index].mesh_index];
+    lods[draw_index] =
+        resident_lod(renderer, mesh, selected_lods[draw_index]);
+    if (lods[draw_index]) {
+      // Keeps a fallback LOD from being evicted while the frame draws it
+      vgltf_geometry_streaming_request(streaming,
+                                       lods[draw_index]->index_resource);
+      index_count += lods[draw_index]->index_count;
+    }
   }
 
-  if (!create_swapchain_image_views(swapchain, device)) {
-    VGLTF_LOG_ERR("Couldn't create image views");
-    goto destroy_swapchain;
+  if (renderer->cluster_culling) {
+    bool was_overflowing = culling->compacted_index_overflow;
+    culling->compacted_index_overflow =
+        index_count > culling->compacted_index_capacity;
+    if (culling->compacted_index_overflow && !was_overflowing) {
+      VGLTF_LOG_INFO("The visible instances have more than %u indices, "
+                     "drawing whole LODs",
+                     culling->compacted_index_capacity);
+    }
+    culling->cluster_draws = !culling->compacted_index_overflow;
+  }
+
+  struct vgltf_renderer_gpu_candidate_draw *candidate_draws =
+      culling->mapped_candidate_draw_buffers[renderer->current_frame];
+  uint32_t compacted_index_count = 0;
+  for (uint32_t draw_index = 0; draw_index < cpu_culling->visible_count;
+       draw_index++) {
+    const struct vgltf_renderer_mesh_lod *lod = lods[draw_index];
+    if (!lod || lod->index_count == 0) {
+      candidate_draws[draw_index] = (struct vgltf_renderer_gpu_candidate_draw){
+          .first_cluster = culling->cluster_count,
+          .first_index = compacted_index_count};
+      continue;
+    }
+
+    uint32_t instance_index = cpu_culling->visible_indices[draw_index];
+    const struct vgltf_renderer_mesh *mesh =
+        &renderer->meshes[renderer->instances[instance_index].mesh_index];
+    const struct vgltf_geometry_resource *index_resource =
+        &streaming->resources[lod->index_resource];
+    const struct vgltf_geometry_resource *vertex_resource =
+        &streaming->resources[mesh->vertex_resource];
+    candidate_draws[draw_index] = (struct vgltf_renderer_gpu_candidate_draw){
+        .first_cluster = culling->cluster_count,
+        .first_meshlet = lod->first_meshlet,
+        .first_index = culling->cluster_draws
+                           ? compacted_index_count
+                           : index_resource->pool_first_element,
+        .index_count = lod->index_count,
+        .source_first_index = index_resource->pool_first_element,
+        .vertex_offset = (int32_t)vertex_resource->pool_first_element};
+    if (culling->cluster_draws) {
+      culling->cluster_count += lod->meshlet_count;
+      compacted_index_count += lod->index_count;
+    }
   }
+}
 
-  return true;
-destroy_swapchain:
-  vkDestroySwapchainKHR(device->device, swapchain->swapchain, nullptr);
-err:
-  return false;
+static void vgltf_renderer_cull_pass(struct vgltf_renderer *renderer,
+                                     VkCommandBuffer command_buffer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  // The draw counts of each winding, cluster draws keep one draw per
+  // candidate
+  uint32_t draw_counts[VGLTF_RENDERER_WINDING_COUNT] = {};
+  if (culling->cluster_draws) {
+    draw_counts[VGLTF_RENDERER_WINDING_COUNTER_CLOCKWISE] =
+        culling->first_mirrored_draw;
+    draw_counts[VGLTF_RENDERER_WINDING_CLOCKWISE] =
+        renderer->cpu_culling.visible_count - culling->first_mirrored_draw;
+  }
+  vkCmdUpdateBuffer(command_buffer,
+                    culling->draw_count_buffers[renderer->current_frame].buffer,
+                    0, sizeof(draw_counts), draw_counts);
+
+  // Also makes the depth pyramid written by the previous frame visible
+  VkMemoryBarrier clear_barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &clear_barrier, 0, nullptr, 0, nullptr);
+
+  struct vgltf_renderer_cull_push_constants push_constants = {
+      .depth_pyramid_width = culling->depth_pyramid_width,
+      .depth_pyramid_height = culling->depth_pyramid_height,
+      .candidate_count = renderer->cpu_culling.visible_count,
+      .occlusion_culling_enabled = culling->depth_pyramid_valid,
+      .cluster_draws = culling->cluster_draws,
+      .first_mirrored_candidate = culling->first_mirrored_draw};
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    culling->cull_pipeline);
+  vkCmdBindDescriptorSets(
+      command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+      culling->cull_pipeline_layout, 0, 1,
+      &culling->cull_descriptor_sets[renderer->current_frame], 0, nullptr);
+  vkCmdPushConstants(command_buffer, culling->cull_pipeline_layout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants),
+                     &push_constants);
+  vkCmdDispatch(command_buffer, (push_constants.candidate_count + 63) / 64, 1,
+                1);
+
+  if (culling->cluster_draws && culling->cluster_count > 0) {
+    VkMemoryBarrier cluster_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &cluster_barrier, 0, nullptr, 0, nullptr);
+
+    struct vgltf_renderer_cluster_cull_push_constants cluster_push_constants = {
+        .depth_pyramid_width = culling->depth_pyramid_width,
+        .depth_pyramid_height = culling->depth_pyramid_height,
+        .draw_count = renderer->cpu_culling.visible_count,
+        .cluster_count = culling->cluster_count,
+        .occlusion_culling_enabled = culling->depth_pyramid_valid};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      culling->cluster_cull_pipeline);
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        culling->cluster_cull_pipeline_layout, 0, 1,
+        &culling->cluster_cull_descriptor_sets[renderer->current_frame], 0,
+        nullptr);
+    vkCmdPushConstants(command_buffer, culling->cluster_cull_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(cluster_push_constants),
+                       &cluster_push_constants);
+    // Past the workgroup count limit of a dimension, the shader flattens a
+    // two dimensional dispatch
+    static constexpr uint32_t max_group_count_x = 65535;
+    uint32_t group_count = (culling->cluster_count + 63) / 64;
+    uint32_t group_count_x =
+        group_count < max_group_count_x ? group_count : max_group_count_x;
+    vkCmdDispatch(command_buffer, group_count_x,
+                  (group_count + group_count_x - 1) / group_count_x, 1);
+  }
+
+  VkMemoryBarrier draw_barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .dstAccessMask =
+          VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT};
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       0, 1, &draw_barrier, 0, nullptr, 0, nullptr);
 }
 
-static void vgltf_vk_swapchain_deinit(struct vgltf_vk_swapchain *swapchain,
-                                      struct vgltf_vk_device *device) {
-  for (uint32_t swapchain_image_view_index = 0;
-       swapchain_image_view_index < swapchain->swapchain_image_count;
-       swapchain_image_view_index++) {
-    vkDestroyImageView(
-        device->device,
-        swapchain->swapchain_image_views[swapchain_image_view_index], nullptr);
+static void vgltf_renderer_depth_pyramid_pass(struct vgltf_renderer *renderer,
+                                              VkCommandBuffer command_buffer) {
+  struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    culling->depth_pyramid_pipeline);
+
+  struct vgltf_renderer_depth_pyramid_push_constants push_constants = {
+      .source_width = renderer->swapchain.swapchain_extent.width,
+      .source_height = renderer->swapchain.swapchain_extent.height,
+      .destination_width = culling->depth_pyramid_width,
+      .destination_height = culling->depth_pyramid_height};
+  for (uint32_t level = 0; level < culling->depth_pyramid_level_count;
+       level++) {
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            culling->depth_pyramid_pipeline_layout, 0, 1,
+                            &culling->depth_pyramid_descriptor_sets[level], 0,
+                            nullptr);
+    vkCmdPushConstants(command_buffer, culling->depth_pyramid_pipeline_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants),
+                       &push_constants);
+    vkCmdDispatch(command_buffer, (push_constants.destination_width + 7) / 8,
+                  (push_constants.destination_height + 7) / 8, 1);
+
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = culling->depth_pyramid.image,
+        .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .baseMipLevel = level,
+                             .levelCount = 1,
+                             .layerCount = 1}};
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    push_constants.source_width = push_constants.destination_width;
+    push_constants.source_height = push_constants.destination_height;
+    push_constants.destination_width =
+        VGLTF_MAX((push_constants.destination_width + 1) / 2, 1);
+    push_constants.destination_height =
+        VGLTF_MAX((push_constants.destination_height + 1) / 2, 1);
   }
-  vkDestroySwapchainKHR(device->device, swapchain->swapchain, nullptr);
+
+  culling->depth_pyramid_valid = true;
 }
 
 static void vgltf_renderer_cleanup_swapchain(struct vgltf_renderer *renderer) {
+  vgltf_renderer_destroy_depth_pyramid(renderer);
   vkDestroyImageView(renderer->device.device, renderer->depth_image_view,
                      nullptr);
   vmaDestroyImage(renderer->device.allocator, renderer->depth_image.image,
@@ -1977,6 +5507,7 @@ static void vgltf_renderer_cleanup_swapchain(struct vgltf_renderer *renderer) {
 }
 
 static bool vgltf_renderer_recreate_swapchain(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   vkDeviceWaitIdle(renderer->device.device);
   vgltf_renderer_cleanup_swapchain(renderer);
 
@@ -1985,12 +5516,225 @@ static bool vgltf_renderer_recreate_swapchain(struct vgltf_renderer *renderer) {
                    &renderer->window_size);
   create_swapchain_image_views(&renderer->swapchain, &renderer->device);
   vgltf_renderer_create_depth_resources(renderer);
+  if (!vgltf_renderer_create_depth_pyramid(renderer)) {
+    VGLTF_LOG_ERR("Couldn't recreate the depth pyramid");
+    goto err;
+  }
   vgltf_renderer_create_framebuffers(renderer);
   return true;
+err:
+  return false;
+}
+
+// Records the draws [first_draw, first_draw + draw_count) of a winding written
+// by the culling passes, without drawIndirectCount support the instances
+// culled on the GPU are still drawn with an instance count of 0. With
+// drawIndirectCount the GPU decides how many draws of the winding there are,
+// so the range has to start at the first draw of the winding.
+static void vgltf_renderer_draw_indirect(struct vgltf_renderer *renderer,
+                                         VkCommandBuffer command_buffer,
+                                         enum vgltf_renderer_winding winding,
+                                         uint32_t first_draw,
+                                         uint32_t draw_count) {
+  static constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  uint32_t end_draw = first_draw + draw_count;
+  VkBuffer draw_command_buffer =
+      renderer->gpu_culling.draw_command_buffers[renderer->current_frame]
+          .buffer;
+  if (renderer->device.draw_indirect_count_supported) {
+    assert(first_draw == (winding == VGLTF_RENDERER_WINDING_CLOCKWISE
+                              ? renderer->gpu_culling.first_mirrored_draw
+                              : 0));
+    vkCmdDrawIndexedIndirectCount(
+        command_buffer, draw_command_buffer, first_draw * stride,
+        renderer->gpu_culling.draw_count_buffers[renderer->current_frame]
+            .buffer,
+        winding * sizeof(uint32_t), draw_count, stride);
+  } else if (renderer->device.multi_draw_indirect_supported) {
+    for (uint32_t first_batch_draw = first_draw; first_batch_draw < end_draw;
+         first_batch_draw += renderer->device.max_draw_indirect_count) {
+      uint32_t remaining_draw_count = end_draw - first_batch_draw;
+      uint32_t batch_draw_count =
+          remaining_draw_count < renderer->device.max_draw_indirect_count
+              ? remaining_draw_count
+              : renderer->device.max_draw_indirect_count;
+      vkCmdDrawIndexedIndirect(command_buffer, draw_command_buffer,
+                               first_batch_draw * stride, batch_draw_count,
+                               stride);
+    }
+  } else {
+    for (uint32_t draw_index = first_draw; draw_index < end_draw;
+         draw_index++) {
+      vkCmdDrawIndexedIndirect(command_buffer, draw_command_buffer,
+                               draw_index * stride, 1, stride);
+    }
+  }
+}
+
+struct vgltf_renderer_draw_recording {
+  struct vgltf_renderer *renderer;
+  uint32_t swapchain_image_index;
+  enum vgltf_renderer_subpass subpass;
+  uint32_t draw_count;
+  uint32_t chunk_count;
+  VkCommandBuffer
+      secondary_command_buffers[VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT];
+  // Chunks whose secondary command buffer couldn't be recorded, which must
+  // not be executed
+  bool failed_chunks[VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT];
+};
+
+// Each chunk is a contiguous range of draws recorded into its own secondary
+// command buffer, the primary executes them in chunk order so the draw order
+// doesn't depend on which thread recorded which chunk
+static void record_draw_chunks(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_renderer_draw_recording *recording = data;
+  struct vgltf_renderer *renderer = recording->renderer;
+  struct vgltf_renderer_thread_command_pool *thread_command_pool =
+      &renderer->thread_command_pools[renderer->current_frame]
+                                     [vgltf_job_system_get_thread_index()];
+
+  for (uint32_t chunk_index = begin; chunk_index < end; chunk_index++) {
+    VkCommandBuffer command_buffer =
+        thread_command_pool->secondary_command_buffers
+            [thread_command_pool->used_secondary_command_buffer_count++];
+    recording->secondary_command_buffers[chunk_index] = command_buffer;
+    recording->failed_chunks[chunk_index] = true;
+
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = renderer->render_pass,
+        .subpass = recording->subpass,
+        .framebuffer =
+            renderer->swapchain_framebuffers[recording->swapchain_image_index],
+        .pipelineStatistics = vgltf_gpu_profiler_get_inherited_statistics(
+            &renderer->gpu_profiler)};
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info};
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Failed to begin recording secondary command buffer");
+      continue;
+    }
+
+    // Timed from the first to the last chunk, which execute in that order
+    bool prepass = recording->subpass == VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS;
+    if (prepass && chunk_index == 0) {
+      vgltf_gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer,
+                                    VGLTF_RENDERER_GPU_PASS_DEPTH_PREPASS);
+    }
+
+    VkViewport viewport = {
+        .x = 0.f,
+        .y = 0.f,
+        .width = (float)renderer->swapchain.swapchain_extent.width,
+        .height = (float)renderer->swapchain.swapchain_extent.height,
+        .minDepth = 0.f,
+        .maxDepth = 1.f};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    VkRect2D scissor = {.offset = {},
+                        .extent = renderer->swapchain.swapchain_extent};
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    // The draws offset their vertices and indices to the ranges of their
+    // geometry in the pools
+    const struct vgltf_geometry_pool *vertex_pool =
+        &renderer->geometry_streaming.pools[GEOMETRY_POOL_VERTEX];
+    const struct vgltf_geometry_pool *index_pool =
+        &renderer->geometry_streaming.pools[GEOMETRY_POOL_INDEX];
+    VkBuffer vertex_buffers[] = {vertex_pool->buffer,
+                                 renderer->constant_vertex_buffer.buffer};
+    if (prepass) {
+      VkDeviceSize offset =
+          vertex_pool->streams[GEOMETRY_VERTEX_STREAM_POSITIONS].offset;
+      vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, &offset);
+    } else {
+      VkDeviceSize offsets[] = {
+          vertex_pool->streams[GEOMETRY_VERTEX_STREAM_ATTRIBUTES].offset, 0};
+      vkCmdBindVertexBuffers(command_buffer, 0,
+                             renderer->vertex_layout.constant_size > 0 ? 2 : 1,
+                             vertex_buffers, offsets);
+    }
+    const struct vgltf_renderer_gpu_culling *culling = &renderer->gpu_culling;
+    vkCmdBindIndexBuffer(
+        command_buffer,
+        culling->cluster_draws
+            ? culling->compacted_index_buffers[renderer->current_frame].buffer
+            : index_pool->buffer,
+        0, VK_INDEX_TYPE_UINT32);
+
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        renderer->pipeline_layout, 0, 1,
+        &renderer->descriptor_sets[renderer->current_frame], 0, nullptr);
+
+    // The draws of mirrored instances follow the others, with the clockwise
+    // pipelines
+    uint32_t first_chunk_draw =
+        (uint64_t)recording->draw_count * chunk_index / recording->chunk_count;
+    uint32_t end_chunk_draw = (uint64_t)recording->draw_count *
+                              (chunk_index + 1) / recording->chunk_count;
+    uint32_t winding_ends[VGLTF_RENDERER_WINDING_COUNT] = {
+        culling->first_mirrored_draw, recording->draw_count};
+    uint32_t winding_begin = 0;
+    for (uint32_t winding = 0; winding < VGLTF_RENDERER_WINDING_COUNT;
+         winding++) {
+      uint32_t first_draw = VGLTF_MAX(first_chunk_draw, winding_begin);
+      uint32_t end_draw = VGLTF_MIN(end_chunk_draw, winding_ends[winding]);
+      winding_begin = winding_ends[winding];
+      if (first_draw >= end_draw) {
+        continue;
+      }
+
+      VkPipeline pipeline = renderer->graphics_pipelines[winding];
+      if (prepass) {
+        pipeline = renderer->depth_pipelines[winding];
+      } else if (renderer->depth_prepass) {
+        pipeline = renderer->depth_equal_graphics_pipelines[winding];
+      }
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      vgltf_renderer_draw_indirect(renderer, command_buffer, winding,
+                                   first_draw, end_draw - first_draw);
+    }
+
+    if (prepass && chunk_index == recording->chunk_count - 1) {
+      vgltf_gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer,
+                                  VGLTF_RENDERER_GPU_PASS_DEPTH_PREPASS);
+    }
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Failed to record secondary command buffer");
+      continue;
+    }
+    recording->failed_chunks[chunk_index] = false;
+  }
+}
+
+// Records the chunks of the subpass with the job system and executes them
+static bool execute_draw_chunks(struct vgltf_renderer_draw_recording *recording,
+                                VkCommandBuffer command_buffer) {
+  vgltf_job_system_parallel_for(recording->renderer->job_system,
+                                recording->chunk_count, 1, record_draw_chunks,
+                                recording);
+  for (uint32_t chunk_index = 0; chunk_index < recording->chunk_count;
+       chunk_index++) {
+    if (recording->failed_chunks[chunk_index]) {
+      goto err;
+    }
+  }
+  vkCmdExecuteCommands(command_buffer, recording->chunk_count,
+                       recording->secondary_command_buffers);
+  return true;
+err:
+  return false;
 }
 
-static void vgltf_renderer_triangle_pass(struct vgltf_renderer *renderer,
+static bool vgltf_renderer_triangle_pass(struct vgltf_renderer *renderer,
                                          uint32_t swapchain_image_index) {
+  VGLTF_TRACE_ZONE(__func__);
   VkRenderPassBeginInfo render_pass_info = {
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       .renderPass = renderer->render_pass,
@@ -2004,44 +5748,55 @@ static void vgltf_renderer_triangle_pass(struct vgltf_renderer *renderer,
 
   };
 
-  vkCmdBeginRenderPass(renderer->command_buffer[renderer->current_frame],
-                       &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-  vkCmdBindPipeline(renderer->command_buffer[renderer->current_frame],
-                    VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    renderer->graphics_pipeline);
-  VkViewport viewport = {
-      .x = 0.f,
-      .y = 0.f,
-      .width = (float)renderer->swapchain.swapchain_extent.width,
-      .height = (float)renderer->swapchain.swapchain_extent.height,
-      .minDepth = 0.f,
-      .maxDepth = 1.f};
-  vkCmdSetViewport(renderer->command_buffer[renderer->current_frame], 0, 1,
-                   &viewport);
-  VkRect2D scissor = {.offset = {},
-                      .extent = renderer->swapchain.swapchain_extent};
-  vkCmdSetScissor(renderer->command_buffer[renderer->current_frame], 0, 1,
-                  &scissor);
-
-  VkBuffer vertex_buffers[] = {renderer->vertex_buffer.buffer};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(renderer->command_buffer[renderer->current_frame], 0,
-                         1, vertex_buffers, offsets);
-  vkCmdBindIndexBuffer(renderer->command_buffer[renderer->current_frame],
-                       renderer->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-  vkCmdBindDescriptorSets(
-      renderer->command_buffer[renderer->current_frame],
-      VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipeline_layout, 0, 1,
-      &renderer->descriptor_sets[renderer->current_frame], 0, nullptr);
-  vkCmdDrawIndexed(renderer->command_buffer[renderer->current_frame],
-                   renderer->index_count, 1, 0, 0, 0);
-
-  vkCmdEndRenderPass(renderer->command_buffer[renderer->current_frame]);
+  struct vgltf_renderer_draw_recording recording = {
+      .renderer = renderer,
+      .swapchain_image_index = swapchain_image_index,
+      .draw_count = renderer->cpu_culling.visible_count,
+      .chunk_count = 1};
+  // A single indirect count draw covers every draw
+  if (!renderer->device.draw_indirect_count_supported) {
+    uint32_t chunk_count =
+        recording.draw_count /
+        VGLTF_RENDERER_MIN_DRAWS_PER_SECONDARY_COMMAND_BUFFER;
+    if (chunk_count > (uint32_t)renderer->recording_thread_count) {
+      chunk_count = renderer->recording_thread_count;
+    }
+    recording.chunk_count = VGLTF_MAX(chunk_count, 1u);
+  }
+
+  // The triangle pass timing covers the depth prepass
+  VkCommandBuffer command_buffer =
+      renderer->command_buffer[renderer->current_frame];
+  vgltf_gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer,
+                                VGLTF_RENDERER_GPU_PASS_TRIANGLE);
+  vgltf_gpu_profiler_begin_statistics(&renderer->gpu_profiler, command_buffer);
+  vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+                       VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  if (renderer->depth_prepass) {
+    recording.subpass = VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS;
+    if (!execute_draw_chunks(&recording, command_buffer)) {
+      goto err;
+    }
+  }
+  vkCmdNextSubpass(command_buffer,
+                   VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+  recording.subpass = VGLTF_RENDERER_SUBPASS_MAIN;
+  if (!execute_draw_chunks(&recording, command_buffer)) {
+    goto err;
+  }
+  vkCmdEndRenderPass(command_buffer);
+  vgltf_gpu_profiler_end_statistics(&renderer->gpu_profiler, command_buffer);
+  vgltf_gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer,
+                              VGLTF_RENDERER_GPU_PASS_TRIANGLE);
+  return true;
+err:
+  VGLTF_LOG_ERR("Couldn't record the triangle pass");
+  return false;
 }
 
 static void update_uniform_buffer(struct vgltf_renderer *renderer,
                                   uint32_t current_frame) {
+  VGLTF_TRACE_ZONE(__func__);
   static long start_time_nanoseconds = 0;
   if (start_time_nanoseconds == 0) {
     if (!vgltf_platform_get_current_time_nanoseconds(&start_time_nanoseconds)) {
@@ -2057,7 +5812,13 @@ static void update_uniform_buffer(struct vgltf_renderer *renderer,
   long elapsed_time_nanoseconds =
       current_time_nanoseconds - start_time_nanoseconds;
   float elapsed_time_seconds = elapsed_time_nanoseconds / 1e9f;
-  VGLTF_LOG_INFO("Elapsed time: %f", elapsed_time_seconds);
+  // Headless frames are animated at a fixed rate so that a given frame
+  // always renders the same image
+  if (renderer->headless) {
+    elapsed_time_seconds = renderer->rendered_frame_count *
+                           VGLTF_RENDERER_HEADLESS_FRAME_DURATION_SECONDS;
+  }
+  VGLTF_LOG_DBG("Elapsed time: %f", elapsed_time_seconds);
 
   vgltf_mat4 model_matrix;
   vgltf_mat4_rotate(model_matrix, (vgltf_mat4)VGLTF_MAT4_IDENTITY,
@@ -2075,6 +5836,25 @@ static void update_uniform_buffer(struct vgltf_renderer *renderer,
                          0.1f, 10.f);
   projection_matrix[1 * 4 + 1] *= -1;
 
+  // Every instance shares the model matrix, culling happens in model space
+  vgltf_mat4 model_view_matrix;
+  vgltf_mat4_multiply(model_view_matrix, model_matrix, view_matrix);
+  vgltf_mat4 model_view_projection_matrix;
+  vgltf_mat4_multiply(model_view_projection_matrix, model_view_matrix,
+                      projection_matrix);
+  vgltf_frustum_from_matrix(&renderer->frustum, model_view_projection_matrix);
+
+  // The model and view matrices are rigid, the camera is at -R^T t of the
+  // model view rotation R and translation t
+  const vgltf_mat_value_type *m = model_view_matrix;
+  renderer->camera_position = (vgltf_vec3){
+      -(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]),
+      -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]),
+      -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14])};
+  renderer->projection_pixel_scale =
+      fabsf(projection_matrix[1 * 4 + 1]) *
+      (float)renderer->swapchain.swapchain_extent.height * 0.5f;
+
   struct vgltf_renderer_uniform_buffer_object ubo = {};
   memcpy(ubo.model, model_matrix, sizeof(vgltf_mat4));
   memcpy(ubo.view, view_matrix, sizeof(vgltf_mat4));
@@ -2083,29 +5863,69 @@ static void update_uniform_buffer(struct vgltf_renderer *renderer,
 }
 
 bool vgltf_renderer_render_frame(struct vgltf_renderer *renderer) {
-  vkWaitForFences(renderer->device.device, 1,
-                  &renderer->in_flight_fences[renderer->current_frame], VK_TRUE,
-                  UINT64_MAX);
-
-  uint32_t image_index;
-  VkResult acquire_swapchain_image_result = vkAcquireNextImageKHR(
-      renderer->device.device, renderer->swapchain.swapchain, UINT64_MAX,
-      renderer->image_available_semaphores[renderer->current_frame],
-      VK_NULL_HANDLE, &image_index);
-  if (acquire_swapchain_image_result == VK_ERROR_OUT_OF_DATE_KHR ||
-      acquire_swapchain_image_result == VK_SUBOPTIMAL_KHR ||
-      renderer->framebuffer_resized) {
-    renderer->framebuffer_resized = false;
-    vgltf_renderer_recreate_swapchain(renderer);
-    return true;
-  } else if (acquire_swapchain_image_result != VK_SUCCESS) {
-    VGLTF_LOG_ERR("Failed to acquire a swapchain image");
-    goto err;
+  VGLTF_TRACE_ZONE(__func__);
+  {
+    VGLTF_TRACE_ZONE("wait for frame fence");
+    vkWaitForFences(renderer->device.device, 1,
+                    &renderer->in_flight_fences[renderer->current_frame],
+                    VK_TRUE, UINT64_MAX);
+  }
+
+  if (renderer->headless) {
+    vgltf_frame_readback_resolve(&renderer->frame_readback,
+                                 renderer->current_frame);
+  }
+
+  // Headless frames render into the offscreen image of their frame in flight,
+  // which the fence wait above made available
+  uint32_t image_index = renderer->current_frame;
+  VkResult acquire_swapchain_image_result = VK_SUCCESS;
+  if (!renderer->headless) {
+    acquire_swapchain_image_result = vkAcquireNextImageKHR(
+        renderer->device.device, renderer->swapchain.swapchain, UINT64_MAX,
+        renderer->image_available_semaphores[renderer->current_frame],
+        VK_NULL_HANDLE, &image_index);
+    if (acquire_swapchain_image_result == VK_ERROR_OUT_OF_DATE_KHR ||
+        acquire_swapchain_image_result == VK_SUBOPTIMAL_KHR ||
+        renderer->framebuffer_resized) {
+      renderer->framebuffer_resized = false;
+      if (!vgltf_renderer_recreate_swapchain(renderer)) {
+        goto err;
+      }
+      return true;
+    } else if (acquire_swapchain_image_result != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Failed to acquire a swapchain image");
+      goto err;
+    }
   }
 
   vkResetFences(renderer->device.device, 1,
                 &renderer->in_flight_fences[renderer->current_frame]);
 
+  for (int thread_index = 0; thread_index < renderer->recording_thread_count;
+       thread_index++) {
+    struct vgltf_renderer_thread_command_pool *thread_command_pool =
+        &renderer->thread_command_pools[renderer->current_frame][thread_index];
+    vkResetCommandPool(renderer->device.device,
+                       thread_command_pool->command_pool, 0);
+    thread_command_pool->used_secondary_command_buffer_count = 0;
+  }
+
+  vgltf_geometry_streaming_begin_frame(&renderer->geometry_streaming,
+                                       renderer->current_frame);
+  vgltf_texture_streaming_begin_frame(&renderer->texture_streaming,
+                                      renderer->current_frame);
+  update_uniform_buffer(renderer, renderer->current_frame);
+  vgltf_cpu_culling_cull(&renderer->cpu_culling, renderer->job_system,
+                         &renderer->frustum);
+  memcpy(renderer->gpu_culling
+             .mapped_visible_instance_buffers[renderer->current_frame],
+         renderer->cpu_culling.visible_indices,
+         renderer->cpu_culling.visible_count * sizeof(uint32_t));
+  vgltf_renderer_write_candidate_draws(renderer);
+  // Before the command buffer records the descriptor set of the frame
+  vgltf_renderer_stream_textures(renderer);
+
   vkResetCommandBuffer(renderer->command_buffer[renderer->current_frame], 0);
   VkCommandBufferBeginInfo begin_info = {
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -2114,19 +5934,59 @@ bool vgltf_renderer_render_frame(struct vgltf_renderer *renderer) {
   if (vkBeginCommandBuffer(renderer->command_buffer[renderer->current_frame],
                            &begin_info) != VK_SUCCESS) {
     VGLTF_LOG_ERR("Failed to begin recording command buffer");
-    goto err;
+    goto cancel_staging;
+  }
+
+  VkCommandBuffer command_buffer =
+      renderer->command_buffer[renderer->current_frame];
+  if (vgltf_gpu_profiler_begin_frame(&renderer->gpu_profiler, command_buffer,
+                                     renderer->current_frame) &&
+      renderer->gpu_profiler.resolved_frame_count %
+              VGLTF_GPU_PROFILER_HISTORY_LENGTH ==
+          0) {
+    vgltf_gpu_profiler_log_report(&renderer->gpu_profiler);
+    vgltf_geometry_streaming_log_report(&renderer->geometry_streaming);
+    vgltf_texture_streaming_log_report(&renderer->texture_streaming);
+  }
+  vgltf_gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer,
+                                VGLTF_RENDERER_GPU_PASS_FRAME);
+  // The geometry and textures staged for this frame, before the passes that
+  // read them
+  vgltf_geometry_streaming_record(&renderer->geometry_streaming,
+                                  command_buffer);
+  vgltf_texture_streaming_record(&renderer->texture_streaming, command_buffer);
+
+  vgltf_gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer,
+                                VGLTF_RENDERER_GPU_PASS_CULL);
+  vgltf_renderer_cull_pass(renderer, command_buffer);
+  vgltf_gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer,
+                              VGLTF_RENDERER_GPU_PASS_CULL);
+
+  if (!vgltf_renderer_triangle_pass(renderer, image_index)) {
+    goto cancel_staging;
   }
 
-  vgltf_renderer_triangle_pass(renderer, image_index);
+  vgltf_gpu_profiler_begin_pass(&renderer->gpu_profiler, command_buffer,
+                                VGLTF_RENDERER_GPU_PASS_DEPTH_PYRAMID);
+  vgltf_renderer_depth_pyramid_pass(renderer, command_buffer);
+  vgltf_gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer,
+                              VGLTF_RENDERER_GPU_PASS_DEPTH_PYRAMID);
+
+  vgltf_gpu_profiler_end_pass(&renderer->gpu_profiler, command_buffer,
+                              VGLTF_RENDERER_GPU_PASS_FRAME);
+
+  if (renderer->headless) {
+    vgltf_frame_readback_record(
+        &renderer->frame_readback, command_buffer, renderer->current_frame,
+        renderer->swapchain.swapchain_images[image_index]);
+  }
 
   if (vkEndCommandBuffer(renderer->command_buffer[renderer->current_frame]) !=
       VK_SUCCESS) {
     VGLTF_LOG_ERR("Failed to record command buffer");
-    goto err;
+    goto cancel_staging;
   }
 
-  update_uniform_buffer(renderer, renderer->current_frame);
-
   VkSubmitInfo submit_info = {
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
   };
@@ -2135,7 +5995,7 @@ bool vgltf_renderer_render_frame(struct vgltf_renderer *renderer) {
       renderer->image_available_semaphores[renderer->current_frame]};
   VkPipelineStageFlags wait_stages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submit_info.waitSemaphoreCount = 1;
+  submit_info.waitSemaphoreCount = renderer->headless ? 0 : 1;
   submit_info.pWaitSemaphores = wait_semaphores;
   submit_info.pWaitDstStageMask = wait_stages;
   submit_info.commandBufferCount = 1;
@@ -2144,39 +6004,49 @@ bool vgltf_renderer_render_frame(struct vgltf_renderer *renderer) {
 
   VkSemaphore signal_semaphores[] = {
       renderer->render_finished_semaphores[renderer->current_frame]};
-  submit_info.signalSemaphoreCount = 1;
+  submit_info.signalSemaphoreCount = renderer->headless ? 0 : 1;
   submit_info.pSignalSemaphores = signal_semaphores;
   if (vkQueueSubmit(renderer->device.graphics_queue, 1, &submit_info,
                     renderer->in_flight_fences[renderer->current_frame]) !=
       VK_SUCCESS) {
     VGLTF_LOG_ERR("Failed to submit draw command buffer");
-    goto err;
-  }
-
-  VkPresentInfoKHR present_info = {.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-                                   .waitSemaphoreCount = 1,
-                                   .pWaitSemaphores = signal_semaphores};
-
-  VkSwapchainKHR swapchains[] = {renderer->swapchain.swapchain};
-  present_info.swapchainCount = 1;
-  present_info.pSwapchains = swapchains;
-  present_info.pImageIndices = &image_index;
-  VkResult result =
-      vkQueuePresentKHR(renderer->device.present_queue, &present_info);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-    vgltf_renderer_recreate_swapchain(renderer);
-  } else if (acquire_swapchain_image_result != VK_SUCCESS) {
-    VGLTF_LOG_ERR("Failed to acquire a swapchain image");
-    goto err;
+    goto cancel_staging;
+  }
+
+  if (!renderer->headless) {
+    VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = signal_semaphores};
+
+    VkSwapchainKHR swapchains[] = {renderer->swapchain.swapchain};
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = swapchains;
+    present_info.pImageIndices = &image_index;
+    VkResult result =
+        vkQueuePresentKHR(renderer->device.present_queue, &present_info);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+      if (!vgltf_renderer_recreate_swapchain(renderer)) {
+        goto err;
+      }
+    } else if (acquire_swapchain_image_result != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Failed to acquire a swapchain image");
+      goto err;
+    }
   }
   renderer->current_frame =
       (renderer->current_frame + 1) % VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT;
+  renderer->rendered_frame_count++;
   return true;
+cancel_staging:
+  // The geometry staged for the frame never reaches its pools
+  vgltf_geometry_streaming_cancel(&renderer->geometry_streaming);
 err:
   return false;
 }
 static bool
 vgltf_renderer_create_uniform_buffers(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkDeviceSize buffer_size =
       sizeof(struct vgltf_renderer_uniform_buffer_object);
 
@@ -2196,12 +6066,17 @@ vgltf_renderer_create_uniform_buffers(struct vgltf_renderer *renderer) {
 
 static bool
 vgltf_renderer_create_descriptor_pool(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkDescriptorPoolSize pool_sizes[] = {
       (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                              .descriptorCount =
                                  VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT},
+      (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                             .descriptorCount =
+                                 2 * VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT},
       (VkDescriptorPoolSize){.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                              .descriptorCount =
+                                 renderer->device.max_bindless_texture_count *
                                  VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT}};
   int pool_size_count = sizeof(pool_sizes) / sizeof(pool_sizes[0]);
 
@@ -2223,6 +6098,7 @@ err:
 }
 static bool
 vgltf_renderer_create_descriptor_sets(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   VkDescriptorSetLayout layouts[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT] = {};
   for (int layout_index = 0;
        layout_index < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT;
@@ -2248,12 +6124,28 @@ vgltf_renderer_create_descriptor_sets(struct vgltf_renderer *renderer) {
         .buffer = renderer->uniform_buffers[set_index].buffer,
         .offset = 0,
         .range = sizeof(struct vgltf_renderer_uniform_buffer_object)};
-
-    VkDescriptorImageInfo image_info = {
-        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .imageView = renderer->texture_image_view,
-        .sampler = renderer->texture_sampler,
-    };
+    VkDescriptorBufferInfo instance_buffer_info = {
+        .buffer = renderer->instance_buffer.buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo material_buffer_info = {
+        .buffer = renderer->material_buffer.buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE};
+
+    // The textures are rewritten as their resident levels change
+    const struct vgltf_texture_streaming *texture_streaming =
+        &renderer->texture_streaming;
+    VkDescriptorImageInfo image_infos[VGLTF_RENDERER_MAX_TEXTURE_COUNT];
+    for (uint32_t texture_index = 0;
+         texture_index < texture_streaming->texture_count; texture_index++) {
+      image_infos[texture_index] = (VkDescriptorImageInfo){
+          .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          .imageView = vgltf_texture_streaming_get_view(texture_streaming,
+                                                        texture_index),
+          .sampler = renderer->texture_sampler,
+      };
+    }
 
     VkWriteDescriptorSet descriptor_writes[] = {
         (VkWriteDescriptorSet){.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -2270,9 +6162,28 @@ vgltf_renderer_create_descriptor_sets(struct vgltf_renderer *renderer) {
                                .dstBinding = 1,
                                .dstArrayElement = 0,
                                .descriptorType =
-                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                               .descriptorCount = 1,
+                               .pBufferInfo = &instance_buffer_info},
+
+        (VkWriteDescriptorSet){.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                               .dstSet = renderer->descriptor_sets[set_index],
+                               .dstBinding = 2,
+                               .dstArrayElement = 0,
+                               .descriptorType =
+                                   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                .descriptorCount = 1,
-                               .pImageInfo = &image_info}};
+                               .pBufferInfo = &material_buffer_info},
+
+        (VkWriteDescriptorSet){.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                               .dstSet = renderer->descriptor_sets[set_index],
+                               .dstBinding = 3,
+                               .dstArrayElement = 0,
+                               .descriptorType =
+                                   VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                               .descriptorCount =
+                                   texture_streaming->texture_count,
+                               .pImageInfo = image_infos}};
     int descriptor_write_count =
         sizeof(descriptor_writes) / sizeof(descriptor_writes[0]);
 
@@ -2288,15 +6199,16 @@ err:
 static bool vgltf_vk_device_init(struct vgltf_vk_device *device,
                                  struct vgltf_vk_instance *instance,
                                  struct vgltf_vk_surface *surface) {
+  VGLTF_TRACE_ZONE(__func__);
   if (!pick_physical_device(&device->physical_device, instance,
                             surface->surface)) {
     VGLTF_LOG_ERR("Couldn't pick physical device");
     goto err;
   }
 
-  if (!create_logical_device(&device->device, &device->graphics_queue,
-                             &device->present_queue, device->physical_device,
-                             surface->surface)) {
+  query_device_capabilities(device);
+
+  if (!create_logical_device(device, surface->surface)) {
     VGLTF_LOG_ERR("Couldn't pick logical device");
     goto err;
   }
@@ -2318,14 +6230,23 @@ static void vgltf_vk_device_deinit(struct vgltf_vk_device *device) {
   vkDestroyDevice(device->device, nullptr);
 }
 
-bool vgltf_renderer_init(struct vgltf_renderer *renderer,
-                         struct vgltf_platform *platform) {
+// Without a platform there is no surface, the renderer is headless
+static bool vgltf_renderer_init_with_window_size(
+    struct vgltf_renderer *renderer, struct vgltf_platform *platform,
+    struct vgltf_job_system *job_system, struct vgltf_window_size window_size,
+    const char *model_path) {
+  VGLTF_TRACE_ZONE(__func__);
+  renderer->job_system = job_system;
+  renderer->window_size = window_size;
+  renderer->headless = platform == nullptr;
   if (!vgltf_vk_instance_init(&renderer->instance, platform)) {
     VGLTF_LOG_ERR("instance creation failed");
     goto err;
   }
   vgltf_renderer_setup_debug_messenger(renderer);
-  if (!vgltf_vk_surface_init(&renderer->surface, &renderer->instance,
+  renderer->surface.surface = VK_NULL_HANDLE;
+  if (!renderer->headless &&
+      !vgltf_vk_surface_init(&renderer->surface, &renderer->instance,
                              platform)) {
     goto destroy_instance;
   }
@@ -2336,13 +6257,6 @@ bool vgltf_renderer_init(struct vgltf_renderer *renderer,
     goto destroy_surface;
   }
 
-  struct vgltf_window_size window_size = {800, 600};
-  if (!vgltf_platform_get_window_size(platform, &window_size)) {
-    VGLTF_LOG_ERR("Couldn't get window size");
-    goto destroy_device;
-  }
-  renderer->window_size = window_size;
-
   if (!vgltf_vk_swapchain_init(&renderer->swapchain, &renderer->device,
                                &renderer->surface, &renderer->window_size)) {
     VGLTF_LOG_ERR("Couldn't create swapchain");
@@ -2359,14 +6273,9 @@ bool vgltf_renderer_init(struct vgltf_renderer *renderer,
     goto destroy_render_pass;
   }
 
-  if (!vgltf_renderer_create_graphics_pipeline(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create graphics pipeline");
-    goto destroy_descriptor_set_layout;
-  }
-
   if (!vgltf_renderer_create_command_pool(renderer)) {
     VGLTF_LOG_ERR("Couldn't create command pool");
-    goto destroy_graphics_pipeline;
+    goto destroy_descriptor_set_layout;
   }
 
   if (!vgltf_renderer_create_depth_resources(renderer)) {
@@ -2379,39 +6288,72 @@ bool vgltf_renderer_init(struct vgltf_renderer *renderer,
     goto destroy_depth_resources;
   }
 
-  if (!vgltf_renderer_create_texture_image(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create texture image");
+  if (!vgltf_renderer_create_texture_sampler(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create texture sampler");
     goto destroy_frame_buffers;
   }
 
-  if (!vgltf_renderer_create_texture_image_view(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create texture image view");
-    goto destroy_texture_image;
+  static_assert(VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT <=
+                    VGLTF_TEXTURE_STREAMING_MAX_FRAME_COUNT,
+                "Frames in flight need their own staging buffer");
+  if (!vgltf_texture_streaming_init(
+          &renderer->texture_streaming, renderer->device.device,
+          renderer->device.allocator, renderer->job_system,
+          renderer->device.max_bindless_texture_count,
+          VGLTF_RENDERER_TEXTURE_STAGING_SIZE, VGLTF_RENDERER_TEXTURE_MAX_SIZE,
+          VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT)) {
+    VGLTF_LOG_ERR("Couldn't create texture streaming");
+    goto destroy_texture_sampler;
   }
 
-  if (!vgltf_renderer_create_texture_sampler(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create texture sampler");
-    goto destroy_texture_image_view;
+  if (!load_model(renderer, model_path)) {
+    VGLTF_LOG_ERR("Couldn't load model");
+    goto destroy_model;
   }
 
-  if (!load_model(renderer)) {
-    VGLTF_LOG_ERR("Couldn't load model");
-    goto destroy_texture_sampler;
+  // Both change the indices, so they run before they become the backing store
+  // of the geometry streaming
+  if (!generate_lods(renderer)) {
+    VGLTF_LOG_ERR("Couldn't generate LODs");
+    goto destroy_model;
+  }
+  renderer->lod_selection = true;
+
+  if (!build_meshlets(renderer)) {
+    VGLTF_LOG_ERR("Couldn't build meshlets");
+    goto destroy_model;
   }
+  renderer->cluster_culling = true;
 
-  if (!vgltf_renderer_create_vertex_buffer(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create vertex buffer");
+  // Needs the vertex layout of the model
+  if (!vgltf_renderer_create_graphics_pipeline(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create graphics pipeline");
     goto destroy_model;
   }
 
-  if (!vgltf_renderer_create_index_buffer(renderer)) {
-    VGLTF_LOG_ERR("Couldn't create index buffer");
-    goto destroy_vertex_buffer;
+  if (!vgltf_renderer_create_geometry_streaming(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create geometry streaming");
+    goto destroy_graphics_pipeline;
+  }
+
+  if (!vgltf_renderer_create_meshlet_buffer(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create meshlet buffer");
+    goto destroy_geometry_streaming;
+  }
+
+  if (!vgltf_renderer_create_instance_buffer(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create instance buffer");
+    goto destroy_meshlet_buffer;
+  }
+
+  if (!vgltf_renderer_create_material_buffer(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create material buffer");
+    goto destroy_instance_buffer;
   }
 
   if (!vgltf_renderer_create_uniform_buffers(renderer)) {
     VGLTF_LOG_ERR("Couldn't create uniform buffers");
-    goto destroy_index_buffer;
+    goto destroy_material_buffer;
   }
 
   if (!vgltf_renderer_create_descriptor_pool(renderer)) {
@@ -2424,18 +6366,74 @@ bool vgltf_renderer_init(struct vgltf_renderer *renderer,
     goto destroy_descriptor_pool;
   }
 
+  if (!vgltf_renderer_create_gpu_culling(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create GPU culling resources");
+    goto destroy_descriptor_pool;
+  }
+
   if (!vgltf_renderer_create_command_buffer(renderer)) {
     VGLTF_LOG_ERR("Couldn't create command buffer");
-    goto destroy_descriptor_pool;
+    goto destroy_gpu_culling;
+  }
+
+  if (!vgltf_renderer_create_thread_command_pools(renderer)) {
+    VGLTF_LOG_ERR("Couldn't create thread command pools");
+    goto destroy_gpu_culling;
+  }
+
+  static_assert(VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT <=
+                    VGLTF_GPU_PROFILER_MAX_FRAME_COUNT,
+                "The GPU profiler needs queries for every frame in flight");
+  static const char *gpu_pass_names[VGLTF_RENDERER_GPU_PASS_COUNT] = {
+      [VGLTF_RENDERER_GPU_PASS_FRAME] = "frame",
+      [VGLTF_RENDERER_GPU_PASS_CULL] = "cull pass",
+      [VGLTF_RENDERER_GPU_PASS_TRIANGLE] = "triangle pass",
+      [VGLTF_RENDERER_GPU_PASS_DEPTH_PYRAMID] = "depth pyramid pass",
+      [VGLTF_RENDERER_GPU_PASS_DEPTH_PREPASS] = "depth prepass",
+  };
+  if (!vgltf_gpu_profiler_init(
+          &renderer->gpu_profiler, renderer->device.device,
+          renderer->device.timestamp_period,
+          renderer->device.timestamp_valid_bits,
+          renderer->device.pipeline_statistics_supported,
+          VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT, gpu_pass_names,
+          VGLTF_RENDERER_GPU_PASS_COUNT)) {
+    VGLTF_LOG_ERR("Couldn't create GPU profiler");
+    goto destroy_thread_command_pools;
+  }
+
+  static_assert(VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT <=
+                    VGLTF_FRAME_READBACK_MAX_FRAME_COUNT,
+                "Frames in flight need their own readback buffer");
+  // Offscreen images are the only ones that can be copied from
+  if (renderer->headless &&
+      !vgltf_frame_readback_init(
+          &renderer->frame_readback, renderer->device.allocator, job_system,
+          renderer->swapchain.swapchain_extent.width,
+          renderer->swapchain.swapchain_extent.height,
+          VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT)) {
+    VGLTF_LOG_ERR("Couldn't create frame readback");
+    goto deinit_gpu_profiler;
   }
 
   if (!vgltf_renderer_create_sync_objects(renderer)) {
     VGLTF_LOG_ERR("Couldn't create sync objects");
-    goto destroy_descriptor_pool;
+    goto deinit_frame_readback;
   }
 
   return true;
 
+deinit_frame_readback:
+  if (renderer->headless) {
+    vgltf_frame_readback_deinit(&renderer->frame_readback);
+  }
+deinit_gpu_profiler:
+  vgltf_gpu_profiler_deinit(&renderer->gpu_profiler);
+destroy_thread_command_pools:
+  vgltf_renderer_destroy_thread_command_pools(renderer);
+destroy_gpu_culling:
+  vgltf_renderer_destroy_depth_pyramid(renderer);
+  vgltf_renderer_destroy_gpu_culling(renderer);
 destroy_descriptor_pool:
   vkDestroyDescriptorPool(renderer->device.device, renderer->descriptor_pool,
                           nullptr);
@@ -2445,22 +6443,40 @@ destroy_uniform_buffers:
                      renderer->uniform_buffers[i].buffer,
                      renderer->uniform_buffers[i].allocation);
   }
-destroy_index_buffer:
-  vmaDestroyBuffer(renderer->device.allocator, renderer->index_buffer.buffer,
-                   renderer->index_buffer.allocation);
-destroy_vertex_buffer:
-  vmaDestroyBuffer(renderer->device.allocator, renderer->vertex_buffer.buffer,
-                   renderer->vertex_buffer.allocation);
+destroy_material_buffer:
+  vmaDestroyBuffer(renderer->device.allocator, renderer->material_buffer.buffer,
+                   renderer->material_buffer.allocation);
+destroy_instance_buffer:
+  vmaDestroyBuffer(renderer->device.allocator, renderer->instance_buffer.buffer,
+                   renderer->instance_buffer.allocation);
+destroy_meshlet_buffer:
+  vmaDestroyBuffer(renderer->device.allocator, renderer->meshlet_buffer.buffer,
+                   renderer->meshlet_buffer.allocation);
+destroy_geometry_streaming:
+  vmaDestroyBuffer(renderer->device.allocator,
+                   renderer->constant_vertex_buffer.buffer,
+                   renderer->constant_vertex_buffer.allocation);
+  vgltf_geometry_streaming_deinit(&renderer->geometry_streaming);
+destroy_graphics_pipeline:
+  for (uint32_t winding = 0; winding < VGLTF_RENDERER_WINDING_COUNT;
+       winding++) {
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->graphics_pipelines[winding], nullptr);
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->depth_pipelines[winding], nullptr);
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->depth_equal_graphics_pipelines[winding],
+                      nullptr);
+  }
+  vkDestroyPipelineLayout(renderer->device.device, renderer->pipeline_layout,
+                          nullptr);
 destroy_model:
-  // TODO
+  vgltf_allocator_free(&system_allocator, renderer->meshlets);
+  vgltf_allocator_free(&system_allocator, renderer->indices);
+  vgltf_allocator_free(&system_allocator, renderer->vertices);
+  vgltf_texture_streaming_deinit(&renderer->texture_streaming);
 destroy_texture_sampler:
   vkDestroySampler(renderer->device.device, renderer->texture_sampler, nullptr);
-destroy_texture_image_view:
-  vkDestroyImageView(renderer->device.device, renderer->texture_image_view,
-                     nullptr);
-destroy_texture_image:
-  vmaDestroyImage(renderer->device.allocator, renderer->texture_image.image,
-                  renderer->texture_image.allocation);
 destroy_depth_resources:
   vkDestroyImageView(renderer->device.device, renderer->depth_image_view,
                      nullptr);
@@ -2477,11 +6493,6 @@ destroy_frame_buffers:
         renderer->device.device,
         renderer->swapchain_framebuffers[swapchain_framebuffer_index], nullptr);
   }
-destroy_graphics_pipeline:
-  vkDestroyPipeline(renderer->device.device, renderer->graphics_pipeline,
-                    nullptr);
-  vkDestroyPipelineLayout(renderer->device.device, renderer->pipeline_layout,
-                          nullptr);
 destroy_descriptor_set_layout:
   vkDestroyDescriptorSetLayout(renderer->device.device,
                                renderer->descriptor_set_layout, nullptr);
@@ -2502,7 +6513,77 @@ destroy_instance:
 err:
   return false;
 }
+
+bool vgltf_renderer_init(struct vgltf_renderer *renderer,
+                         struct vgltf_platform *platform,
+                         struct vgltf_job_system *job_system,
+                         const char *model_path) {
+  struct vgltf_window_size window_size = {800, 600};
+  if (!vgltf_platform_get_window_size(platform, &window_size)) {
+    VGLTF_LOG_ERR("Couldn't get window size");
+    return false;
+  }
+
+  return vgltf_renderer_init_with_window_size(renderer, platform, job_system,
+                                              window_size, model_path);
+}
+
+bool vgltf_renderer_request_readback(struct vgltf_renderer *renderer,
+                                     const char *path) {
+  if (!renderer->headless) {
+    VGLTF_LOG_ERR("Frames can only be read back when rendering headless");
+    return false;
+  }
+
+  return vgltf_frame_readback_request(&renderer->frame_readback, path);
+}
+
+void vgltf_renderer_set_depth_prepass(struct vgltf_renderer *renderer,
+                                      bool enabled) {
+  if (renderer->depth_prepass == enabled) {
+    return;
+  }
+
+  // Reports the timings of the previous mode before starting over
+  vgltf_gpu_profiler_log_report(&renderer->gpu_profiler);
+  vgltf_gpu_profiler_clear_history(&renderer->gpu_profiler);
+  VGLTF_LOG_INFO("Depth prepass %s", enabled ? "enabled" : "disabled");
+  renderer->depth_prepass = enabled;
+}
+
+void vgltf_renderer_set_cluster_culling(struct vgltf_renderer *renderer,
+                                        bool enabled) {
+  if (renderer->cluster_culling == enabled) {
+    return;
+  }
+
+  vgltf_gpu_profiler_log_report(&renderer->gpu_profiler);
+  vgltf_gpu_profiler_clear_history(&renderer->gpu_profiler);
+  VGLTF_LOG_INFO("Cluster culling %s", enabled ? "enabled" : "disabled");
+  renderer->cluster_culling = enabled;
+}
+
+void vgltf_renderer_set_lod_selection(struct vgltf_renderer *renderer,
+                                      bool enabled) {
+  if (renderer->lod_selection == enabled) {
+    return;
+  }
+
+  vgltf_gpu_profiler_log_report(&renderer->gpu_profiler);
+  vgltf_gpu_profiler_clear_history(&renderer->gpu_profiler);
+  VGLTF_LOG_INFO("LOD selection %s", enabled ? "enabled" : "disabled");
+  renderer->lod_selection = enabled;
+}
+
+bool vgltf_renderer_init_headless(struct vgltf_renderer *renderer,
+                                  struct vgltf_job_system *job_system,
+                                  struct vgltf_window_size size,
+                                  const char *model_path) {
+  return vgltf_renderer_init_with_window_size(renderer, nullptr, job_system,
+                                              size, model_path);
+}
 void vgltf_renderer_deinit(struct vgltf_renderer *renderer) {
+  VGLTF_TRACE_ZONE(__func__);
   vkDeviceWaitIdle(renderer->device.device);
   vgltf_renderer_cleanup_swapchain(renderer);
   for (int i = 0; i < VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT; i++) {
@@ -2512,17 +6593,32 @@ void vgltf_renderer_deinit(struct vgltf_renderer *renderer) {
                      renderer->uniform_buffers[i].buffer,
                      renderer->uniform_buffers[i].allocation);
   }
-  vmaDestroyBuffer(renderer->device.allocator, renderer->index_buffer.buffer,
-                   renderer->index_buffer.allocation);
-  vmaDestroyBuffer(renderer->device.allocator, renderer->vertex_buffer.buffer,
-                   renderer->vertex_buffer.allocation);
+  vgltf_renderer_destroy_gpu_culling(renderer);
+  vmaDestroyBuffer(renderer->device.allocator, renderer->material_buffer.buffer,
+                   renderer->material_buffer.allocation);
+  vmaDestroyBuffer(renderer->device.allocator, renderer->instance_buffer.buffer,
+                   renderer->instance_buffer.allocation);
+  vmaDestroyBuffer(renderer->device.allocator, renderer->meshlet_buffer.buffer,
+                   renderer->meshlet_buffer.allocation);
+  vmaDestroyBuffer(renderer->device.allocator,
+                   renderer->constant_vertex_buffer.buffer,
+                   renderer->constant_vertex_buffer.allocation);
+  vgltf_geometry_streaming_deinit(&renderer->geometry_streaming);
+  vgltf_allocator_free(&system_allocator, renderer->meshlets);
+  vgltf_allocator_free(&system_allocator, renderer->indices);
+  vgltf_allocator_free(&system_allocator, renderer->vertices);
+  vgltf_texture_streaming_deinit(&renderer->texture_streaming);
   vkDestroySampler(renderer->device.device, renderer->texture_sampler, nullptr);
-  vkDestroyImageView(renderer->device.device, renderer->texture_image_view,
-                     nullptr);
-  vmaDestroyImage(renderer->device.allocator, renderer->texture_image.image,
-                  renderer->texture_image.allocation);
-  vkDestroyPipeline(renderer->device.device, renderer->graphics_pipeline,
-                    nullptr);
+  for (uint32_t winding = 0; winding < VGLTF_RENDERER_WINDING_COUNT;
+       winding++) {
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->graphics_pipelines[winding], nullptr);
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->depth_pipelines[winding], nullptr);
+    vkDestroyPipeline(renderer->device.device,
+                      renderer->depth_equal_graphics_pipelines[winding],
+                      nullptr);
+  }
   vkDestroyPipelineLayout(renderer->device.device, renderer->pipeline_layout,
                           nullptr);
   vkDestroyDescriptorPool(renderer->device.device, renderer->descriptor_pool,
@@ -2538,6 +6634,11 @@ void vgltf_renderer_deinit(struct vgltf_renderer *renderer) {
     vkDestroyFence(renderer->device.device, renderer->in_flight_fences[i],
                    nullptr);
   }
+  if (renderer->headless) {
+    vgltf_frame_readback_deinit(&renderer->frame_readback);
+  }
+  vgltf_gpu_profiler_deinit(&renderer->gpu_profiler);
+  vgltf_renderer_destroy_thread_command_pools(renderer);
   vkDestroyCommandPool(renderer->device.device, renderer->command_pool,
                        nullptr);
   vgltf_vk_device_deinit(&renderer->device);
@@ -1,24 +1,78 @@
 #ifndef VGLTF_RENDERER_H
 #define VGLTF_RENDERER_H
 
+#include "../job.h"
 #include "../maths.h"
 #include "../platform.h"
+#include "cpu_culling.h"
+#include "frame_readback.h"
+#include "geometry_streaming.h"
+#include "gpu_profiler.h"
+#include "texture_streaming.h"
 #include "vma_usage.h"
 #include <vulkan/vulkan.h>
 
+// Vertex of the OBJ models and of the glTF models with float attributes
 struct vgltf_vertex {
   vgltf_vec3 position;
   vgltf_vec3 color;
   vgltf_vec2 texture_coordinates;
 };
-VkVertexInputBindingDescription vgltf_vertex_binding_description(void);
+
+enum vgltf_vertex_attribute {
+  VGLTF_VERTEX_ATTRIBUTE_POSITION,
+  VGLTF_VERTEX_ATTRIBUTE_COLOR,
+  VGLTF_VERTEX_ATTRIBUTE_TEXTURE_COORDINATES,
+  VGLTF_VERTEX_ATTRIBUTE_COUNT
+};
+
+// Interleaved vertex attributes. Quantized glTF attributes
+// (KHR_mesh_quantization) keep their integer components, the normalized and
+// scaled formats convert them to floats when the vertices are fetched.
+// Attributes with the same value for every vertex aren't stored per vertex,
+// they're fetched with a stride of 0 from constant_values, which follows the
+// vertices in the vertex buffer. The positions are also stored again, tightly
+// packed after the constant values, for the passes that only need depth.
+struct vgltf_vertex_layout {
+  VkFormat formats[VGLTF_VERTEX_ATTRIBUTE_COUNT];
+  // In the vertex, or in constant_values for the constant attributes
+  uint32_t offsets[VGLTF_VERTEX_ATTRIBUTE_COUNT];
+  uint32_t stride;
+  // Size of a position, in the interleaved vertices and in the position stream
+  uint32_t position_stride;
+  bool constant[VGLTF_VERTEX_ATTRIBUTE_COUNT];
+  unsigned char constant_values[16];
+  uint32_t constant_size;
+  // Positions are normalized to the bounding box of their mesh, the instance
+  // transforms scale them back
+  bool mesh_relative_positions;
+};
+// Layout of struct vgltf_vertex
+struct vgltf_vertex_layout vgltf_vertex_layout_float(void);
+// At most 16 bytes per vertex: signed normalized 16 bits positions relative
+// to the mesh bounding box, 8 bits colors and half float texture coordinates.
+// Models without colors or texture coordinates don't store them. Texture
+// coordinates too large for half floats to address a texel are stored as
+// floats instead, 4 bytes more.
+struct vgltf_vertex_layout
+vgltf_vertex_layout_compact(bool has_colors, bool has_texture_coordinates,
+                            bool half_texture_coordinates);
+
+// Binding 0 is per vertex, binding 1, if any, holds the constant attributes
+struct vgltf_vertex_input_binding_descriptions {
+  VkVertexInputBindingDescription descriptions[2];
+  uint32_t count;
+};
+struct vgltf_vertex_input_binding_descriptions
+vgltf_vertex_binding_descriptions(const struct vgltf_vertex_layout *layout);
 
 struct vgltf_vertex_input_attribute_descriptions {
-  VkVertexInputAttributeDescription descriptions[3];
+  VkVertexInputAttributeDescription
+      descriptions[VGLTF_VERTEX_ATTRIBUTE_COUNT];
   uint32_t count;
 };
 struct vgltf_vertex_input_attribute_descriptions
-vgltf_vertex_attribute_descriptions(void);
+vgltf_vertex_attribute_descriptions(const struct vgltf_vertex_layout *layout);
 
 struct vgltf_renderer_uniform_buffer_object {
   alignas(16) vgltf_mat4 model;
@@ -48,6 +102,16 @@ struct vgltf_vk_device {
   VkQueue graphics_queue;
   VkQueue present_queue;
   VmaAllocator allocator;
+  uint32_t max_draw_indirect_count;
+  uint32_t max_bindless_texture_count;
+  // Nanoseconds per timestamp tick, 0 when timestamps aren't supported
+  float timestamp_period;
+  // Bits of the timestamps the graphics queue writes, 0 when it writes none
+  uint32_t timestamp_valid_bits;
+  bool multi_draw_indirect_supported;
+  bool draw_indirect_count_supported;
+  bool pipeline_statistics_supported;
+  bool memory_budget_supported;
 };
 
 struct vgltf_vk_surface {
@@ -62,6 +126,10 @@ struct vgltf_vk_swapchain {
   VkImageView swapchain_image_views[VGLTF_RENDERER_MAX_SWAPCHAIN_IMAGE_COUNT];
   VkExtent2D swapchain_extent;
   uint32_t swapchain_image_count;
+  // Without a surface the swapchain images are offscreen images, one per
+  // frame in flight
+  struct vgltf_renderer_allocated_image
+      offscreen_images[VGLTF_RENDERER_MAX_SWAPCHAIN_IMAGE_COUNT];
 };
 
 struct vgltf_vk_pipeline {
@@ -69,8 +137,257 @@ struct vgltf_vk_pipeline {
   VkPipeline pipeline;
 };
 
+// A simplified version of a mesh, with its own range of the index buffer and
+// its own meshlets
+struct vgltf_renderer_mesh_lod {
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+  // Estimated distance to the full detail surface, the sum of the simplify
+  // errors of the LODs up to this one, in model space units before the
+  // instance transform
+  vgltf_vec_value_type error;
+  // Streamed resource of the index range, in the index pool
+  uint32_t index_resource;
+};
+
+constexpr int VGLTF_RENDERER_MAX_LOD_COUNT = 6;
+
+// A mesh is a range of the shared vertex and index arrays
+struct vgltf_renderer_mesh {
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+  uint32_t vertex_count;
+  // Streamed resource of the vertex range, in the vertex pool
+  uint32_t vertex_resource;
+  // The bounding sphere is centered on the bounding box
+  vgltf_vec3 bounding_sphere_center;
+  vgltf_vec_value_type bounding_sphere_radius;
+  vgltf_vec3 bounding_box_half_extent;
+  uint32_t material_index;
+  // From the most to the least detailed, lods[0] is the index range above
+  struct vgltf_renderer_mesh_lod lods[VGLTF_RENDERER_MAX_LOD_COUNT];
+  uint32_t lod_count;
+};
+
+struct vgltf_renderer_instance {
+  uint32_t mesh_index;
+  // Moves the mesh to model space
+  vgltf_mat4 transform;
+  // Upper bound of the largest scale of the transform
+  vgltf_vec_value_type max_scale;
+};
+
+// Instance as read by the culling compute shader (cull.comp) and the vertex
+// shader (triangle.vert), the bounding sphere is in model space. The draws
+// take their index range and vertex offset from the candidate draws.
+struct vgltf_renderer_gpu_instance {
+  float transform[16];
+  float bounding_sphere[4];
+  uint32_t material_index;
+  uint32_t padding[3];
+};
+
+// Meshlet as read by the cluster culling shader (cluster_cull.comp), the bounds
+// are in the space of the vertex positions, first_index is relative to the
+// first index of its LOD
+struct vgltf_renderer_gpu_meshlet {
+  float bounding_sphere[4];
+  float cone_apex[3];
+  float cone_cutoff;
+  float cone_axis[3];
+  uint32_t first_index;
+  uint32_t triangle_count;
+  uint32_t padding[3];
+};
+
+// Written every frame for each instance that passed the CPU frustum culling,
+// with the index range of its selected LOD in the index pool and the offset of
+// its mesh in the vertex pool. With cluster culling, the meshlets of that LOD
+// are the clusters [first_cluster, first_cluster + meshlet count) of the
+// cluster culling dispatch, and the indices of the visible ones are compacted
+// from first_index in the compacted index buffer. Instances whose geometry
+// isn't resident yet have an empty draw.
+struct vgltf_renderer_gpu_candidate_draw {
+  uint32_t first_cluster;
+  uint32_t first_meshlet;
+  uint32_t first_index;
+  uint32_t index_count;
+  // Of the LOD in the index pool
+  uint32_t source_first_index;
+  int32_t vertex_offset;
+  uint32_t padding[2];
+};
+
+// Material as read by the fragment shader (triangle.frag), textures are
+// indices in the bindless texture array
+struct vgltf_renderer_material {
+  float base_color_factor[4];
+  uint32_t base_color_texture_index;
+  uint32_t padding[3];
+};
+
+// Push constants of the culling compute shader (cull.comp)
+struct vgltf_renderer_cull_push_constants {
+  float depth_pyramid_width;
+  float depth_pyramid_height;
+  uint32_t candidate_count;
+  uint32_t occlusion_culling_enabled;
+  uint32_t cluster_draws;
+  uint32_t first_mirrored_candidate;
+};
+
+// Push constants of the cluster culling compute shader (cluster_cull.comp)
+struct vgltf_renderer_cluster_cull_push_constants {
+  float depth_pyramid_width;
+  float depth_pyramid_height;
+  uint32_t draw_count;
+  uint32_t cluster_count;
+  uint32_t occlusion_culling_enabled;
+};
+
+// Push constants of the depth pyramid reduction shader (depth_pyramid.comp)
+struct vgltf_renderer_depth_pyramid_push_constants {
+  int32_t source_width;
+  int32_t source_height;
+  int32_t destination_width;
+  int32_t destination_height;
+};
+
 constexpr int VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT = 2;
+constexpr float VGLTF_RENDERER_HEADLESS_FRAME_DURATION_SECONDS = 1.f / 60.f;
+constexpr int VGLTF_RENDERER_MAX_MESH_COUNT = 1024;
+constexpr int VGLTF_RENDERER_MAX_INSTANCE_COUNT = 4096;
+constexpr int VGLTF_RENDERER_MAX_TEXTURE_COUNT = 1024;
+constexpr int VGLTF_RENDERER_MAX_MATERIAL_COUNT = 256;
+constexpr int VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT = 16;
+// The least detailed LOD whose error covers at most this many pixels is drawn
+constexpr float VGLTF_RENDERER_LOD_MAX_PIXEL_ERROR = 1.f;
+// LODs whose error is above this fraction of the mesh bounding sphere radius
+// aren't generated
+constexpr float VGLTF_RENDERER_LOD_MAX_RELATIVE_ERROR = 0.25f;
+// Per frame in flight. Frames whose visible instances have more indices are
+// drawn without cluster culling.
+constexpr uint32_t VGLTF_RENDERER_MAX_COMPACTED_INDEX_COUNT = 1 << 24;
+// Device memory of the vertex and index pools together, models that fit in it
+// only take their own size
+constexpr uint64_t VGLTF_RENDERER_GEOMETRY_POOL_SIZE = 256ull << 20;
+// Per frame in flight, geometry requested past it is uploaded by the next
+// frames
+constexpr uint64_t VGLTF_RENDERER_GEOMETRY_STAGING_SIZE = 16ull << 20;
+// Device memory of the textures at most, the heap budget may leave them less
+constexpr uint64_t VGLTF_RENDERER_TEXTURE_MAX_SIZE = 1ull << 30;
+// Per frame in flight, texture levels larger than it are uploaded in strips
+// of rows over several frames
+constexpr uint64_t VGLTF_RENDERER_TEXTURE_STAGING_SIZE = 32ull << 20;
+constexpr int VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT =
+    VGLTF_JOB_SYSTEM_MAX_THREAD_COUNT;
+// Below this many draws per secondary command buffer, splitting the recording
+// costs more than it saves
+constexpr int VGLTF_RENDERER_MIN_DRAWS_PER_SECONDARY_COMMAND_BUFFER = 64;
+static_assert(VGLTF_RENDERER_MAX_INSTANCE_COUNT <=
+                  VGLTF_CPU_CULLING_MAX_SPHERE_COUNT,
+              "Every instance needs a CPU culling bounding sphere");
+
+// Occlusion culling done in a compute pass writing the indirect draw commands
+// of the triangle pass. The candidates are the instances that passed the CPU
+// frustum culling, occlusion is tested against a hierarchical depth pyramid
+// built from the previous frame depth buffer.
+// With cluster culling, the meshlets of the visible instances are then culled
+// against the frustum, their normal cone and the depth pyramid, and the
+// indices of the visible ones are compacted into a per frame index buffer
+// that the draws read instead of the mesh indices.
+struct vgltf_renderer_gpu_culling {
+  VkDescriptorSetLayout cull_descriptor_set_layout;
+  VkPipelineLayout cull_pipeline_layout;
+  VkPipeline cull_pipeline;
+  VkDescriptorSetLayout cluster_cull_descriptor_set_layout;
+  VkPipelineLayout cluster_cull_pipeline_layout;
+  VkPipeline cluster_cull_pipeline;
+  VkDescriptorSetLayout depth_pyramid_descriptor_set_layout;
+  VkPipelineLayout depth_pyramid_pipeline_layout;
+  VkPipeline depth_pyramid_pipeline;
+
+  VkDescriptorPool descriptor_pool;
+  VkDescriptorSet cull_descriptor_sets[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  VkDescriptorSet
+      cluster_cull_descriptor_sets[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  VkDescriptorSet
+      depth_pyramid_descriptor_sets[VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT];
+
+  struct vgltf_renderer_allocated_buffer
+      visible_instance_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  void *mapped_visible_instance_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  struct vgltf_renderer_allocated_buffer
+      draw_command_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  struct vgltf_renderer_allocated_buffer
+      draw_count_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  struct vgltf_renderer_allocated_buffer
+      candidate_draw_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  void *mapped_candidate_draw_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  struct vgltf_renderer_allocated_buffer
+      compacted_index_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  uint32_t compacted_index_capacity;
+  // Whether the visible instances of the last cluster culled frame had more
+  // indices than the compacted index buffer holds
+  bool compacted_index_overflow;
+  // Meshlets of the visible instances, when the current frame culls clusters
+  uint32_t cluster_count;
+  bool cluster_draws;
+  // Draws from this one on are of mirrored instances
+  uint32_t first_mirrored_draw;
+
+  struct vgltf_renderer_allocated_image depth_pyramid;
+  VkImageView depth_pyramid_view;
+  VkImageView
+      depth_pyramid_level_views[VGLTF_RENDERER_MAX_DEPTH_PYRAMID_LEVEL_COUNT];
+  uint32_t depth_pyramid_width;
+  uint32_t depth_pyramid_height;
+  uint32_t depth_pyramid_level_count;
+  VkSampler depth_pyramid_sampler;
+  bool depth_pyramid_valid;
+};
+
+// Subpasses of the render pass, the depth prepass is left empty when it's
+// disabled
+enum vgltf_renderer_subpass {
+  VGLTF_RENDERER_SUBPASS_DEPTH_PREPASS,
+  VGLTF_RENDERER_SUBPASS_MAIN,
+  VGLTF_RENDERER_SUBPASS_COUNT
+};
+
+// Front face winding of the graphics pipelines. The transform of mirrored
+// instances has a negative determinant, which flips the winding of their
+// triangles on screen.
+enum vgltf_renderer_winding {
+  VGLTF_RENDERER_WINDING_COUNTER_CLOCKWISE,
+  VGLTF_RENDERER_WINDING_CLOCKWISE,
+  VGLTF_RENDERER_WINDING_COUNT
+};
+
+// Command pools are externally synchronized, each job system thread records
+// into secondary command buffers allocated from its own pools
+struct vgltf_renderer_thread_command_pool {
+  VkCommandPool command_pool;
+  VkCommandBuffer secondary_command_buffers
+      [VGLTF_RENDERER_SUBPASS_COUNT *
+       VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT];
+  uint32_t used_secondary_command_buffer_count;
+};
+
+enum vgltf_renderer_gpu_pass {
+  VGLTF_RENDERER_GPU_PASS_FRAME,
+  VGLTF_RENDERER_GPU_PASS_CULL,
+  VGLTF_RENDERER_GPU_PASS_TRIANGLE,
+  VGLTF_RENDERER_GPU_PASS_DEPTH_PYRAMID,
+  VGLTF_RENDERER_GPU_PASS_DEPTH_PREPASS,
+  VGLTF_RENDERER_GPU_PASS_COUNT
+};
+
 struct vgltf_renderer {
+  struct vgltf_job_system *job_system;
   struct vgltf_vk_instance instance;
   struct vgltf_vk_device device;
   VkDebugUtilsMessengerEXT debug_messenger;
@@ -85,12 +402,25 @@ struct vgltf_renderer {
   VkDescriptorPool descriptor_pool;
   VkDescriptorSet descriptor_sets[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
   VkPipelineLayout pipeline_layout;
-  VkPipeline graphics_pipeline;
+  VkPipeline graphics_pipelines[VGLTF_RENDERER_WINDING_COUNT];
+  // Writes depth only, from the position stream, in the depth prepass
+  VkPipeline depth_pipelines[VGLTF_RENDERER_WINDING_COUNT];
+  // graphics_pipelines after a depth prepass, shades the pixels whose depth
+  // equals the prepass depth and doesn't write depth
+  VkPipeline depth_equal_graphics_pipelines[VGLTF_RENDERER_WINDING_COUNT];
+  bool depth_prepass;
+  bool cluster_culling;
+  // Without it every instance draws its most detailed LOD
+  bool lod_selection;
 
   VkFramebuffer swapchain_framebuffers[VGLTF_RENDERER_MAX_SWAPCHAIN_IMAGE_COUNT];
 
   VkCommandPool command_pool;
   VkCommandBuffer command_buffer[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
+  struct vgltf_renderer_thread_command_pool
+      thread_command_pools[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT]
+                          [VGLTF_RENDERER_MAX_RECORDING_THREAD_COUNT];
+  int recording_thread_count;
   VkSemaphore
       image_available_semaphores[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
   VkSemaphore
@@ -101,24 +431,81 @@ struct vgltf_renderer {
       uniform_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
   void *mapped_uniform_buffers[VGLTF_RENDERER_MAX_FRAME_IN_FLIGHT_COUNT];
 
-  uint32_t mip_level_count;
-  struct vgltf_renderer_allocated_image texture_image;
-  VkImageView texture_image_view;
+  // Texture 0 and material 0 are the defaults of meshes without material. The
+  // textures start with their smallest levels, finer ones are streamed in as
+  // the visible instances need them.
+  struct vgltf_texture_streaming texture_streaming;
   VkSampler texture_sampler;
-  struct vgltf_vertex vertices[100000];
+  struct vgltf_renderer_material materials[VGLTF_RENDERER_MAX_MATERIAL_COUNT];
+  uint32_t material_count;
+  // Sized by the model loader, vertices follow vertex_layout, with the
+  // constant values and the position stream after them. They stay in system
+  // memory as the backing store of the geometry streaming.
+  void *vertices;
   int vertex_count;
-  uint16_t indices[100000];
+  struct vgltf_vertex_layout vertex_layout;
+  uint32_t *indices;
   int index_count;
-  struct vgltf_renderer_allocated_buffer vertex_buffer;
-  struct vgltf_renderer_allocated_buffer index_buffer;
+  struct vgltf_renderer_mesh meshes[VGLTF_RENDERER_MAX_MESH_COUNT];
+  uint32_t mesh_count;
+  struct vgltf_renderer_gpu_meshlet *meshlets;
+  uint32_t meshlet_count;
+  // Mirrored instances come after the others, so that their draws can use
+  // the clockwise pipelines
+  struct vgltf_renderer_instance instances[VGLTF_RENDERER_MAX_INSTANCE_COUNT];
+  uint32_t instance_count;
+  uint32_t first_mirrored_instance;
+  // Geometry of the visible instances, streamed from vertices and indices
+  struct vgltf_geometry_streaming geometry_streaming;
+  // Constant attributes of binding 1, if any
+  struct vgltf_renderer_allocated_buffer constant_vertex_buffer;
+  struct vgltf_renderer_allocated_buffer meshlet_buffer;
+  struct vgltf_renderer_allocated_buffer instance_buffer;
+  struct vgltf_renderer_allocated_buffer material_buffer;
+  struct vgltf_renderer_gpu_culling gpu_culling;
+  struct vgltf_cpu_culling cpu_culling;
+  struct vgltf_gpu_profiler gpu_profiler;
+  struct vgltf_frame_readback frame_readback;
 
+  vgltf_frustum frustum;
+  // Of the current frame, for the LOD selection: the camera position in model
+  // space, and the pixels covered along the screen height by a unit length
+  // at a unit distance from the camera
+  vgltf_vec3 camera_position;
+  vgltf_vec_value_type projection_pixel_scale;
   struct vgltf_window_size window_size;
   uint32_t current_frame;
   bool framebuffer_resized;
+  bool headless;
+  uint64_t rendered_frame_count;
 };
+// Models are glTF (.gltf and .glb) or OBJ files
 bool vgltf_renderer_init(struct vgltf_renderer *renderer,
-                       struct vgltf_platform *platform);
+                         struct vgltf_platform *platform,
+                         struct vgltf_job_system *job_system,
+                         const char *model_path);
+// Renders into offscreen images without a window, frames aren't presented
+bool vgltf_renderer_init_headless(struct vgltf_renderer *renderer,
+                                  struct vgltf_job_system *job_system,
+                                  struct vgltf_window_size size,
+                                  const char *model_path);
+// Writes the next rendered frame to an image file without stalling the frame
+// loop, headless renderers only
+bool vgltf_renderer_request_readback(struct vgltf_renderer *renderer,
+                                     const char *path);
 void vgltf_renderer_deinit(struct vgltf_renderer *renderer);
+// Takes effect on the next recorded frame. The GPU timings so far are logged
+// and cleared, so that they only cover one mode.
+void vgltf_renderer_set_depth_prepass(struct vgltf_renderer *renderer,
+                                      bool enabled);
+// Takes effect on the next recorded frame, with the same timings reset as the
+// depth prepass
+void vgltf_renderer_set_cluster_culling(struct vgltf_renderer *renderer,
+                                        bool enabled);
+// Takes effect on the next recorded frame, with the same timings reset as the
+// depth prepass
+void vgltf_renderer_set_lod_selection(struct vgltf_renderer *renderer,
+                                      bool enabled);
 bool vgltf_renderer_render_frame(struct vgltf_renderer *renderer);
 void vgltf_renderer_on_window_resized(struct vgltf_renderer *renderer,
                                     struct vgltf_window_size size);
@@ -0,0 +1,972 @@
+#include "texture_streaming.h"
+#include "../alloc.h"
+#include "../log.h"
+#include "../maths.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+static constexpr uint32_t TEXEL_SIZE = 4;
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+static constexpr uint32_t GENERATION_BATCH_SIZE = 16;
+static constexpr uint32_t NO_TEXTURE = UINT32_MAX;
+
+// Linear values of the sRGB bytes, and the linear values halfway between
+// consecutive bytes in sRGB, where the encoding rounds to the next byte
+static float srgb_to_linear[256];
+static float srgb_thresholds[255];
+
+static float decode_srgb(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static void init_srgb_tables(void) {
+  for (uint32_t byte = 0; byte < 256; byte++) {
+    srgb_to_linear[byte] = decode_srgb(byte / 255.f);
+  }
+  for (uint32_t byte = 0; byte < 255; byte++) {
+    srgb_thresholds[byte] = decode_srgb((byte + 0.5f) / 255.f);
+  }
+}
+
+static unsigned char encode_srgb(float value) {
+  // Count of the thresholds at most value
+  uint32_t low = 0;
+  uint32_t high = 255;
+  while (low < high) {
+    uint32_t middle = (low + high) / 2;
+    if (srgb_thresholds[middle] <= value) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return (unsigned char)low;
+}
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t level_width(const struct vgltf_streamed_texture *texture,
+                            uint32_t level) {
+  return VGLTF_MAX(texture->width >> level, 1u);
+}
+
+static uint32_t level_height(const struct vgltf_streamed_texture *texture,
+                             uint32_t level) {
+  return VGLTF_MAX(texture->height >> level, 1u);
+}
+
+// Of the levels from first_level in the backing store, about what an image
+// of them takes
+static VkDeviceSize levels_size(const struct vgltf_streamed_texture *texture,
+                                uint32_t first_level) {
+  uint32_t last_level = texture->level_count - 1;
+  return texture->level_offsets[last_level] +
+         (VkDeviceSize)level_width(texture, last_level) *
+             level_height(texture, last_level) * TEXEL_SIZE -
+         texture->level_offsets[first_level];
+}
+
+// Levels not requested by the current frame are only wanted down to the tail
+static uint32_t wanted_level(const struct vgltf_texture_streaming *streaming,
+                             const struct vgltf_streamed_texture *texture) {
+  return texture->desired_frame == streaming->frame ? texture->desired_level
+                                                    : texture->tail_level;
+}
+
+static bool create_image(struct vgltf_texture_streaming *streaming,
+                         uint32_t width, uint32_t height, uint32_t level_count,
+                         struct vgltf_texture_streaming_image *image) {
+  VkImageCreateInfo image_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = TEXTURE_FORMAT,
+      .extent = {width, height, 1},
+      .mipLevels = level_count,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+  VmaAllocationCreateInfo alloc_info = {
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE};
+  VmaAllocationInfo allocation_info;
+  if (vmaCreateImage(streaming->allocator, &image_info, &alloc_info,
+                     &image->image, &image->allocation,
+                     &allocation_info) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create streamed texture image");
+    goto err;
+  }
+
+  VkImageViewCreateInfo view_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = image->image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = TEXTURE_FORMAT,
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = 0,
+                           .levelCount = level_count,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1}};
+  if (vkCreateImageView(streaming->device, &view_info, nullptr,
+                        &image->view) != VK_SUCCESS) {
+    VGLTF_LOG_ERR("Couldn't create streamed texture image view");
+    goto destroy_image;
+  }
+
+  image->size = allocation_info.size;
+  streaming->allocated_size += image->size;
+  return true;
+destroy_image:
+  vmaDestroyImage(streaming->allocator, image->image, image->allocation);
+err:
+  *image = (struct vgltf_texture_streaming_image){};
+  return false;
+}
+
+static void destroy_image(struct vgltf_texture_streaming *streaming,
+                          struct vgltf_texture_streaming_image *image) {
+  vkDestroyImageView(streaming->device, image->view, nullptr);
+  vmaDestroyImage(streaming->allocator, image->image, image->allocation);
+  streaming->allocated_size -= image->size;
+  *image = (struct vgltf_texture_streaming_image){};
+}
+
+static void destroy_frames(struct vgltf_texture_streaming *streaming,
+                           uint32_t frame_count) {
+  for (uint32_t frame_index = 0; frame_index < frame_count; frame_index++) {
+    struct vgltf_texture_streaming_frame *frame =
+        &streaming->frames[frame_index];
+    vgltf_allocator_free(&system_allocator, frame->barriers);
+    vgltf_allocator_free(&system_allocator, frame->image_copies);
+    vgltf_allocator_free(&system_allocator, frame->buffer_copy_sources);
+    vgltf_allocator_free(&system_allocator, frame->buffer_copies);
+    vgltf_allocator_free(&system_allocator, frame->transfers);
+    vmaDestroyBuffer(streaming->allocator, frame->staging_buffer,
+                     frame->staging_allocation);
+  }
+}
+
+static void free_arrays(struct vgltf_texture_streaming *streaming) {
+  vgltf_allocator_free(&system_allocator, streaming->refinements);
+  vgltf_allocator_free(&system_allocator, streaming->descriptor_writes);
+  vgltf_allocator_free(&system_allocator, streaming->image_infos);
+  vgltf_allocator_free(&system_allocator, streaming->retired_images);
+  vgltf_allocator_free(&system_allocator, streaming->textures);
+}
+
+bool vgltf_texture_streaming_init(struct vgltf_texture_streaming *streaming,
+                                  VkDevice device, VmaAllocator allocator,
+                                  struct vgltf_job_system *job_system,
+                                  uint32_t texture_capacity,
+                                  VkDeviceSize staging_size,
+                                  VkDeviceSize max_size, uint32_t frame_count) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(streaming);
+  assert(frame_count <= VGLTF_TEXTURE_STREAMING_MAX_FRAME_COUNT);
+  *streaming = (struct vgltf_texture_streaming){
+      .device = device,
+      .allocator = allocator,
+      .job_system = job_system,
+      .texture_capacity = texture_capacity,
+      .max_size = max_size,
+      .frame_count = frame_count,
+      .staging_size = staging_size};
+  init_srgb_tables();
+
+  uint32_t capacity = texture_capacity > 0 ? texture_capacity : 1;
+  // Every texture retires at most one image per frame, and the images
+  // retired by the frames in flight are kept
+  streaming->retired_image_capacity = capacity * frame_count;
+  streaming->textures = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(struct vgltf_streamed_texture));
+  streaming->retired_images = vgltf_allocator_allocate_array(
+      &system_allocator, streaming->retired_image_capacity,
+      sizeof(struct vgltf_texture_streaming_retired_image));
+  streaming->image_infos = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(VkDescriptorImageInfo));
+  streaming->descriptor_writes = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(VkWriteDescriptorSet));
+  streaming->refinements = vgltf_allocator_allocate_array(
+      &system_allocator, capacity, sizeof(uint64_t));
+  if (!streaming->textures || !streaming->retired_images ||
+      !streaming->image_infos || !streaming->descriptor_writes ||
+      !streaming->refinements) {
+    VGLTF_LOG_ERR("Couldn't allocate the streamed textures");
+    goto free_arrays;
+  }
+
+  uint32_t frame_index = 0;
+  for (; frame_index < frame_count; frame_index++) {
+    struct vgltf_texture_streaming_frame *frame =
+        &streaming->frames[frame_index];
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = staging_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+    VmaAllocationCreateInfo alloc_info = {
+        .usage = VMA_MEMORY_USAGE_AUTO,
+        .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                 VMA_ALLOCATION_CREATE_MAPPED_BIT};
+    VmaAllocationInfo allocation_info;
+    if (vmaCreateBuffer(allocator, &buffer_info, &alloc_info,
+                        &frame->staging_buffer, &frame->staging_allocation,
+                        &allocation_info) != VK_SUCCESS) {
+      VGLTF_LOG_ERR("Couldn't create texture staging buffer");
+      goto destroy_frames;
+    }
+    frame->mapped_staging = allocation_info.pMappedData;
+
+    // A texture copies at most one region per level in a frame
+    size_t copy_capacity =
+        (size_t)capacity * VGLTF_TEXTURE_STREAMING_MAX_LEVEL_COUNT;
+    frame->transfers = vgltf_allocator_allocate_array(
+        &system_allocator, capacity, sizeof(struct vgltf_texture_transfer));
+    frame->buffer_copies = vgltf_allocator_allocate_array(
+        &system_allocator, copy_capacity, sizeof(VkBufferImageCopy));
+    frame->buffer_copy_sources = vgltf_allocator_allocate_array(
+        &system_allocator, copy_capacity, sizeof(const unsigned char *));
+    frame->image_copies = vgltf_allocator_allocate_array(
+        &system_allocator, copy_capacity, sizeof(VkImageCopy));
+    frame->barriers = vgltf_allocator_allocate_array(
+        &system_allocator, (size_t)capacity * 2, sizeof(VkImageMemoryBarrier));
+    if (!frame->transfers || !frame->buffer_copies ||
+        !frame->buffer_copy_sources || !frame->image_copies ||
+        !frame->barriers) {
+      VGLTF_LOG_ERR("Couldn't allocate the texture transfers");
+      frame_index++;
+      goto destroy_frames;
+    }
+  }
+
+  if (!create_image(streaming, 1, 1, 1, &streaming->placeholder)) {
+    VGLTF_LOG_ERR("Couldn't create the placeholder texture");
+    goto destroy_frames;
+  }
+
+  // The textures are budgeted against the heap of the placeholder
+  VmaAllocationInfo placeholder_info;
+  vmaGetAllocationInfo(allocator, streaming->placeholder.allocation,
+                       &placeholder_info);
+  const VkPhysicalDeviceMemoryProperties *memory_properties;
+  vmaGetMemoryProperties(allocator, &memory_properties);
+  streaming->heap_index =
+      memory_properties->memoryTypes[placeholder_info.memoryType].heapIndex;
+
+  return true;
+destroy_frames:
+  destroy_frames(streaming, frame_index);
+free_arrays:
+  free_arrays(streaming);
+  return false;
+}
+
+void vgltf_texture_streaming_deinit(struct vgltf_texture_streaming *streaming) {
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    destroy_image(streaming, &texture->pending);
+    destroy_image(streaming, &texture->resident);
+    vgltf_allocator_free(&system_allocator, texture->levels);
+  }
+  for (uint32_t retired_index = 0;
+       retired_index < streaming->retired_image_count; retired_index++) {
+    destroy_image(streaming, &streaming->retired_images[retired_index].image);
+  }
+  destroy_image(streaming, &streaming->placeholder);
+  destroy_frames(streaming, streaming->frame_count);
+  free_arrays(streaming);
+}
+
+struct level_generation {
+  const unsigned char *source;
+  uint32_t source_width;
+  uint32_t source_height;
+  unsigned char *destination;
+  uint32_t width;
+};
+
+// Box filters the colors in linear space, the alpha as is. Odd sizes repeat
+// their last row or column.
+static void generate_level_rows(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  const struct level_generation *generation = data;
+  size_t source_row_size = (size_t)generation->source_width * TEXEL_SIZE;
+  for (uint32_t y = begin; y < end; y++) {
+    uint32_t last_row = generation->source_height - 1;
+    const unsigned char *source_rows[2] = {
+        generation->source + VGLTF_MIN(2 * y, last_row) * source_row_size,
+        generation->source + VGLTF_MIN(2 * y + 1, last_row) * source_row_size};
+    uint32_t last_column = generation->source_width - 1;
+    unsigned char *destination =
+        generation->destination + (size_t)y * generation->width * TEXEL_SIZE;
+    for (uint32_t x = 0; x < generation->width; x++) {
+      uint32_t source_columns[2] = {
+          VGLTF_MIN(2 * x, last_column) * TEXEL_SIZE,
+          VGLTF_MIN(2 * x + 1, last_column) * TEXEL_SIZE};
+      float color[3] = {};
+      uint32_t alpha = 0;
+      for (uint32_t row = 0; row < 2; row++) {
+        for (uint32_t column = 0; column < 2; column++) {
+          const unsigned char *texel =
+              source_rows[row] + source_columns[column];
+          for (uint32_t channel = 0; channel < 3; channel++) {
+            color[channel] += srgb_to_linear[texel[channel]];
+          }
+          alpha += texel[3];
+        }
+      }
+      for (uint32_t channel = 0; channel < 3; channel++) {
+        destination[x * TEXEL_SIZE + channel] =
+            encode_srgb(color[channel] * 0.25f);
+      }
+      destination[x * TEXEL_SIZE + 3] = (unsigned char)((alpha + 2) / 4);
+    }
+  }
+}
+
+bool vgltf_texture_streaming_add(struct vgltf_texture_streaming *streaming,
+                                 const struct vgltf_image *image,
+                                 uint32_t *texture_index) {
+  VGLTF_TRACE_ZONE(__func__);
+  assert(streaming->texture_count < streaming->texture_capacity);
+  assert(image->format == VGLTF_IMAGE_FORMAT_R8G8B8A8);
+  uint32_t max_size = VGLTF_MAX(image->width, image->height);
+  uint32_t level_count = 1;
+  while (max_size >> level_count) {
+    level_count++;
+  }
+  if (level_count > VGLTF_TEXTURE_STREAMING_MAX_LEVEL_COUNT) {
+    VGLTF_LOG_ERR("Image of %ux%u texels, textures have at most %d levels",
+                  image->width, image->height,
+                  VGLTF_TEXTURE_STREAMING_MAX_LEVEL_COUNT);
+    goto err;
+  }
+
+  struct vgltf_streamed_texture texture = {
+      .width = image->width,
+      .height = image->height,
+      .level_count = level_count,
+      .resident_level = level_count};
+  size_t size = 0;
+  for (uint32_t level = 0; level < level_count; level++) {
+    texture.level_offsets[level] = size;
+    size += (size_t)level_width(&texture, level) *
+            level_height(&texture, level) * TEXEL_SIZE;
+    if (texture.tail_level == level &&
+        VGLTF_MAX(level_width(&texture, level), level_height(&texture, level)) >
+            VGLTF_TEXTURE_STREAMING_TAIL_SIZE) {
+      texture.tail_level = level + 1;
+    }
+  }
+  texture.levels = vgltf_allocator_allocate_array(&system_allocator, size, 1);
+  if (!texture.levels) {
+    VGLTF_LOG_ERR("Couldn't allocate the levels of a %ux%u texture",
+                  image->width, image->height);
+    goto err;
+  }
+
+  memcpy(texture.levels, image->data,
+         (size_t)image->width * image->height * TEXEL_SIZE);
+  for (uint32_t level = 1; level < level_count; level++) {
+    struct level_generation generation = {
+        .source = texture.levels + texture.level_offsets[level - 1],
+        .source_width = level_width(&texture, level - 1),
+        .source_height = level_height(&texture, level - 1),
+        .destination = texture.levels + texture.level_offsets[level],
+        .width = level_width(&texture, level)};
+    vgltf_job_system_parallel_for(
+        streaming->job_system, level_height(&texture, level),
+        GENERATION_BATCH_SIZE, generate_level_rows, &generation);
+  }
+
+  *texture_index = streaming->texture_count++;
+  streaming->textures[*texture_index] = texture;
+  return true;
+err:
+  return false;
+}
+
+VkImageView vgltf_texture_streaming_get_view(
+    const struct vgltf_texture_streaming *streaming, uint32_t texture_index) {
+  const struct vgltf_streamed_texture *texture =
+      &streaming->textures[texture_index];
+  return texture->resident.image ? texture->resident.view
+                                 : streaming->placeholder.view;
+}
+
+void vgltf_texture_streaming_begin_frame(
+    struct vgltf_texture_streaming *streaming, uint32_t frame_index) {
+  assert(frame_index < streaming->frame_count);
+  streaming->frame++;
+  streaming->frame_index = frame_index;
+
+  // The frames up to frame - frame_count have completed
+  uint32_t kept_count = 0;
+  for (uint32_t retired_index = 0;
+       retired_index < streaming->retired_image_count; retired_index++) {
+    struct vgltf_texture_streaming_retired_image *retired =
+        &streaming->retired_images[retired_index];
+    if (retired->frame + streaming->frame_count <= streaming->frame) {
+      destroy_image(streaming, &retired->image);
+    } else {
+      streaming->retired_images[kept_count++] = *retired;
+    }
+  }
+  streaming->retired_image_count = kept_count;
+
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[frame_index];
+  frame->staging_used_size = 0;
+  frame->transfer_count = 0;
+  frame->buffer_copy_count = 0;
+  frame->image_copy_count = 0;
+}
+
+void vgltf_texture_streaming_request(struct vgltf_texture_streaming *streaming,
+                                     uint32_t texture_index, float pixel_size) {
+  struct vgltf_streamed_texture *texture = &streaming->textures[texture_index];
+  uint32_t level = texture->tail_level;
+  if (pixel_size > 0.f) {
+    float ratio =
+        (float)VGLTF_MAX(texture->width, texture->height) / pixel_size;
+    if (ratio < (float)(1u << texture->tail_level)) {
+      level = ratio <= 1.f ? 0 : (uint32_t)floorf(log2f(ratio));
+    }
+  }
+
+  if (texture->desired_frame != streaming->frame ||
+      level < texture->desired_level) {
+    texture->desired_level = level;
+  }
+  texture->desired_frame = streaming->frame;
+  texture->last_used_frame = streaming->frame;
+}
+
+static VkDeviceSize heap_budget(struct vgltf_texture_streaming *streaming) {
+  VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+  vmaGetHeapBudgets(streaming->allocator, budgets);
+  const VmaBudget *budget = &budgets[streaming->heap_index];
+  VkDeviceSize other_usage = budget->usage > streaming->allocated_size
+                                 ? budget->usage - streaming->allocated_size
+                                 : 0;
+  if (budget->budget <= other_usage) {
+    return 0;
+  }
+  VkDeviceSize texture_budget =
+      (VkDeviceSize)((budget->budget - other_usage) *
+                     VGLTF_TEXTURE_STREAMING_BUDGET_FRACTION);
+  return VGLTF_MIN(texture_budget, streaming->max_size);
+}
+
+static struct vgltf_texture_transfer *
+begin_transfer(struct vgltf_texture_streaming *streaming,
+               struct vgltf_streamed_texture *texture) {
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  texture->transfer_frame = streaming->frame;
+  struct vgltf_texture_transfer *transfer =
+      &frame->transfers[frame->transfer_count++];
+  *transfer = (struct vgltf_texture_transfer){
+      .first_buffer_copy = frame->buffer_copy_count,
+      .first_image_copy = frame->image_copy_count};
+  return transfer;
+}
+
+// Copies the levels of the resident image to the same levels of the image
+// holding the levels from first_level, which replaces it
+static void replace_resident(struct vgltf_texture_streaming *streaming,
+                             struct vgltf_streamed_texture *texture,
+                             struct vgltf_texture_transfer *transfer,
+                             struct vgltf_texture_streaming_image *image,
+                             uint32_t first_level) {
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  transfer->destination = image->image;
+  transfer->destination_level_count = texture->level_count - first_level;
+  transfer->completed = true;
+  if (texture->resident.image) {
+    uint32_t copied_level = VGLTF_MAX(first_level, texture->resident_level);
+    transfer->source = texture->resident.image;
+    transfer->source_level_count =
+        texture->level_count - texture->resident_level;
+    for (; copied_level < texture->level_count; copied_level++) {
+      VkImageSubresourceLayers subresource = {
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+          .baseArrayLayer = 0,
+          .layerCount = 1};
+      VkImageCopy *copy = &frame->image_copies[frame->image_copy_count++];
+      *copy = (VkImageCopy){.srcSubresource = subresource,
+                            .dstSubresource = subresource,
+                            .extent = {level_width(texture, copied_level),
+                                       level_height(texture, copied_level), 1}};
+      copy->srcSubresource.mipLevel = copied_level - texture->resident_level;
+      copy->dstSubresource.mipLevel = copied_level - first_level;
+      transfer->image_copy_count++;
+    }
+
+    assert(streaming->retired_image_count < streaming->retired_image_capacity);
+    streaming->retired_images[streaming->retired_image_count++] =
+        (struct vgltf_texture_streaming_retired_image){
+            .image = texture->resident, .frame = streaming->frame};
+    streaming->committed_size -= texture->resident.size;
+  }
+
+  texture->resident = *image;
+  texture->resident_level = first_level;
+  texture->stale_descriptor_mask = (1u << streaming->frame_count) - 1;
+}
+
+static bool start_pending(struct vgltf_texture_streaming *streaming,
+                          struct vgltf_streamed_texture *texture,
+                          uint32_t level) {
+  if (!create_image(streaming, level_width(texture, level),
+                    level_height(texture, level), texture->level_count - level,
+                    &texture->pending)) {
+    return false;
+  }
+  streaming->committed_size += texture->pending.size;
+  texture->pending_level = level;
+  texture->upload_level = level;
+  texture->uploaded_row_count = 0;
+  return true;
+}
+
+// Stages the rows of the missing levels that the staging buffer has room
+// for, and replaces the resident image once they are all uploaded
+static void stage_pending(struct vgltf_texture_streaming *streaming,
+                          struct vgltf_streamed_texture *texture) {
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  if (texture->transfer_frame == streaming->frame) {
+    return;
+  }
+
+  // Until its first rows are staged, the image is still undefined
+  bool created = texture->upload_level == texture->pending_level &&
+                 texture->uploaded_row_count == 0;
+  uint32_t first_buffer_copy = frame->buffer_copy_count;
+  while (texture->upload_level < texture->resident_level &&
+         frame->staging_used_size < streaming->staging_size) {
+    uint32_t width = level_width(texture, texture->upload_level);
+    uint32_t height = level_height(texture, texture->upload_level);
+    VkDeviceSize row_size = (VkDeviceSize)width * TEXEL_SIZE;
+    VkDeviceSize available_size =
+        streaming->staging_size - frame->staging_used_size;
+    uint32_t row_count = (uint32_t)VGLTF_MIN(
+        (VkDeviceSize)(height - texture->uploaded_row_count),
+        available_size / row_size);
+    if (row_count == 0) {
+      break;
+    }
+
+    frame->buffer_copies[frame->buffer_copy_count] = (VkBufferImageCopy){
+        .bufferOffset = frame->staging_used_size,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                             .mipLevel = texture->upload_level -
+                                         texture->pending_level,
+                             .baseArrayLayer = 0,
+                             .layerCount = 1},
+        .imageOffset = {0, (int32_t)texture->uploaded_row_count, 0},
+        .imageExtent = {width, row_count, 1}};
+    frame->buffer_copy_sources[frame->buffer_copy_count] =
+        texture->levels + texture->level_offsets[texture->upload_level] +
+        texture->uploaded_row_count * row_size;
+    frame->buffer_copy_count++;
+    frame->staging_used_size = align_up(
+        frame->staging_used_size + row_count * row_size, STAGING_ALIGNMENT);
+    streaming->uploaded_size += row_count * row_size;
+
+    texture->uploaded_row_count += row_count;
+    if (texture->uploaded_row_count == height) {
+      texture->upload_level++;
+      texture->uploaded_row_count = 0;
+    }
+  }
+  if (frame->buffer_copy_count == first_buffer_copy) {
+    return;
+  }
+
+  struct vgltf_texture_transfer *transfer = begin_transfer(streaming, texture);
+  transfer->destination = texture->pending.image;
+  transfer->destination_level_count =
+      texture->level_count - texture->pending_level;
+  transfer->first_buffer_copy = first_buffer_copy;
+  transfer->buffer_copy_count = frame->buffer_copy_count - first_buffer_copy;
+  transfer->created = created;
+  if (texture->upload_level == texture->resident_level) {
+    struct vgltf_texture_streaming_image pending = texture->pending;
+    texture->pending = (struct vgltf_texture_streaming_image){};
+    replace_resident(streaming, texture, transfer, &pending,
+                     texture->pending_level);
+  }
+}
+
+// Replaces the resident image by one holding the levels from level, copied on
+// the GPU
+static bool evict(struct vgltf_texture_streaming *streaming,
+                  struct vgltf_streamed_texture *texture, uint32_t level) {
+  struct vgltf_texture_streaming_image image;
+  if (!create_image(streaming, level_width(texture, level),
+                    level_height(texture, level), texture->level_count - level,
+                    &image)) {
+    return false;
+  }
+  streaming->committed_size += image.size;
+  streaming->evicted_level_count += level - texture->resident_level;
+
+  struct vgltf_texture_transfer *transfer = begin_transfer(streaming, texture);
+  transfer->created = true;
+  replace_resident(streaming, texture, transfer, &image, level);
+  return true;
+}
+
+// Textures with levels finer than level, and no copies in progress
+static bool is_evictable(const struct vgltf_texture_streaming *streaming,
+                         const struct vgltf_streamed_texture *texture,
+                         uint32_t level) {
+  return !texture->pending.image &&
+         texture->transfer_frame != streaming->frame &&
+         texture->resident_level < level;
+}
+
+static VkDeviceSize
+reclaimable_size(const struct vgltf_texture_streaming *streaming,
+                 const struct vgltf_streamed_texture *texture) {
+  return levels_size(texture, texture->resident_level) -
+         levels_size(texture, wanted_level(streaming, texture));
+}
+
+// Least recently used texture with levels it doesn't want or, with
+// wanted_levels, with levels finer than its tail
+static uint32_t
+eviction_candidate(const struct vgltf_texture_streaming *streaming,
+                   bool wanted_levels) {
+  uint32_t candidate = NO_TEXTURE;
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    const struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    uint32_t level = wanted_levels ? texture->tail_level
+                                   : wanted_level(streaming, texture);
+    if (!is_evictable(streaming, texture, level)) {
+      continue;
+    }
+    if (candidate == NO_TEXTURE ||
+        texture->last_used_frame <
+            streaming->textures[candidate].last_used_frame) {
+      candidate = texture_index;
+    }
+  }
+  return candidate;
+}
+
+// Larger gaps first
+static int compare_refinements(const void *a, const void *b) {
+  uint64_t refinement_a = *(const uint64_t *)a;
+  uint64_t refinement_b = *(const uint64_t *)b;
+  return (refinement_a < refinement_b) - (refinement_a > refinement_b);
+}
+
+static void copy_uploads(void *data, uint32_t begin, uint32_t end) {
+  VGLTF_TRACE_ZONE(__func__);
+  const struct vgltf_texture_streaming_frame *frame = data;
+  for (uint32_t copy_index = begin; copy_index < end; copy_index++) {
+    const VkBufferImageCopy *copy = &frame->buffer_copies[copy_index];
+    memcpy((char *)frame->mapped_staging + copy->bufferOffset,
+           frame->buffer_copy_sources[copy_index],
+           (size_t)copy->imageExtent.width * copy->imageExtent.height *
+               TEXEL_SIZE);
+  }
+}
+
+void vgltf_texture_streaming_update(struct vgltf_texture_streaming *streaming) {
+  VGLTF_TRACE_ZONE(__func__);
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  streaming->budget = heap_budget(streaming);
+
+  // The other allocations may have grown since the last frame. The levels the
+  // textures don't want go first, then the finest levels of the least
+  // recently used textures, one at a time.
+  while (streaming->committed_size > streaming->budget) {
+    uint32_t texture_index = eviction_candidate(streaming, false);
+    uint32_t level = 0;
+    if (texture_index != NO_TEXTURE) {
+      level = wanted_level(streaming, &streaming->textures[texture_index]);
+    } else if ((texture_index = eviction_candidate(streaming, true)) !=
+               NO_TEXTURE) {
+      level = streaming->textures[texture_index].resident_level + 1;
+    }
+    if (texture_index == NO_TEXTURE ||
+        !evict(streaming, &streaming->textures[texture_index], level)) {
+      break;
+    }
+  }
+
+  // Tails are uploaded regardless of the budget, and the pending images carry
+  // on before new ones start
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    if (!texture->resident.image && !texture->pending.image &&
+        !start_pending(streaming, texture, texture->tail_level)) {
+      continue;
+    }
+    if (texture->pending.image) {
+      stage_pending(streaming, texture);
+    }
+  }
+
+  // Refinements that wouldn't fit even after every eviction don't evict
+  uint32_t refinement_count = 0;
+  VkDeviceSize evictable_size = 0;
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    const struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    uint32_t level = wanted_level(streaming, texture);
+    if (texture->resident.image && !texture->pending.image &&
+        texture->transfer_frame != streaming->frame &&
+        level < texture->resident_level) {
+      streaming->refinements[refinement_count++] =
+          (uint64_t)(texture->resident_level - level) << 32 | texture_index;
+    } else if (is_evictable(streaming, texture, level)) {
+      evictable_size += reclaimable_size(streaming, texture);
+    }
+  }
+  qsort(streaming->refinements, refinement_count, sizeof(uint64_t),
+        compare_refinements);
+
+  // One level at a time, evicting the levels other textures don't want to
+  // stay under the budget
+  for (uint32_t refinement_index = 0;
+       refinement_index < refinement_count &&
+       frame->staging_used_size < streaming->staging_size;
+       refinement_index++) {
+    uint32_t texture_index = (uint32_t)streaming->refinements[refinement_index];
+    struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    uint32_t level = texture->resident_level - 1;
+    VkDeviceSize size = levels_size(texture, level);
+    if (streaming->committed_size + size > streaming->budget + evictable_size) {
+      continue;
+    }
+    while (streaming->committed_size + size > streaming->budget) {
+      uint32_t victim_index = eviction_candidate(streaming, false);
+      if (victim_index == NO_TEXTURE) {
+        break;
+      }
+      struct vgltf_streamed_texture *victim =
+          &streaming->textures[victim_index];
+      evictable_size -= VGLTF_MIN(evictable_size,
+                                  reclaimable_size(streaming, victim));
+      if (!evict(streaming, victim, wanted_level(streaming, victim))) {
+        break;
+      }
+    }
+    if (streaming->committed_size + size > streaming->budget) {
+      continue;
+    }
+    if (!start_pending(streaming, texture, level)) {
+      break;
+    }
+    stage_pending(streaming, texture);
+  }
+
+  vgltf_job_system_parallel_for(streaming->job_system,
+                                frame->buffer_copy_count, 1, copy_uploads,
+                                frame);
+  vmaFlushAllocation(streaming->allocator, frame->staging_allocation, 0,
+                     VK_WHOLE_SIZE);
+}
+
+void vgltf_texture_streaming_write_descriptors(
+    struct vgltf_texture_streaming *streaming, VkDescriptorSet descriptor_set,
+    uint32_t binding, VkSampler sampler) {
+  uint32_t frame_bit = 1u << streaming->frame_index;
+  uint32_t write_count = 0;
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    struct vgltf_streamed_texture *texture =
+        &streaming->textures[texture_index];
+    if (!(texture->stale_descriptor_mask & frame_bit)) {
+      continue;
+    }
+    texture->stale_descriptor_mask &= ~frame_bit;
+    streaming->image_infos[write_count] = (VkDescriptorImageInfo){
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .imageView = vgltf_texture_streaming_get_view(streaming, texture_index),
+        .sampler = sampler};
+    streaming->descriptor_writes[write_count] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor_set,
+        .dstBinding = binding,
+        .dstArrayElement = texture_index,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &streaming->image_infos[write_count]};
+    write_count++;
+  }
+  if (write_count > 0) {
+    vkUpdateDescriptorSets(streaming->device, write_count,
+                           streaming->descriptor_writes, 0, nullptr);
+  }
+}
+
+static VkImageMemoryBarrier image_barrier(VkImage image, uint32_t level_count,
+                                          VkImageLayout old_layout,
+                                          VkImageLayout new_layout,
+                                          VkAccessFlags src_access_mask,
+                                          VkAccessFlags dst_access_mask) {
+  return (VkImageMemoryBarrier){
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = src_access_mask,
+      .dstAccessMask = dst_access_mask,
+      .oldLayout = old_layout,
+      .newLayout = new_layout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .baseMipLevel = 0,
+                           .levelCount = level_count,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1}};
+}
+
+// White, as the textures of the materials are multiplied by their factor
+static void clear_placeholder(struct vgltf_texture_streaming *streaming,
+                              VkCommandBuffer command_buffer) {
+  VkImageMemoryBarrier barrier = image_barrier(
+      streaming->placeholder.image, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  VkClearColorValue white = {.float32 = {1.f, 1.f, 1.f, 1.f}};
+  VkImageSubresourceRange range = barrier.subresourceRange;
+  vkCmdClearColorImage(command_buffer, streaming->placeholder.image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1,
+                       &range);
+  barrier = image_barrier(streaming->placeholder.image, 1,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                          VK_ACCESS_SHADER_READ_BIT);
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  streaming->placeholder_cleared = true;
+}
+
+void vgltf_texture_streaming_record(struct vgltf_texture_streaming *streaming,
+                                    VkCommandBuffer command_buffer) {
+  VGLTF_TRACE_ZONE(__func__);
+  if (!streaming->placeholder_cleared) {
+    clear_placeholder(streaming, command_buffer);
+  }
+  struct vgltf_texture_streaming_frame *frame =
+      &streaming->frames[streaming->frame_index];
+  if (frame->transfer_count == 0) {
+    return;
+  }
+
+  // New images start undefined, the resident images copied from stop being
+  // sampled by the previous frames
+  uint32_t barrier_count = 0;
+  for (uint32_t transfer_index = 0; transfer_index < frame->transfer_count;
+       transfer_index++) {
+    const struct vgltf_texture_transfer *transfer =
+        &frame->transfers[transfer_index];
+    if (transfer->created) {
+      frame->barriers[barrier_count++] = image_barrier(
+          transfer->destination, transfer->destination_level_count,
+          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+          VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+    if (transfer->source) {
+      frame->barriers[barrier_count++] = image_barrier(
+          transfer->source, transfer->source_level_count,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+  }
+  if (barrier_count > 0) {
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT |
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, barrier_count, frame->barriers);
+  }
+
+  for (uint32_t transfer_index = 0; transfer_index < frame->transfer_count;
+       transfer_index++) {
+    const struct vgltf_texture_transfer *transfer =
+        &frame->transfers[transfer_index];
+    if (transfer->buffer_copy_count > 0) {
+      vkCmdCopyBufferToImage(
+          command_buffer, frame->staging_buffer, transfer->destination,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, transfer->buffer_copy_count,
+          &frame->buffer_copies[transfer->first_buffer_copy]);
+    }
+    if (transfer->image_copy_count > 0) {
+      vkCmdCopyImage(command_buffer, transfer->source,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     transfer->destination,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     transfer->image_copy_count,
+                     &frame->image_copies[transfer->first_image_copy]);
+    }
+  }
+
+  // Retired sources stay in the transfer layout
+  barrier_count = 0;
+  for (uint32_t transfer_index = 0; transfer_index < frame->transfer_count;
+       transfer_index++) {
+    const struct vgltf_texture_transfer *transfer =
+        &frame->transfers[transfer_index];
+    if (transfer->completed) {
+      frame->barriers[barrier_count++] = image_barrier(
+          transfer->destination, transfer->destination_level_count,
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+  }
+  if (barrier_count > 0) {
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, barrier_count, frame->barriers);
+  }
+}
+
+void vgltf_texture_streaming_log_report(
+    struct vgltf_texture_streaming *streaming) {
+  uint32_t full_count = 0;
+  for (uint32_t texture_index = 0; texture_index < streaming->texture_count;
+       texture_index++) {
+    full_count += streaming->textures[texture_index].resident_level == 0;
+  }
+  VGLTF_LOG_INFO("Texture streaming: %.1f/%.1f MiB resident, %u/%u textures "
+                 "at full resolution, %.1f MiB uploaded, %u levels evicted",
+                 streaming->committed_size / (1024.0 * 1024.0),
+                 streaming->budget / (1024.0 * 1024.0), full_count,
+                 streaming->texture_count,
+                 streaming->uploaded_size / (1024.0 * 1024.0),
+                 streaming->evicted_level_count);
+  streaming->uploaded_size = 0;
+  streaming->evicted_level_count = 0;
+}
@@ -0,0 +1,190 @@
+#ifndef VGLTF_RENDERER_TEXTURE_STREAMING_H
+#define VGLTF_RENDERER_TEXTURE_STREAMING_H
+
+#include "../image.h"
+#include "../job.h"
+#include "vma_usage.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+constexpr int VGLTF_TEXTURE_STREAMING_MAX_FRAME_COUNT = 4;
+// Up to 32768 texels on a side
+constexpr int VGLTF_TEXTURE_STREAMING_MAX_LEVEL_COUNT = 16;
+// Levels at most this large on their longest side are always resident
+constexpr uint32_t VGLTF_TEXTURE_STREAMING_TAIL_SIZE = 128;
+// Fraction of the memory heap budget left by the other allocations that the
+// textures may use, the rest is headroom for the allocations of the frame
+constexpr float VGLTF_TEXTURE_STREAMING_BUDGET_FRACTION = 0.8f;
+
+struct vgltf_texture_streaming_image {
+  VkImage image;
+  VmaAllocation allocation;
+  VkImageView view;
+  VkDeviceSize size;
+};
+
+// An RGBA8 sRGB texture whose resident image holds its levels from
+// resident_level to the last one. Finer levels are uploaded one at a time into
+// a pending image, which replaces the resident one once it is complete.
+struct vgltf_streamed_texture {
+  // Every level from the finest, tightly packed, as the backing store
+  unsigned char *levels;
+  size_t level_offsets[VGLTF_TEXTURE_STREAMING_MAX_LEVEL_COUNT];
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  // The levels from it are uploaded first and never evicted
+  uint32_t tail_level;
+
+  // Without any level resident, resident_level is level_count and the
+  // texture is sampled from the placeholder
+  struct vgltf_texture_streaming_image resident;
+  uint32_t resident_level;
+  // Holds the levels from pending_level, the ones of the resident image are
+  // copied to it when the others are uploaded
+  struct vgltf_texture_streaming_image pending;
+  uint32_t pending_level;
+  // Upload progress of the pending levels missing from the resident image
+  uint32_t upload_level;
+  uint32_t uploaded_row_count;
+
+  // Finest level wanted by the frame desired_frame
+  uint32_t desired_level;
+  uint64_t desired_frame;
+  uint64_t last_used_frame;
+  // Last frame that recorded copies of the texture, at most one does per frame
+  uint64_t transfer_frame;
+  // One bit per frame in flight whose descriptor doesn't sample the resident
+  // image yet
+  uint32_t stale_descriptor_mask;
+};
+
+// Image copies of a texture recorded by a frame. The destination starts
+// undefined when it was created by the frame, and becomes sampled when the
+// frame completes it, with the levels of source copied to it.
+struct vgltf_texture_transfer {
+  VkImage destination;
+  uint32_t destination_level_count;
+  VkImage source;
+  uint32_t source_level_count;
+  uint32_t first_buffer_copy;
+  uint32_t buffer_copy_count;
+  uint32_t first_image_copy;
+  uint32_t image_copy_count;
+  bool created;
+  bool completed;
+};
+
+struct vgltf_texture_streaming_frame {
+  VkBuffer staging_buffer;
+  VmaAllocation staging_allocation;
+  void *mapped_staging;
+  VkDeviceSize staging_used_size;
+  struct vgltf_texture_transfer *transfers;
+  uint32_t transfer_count;
+  // buffer_copy_sources[i] is copied to the staging buffer for buffer_copies[i]
+  VkBufferImageCopy *buffer_copies;
+  const unsigned char **buffer_copy_sources;
+  uint32_t buffer_copy_count;
+  VkImageCopy *image_copies;
+  uint32_t image_copy_count;
+  // Two per transfer, for the layout transitions of the record
+  VkImageMemoryBarrier *barriers;
+};
+
+// An image that frames in flight may still sample, destroyed frame_count
+// frames after it was replaced
+struct vgltf_texture_streaming_retired_image {
+  struct vgltf_texture_streaming_image image;
+  uint64_t frame;
+};
+
+// Textures start with their tail levels only, and get finer levels as the
+// frames request them, under a budget derived from the VMA heap budget of
+// their memory. Reaching the budget evicts the levels finer than requested
+// of the least recently used textures. Uploads go through a staging buffer
+// per frame in flight, filled by jobs, and the frame command buffer.
+struct vgltf_texture_streaming {
+  VkDevice device;
+  VmaAllocator allocator;
+  struct vgltf_job_system *job_system;
+  struct vgltf_streamed_texture *textures;
+  uint32_t texture_count;
+  uint32_t texture_capacity;
+  // White, sampled by the textures without resident levels
+  struct vgltf_texture_streaming_image placeholder;
+  bool placeholder_cleared;
+  uint32_t heap_index;
+  VkDeviceSize max_size;
+  // Of the last update, at most max_size
+  VkDeviceSize budget;
+  // Of the resident and pending images, which the budget applies to
+  VkDeviceSize committed_size;
+  // Of every image, retired ones included
+  VkDeviceSize allocated_size;
+  struct vgltf_texture_streaming_retired_image *retired_images;
+  uint32_t retired_image_count;
+  uint32_t retired_image_capacity;
+  // Of the stale textures, written by vgltf_texture_streaming_write_descriptors
+  VkDescriptorImageInfo *image_infos;
+  VkWriteDescriptorSet *descriptor_writes;
+  // Textures to refine in the update, the level gap of each in the high bits
+  // and its index in the low ones
+  uint64_t *refinements;
+
+  struct vgltf_texture_streaming_frame
+      frames[VGLTF_TEXTURE_STREAMING_MAX_FRAME_COUNT];
+  uint32_t frame_count;
+  uint32_t frame_index;
+  VkDeviceSize staging_size;
+  // Counts the frames begun
+  uint64_t frame;
+  // Since the last report
+  uint64_t uploaded_size;
+  uint32_t evicted_level_count;
+};
+
+// Every frame in flight gets a staging buffer of staging_size bytes. The
+// textures never take more than max_size bytes, their tails aside.
+bool vgltf_texture_streaming_init(struct vgltf_texture_streaming *streaming,
+                                  VkDevice device, VmaAllocator allocator,
+                                  struct vgltf_job_system *job_system,
+                                  uint32_t texture_capacity,
+                                  VkDeviceSize staging_size,
+                                  VkDeviceSize max_size, uint32_t frame_count);
+// The device must be idle
+void vgltf_texture_streaming_deinit(struct vgltf_texture_streaming *streaming);
+
+// Builds the levels of an RGBA8 sRGB image into the backing store of a new
+// texture, the image can be freed afterwards. Textures get consecutive
+// indices from 0.
+bool vgltf_texture_streaming_add(struct vgltf_texture_streaming *streaming,
+                                 const struct vgltf_image *image,
+                                 uint32_t *texture_index);
+// Resident image of the texture, or the placeholder
+VkImageView vgltf_texture_streaming_get_view(
+    const struct vgltf_texture_streaming *streaming, uint32_t texture_index);
+
+// Starts a frame once the fence of its frame in flight has been waited on
+void vgltf_texture_streaming_begin_frame(
+    struct vgltf_texture_streaming *streaming, uint32_t frame_index);
+// The texture covers about pixel_size pixels on screen, its level whose size
+// is nearest above it is wanted
+void vgltf_texture_streaming_request(struct vgltf_texture_streaming *streaming,
+                                     uint32_t texture_index, float pixel_size);
+// Evicts and stages levels for the requests of the frame
+void vgltf_texture_streaming_update(struct vgltf_texture_streaming *streaming);
+// Points the textures of the descriptor set of the frame at their resident
+// image, where it changed since the set was last used
+void vgltf_texture_streaming_write_descriptors(
+    struct vgltf_texture_streaming *streaming, VkDescriptorSet descriptor_set,
+    uint32_t binding, VkSampler sampler);
+// Records the copies of the frame, outside of a render pass
+void vgltf_texture_streaming_record(struct vgltf_texture_streaming *streaming,
+                                    VkCommandBuffer command_buffer);
+
+// Logs the memory used and the traffic since the last report
+void vgltf_texture_streaming_log_report(
+    struct vgltf_texture_streaming *streaming);
+
+#endif // VGLTF_RENDERER_TEXTURE_STREAMING_H
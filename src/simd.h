@@ -0,0 +1,18 @@
+#ifndef VGLTF_SIMD_H
+#define VGLTF_SIMD_H
+
+// Size in bytes of the GCC vector types of the SIMD code paths, which lower
+// to one AVX2 register, or to one SSE/NEON register elsewhere
+#if defined(__AVX2__)
+#define VGLTF_SIMD_VECTOR_SIZE 32
+#else
+#define VGLTF_SIMD_VECTOR_SIZE 16
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#endif // VGLTF_SIMD_H
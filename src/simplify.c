@@ -0,0 +1,539 @@
+#include "simplify.h"
+#include "log.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr uint32_t NO_VERTEX = UINT32_MAX;
+// Border edges are held in place by planes perpendicular to their triangle,
+// weighted above the triangle planes so that the silhouette goes last
+static constexpr float BORDER_EDGE_WEIGHT = 10.f;
+// A collapse can't turn the normal of a triangle by more than ~75 degrees
+static constexpr float MIN_NORMAL_COSINE = 0.25f;
+static constexpr int MAX_PASS_COUNT = 64;
+
+enum vertex_kind {
+  VERTEX_KIND_MANIFOLD,
+  // On exactly one open border, only collapses along it
+  VERTEX_KIND_BORDER,
+  // On an attribute discontinuity or a non manifold border, never collapses
+  VERTEX_KIND_LOCKED,
+};
+
+// Sum of squared distances to weighted planes, as the symmetric matrix A, the
+// vector b and the constant c of p^T A p + 2 b^T p + c
+struct quadric {
+  float a00, a11, a22, a10, a20, a21;
+  float b0, b1, b2;
+  float c;
+  float weight;
+};
+
+struct collapse {
+  float error;
+  uint32_t vertex;
+  uint32_t target;
+};
+
+struct simplifier {
+  uint32_t vertex_count;
+  vgltf_vec3 *positions;
+  struct quadric *quadrics;
+  unsigned char *kinds;
+  // Neighbours along the open border of border vertices
+  uint32_t *border_next;
+  uint32_t *border_previous;
+  uint32_t *collapse_targets;
+  // Vertices on a triangle moved this pass, which can't collapse anymore
+  bool *frozen;
+  uint32_t *adjacency_offsets;
+  uint32_t *adjacency;
+  struct collapse *collapses;
+  uint32_t *hash_keys;
+};
+
+static void quadric_add_plane(struct quadric *quadric, vgltf_vec3 normal,
+                              float distance, float weight) {
+  quadric->a00 += weight * normal.x * normal.x;
+  quadric->a11 += weight * normal.y * normal.y;
+  quadric->a22 += weight * normal.z * normal.z;
+  quadric->a10 += weight * normal.y * normal.x;
+  quadric->a20 += weight * normal.z * normal.x;
+  quadric->a21 += weight * normal.z * normal.y;
+  quadric->b0 += weight * normal.x * distance;
+  quadric->b1 += weight * normal.y * distance;
+  quadric->b2 += weight * normal.z * distance;
+  quadric->c += weight * distance * distance;
+  quadric->weight += weight;
+}
+
+static void quadric_add(struct quadric *quadric, const struct quadric *other) {
+  quadric->a00 += other->a00;
+  quadric->a11 += other->a11;
+  quadric->a22 += other->a22;
+  quadric->a10 += other->a10;
+  quadric->a20 += other->a20;
+  quadric->a21 += other->a21;
+  quadric->b0 += other->b0;
+  quadric->b1 += other->b1;
+  quadric->b2 += other->b2;
+  quadric->c += other->c;
+  quadric->weight += other->weight;
+}
+
+// Weighted mean of the squared distances from the point to the planes
+static float quadric_error(const struct quadric *quadric, vgltf_vec3 p) {
+  if (quadric->weight == 0.f) {
+    return 0.f;
+  }
+  float error = quadric->a00 * p.x * p.x + quadric->a11 * p.y * p.y +
+                quadric->a22 * p.z * p.z +
+                2.f * (quadric->a10 * p.x * p.y + quadric->a20 * p.x * p.z +
+                       quadric->a21 * p.y * p.z) +
+                2.f * (quadric->b0 * p.x + quadric->b1 * p.y +
+                       quadric->b2 * p.z) +
+                quadric->c;
+  return fabsf(error) / quadric->weight;
+}
+
+static vgltf_vec3 triangle_normal(vgltf_vec3 p0, vgltf_vec3 p1,
+                                  vgltf_vec3 p2) {
+  return vgltf_vec3_cross(vgltf_vec3_sub(p1, p0), vgltf_vec3_sub(p2, p0));
+}
+
+// Vertices at the same position as another vertex differ by an attribute,
+// both are locked so that the discontinuity stays where it is
+static void lock_discontinuities(struct simplifier *simplifier) {
+  uint32_t hash_bit_count = 1;
+  while (1u << hash_bit_count < 2 * simplifier->vertex_count) {
+    hash_bit_count++;
+  }
+  uint32_t hash_capacity = 1u << hash_bit_count;
+  uint32_t mask = hash_capacity - 1;
+  memset(simplifier->hash_keys, 0xff, hash_capacity * sizeof(uint32_t));
+  for (uint32_t vertex = 0; vertex < simplifier->vertex_count; vertex++) {
+    vgltf_vec3 position = simplifier->positions[vertex];
+    uint32_t bits[3];
+    memcpy(bits, &position, sizeof(bits));
+    uint32_t hash = bits[0] * 73856093u ^ bits[1] * 19349663u ^
+                    bits[2] * 83492791u;
+    uint32_t slot = (hash * 2654435761u) >> (32 - hash_bit_count);
+    while (simplifier->hash_keys[slot] != NO_VERTEX) {
+      uint32_t other = simplifier->hash_keys[slot];
+      if (memcmp(&simplifier->positions[other], &position,
+                 sizeof(position)) == 0) {
+        simplifier->kinds[other] = VERTEX_KIND_LOCKED;
+        simplifier->kinds[vertex] = VERTEX_KIND_LOCKED;
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    if (simplifier->hash_keys[slot] == NO_VERTEX) {
+      simplifier->hash_keys[slot] = vertex;
+    }
+  }
+}
+
+// Triangles of each vertex, in adjacency[adjacency_offsets[v]..
+// adjacency_offsets[v + 1]]
+static void build_adjacency(struct simplifier *simplifier,
+                            const uint32_t *indices, uint32_t index_count) {
+  uint32_t *offsets = simplifier->adjacency_offsets;
+  memset(offsets, 0, (simplifier->vertex_count + 1) * sizeof(uint32_t));
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    offsets[indices[corner] + 1]++;
+  }
+  for (uint32_t vertex = 0; vertex < simplifier->vertex_count; vertex++) {
+    offsets[vertex + 1] += offsets[vertex];
+  }
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    simplifier->adjacency[offsets[indices[corner]]++] = corner / 3;
+  }
+  // The fill moved each offset to the start of the next vertex
+  memmove(offsets + 1, offsets, simplifier->vertex_count * sizeof(uint32_t));
+  offsets[0] = 0;
+}
+
+// An edge is open when no triangle goes through it the other way
+static bool is_open_edge(const struct simplifier *simplifier,
+                         const uint32_t *indices, uint32_t from,
+                         uint32_t to) {
+  for (uint32_t i = simplifier->adjacency_offsets[to];
+       i < simplifier->adjacency_offsets[to + 1]; i++) {
+    const uint32_t *triangle = &indices[simplifier->adjacency[i] * 3];
+    for (int corner = 0; corner < 3; corner++) {
+      if (triangle[corner] == to && triangle[(corner + 1) % 3] == from) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Finds the open borders, vertices on more than one are locked
+static void classify_borders(struct simplifier *simplifier,
+                             const uint32_t *indices, uint32_t index_count) {
+  for (uint32_t vertex = 0; vertex < simplifier->vertex_count; vertex++) {
+    simplifier->border_next[vertex] = NO_VERTEX;
+    simplifier->border_previous[vertex] = NO_VERTEX;
+  }
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    uint32_t from = indices[corner];
+    uint32_t to = indices[corner - corner % 3 + (corner + 1) % 3];
+    if (from == to || !is_open_edge(simplifier, indices, from, to)) {
+      continue;
+    }
+    if (simplifier->border_next[from] != NO_VERTEX ||
+        simplifier->border_previous[to] != NO_VERTEX) {
+      simplifier->kinds[from] = VERTEX_KIND_LOCKED;
+      simplifier->kinds[to] = VERTEX_KIND_LOCKED;
+    }
+    simplifier->border_next[from] = to;
+    simplifier->border_previous[to] = from;
+  }
+  for (uint32_t vertex = 0; vertex < simplifier->vertex_count; vertex++) {
+    bool has_next = simplifier->border_next[vertex] != NO_VERTEX;
+    bool has_previous = simplifier->border_previous[vertex] != NO_VERTEX;
+    if (simplifier->kinds[vertex] != VERTEX_KIND_MANIFOLD ||
+        (!has_next && !has_previous)) {
+      continue;
+    }
+    simplifier->kinds[vertex] =
+        has_next && has_previous ? VERTEX_KIND_BORDER : VERTEX_KIND_LOCKED;
+  }
+}
+
+static void compute_quadrics(struct simplifier *simplifier,
+                             const uint32_t *indices, uint32_t index_count) {
+  memset(simplifier->quadrics, 0,
+         simplifier->vertex_count * sizeof(struct quadric));
+  for (uint32_t first_corner = 0; first_corner < index_count;
+       first_corner += 3) {
+    const uint32_t *triangle = &indices[first_corner];
+    vgltf_vec3 p[3] = {simplifier->positions[triangle[0]],
+                       simplifier->positions[triangle[1]],
+                       simplifier->positions[triangle[2]]};
+    vgltf_vec3 normal = triangle_normal(p[0], p[1], p[2]);
+    float double_area = vgltf_vec3_length(normal);
+    if (double_area == 0.f) {
+      continue;
+    }
+    normal = (vgltf_vec3){normal.x / double_area, normal.y / double_area,
+                          normal.z / double_area};
+    float distance = -vgltf_vec3_dot(normal, p[0]);
+    for (int corner = 0; corner < 3; corner++) {
+      quadric_add_plane(&simplifier->quadrics[triangle[corner]], normal,
+                        distance, double_area * 0.5f);
+    }
+
+    for (int corner = 0; corner < 3; corner++) {
+      uint32_t from = triangle[corner];
+      uint32_t to = triangle[(corner + 1) % 3];
+      if (simplifier->border_next[from] != to) {
+        continue;
+      }
+      vgltf_vec3 edge = vgltf_vec3_sub(p[(corner + 1) % 3], p[corner]);
+      float length = vgltf_vec3_length(edge);
+      if (length == 0.f) {
+        continue;
+      }
+      vgltf_vec3 edge_normal =
+          vgltf_vec3_normalized(vgltf_vec3_cross(edge, normal));
+      float edge_distance = -vgltf_vec3_dot(edge_normal, p[corner]);
+      float weight = length * length * BORDER_EDGE_WEIGHT;
+      quadric_add_plane(&simplifier->quadrics[from], edge_normal,
+                        edge_distance, weight);
+      quadric_add_plane(&simplifier->quadrics[to], edge_normal, edge_distance,
+                        weight);
+    }
+  }
+}
+
+static bool can_collapse(const struct simplifier *simplifier, uint32_t vertex,
+                         uint32_t target) {
+  switch (simplifier->kinds[vertex]) {
+  case VERTEX_KIND_MANIFOLD:
+    return true;
+  case VERTEX_KIND_BORDER:
+    return simplifier->border_next[vertex] == target ||
+           simplifier->border_previous[vertex] == target;
+  default:
+    return false;
+  }
+}
+
+// Whether moving the vertex onto the target turns one of the triangles that
+// survive the collapse too far, or makes it face away from the surface around
+// the vertex. The second test catches thin triangles drifting over the passes.
+static bool flips_triangles(const struct simplifier *simplifier,
+                            const uint32_t *indices, uint32_t vertex,
+                            uint32_t target) {
+  vgltf_vec3 target_position = simplifier->positions[target];
+  vgltf_vec3 surface_normal = {};
+  for (uint32_t i = simplifier->adjacency_offsets[vertex];
+       i < simplifier->adjacency_offsets[vertex + 1]; i++) {
+    const uint32_t *triangle = &indices[simplifier->adjacency[i] * 3];
+    vgltf_vec3 normal =
+        triangle_normal(simplifier->positions[triangle[0]],
+                        simplifier->positions[triangle[1]],
+                        simplifier->positions[triangle[2]]);
+    surface_normal = (vgltf_vec3){surface_normal.x + normal.x,
+                                  surface_normal.y + normal.y,
+                                  surface_normal.z + normal.z};
+  }
+  for (uint32_t i = simplifier->adjacency_offsets[vertex];
+       i < simplifier->adjacency_offsets[vertex + 1]; i++) {
+    const uint32_t *triangle = &indices[simplifier->adjacency[i] * 3];
+    if (triangle[0] == target || triangle[1] == target ||
+        triangle[2] == target) {
+      continue;
+    }
+    vgltf_vec3 p[3];
+    for (int corner = 0; corner < 3; corner++) {
+      p[corner] = simplifier->positions[triangle[corner]];
+    }
+    vgltf_vec3 normal = triangle_normal(p[0], p[1], p[2]);
+    for (int corner = 0; corner < 3; corner++) {
+      if (triangle[corner] == vertex) {
+        p[corner] = target_position;
+      }
+    }
+    vgltf_vec3 collapsed_normal = triangle_normal(p[0], p[1], p[2]);
+    float length = vgltf_vec3_length(normal);
+    if (length > 0.f &&
+        vgltf_vec3_dot(normal, collapsed_normal) <=
+            MIN_NORMAL_COSINE * length *
+                vgltf_vec3_length(collapsed_normal)) {
+      return true;
+    }
+    if (vgltf_vec3_dot(surface_normal, collapsed_normal) <= 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static int compare_collapses(const void *lhs, const void *rhs) {
+  float lhs_error = ((const struct collapse *)lhs)->error;
+  float rhs_error = ((const struct collapse *)rhs)->error;
+  return (lhs_error > rhs_error) - (lhs_error < rhs_error);
+}
+
+// Cheapest allowed direction of every edge under the error limit, each
+// interior edge is seen from both of its triangles and only kept once
+static uint32_t find_collapses(struct simplifier *simplifier,
+                               const uint32_t *indices, uint32_t index_count,
+                               float max_squared_error) {
+  uint32_t collapse_count = 0;
+  for (uint32_t corner = 0; corner < index_count; corner++) {
+    uint32_t from = indices[corner];
+    uint32_t to = indices[corner - corner % 3 + (corner + 1) % 3];
+    if (from > to && simplifier->border_next[from] != to) {
+      continue;
+    }
+
+    struct collapse best = {.error = INFINITY};
+    if (can_collapse(simplifier, from, to)) {
+      best = (struct collapse){
+          .error = quadric_error(&simplifier->quadrics[from],
+                                 simplifier->positions[to]),
+          .vertex = from,
+          .target = to};
+    }
+    if (can_collapse(simplifier, to, from)) {
+      float error = quadric_error(&simplifier->quadrics[to],
+                                  simplifier->positions[from]);
+      if (error < best.error) {
+        best = (struct collapse){.error = error, .vertex = to, .target = from};
+      }
+    }
+    if (best.error <= max_squared_error) {
+      simplifier->collapses[collapse_count++] = best;
+    }
+  }
+  return collapse_count;
+}
+
+// Moves the border links of a border vertex collapsing along its border to
+// the target
+static void collapse_border(struct simplifier *simplifier, uint32_t vertex,
+                            uint32_t target) {
+  if (simplifier->border_next[vertex] == target) {
+    uint32_t previous = simplifier->border_previous[vertex];
+    simplifier->border_next[previous] = target;
+    simplifier->border_previous[target] = previous;
+  } else {
+    uint32_t next = simplifier->border_next[vertex];
+    simplifier->border_previous[next] = target;
+    simplifier->border_next[target] = next;
+  }
+}
+
+bool vgltf_simplify(struct vgltf_allocator *allocator, uint32_t *destination,
+                    const uint32_t *indices, uint32_t index_count,
+                    const vgltf_vec3 *positions, uint32_t vertex_count,
+                    uint32_t target_index_count,
+                    vgltf_vec_value_type max_error,
+                    struct vgltf_simplify_result *result) {
+  assert(allocator);
+  assert(destination);
+  assert(indices || index_count == 0);
+  assert(positions || vertex_count == 0);
+  assert(index_count % 3 == 0);
+  assert(result);
+  memmove(destination, indices, index_count * sizeof(uint32_t));
+  *result = (struct vgltf_simplify_result){.index_count = index_count};
+  if (index_count <= target_index_count || vertex_count == 0) {
+    return true;
+  }
+
+  uint32_t hash_capacity = 2;
+  while (hash_capacity < 2 * vertex_count) {
+    hash_capacity *= 2;
+  }
+  size_t vertex_sizes[] = {
+      sizeof(vgltf_vec3),     sizeof(struct quadric), sizeof(uint32_t),
+      sizeof(uint32_t),       sizeof(uint32_t),       sizeof(uint32_t),
+      sizeof(unsigned char),  sizeof(bool)};
+  size_t size = (size_t)(vertex_count + 1) * sizeof(uint32_t) +
+                (size_t)index_count *
+                    (sizeof(uint32_t) + sizeof(struct collapse)) +
+                (size_t)hash_capacity * sizeof(uint32_t);
+  for (size_t i = 0; i < sizeof(vertex_sizes) / sizeof(vertex_sizes[0]);
+       i++) {
+    size += (size_t)vertex_count * vertex_sizes[i];
+  }
+  char *memory = vgltf_allocator_allocate(allocator, size);
+  if (!memory) {
+    VGLTF_LOG_ERR("Couldn't allocate the simplifier memory");
+    return false;
+  }
+
+  // Largest alignments first
+  struct simplifier simplifier = {.vertex_count = vertex_count};
+  char *next = memory;
+  simplifier.positions = (vgltf_vec3 *)next;
+  next += vertex_count * sizeof(vgltf_vec3);
+  simplifier.quadrics = (struct quadric *)next;
+  next += vertex_count * sizeof(struct quadric);
+  simplifier.collapses = (struct collapse *)next;
+  next += index_count * sizeof(struct collapse);
+  simplifier.border_next = (uint32_t *)next;
+  next += vertex_count * sizeof(uint32_t);
+  simplifier.border_previous = (uint32_t *)next;
+  next += vertex_count * sizeof(uint32_t);
+  simplifier.collapse_targets = (uint32_t *)next;
+  next += vertex_count * sizeof(uint32_t);
+  simplifier.hash_keys = (uint32_t *)next;
+  next += hash_capacity * sizeof(uint32_t);
+  simplifier.adjacency_offsets = (uint32_t *)next;
+  next += (vertex_count + 1) * sizeof(uint32_t);
+  simplifier.adjacency = (uint32_t *)next;
+  next += index_count * sizeof(uint32_t);
+  simplifier.kinds = (unsigned char *)next;
+  next += vertex_count * sizeof(unsigned char);
+  simplifier.frozen = (bool *)next;
+
+  // Positions are scaled to the unit cube so that the quadrics keep their
+  // float precision whatever the size of the mesh
+  vgltf_vec3 min = positions[0];
+  vgltf_vec3 max = positions[0];
+  for (uint32_t vertex = 1; vertex < vertex_count; vertex++) {
+    min = (vgltf_vec3){fminf(min.x, positions[vertex].x),
+                       fminf(min.y, positions[vertex].y),
+                       fminf(min.z, positions[vertex].z)};
+    max = (vgltf_vec3){fmaxf(max.x, positions[vertex].x),
+                       fmaxf(max.y, positions[vertex].y),
+                       fmaxf(max.z, positions[vertex].z)};
+  }
+  float extent = fmaxf(max.x - min.x, fmaxf(max.y - min.y, max.z - min.z));
+  float scale = extent > 0.f ? 1.f / extent : 0.f;
+  for (uint32_t vertex = 0; vertex < vertex_count; vertex++) {
+    vgltf_vec3 offset = vgltf_vec3_sub(positions[vertex], min);
+    simplifier.positions[vertex] =
+        (vgltf_vec3){offset.x * scale, offset.y * scale, offset.z * scale};
+  }
+  float max_squared_error = max_error * scale * max_error * scale;
+
+  memset(simplifier.kinds, VERTEX_KIND_MANIFOLD, vertex_count);
+  lock_discontinuities(&simplifier);
+  build_adjacency(&simplifier, destination, index_count);
+  classify_borders(&simplifier, destination, index_count);
+  compute_quadrics(&simplifier, destination, index_count);
+
+  float squared_error = 0.f;
+  for (int pass = 0; pass < MAX_PASS_COUNT && index_count > target_index_count;
+       pass++) {
+    if (pass > 0) {
+      build_adjacency(&simplifier, destination, index_count);
+    }
+    uint32_t collapse_count = find_collapses(&simplifier, destination,
+                                             index_count, max_squared_error);
+    qsort(simplifier.collapses, collapse_count, sizeof(struct collapse),
+          compare_collapses);
+
+    for (uint32_t vertex = 0; vertex < vertex_count; vertex++) {
+      simplifier.collapse_targets[vertex] = vertex;
+    }
+    memset(simplifier.frozen, 0, vertex_count * sizeof(bool));
+    // Each collapse removes the two triangles of its edge, or one on a border
+    uint32_t triangle_goal = (index_count - target_index_count + 2) / 3;
+    uint32_t removed_triangle_count = 0;
+    for (uint32_t i = 0;
+         i < collapse_count && removed_triangle_count < triangle_goal; i++) {
+      struct collapse collapse = simplifier.collapses[i];
+      // Frozen vertices are on a triangle that has already moved this pass
+      if (simplifier.frozen[collapse.vertex] ||
+          simplifier.frozen[collapse.target] ||
+          !can_collapse(&simplifier, collapse.vertex, collapse.target) ||
+          flips_triangles(&simplifier, destination, collapse.vertex,
+                          collapse.target)) {
+        continue;
+      }
+
+      if (simplifier.kinds[collapse.vertex] == VERTEX_KIND_BORDER) {
+        collapse_border(&simplifier, collapse.vertex, collapse.target);
+        removed_triangle_count += 1;
+      } else {
+        removed_triangle_count += 2;
+      }
+      quadric_add(&simplifier.quadrics[collapse.target],
+                  &simplifier.quadrics[collapse.vertex]);
+      simplifier.collapse_targets[collapse.vertex] = collapse.target;
+      // Every corner of the moved triangles is frozen, so that the flip test
+      // of the following collapses never sees a stale position
+      for (uint32_t j = simplifier.adjacency_offsets[collapse.vertex];
+           j < simplifier.adjacency_offsets[collapse.vertex + 1]; j++) {
+        const uint32_t *triangle = &destination[simplifier.adjacency[j] * 3];
+        for (int corner = 0; corner < 3; corner++) {
+          simplifier.frozen[triangle[corner]] = true;
+        }
+      }
+      squared_error = fmaxf(squared_error, collapse.error);
+    }
+    if (removed_triangle_count == 0) {
+      break;
+    }
+
+    // Triangles of the collapsed edges are left with a repeated vertex
+    uint32_t kept_index_count = 0;
+    for (uint32_t first_corner = 0; first_corner < index_count;
+         first_corner += 3) {
+      uint32_t a = simplifier.collapse_targets[destination[first_corner]];
+      uint32_t b = simplifier.collapse_targets[destination[first_corner + 1]];
+      uint32_t c = simplifier.collapse_targets[destination[first_corner + 2]];
+      if (a != b && b != c && c != a) {
+        destination[kept_index_count++] = a;
+        destination[kept_index_count++] = b;
+        destination[kept_index_count++] = c;
+      }
+    }
+    index_count = kept_index_count;
+  }
+
+  *result = (struct vgltf_simplify_result){
+      .index_count = index_count, .error = sqrtf(squared_error) * extent};
+  vgltf_allocator_free(allocator, memory);
+  return true;
+}
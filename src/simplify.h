@@ -0,0 +1,37 @@
+#ifndef VGLTF_SIMPLIFY_H
+#define VGLTF_SIMPLIFY_H
+
+#include "alloc.h"
+#include "maths.h"
+#include <stdint.h>
+
+// Mesh simplification by quadric error metric edge collapses. Vertices are
+// never moved or added, the simplified triangles reuse the source vertices.
+
+struct vgltf_simplify_result {
+  uint32_t index_count;
+  // Root mean square distance from a collapsed vertex to the source triangle
+  // planes it absorbed, area weighted, the largest over the collapses. In the
+  // units of the positions, it estimates how far the surface moved but isn't
+  // a bound of the distance to the source surface.
+  vgltf_vec_value_type error;
+};
+
+// Collapses edges of the triangles, cheapest first, until at most
+// target_index_count indices are left or the next collapse would have an
+// error above max_error. The indices are in [0, vertex_count), and the
+// simplified triangles are written to destination, which holds at least
+// index_count indices and may be indices.
+//
+// Vertices that share their position with another vertex are on an attribute
+// discontinuity, like a UV seam or a hard normal edge, and are never
+// collapsed, so the discontinuity is kept. Vertices on an open border only
+// collapse along it.
+bool vgltf_simplify(struct vgltf_allocator *allocator, uint32_t *destination,
+                    const uint32_t *indices, uint32_t index_count,
+                    const vgltf_vec3 *positions, uint32_t vertex_count,
+                    uint32_t target_index_count,
+                    vgltf_vec_value_type max_error,
+                    struct vgltf_simplify_result *result);
+
+#endif // VGLTF_SIMPLIFY_H
@@ -2,6 +2,7 @@
 #include "alloc.h"
 #include "hash.h"
 #include "platform.h"
+#include "simd.h"
 #include <assert.h>
 #include <stdarg.h>
 #include <string.h>
@@ -31,7 +32,53 @@ size_t vgltf_string_view_length(const struct vgltf_string_view *string_view) {
 }
 
 uint64_t vgltf_string_view_hash(const struct vgltf_string_view view) {
-  return vgltf_hash_fnv_1a(view.data, view.length);
+  return vgltf_hash_64(view.data, view.length);
+}
+
+// Returns the size of the well formed sequence starting bytes, 0 if there's
+// none. Overlong encodings, surrogates and codepoints above U+10FFFF are
+// rejected, see the Unicode standard table 3-7.
+static int decode_utf8_sequence(const unsigned char *bytes, size_t size,
+                                uint32_t *codepoint) {
+  unsigned char lead = bytes[0];
+  if (lead < 0x80) {
+    *codepoint = lead;
+    return 1;
+  }
+
+  int sequence_size;
+  unsigned char second_min = 0x80;
+  unsigned char second_max = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    sequence_size = 2;
+    *codepoint = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    sequence_size = 3;
+    *codepoint = lead & 0x0F;
+    second_min = lead == 0xE0 ? 0xA0 : second_min;
+    second_max = lead == 0xED ? 0x9F : second_max;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    sequence_size = 4;
+    *codepoint = lead & 0x07;
+    second_min = lead == 0xF0 ? 0x90 : second_min;
+    second_max = lead == 0xF4 ? 0x8F : second_max;
+  } else {
+    return 0;
+  }
+
+  if (size < (size_t)sequence_size || bytes[1] < second_min ||
+      bytes[1] > second_max) {
+    return 0;
+  }
+  for (int i = 1; i < sequence_size; i++) {
+    if ((bytes[i] & 0xC0) != 0x80) {
+      return 0;
+    }
+
+    *codepoint = (*codepoint << 6) | (bytes[i] & 0x3F);
+  }
+
+  return sequence_size;
 }
 
 int vgltf_string_view_utf8_codepoint_at_offset(struct vgltf_string_view view,
@@ -40,37 +87,113 @@ int vgltf_string_view_utf8_codepoint_at_offset(struct vgltf_string_view view,
   assert(codepoint);
   assert(offset < view.length);
 
-  const unsigned char *s = (unsigned char *)&view.data[offset];
-
-  int size;
-  if ((*s & 0x80) == 0) {
-    *codepoint = *s;
-    size = 1;
-  } else if ((*s & 0xE0) == 0xC0) {
-    *codepoint = *s & 0x1f;
-    size = 2;
-  } else if ((*s & 0xF0) == 0xE0) {
-    *codepoint = *s & 0x0f;
-    size = 3;
-  } else if ((*s & 0xF8) == 0xF0) {
-    *codepoint = *s & 0x07;
-    size = 4;
-  } else {
+  int size = decode_utf8_sequence((const unsigned char *)&view.data[offset],
+                                  view.length - offset, codepoint);
+  if (size == 0) {
     VGLTF_LOG_ERR("Invalid UTF-8 sequence");
-    return 0;
+  }
+  return size;
+}
+
+// ASCII runs are checked one vector at a time
+#define VGLTF_STR_UTF8_BLOCK_SIZE VGLTF_SIMD_VECTOR_SIZE
+
+typedef uint8_t vgltf_str_u8v
+    __attribute__((vector_size(VGLTF_STR_UTF8_BLOCK_SIZE)));
+typedef uint32_t vgltf_str_u32v
+    __attribute__((vector_size(VGLTF_STR_UTF8_BLOCK_SIZE * sizeof(uint32_t))));
+
+// Returns how many bytes the block starts with are ASCII
+static size_t load_ascii_prefix(const char *bytes, vgltf_str_u8v *block) {
+  memcpy(block, bytes, sizeof(*block));
+  vgltf_str_u8v high_bits = *block & 0x80;
+  uint64_t words[VGLTF_STR_UTF8_BLOCK_SIZE / sizeof(uint64_t)];
+  memcpy(words, &high_bits, sizeof(words));
+  uint64_t any_high_bit = 0;
+  for (size_t word_index = 0; word_index < sizeof(words) / sizeof(words[0]);
+       word_index++) {
+    any_high_bit |= words[word_index];
+  }
+  if (any_high_bit == 0) {
+    return VGLTF_STR_UTF8_BLOCK_SIZE;
   }
 
-  for (int i = 1; i < size; i++) {
-    if ((s[i] & 0xC0) != 0x80) {
-      VGLTF_LOG_ERR("Invalid UTF-8 continuation byte");
-      return 0;
+  size_t word_index = 0;
+  while (words[word_index] == 0) {
+    word_index++;
+  }
+  // Little endian, the lowest set bit belongs to the first non ASCII byte
+  return word_index * sizeof(uint64_t) +
+         __builtin_ctzll(words[word_index]) / 8;
+}
+
+bool vgltf_string_view_utf8_validate(struct vgltf_string_view view) {
+  const unsigned char *bytes = (const unsigned char *)view.data;
+  size_t offset = 0;
+  while (offset < view.length) {
+    if (offset + VGLTF_STR_UTF8_BLOCK_SIZE <= view.length) {
+      vgltf_str_u8v block;
+      size_t ascii_length = load_ascii_prefix(view.data + offset, &block);
+      offset += ascii_length;
+      if (ascii_length == VGLTF_STR_UTF8_BLOCK_SIZE) {
+        continue;
+      }
+    }
+
+    uint32_t codepoint;
+    int size =
+        decode_utf8_sequence(bytes + offset, view.length - offset, &codepoint);
+    if (size == 0) {
+      return false;
+    }
+    offset += size;
+  }
+
+  return true;
+}
+
+bool vgltf_string_view_utf8_decode(struct vgltf_string_view view,
+                                   uint32_t *codepoints,
+                                   size_t codepoint_capacity,
+                                   size_t *codepoint_count) {
+  assert(codepoints);
+  assert(codepoint_count);
+  const unsigned char *bytes = (const unsigned char *)view.data;
+  size_t offset = 0;
+  size_t count = 0;
+  while (offset < view.length) {
+    // The whole block is widened, only its ASCII prefix is kept
+    if (offset + VGLTF_STR_UTF8_BLOCK_SIZE <= view.length &&
+        count + VGLTF_STR_UTF8_BLOCK_SIZE <= codepoint_capacity) {
+      vgltf_str_u8v block;
+      size_t ascii_length = load_ascii_prefix(view.data + offset, &block);
+      vgltf_str_u32v widened = __builtin_convertvector(block, vgltf_str_u32v);
+      memcpy(codepoints + count, &widened, sizeof(widened));
+      offset += ascii_length;
+      count += ascii_length;
+      if (ascii_length == VGLTF_STR_UTF8_BLOCK_SIZE) {
+        continue;
+      }
     }
 
-    *codepoint = (*codepoint << 6) | (s[i] & 0x3F);
+    if (count == codepoint_capacity) {
+      VGLTF_LOG_ERR("Codepoint array cannot fit the decoded string");
+      return false;
+    }
+    int size = decode_utf8_sequence(bytes + offset, view.length - offset,
+                                    &codepoints[count]);
+    if (size == 0) {
+      VGLTF_LOG_ERR("Invalid UTF-8 sequence at offset %zu", offset);
+      return false;
+    }
+    offset += size;
+    count++;
   }
 
-  return size;
+  *codepoint_count = count;
+  return true;
 }
+
 int vgltf_string_utf8_encode_codepoint(uint32_t codepoint,
                                      char encoded_codepoint[4]) {
   assert(encoded_codepoint);
@@ -173,7 +296,7 @@ bool vgltf_string_eq_view(const struct vgltf_string string,
          (strncmp(string.data, view.data, string.length) == 0);
 }
 uint64_t vgltf_string_hash(const struct vgltf_string string) {
-  return vgltf_hash_fnv_1a(string.data, string.length);
+  return vgltf_hash_64(string.data, string.length);
 }
 bool vgltf_string_eq(struct vgltf_string string, struct vgltf_string other) {
   return string.length == other.length &&
@@ -30,6 +30,15 @@ uint64_t vgltf_string_view_hash(const struct vgltf_string_view view);
 int vgltf_string_view_utf8_codepoint_at_offset(struct vgltf_string_view view,
                                              size_t offset,
                                              uint32_t *codepoint);
+// Checks the whole view is well formed UTF-8, ASCII runs are checked 16 or 32
+// bytes at a time
+bool vgltf_string_view_utf8_validate(struct vgltf_string_view view);
+// Decodes the whole view, view.length codepoints are always enough.
+// Returns false if the view isn't well formed UTF-8 or doesn't fit.
+bool vgltf_string_view_utf8_decode(struct vgltf_string_view view,
+                                   uint32_t *codepoints,
+                                   size_t codepoint_capacity,
+                                   size_t *codepoint_count);
 // codepoint has to be a char[4]
 int vgltf_string_utf8_encode_codepoint(uint32_t codepoint,
                                      char encoded_codepoint[4]);
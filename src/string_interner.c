@@ -0,0 +1,152 @@
+#include "string_interner.h"
+#include "log.h"
+#include <assert.h>
+#include <string.h>
+
+bool vgltf_string_interner_init(struct vgltf_string_interner *interner,
+                                struct vgltf_allocator *allocator,
+                                uint32_t max_string_count,
+                                size_t max_byte_count) {
+  assert(interner);
+  assert(allocator);
+  assert(max_string_count > 0);
+  // At most half full, so probe sequences stay short and always end
+  interner->slot_capacity = 1;
+  while (interner->slot_capacity < 2 * max_string_count) {
+    interner->slot_capacity *= 2;
+  }
+  interner->max_string_count = max_string_count;
+  atomic_init(&interner->string_count, 0);
+
+  interner->slots = vgltf_allocator_allocate_array(
+      allocator, interner->slot_capacity, sizeof(vgltf_string_id));
+  if (!interner->slots) {
+    VGLTF_LOG_ERR("Couldn't allocate the string interner slots");
+    goto err;
+  }
+  for (uint32_t slot_index = 0; slot_index < interner->slot_capacity;
+       slot_index++) {
+    atomic_init(&interner->slots[slot_index], VGLTF_STRING_ID_INVALID);
+  }
+
+  interner->entries = vgltf_allocator_allocate_array(
+      allocator, max_string_count, sizeof(struct vgltf_string_interner_entry));
+  if (!interner->entries) {
+    VGLTF_LOG_ERR("Couldn't allocate the string interner entries");
+    goto free_slots;
+  }
+
+  vgltf_arena_init(allocator, &interner->arena, max_byte_count);
+  if (!interner->arena.data) {
+    VGLTF_LOG_ERR("Couldn't allocate the string interner arena");
+    goto free_entries;
+  }
+
+  if (!vgltf_platform_mutex_init(&interner->insert_mutex)) {
+    VGLTF_LOG_ERR("Couldn't create the string interner mutex");
+    goto deinit_arena;
+  }
+
+  return true;
+deinit_arena:
+  vgltf_arena_deinit(allocator, &interner->arena);
+free_entries:
+  vgltf_allocator_free(allocator, interner->entries);
+free_slots:
+  vgltf_allocator_free(allocator, (void *)interner->slots);
+err:
+  return false;
+}
+
+void vgltf_string_interner_deinit(struct vgltf_string_interner *interner,
+                                  struct vgltf_allocator *allocator) {
+  assert(interner);
+  assert(allocator);
+  vgltf_platform_mutex_deinit(&interner->insert_mutex);
+  vgltf_arena_deinit(allocator, &interner->arena);
+  vgltf_allocator_free(allocator, interner->entries);
+  vgltf_allocator_free(allocator, (void *)interner->slots);
+}
+
+// Returns the id of the string, or VGLTF_STRING_ID_INVALID and the empty slot
+// ending its probe sequence. The acquire load pairs with the release store
+// publishing an id, so the entry it indexes is complete.
+static vgltf_string_id
+find_slot(const struct vgltf_string_interner *interner,
+          struct vgltf_string_view string, uint64_t hash,
+          uint32_t *slot_index) {
+  uint32_t mask = interner->slot_capacity - 1;
+  for (*slot_index = hash & mask;; *slot_index = (*slot_index + 1) & mask) {
+    vgltf_string_id id = atomic_load_explicit(&interner->slots[*slot_index],
+                                              memory_order_acquire);
+    if (id == VGLTF_STRING_ID_INVALID) {
+      return VGLTF_STRING_ID_INVALID;
+    }
+
+    const struct vgltf_string_interner_entry *entry =
+        &interner->entries[id - 1];
+    if (entry->hash == hash && vgltf_string_view_eq(entry->string, string)) {
+      return id;
+    }
+  }
+}
+
+vgltf_string_id
+vgltf_string_interner_intern(struct vgltf_string_interner *interner,
+                             struct vgltf_string_view string) {
+  assert(interner);
+  uint64_t hash = vgltf_string_view_hash(string);
+  uint32_t slot_index;
+  vgltf_string_id id = find_slot(interner, string, hash, &slot_index);
+  if (id != VGLTF_STRING_ID_INVALID) {
+    return id;
+  }
+
+  vgltf_platform_mutex_lock(&interner->insert_mutex);
+  // Another thread may have inserted it since
+  id = find_slot(interner, string, hash, &slot_index);
+  if (id != VGLTF_STRING_ID_INVALID) {
+    goto unlock;
+  }
+
+  uint32_t string_count =
+      atomic_load_explicit(&interner->string_count, memory_order_relaxed);
+  if (string_count == interner->max_string_count ||
+      interner->arena.size + string.length + 1 > interner->arena.capacity) {
+    VGLTF_LOG_ERR("String interner full, couldn't intern %.*s",
+                  (int)string.length, string.data);
+    goto unlock;
+  }
+
+  char *data = vgltf_arena_allocate(&interner->arena, string.length + 1);
+  memcpy(data, string.data, string.length);
+  data[string.length] = '\0';
+  interner->entries[string_count] = (struct vgltf_string_interner_entry){
+      .string = {.data = data, .length = string.length}, .hash = hash};
+  id = string_count + 1;
+  atomic_store_explicit(&interner->string_count, id, memory_order_relaxed);
+  atomic_store_explicit(&interner->slots[slot_index], id,
+                        memory_order_release);
+unlock:
+  vgltf_platform_mutex_unlock(&interner->insert_mutex);
+  return id;
+}
+
+vgltf_string_id
+vgltf_string_interner_find(const struct vgltf_string_interner *interner,
+                           struct vgltf_string_view string) {
+  assert(interner);
+  uint32_t slot_index;
+  return find_slot(interner, string, vgltf_string_view_hash(string),
+                   &slot_index);
+}
+
+struct vgltf_string_view
+vgltf_string_interner_get(const struct vgltf_string_interner *interner,
+                          vgltf_string_id id) {
+  assert(interner);
+  assert(id != VGLTF_STRING_ID_INVALID &&
+         id <= atomic_load_explicit(&interner->string_count,
+                                    memory_order_relaxed));
+  return interner->entries[id - 1].string;
+}
@@ -0,0 +1,56 @@
+#ifndef VGLTF_STRING_INTERNER_H
+#define VGLTF_STRING_INTERNER_H
+
+#include "alloc.h"
+#include "platform.h"
+#include "str.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Interned strings are equal if their ids are
+typedef uint32_t vgltf_string_id;
+constexpr vgltf_string_id VGLTF_STRING_ID_INVALID = 0;
+
+struct vgltf_string_interner_entry {
+  struct vgltf_string_view string;
+  uint64_t hash;
+};
+
+// Maps strings to stable ids, every unique string is stored once, null
+// terminated, in an arena. Lookups of interned strings don't lock, inserting
+// takes a mutex. Nothing is ever removed, so ids and views stay valid until
+// deinit.
+struct vgltf_string_interner {
+  struct vgltf_arena arena;
+  struct vgltf_platform_mutex insert_mutex;
+  // Open addressing table of ids, published after their entry is written
+  _Atomic vgltf_string_id *slots;
+  uint32_t slot_capacity;
+  // Indexed by id - 1
+  struct vgltf_string_interner_entry *entries;
+  uint32_t max_string_count;
+  atomic_uint_least32_t string_count;
+};
+
+bool vgltf_string_interner_init(struct vgltf_string_interner *interner,
+                                struct vgltf_allocator *allocator,
+                                uint32_t max_string_count,
+                                size_t max_byte_count);
+void vgltf_string_interner_deinit(struct vgltf_string_interner *interner,
+                                  struct vgltf_allocator *allocator);
+
+// Returns VGLTF_STRING_ID_INVALID if the interner is full
+vgltf_string_id
+vgltf_string_interner_intern(struct vgltf_string_interner *interner,
+                             struct vgltf_string_view string);
+
+// Returns VGLTF_STRING_ID_INVALID if the string isn't interned, never locks
+vgltf_string_id
+vgltf_string_interner_find(const struct vgltf_string_interner *interner,
+                           struct vgltf_string_view string);
+
+struct vgltf_string_view
+vgltf_string_interner_get(const struct vgltf_string_interner *interner,
+                          vgltf_string_id id);
+
+#endif // VGLTF_STRING_INTERNER_H
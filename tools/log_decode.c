@@ -0,0 +1,74 @@
+// Decodes a binary log written by a build with the binary_log option:
+// vgltf_log_decode vgltf_log.bin
+#include "../src/log_binary.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *LEVEL_STR[] = {"debug", "info", "error"};
+static constexpr int MAX_STRING_LENGTH = UINT16_MAX;
+
+static bool read_string(FILE *file, char *string) {
+  uint16_t length;
+  if (fread(&length, sizeof(length), 1, file) != 1 ||
+      fread(string, 1, length, file) != length) {
+    return false;
+  }
+
+  string[length] = '\0';
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <binary log>\n", argv[0]);
+    goto err;
+  }
+
+  FILE *file = fopen(argv[1], "rb");
+  if (!file) {
+    fprintf(stderr, "Couldn't open %s\n", argv[1]);
+    goto err;
+  }
+
+  char magic[sizeof(VGLTF_LOG_BINARY_MAGIC)];
+  if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+      memcmp(magic, VGLTF_LOG_BINARY_MAGIC, sizeof(magic)) != 0) {
+    fprintf(stderr, "%s isn't a binary log\n", argv[1]);
+    goto close_file;
+  }
+
+  static char file_path[MAX_STRING_LENGTH + 1];
+  static char format[MAX_STRING_LENGTH + 1];
+  static char arguments[MAX_STRING_LENGTH];
+  static char message[4096];
+  while (true) {
+    uint8_t level;
+    int32_t line;
+    uint16_t arguments_size;
+    if (fread(&level, sizeof(level), 1, file) != 1) {
+      break;
+    }
+    if (fread(&line, sizeof(line), 1, file) != 1 ||
+        !read_string(file, file_path) || !read_string(file, format) ||
+        fread(&arguments_size, sizeof(arguments_size), 1, file) != 1 ||
+        fread(arguments, 1, arguments_size, file) != arguments_size) {
+      fprintf(stderr, "Truncated record\n");
+      goto close_file;
+    }
+
+    vgltf_log_binary_format(message, sizeof(message), format, arguments,
+                            arguments_size);
+    printf("[%s %s:%d] %s\n",
+           level < sizeof(LEVEL_STR) / sizeof(LEVEL_STR[0]) ? LEVEL_STR[level]
+                                                            : "?",
+           file_path, line, message);
+  }
+
+  fclose(file);
+  return 0;
+close_file:
+  fclose(file);
+err:
+  return 1;
+}